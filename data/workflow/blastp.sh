@@ -27,26 +27,42 @@ ALN_RES_MERGE="$TMP_PATH/aln_0"
 while [ "$STEP" -lt "$STEPS" ]; do
     SENS_PARAM=SENSE_${STEP}
     eval SENS="\$$SENS_PARAM"
-    # call prefilter module
-    if notExists "$TMP_PATH/pref_$STEP.dbtype"; then
-        # shellcheck disable=SC2086
-        $RUNNER "$MMSEQS" prefilter "$INPUT" "$TARGET" "$TMP_PATH/pref_$STEP" $PREFILTER_PAR -s "$SENS" \
-            || fail "Prefilter died"
-    fi
-
-    # call alignment module
-    if [ "$STEPS" -eq 1 ]; then
-        if notExists "$3.dbtype"; then
+    if [ -n "$PREFILTER_ALIGN" ]; then
+        # prefilter and alignment in one process, the prefilter results are never written
+        ALN_RES="$TMP_PATH/aln_$STEP"
+        if [ "$STEPS" -eq 1 ]; then
+            ALN_RES="$3"
+        fi
+        if notExists "$ALN_RES.dbtype"; then
             # shellcheck disable=SC2086
-            $RUNNER "$MMSEQS" "${ALIGN_MODULE}" "$INPUT" "$TARGET${ALIGNMENT_DB_EXT}" "$TMP_PATH/pref_$STEP" "$3" $ALIGNMENT_PAR  \
-                || fail "Alignment died"
+            $RUNNER "$MMSEQS" prefilteralign "$INPUT" "$TARGET" "$ALN_RES" $PREFILTER_ALIGN_PAR -s "$SENS" \
+                || fail "Prefilteralign died"
+        fi
+        if [ "$STEPS" -eq 1 ]; then
+            break
         fi
-        break
     else
-        if notExists "$TMP_PATH/aln_$STEP.dbtype"; then
+        # call prefilter module
+        if notExists "$TMP_PATH/pref_$STEP.dbtype"; then
             # shellcheck disable=SC2086
-            $RUNNER "$MMSEQS" "${ALIGN_MODULE}" "$INPUT" "$TARGET${ALIGNMENT_DB_EXT}" "$TMP_PATH/pref_$STEP" "$TMP_PATH/aln_$STEP" $ALIGNMENT_PAR  \
-                || fail "Alignment died"
+            $RUNNER "$MMSEQS" prefilter "$INPUT" "$TARGET" "$TMP_PATH/pref_$STEP" $PREFILTER_PAR -s "$SENS" \
+                || fail "Prefilter died"
+        fi
+
+        # call alignment module
+        if [ "$STEPS" -eq 1 ]; then
+            if notExists "$3.dbtype"; then
+                # shellcheck disable=SC2086
+                $RUNNER "$MMSEQS" "${ALIGN_MODULE}" "$INPUT" "$TARGET${ALIGNMENT_DB_EXT}" "$TMP_PATH/pref_$STEP" "$3" $ALIGNMENT_PAR  \
+                    || fail "Alignment died"
+            fi
+            break
+        else
+            if notExists "$TMP_PATH/aln_$STEP.dbtype"; then
+                # shellcheck disable=SC2086
+                $RUNNER "$MMSEQS" "${ALIGN_MODULE}" "$INPUT" "$TARGET${ALIGNMENT_DB_EXT}" "$TMP_PATH/pref_$STEP" "$TMP_PATH/aln_$STEP" $ALIGNMENT_PAR  \
+                    || fail "Alignment died"
+            fi
         fi
     fi
 
@@ -78,7 +94,12 @@ while [ "$STEP" -lt "$STEPS" ]; do
     #do not create subdb at last step
     if [ "$STEP" -lt "$((STEPS-1))" ]; then
         if notExists "$TMP_PATH/order_$STEP.dbtype"; then
-            awk '$3 < 2 { print $1 }' "$TMP_PATH/aln_$STEP.index" > "$TMP_PATH/order_$STEP" \
+            if notExists "$TMP_PATH/aln_$STEP.index_txt"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" convertdbindex "$TMP_PATH/aln_$STEP" "$TMP_PATH/aln_$STEP.index_txt" --index-format 0 ${VERBOSITY} \
+                    || fail "convertdbindex died"
+            fi
+            awk '$3 < 2 { print $1 }' "$TMP_PATH/aln_$STEP.index_txt" > "$TMP_PATH/order_$STEP" \
                 || fail "Awk step $STEP died"
         fi
 
@@ -107,7 +128,7 @@ if [ -n "$REMOVE_TMP" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/aln_$STEP" ${VERBOSITY}
         # shellcheck disable=SC2086
         "$MMSEQS" rmdb "${TMP_PATH}/input_$STEP" ${VERBOSITY}
-        rm -f "${TMP_PATH}/order_$STEP"
+        rm -f "${TMP_PATH}/order_$STEP" "${TMP_PATH}/aln_$STEP.index_txt"
         STEP="$((STEP+1))"
     done
     # shellcheck disable=SC2086
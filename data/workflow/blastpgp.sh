@@ -75,11 +75,32 @@ while [ $STEP -lt $NUM_IT ]; do
         if notExists "$TMP_PATH/aln_$STEP.dbtype"; then
             STEPONE=$((STEP-1))
 
+            MERGE_KEYS="$QUERYDB"
+            if [ -n "$SKIP_CONVERGED" ]; then
+                # only queries with new hits are searched again, all others have converged
+                if notExists "$TMP_PATH/aln_tmp_$STEP.index_txt"; then
+                    # shellcheck disable=SC2086
+                    "$MMSEQS" convertdbindex "$TMP_PATH/aln_tmp_$STEP" "$TMP_PATH/aln_tmp_$STEP.index_txt" --index-format 0 ${VERBOSITY} \
+                        || fail "convertdbindex died"
+                fi
+                awk '$3 > 1 { print $1 }' "$TMP_PATH/aln_tmp_$STEP.index_txt" > "$TMP_PATH/changed_$STEP" \
+                    || fail "Awk step $STEP died"
+                if notExists "$TMP_PATH/query_$STEP.index_txt"; then
+                    # shellcheck disable=SC2086
+                    "$MMSEQS" convertdbindex "$QUERYDB" "$TMP_PATH/query_$STEP.index_txt" --index-format 0 ${VERBOSITY} \
+                        || fail "convertdbindex died"
+                fi
+                SEARCHED="$(wc -l < "$TMP_PATH/query_$STEP.index_txt")"
+                echo "Iteration $((STEP+1)): $SEARCHED queries searched, $(wc -l < "$TMP_PATH/changed_$STEP") with new hits"
+                # the profiles of this iteration only contain the searched queries
+                MERGE_KEYS="$1"
+            fi
+
             if [ $STEP -ne $((NUM_IT  - 1)) ]; then
-                "$MMSEQS" mergedbs "$QUERYDB" "$TMP_PATH/aln_$STEP" "$TMP_PATH/aln_$STEPONE" "$TMP_PATH/aln_tmp_$STEP" \
+                "$MMSEQS" mergedbs "$MERGE_KEYS" "$TMP_PATH/aln_$STEP" "$TMP_PATH/aln_$STEPONE" "$TMP_PATH/aln_tmp_$STEP" \
                     || fail "Alignment died"
             else
-                "$MMSEQS" mergedbs "$QUERYDB" "$3" "$TMP_PATH/aln_$STEPONE" "$TMP_PATH/aln_tmp_$STEP" \
+                "$MMSEQS" mergedbs "$MERGE_KEYS" "$3" "$TMP_PATH/aln_$STEPONE" "$TMP_PATH/aln_tmp_$STEP" \
                         || fail "Alignment died"
             fi
             "$MMSEQS" rmdb "$TMP_PATH/aln_$STEPONE"
@@ -89,11 +110,25 @@ while [ $STEP -lt $NUM_IT ]; do
 
 # create profiles
     if [ $STEP -ne $((NUM_IT  - 1)) ]; then
+        PROFILE_INPUT="$TMP_PATH/aln_$STEP"
+        if [ -n "$SKIP_CONVERGED" ] && [ $STEP -gt 0 ]; then
+            if [ ! -s "$TMP_PATH/changed_$STEP" ]; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" mvdb "$TMP_PATH/aln_$STEP" "$3" ${VERBOSITY}
+                break
+            fi
+            PROFILE_INPUT="$TMP_PATH/aln_changed_$STEP"
+            if notExists "$PROFILE_INPUT.dbtype"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" createsubdb "$TMP_PATH/changed_$STEP" "$TMP_PATH/aln_$STEP" "$PROFILE_INPUT" ${VERBOSITY} --subdb-mode 1 \
+                    || fail "Order step $STEP died"
+            fi
+        fi
         if notExists "$TMP_PATH/profile_$STEP.dbtype"; then
             PARAM="PROFILE_PAR_$STEP"
             eval TMP="\$$PARAM"
             # shellcheck disable=SC2086
-            $RUNNER "$MMSEQS" result2profile "$QUERYDB" "$2" "$TMP_PATH/aln_$STEP" "$TMP_PATH/profile_$STEP" ${TMP} \
+            $RUNNER "$MMSEQS" result2profile "$QUERYDB" "$2" "$PROFILE_INPUT" "$TMP_PATH/profile_$STEP" ${TMP} \
             || fail "Create profile died"
         fi
     fi
@@ -110,6 +145,10 @@ if [ -n "$REMOVE_TMP" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/aln_$STEP" ${VERBOSITY}
         # shellcheck disable=SC2086
         "$MMSEQS" rmdb "${TMP_PATH}/profile_$STEP" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/aln_changed_$STEP" ${VERBOSITY}
+        # the soft linked data of aln_changed is dangling once aln was removed
+        rm -f "${TMP_PATH}/aln_changed_$STEP" "${TMP_PATH}/changed_$STEP" "${TMP_PATH}/aln_tmp_$STEP.index_txt" "${TMP_PATH}/query_$STEP.index_txt"
         STEP=$((STEP+1))
     done
     rm -f "$TMP_PATH/blastpgp.sh"
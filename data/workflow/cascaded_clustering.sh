@@ -146,9 +146,21 @@ if [ -n "$REASSIGN" ]; then
     if notExists "${TMP_PATH}/seq_wrong_assigned_pref.dbtype"; then
         if notExists "${TMP_PATH}/seq_seeds.merged.dbtype"; then
             # combine seq dbs
-            MAXOFFSET=$(awk '($2+$3) > max{max=$2+$3}END{print max}' "${TMP_PATH}/seq_seeds.index")
-            awk -v OFFSET="${MAXOFFSET}" 'FNR==NR{print $0; next}{print $1"\t"$2+OFFSET"\t"$3}' "${TMP_PATH}/seq_seeds.index" \
-                 "${TMP_PATH}/seq_wrong_assigned.index" > "${TMP_PATH}/seq_seeds.merged.index"
+            if notExists "${TMP_PATH}/seq_seeds.index_txt"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" convertdbindex "${TMP_PATH}/seq_seeds" "${TMP_PATH}/seq_seeds.index_txt" --index-format 0 ${VERBOSITY} \
+                    || fail "convertdbindex died"
+            fi
+            if notExists "${TMP_PATH}/seq_wrong_assigned.index_txt"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" convertdbindex "${TMP_PATH}/seq_wrong_assigned" "${TMP_PATH}/seq_wrong_assigned.index_txt" --index-format 0 ${VERBOSITY} \
+                    || fail "convertdbindex died"
+            fi
+            SEEDS_INDEX="${TMP_PATH}/seq_seeds.index_txt"
+            WRONG_INDEX="${TMP_PATH}/seq_wrong_assigned.index_txt"
+            MAXOFFSET=$(awk '($2+$3) > max{max=$2+$3}END{print max}' "${SEEDS_INDEX}")
+            awk -v OFFSET="${MAXOFFSET}" 'FNR==NR{print $0; next}{print $1"\t"$2+OFFSET"\t"$3}' "${SEEDS_INDEX}" \
+                 "${WRONG_INDEX}" > "${TMP_PATH}/seq_seeds.merged.index"
             ln -s "$(abspath "${TMP_PATH}/seq_seeds")" "${TMP_PATH}/seq_seeds.merged.0"
             ln -s "$(abspath "${TMP_PATH}/seq_wrong_assigned")" "${TMP_PATH}/seq_seeds.merged.1"
             cp "${TMP_PATH}/seq_seeds.dbtype" "${TMP_PATH}/seq_seeds.merged.dbtype"
@@ -184,7 +196,18 @@ if [ -n "$REASSIGN" ]; then
     fi
 
     if notExists "${TMP_PATH}/missing.single.seqs.db.dbtype"; then
-         awk 'FNR==NR{if($3 > 1){ f[$1]=1; }next} !($1 in f){print $1"\t"$1}' "${TMP_PATH}/clu_accepted_plus_wrong.index" "${SOURCE}.index" > "${TMP_PATH}/missing.single.seqs"
+        if notExists "${TMP_PATH}/clu_accepted_plus_wrong.index_txt"; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" convertdbindex "${TMP_PATH}/clu_accepted_plus_wrong" "${TMP_PATH}/clu_accepted_plus_wrong.index_txt" --index-format 0 ${VERBOSITY} \
+                || fail "convertdbindex died"
+        fi
+        if notExists "${TMP_PATH}/source.index_txt"; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" convertdbindex "${SOURCE}" "${TMP_PATH}/source.index_txt" --index-format 0 ${VERBOSITY} \
+                || fail "convertdbindex died"
+        fi
+         awk 'FNR==NR{if($3 > 1){ f[$1]=1; }next} !($1 in f){print $1"\t"$1}' "${TMP_PATH}/clu_accepted_plus_wrong.index_txt" \
+             "${TMP_PATH}/source.index_txt" > "${TMP_PATH}/missing.single.seqs"
         # shellcheck disable=SC2086
         "$MMSEQS" tsv2db "${TMP_PATH}/missing.single.seqs" "${TMP_PATH}/missing.single.seqs.db" --output-dbtype 6 ${VERBCOMPRESS} \
                             || fail "tsv2db reassign died"
@@ -229,6 +252,8 @@ if [ -n "$REASSIGN" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln_ocol" ${VERBOSITY}
         rm -f "${TMP_PATH}/missing.single.seqs"
         rm -f "${TMP_PATH}/clu_accepted_plus_wrong.tsv"
+        rm -f "${TMP_PATH}/seq_seeds.index_txt" "${TMP_PATH}/seq_wrong_assigned.index_txt"
+        rm -f "${TMP_PATH}/clu_accepted_plus_wrong.index_txt" "${TMP_PATH}/source.index_txt"
         # shellcheck disable=SC2086
         "$MMSEQS" rmdb "${TMP_PATH}/missing.single.seqs.db" ${VERBOSITY}
         # shellcheck disable=SC2086
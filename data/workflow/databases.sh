@@ -359,6 +359,10 @@ if [ -n "${TAXONOMY}" ] && notExists "${OUTDB}_mapping"; then
         SOH_CHAR=$(printf '\001')
         cut -d "$SOH_CHAR" -f1 "${TMP_PATH}/header_pref.tsv" | awk -F'\t' '{ match($2, /^([^ .]+)/, accession); match($2, /\[([^\]]+)\]$/, name); print $1"\t"accession[1]"\t"name[1]; }' > "${TMP_PATH}/acc_names.tsv"
         awk 'FNR == 1 { FINDEX++; } FINDEX <= 2 { a2t[$1] = $3; next; } FINDEX == 3 { n2t[$2] = $1; next; } { split($2, a, "."); $2 = a[1]; } $2 in a2t { print $1"\t"a2t[$2]; next; } $3 in n2t { print $1"\t"n2t[$3]; }' "${TMP_PATH}/pdb.accession2taxid" "${TMP_PATH}/prot.accession2taxid" "${TMP_PATH}/names_unique.tsv" "${TMP_PATH}/acc_names.tsv" > "${OUTDB}_mapping"
+        # createtaxdb converted the empty mapping
+        # shellcheck disable=SC2086
+        "${MMSEQS}" createbintaxmapping "${OUTDB}_mapping" "${OUTDB}_mapping.bin" ${VERB_PAR} \
+            || fail "createbintaxmapping died"
        ;;
      *)
        # shellcheck disable=SC2086
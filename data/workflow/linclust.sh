@@ -36,7 +36,12 @@ if notExists "${TMP_PATH}/pre_clust.dbtype"; then
         || fail "Pre-clustering step died"
 fi
 
-awk '{ print $1 }' "${TMP_PATH}/pre_clust.index" > "${TMP_PATH}/order_redundancy"
+if notExists "${TMP_PATH}/pre_clust.index_txt"; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" convertdbindex "${TMP_PATH}/pre_clust" "${TMP_PATH}/pre_clust.index_txt" --index-format 0 ${VERBOSITY} \
+        || fail "convertdbindex died"
+fi
+awk '{ print $1 }' "${TMP_PATH}/pre_clust.index_txt" > "${TMP_PATH}/order_redundancy"
 if notExists "${TMP_PATH}/input_step_redundancy.dbtype"; then
     # shellcheck disable=SC2086
     "$MMSEQS" createsubdb "${TMP_PATH}/order_redundancy" "$INPUT" "${TMP_PATH}/input_step_redundancy" ${VERBOSITY} --subdb-mode 1 \
@@ -97,7 +102,7 @@ if [ -n "$REMOVE_TMP" ]; then
     "$MMSEQS" rmdb "${TMP_PATH}/pre_clust" ${VERBOSITY}
     # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/input_step_redundancy" ${VERBOSITY}
-    rm -f "${TMP_PATH}/order_redundancy"
+    rm -f "${TMP_PATH}/order_redundancy" "${TMP_PATH}/pre_clust.index_txt"
 
     # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/pref_filter1" ${VERBOSITY}
@@ -42,12 +42,18 @@ TARGET="$(abspath "$2")"
 RESULT="$3"
 TMP_PATH="$4"
 
+if notExists "${TMP_PATH}/target.index_txt"; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" convertdbindex "${TARGET}" "${TMP_PATH}/target.index_txt" --index-format 0 ${VERBOSITY} \
+        || fail "convertdbindex died"
+fi
+
 PROFILEDB="${TMP_PATH}/profileDB"
 if notExists "${PROFILEDB}.dbtype"; then
     # symlink the profile DB that can be reduced at every iteration the search
     ln -s "${TARGET}" "${PROFILEDB}"
     ln -s "${TARGET}.dbtype" "${PROFILEDB}.dbtype"
-    cp -f "${TARGET}.index" "${PROFILEDB}.index"
+    cp -f "${TMP_PATH}/target.index_txt" "${PROFILEDB}.index"
 
     echo "${AVAIL_DISK}" > "${PROFILEDB}.meta"
 else
@@ -55,7 +61,12 @@ else
 fi
 
 TOTAL_NUM_PROFILES=$(wc -l < "${PROFILEDB}.index")
-NUM_SEQS_THAT_SATURATE="$(wc -l < "${INPUT}.index")"
+if notExists "${TMP_PATH}/input.index_txt"; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" convertdbindex "${INPUT}" "${TMP_PATH}/input.index_txt" --index-format 0 ${VERBOSITY} \
+        || fail "convertdbindex died"
+fi
+NUM_SEQS_THAT_SATURATE="$(wc -l < "${TMP_PATH}/input.index_txt")"
 FIRST_INDEX_LINE=1
 NUM_PROFS_IN_STEP=1
 NUM_PREF_RESULTS_IN_ALL_PREV_STEPS=0
@@ -99,7 +110,7 @@ while [ "${FIRST_INDEX_LINE}" -le "${TOTAL_NUM_PROFILES}" ]; do
     # take a chunk of profiles from FIRST_INDEX_LINE to (FIRST_INDEX_LINE + NUM_PROFS_IN_STEP -1)
     LAST_INDEX_LINE_TO_PROCESS="$((FIRST_INDEX_LINE+NUM_PROFS_IN_STEP-1))"
     awk -v first="${FIRST_INDEX_LINE}" -v last="${LAST_INDEX_LINE_TO_PROCESS}" \
-        "NR >= first && NR <= last { print; }" "${TARGET}.index" > "${PROFILEDB}.index"
+        "NR >= first && NR <= last { print; }" "${TMP_PATH}/target.index_txt" > "${PROFILEDB}.index"
 
     # prefilter current chunk
     if notExists "${TMP_PATH}/pref.done"; then
@@ -188,5 +199,6 @@ if [ -n "$REMOVE_TMP" ]; then
         CURR_STEP="$((CURR_STEP+1))"
     done
     rm -f "${PROFILEDB}.meta"
+    rm -f "${TMP_PATH}/target.index_txt" "${TMP_PATH}/input.index_txt"
     rm -f "$TMP_PATH/searchslicedtargetprofile.sh"
 fi
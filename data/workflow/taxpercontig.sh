@@ -45,7 +45,12 @@ if [ -n "${ORF_FILTER}" ]; then
     fi
 
     if notExists "${TMP_PATH}/orfs_aln.list"; then
-        awk '$3 > 1 { print $1 }' "${TMP_PATH}/orfs_aln.index" > "${TMP_PATH}/orfs_aln.list"
+        if notExists "${TMP_PATH}/orfs_aln.index_txt"; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" convertdbindex "${TMP_PATH}/orfs_aln" "${TMP_PATH}/orfs_aln.index_txt" --index-format 0 ${VERBOSITY} \
+                || fail "convertdbindex died"
+        fi
+        awk '$3 > 1 { print $1 }' "${TMP_PATH}/orfs_aln.index_txt" > "${TMP_PATH}/orfs_aln.list"
     fi
 
     if notExists "${TMP_PATH}/orfs_filter.dbtype"; then
@@ -97,7 +102,7 @@ if [ -n "${REMOVE_TMP}" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/orfs_filter" ${VERBOSITY}
         # shellcheck disable=SC2086
         "$MMSEQS" rmdb "${TMP_PATH}/orfs_filter_h" ${VERBOSITY}
-        rm -f "${TMP_PATH}/orfs_aln.list"
+        rm -f "${TMP_PATH}/orfs_aln.list" "${TMP_PATH}/orfs_aln.index_txt"
     fi
      # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/orfs_tax" ${VERBOSITY}
@@ -52,7 +52,12 @@ if [ -n "$QUERY_NUCL" ] && [ -n "${ORF_FILTER}" ]; then
     fi
 
     if notExists "${TMP_PATH}/q_orfs_aa_filter.dbtype"; then
-        awk '$3 > 1 { print $1 }' "${TMP_PATH}/q_orfs_aa_pref.index" > "${TMP_PATH}/q_orfs_aa_filter.list"
+        if notExists "${TMP_PATH}/q_orfs_aa_pref.index_txt"; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" convertdbindex "${TMP_PATH}/q_orfs_aa_pref" "${TMP_PATH}/q_orfs_aa_pref.index_txt" --index-format 0 ${VERBOSITY} \
+                || fail "convertdbindex died"
+        fi
+        awk '$3 > 1 { print $1 }' "${TMP_PATH}/q_orfs_aa_pref.index_txt" > "${TMP_PATH}/q_orfs_aa_filter.list"
         # shellcheck disable=SC2086
         "$MMSEQS" createsubdb "${TMP_PATH}/q_orfs_aa_filter.list" "${QUERY}" "${TMP_PATH}/q_orfs_aa_filter" ${CREATESUBDB_PAR} \
             || fail "createsubdb died"
@@ -88,5 +93,6 @@ if [ -n "$REMOVE_TMP" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/q_orfs_aa_filter" ${VERBOSITY}
         rm -f "${TMP_PATH}/q_orfs_aa_filter.list"
     fi
+    rm -f "${TMP_PATH}/q_orfs_aa_pref.index_txt"
     rm -f "${TMP_PATH}/translated_search.sh"
 fi
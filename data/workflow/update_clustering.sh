@@ -29,25 +29,11 @@ abspath() {
     fi
 }
 
-joinAndReplace() {
-    INPUT="$1"
-    OUTPUT="$2"
-    MAPPING="$3"
-    FIELDS="$4"
-
-    LC_ALL=C join -t $'\t' -o "$FIELDS" <(LC_ALL=C sort -T "${TMP_PATH}" -k1,1 "$MAPPING") \
-        <(LC_ALL=C sort -T "${TMP_PATH}" -k1,1 "$INPUT") \
-        | LC_ALL=C sort -T "${TMP_PATH}" -k1,1 > "$OUTPUT"
-}
-
 hasCommand () {
     command -v "$1" >/dev/null 2>&1 || { echo "Please make sure that $1 is in \$PATH."; exit 1; }
 }
 
 hasCommand awk
-hasCommand comm
-hasCommand join
-hasCommand sort
 
 # pre processing
 # check number of input variables
@@ -85,97 +71,26 @@ WARN
     exit 1
 fi
 
-if [ -n "${RECOVER_DELETED}" ] && [ -s "${TMP_PATH}/removedSeqs" ]; then
-    echo "==================================================="
-    echo "============ Recover removed sequences ============"
-    echo "==================================================="
-
-    if notExists "${TMP_PATH}/OLDDB.removedMapping"; then
-        (
-            HIGHESTID="$(sort -T "${TMP_PATH}" -r -n -k1,1 "${NEWDB}.index"| head -n 1 | cut -f1)"
-            awk -v highest="$HIGHESTID" \
-                'BEGIN { start=highest+1 } { print $1"\t"start; start=start+1; }' \
-                "${TMP_PATH}/removedSeqs" > "${TMP_PATH}/OLDDB.removedMapping"
-            cat "${TMP_PATH}/OLDDB.removedMapping" >> "${TMP_PATH}/mappingSeqs"
-        ) || fail "Could not create ${TMP_PATH}/OLDDB.removedMapping"
-    fi
-
-    if notExists "${TMP_PATH}/NEWDB.withOld.dbtype"; then
-        (
-            ln -sf "${OLDDB}" "${TMP}/OLDDB.removedDb"
-            ln -sf "${OLDDB}_h" "${TMP}/OLDDB.removedDb_h"
-            joinAndReplace "${OLDDB}.index" "${TMP_PATH}/OLDDB.removedDb.index" "${TMP_PATH}/OLDDB.removedMapping" "1.2 2.2 2.3"
-            joinAndReplace "${OLDDB}_h.index" "${TMP_PATH}/OLDDB.removedDb_h.index" "${TMP_PATH}/OLDDB.removedMapping" "1.2 2.2 2.3"
-            joinAndReplace "${OLDDB}.lookup" "${TMP_PATH}/OLDDB.removedDb.lookup" "${TMP_PATH}/OLDDB.removedMapping" "1.2 2.2"
-            $MMSEQS concatdbs "$NEWDB" "${TMP_PATH}/OLDDB.removedDb" "${TMP_PATH}/NEWDB.withOld" --preserve-keys
-            $MMSEQS concatdbs "${NEWDB}_h" "${TMP_PATH}/OLDDB.removedDb_h" "${TMP_PATH}/NEWDB.withOld_h" --preserve-keys
-            cat "${NEWDB}.lookup" "${TMP_PATH}/OLDDB.removedDb.lookup" > "${TMP_PATH}/NEWDB.withOld.lookup"
-        ) || fail "Could not create ${TMP_PATH}/NEWDB.withOld"
-    fi
-
-    NEWDB="${TMP_PATH}/NEWDB.withOld"
-
-    if [ -n "$REMOVE_TMP" ]; then
-        echo "Remove temporary files 1/3"
-        rm -f "${TMP_PATH}/OLDDB.removedMapping" "${TMP_PATH}/OLDDB.removed"{Db,Db.index,Db_h,Db_h.index,Db.lookup}
-    fi
-fi
-
 debugWait
 echo "==================================================="
 echo "=== Update the new sequences with the old keys ===="
 echo "==================================================="
 
-if notExists "${TMP_PATH}/newMappingSeqs"; then
-    (
-        OLDHIGHESTID="$(sort -T "${TMP_PATH}" -r -n -k1,1 "${OLDDB}.index"| head -n 1 | cut -f1)"
-        NEWHIGHESTID="$(sort -T "${TMP_PATH}" -r -n -k1,1 "${NEWDB}.index"| head -n 1 | cut -f1)"
-        MAXID="$((OLDHIGHESTID>NEWHIGHESTID?OLDHIGHESTID:NEWHIGHESTID))"
-        awk -v highest="$MAXID" \
-            'BEGIN { start=highest+1 } { print $1"\t"start; start=start+1; }' \
-            "${TMP_PATH}/newSeqs" > "${TMP_PATH}/newSeqs.mapped"
-        awk '{ print $2"\t"$1 }' "${TMP_PATH}/mappingSeqs" > "${TMP_PATH}/mappingSeqs.reverse"
-        cat "${TMP_PATH}/mappingSeqs.reverse" "${TMP_PATH}/newSeqs.mapped" > "${TMP_PATH}/newMappingSeqs"
-        awk '{ print $2 }' "${TMP_PATH}/newSeqs.mapped" > "${TMP_PATH}/newSeqs"
-    ) || fail "Could not create ${TMP_PATH}/newMappingSeqs"
-fi
-
-if notExists "${TMP_PATH}/NEWDB.index"; then
-    joinAndReplace "${NEWDB}.index" "${NEWMAPDB}.index" "${TMP_PATH}/newMappingSeqs" "1.2 2.2 2.3" \
-        || fail "join died"
-fi
-
-
-if notExists "${TMP_PATH}/NEWDB_h.index"; then
-    joinAndReplace "${NEWDB}_h.index" "${NEWMAPDB}_h.index" "${TMP_PATH}/newMappingSeqs" "1.2 2.2 2.3" \
-        || fail "join died"
-fi
-
-if notExists "${TMP_PATH}/NEWDB.lookup"; then
-    joinAndReplace "${NEWDB}.lookup" "${NEWMAPDB}.lookup" "${TMP_PATH}/newMappingSeqs" "1.2 2.2" \
-        || fail "join died"
+if notExists "${TMP_PATH}/newSeqs.mapped"; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" renumberdbs "$OLDDB" "$NEWDB" "${TMP_PATH}/removedSeqs" "${TMP_PATH}/mappingSeqs" "${TMP_PATH}/newSeqs" "$NEWMAPDB" ${RENUMBER_PAR} \
+        || fail "renumberdbs died"
 fi
 
-ln -sf "${NEWDB}" "${NEWMAPDB}"
-ln -sf "${NEWDB}_h" "${NEWMAPDB}_h"
-ln -sf "${NEWDB}.dbtype" "${NEWMAPDB}.dbtype"
-ln -sf "${NEWDB}_h.dbtype" "${NEWMAPDB}_h.dbtype"
-
 NEWDB="${NEWMAPDB}"
 
-if [ -n "$REMOVE_TMP" ]; then
-    echo "Remove temporary files 2/3"
-    "$MMSEQS" rmdb "${TMP_PATH}/NEWDB.withOld"
-    "$MMSEQS" rmdb "${TMP_PATH}/NEWDB.withOld_h"
-fi
-
 debugWait
 echo "==================================================="
 echo "====== Filter out the new from old sequences ======"
 echo "==================================================="
 if notExists "${TMP_PATH}/NEWDB.newSeqs.dbtype"; then
     # shellcheck disable=SC2086
-    "$MMSEQS" createsubdb "${TMP_PATH}/newSeqs" "$NEWDB" "${TMP_PATH}/NEWDB.newSeqs" ${VERBOSITY} --subdb-mode 1 \
+    "$MMSEQS" createsubdb "${TMP_PATH}/newSeqs.mapped" "$NEWDB" "${TMP_PATH}/NEWDB.newSeqs" ${VERBOSITY} --subdb-mode 1 \
         || fail "Order died"
     ln -sf "${NEWDB}.dbtype" "${TMP_PATH}/NEWDB.newSeqs.dbtype"
 fi
@@ -207,7 +122,13 @@ if notExists "${TMP_PATH}/newSeqsHits.swapped.all"; then
         || fail "Swapresults died"
 fi
 
-if [ -s "${TMP_PATH}/newSeqsHits.swapped.all.index" ]; then
+# a binary index always has a header, only its text copy is empty for an empty DB
+if notExists "${TMP_PATH}/newSeqsHits.swapped.all.index_txt"; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" convertdbindex "${TMP_PATH}/newSeqsHits.swapped.all" "${TMP_PATH}/newSeqsHits.swapped.all.index_txt" --index-format 0 ${VERBOSITY} \
+        || fail "convertdbindex died"
+fi
+if [ -s "${TMP_PATH}/newSeqsHits.swapped.all.index_txt" ]; then
     if notExists "${TMP_PATH}/newSeqsHits.swapped"; then
         "$MMSEQS" filterdb "${TMP_PATH}/newSeqsHits.swapped.all" "${TMP_PATH}/newSeqsHits.swapped" --trim-to-one-column \
             || fail "Trimming died"
@@ -243,7 +164,12 @@ echo "==================================================="
 echo "=========== Extract unmapped sequences ============"
 echo "==================================================="
 if notExists "${TMP_PATH}/noHitSeqList.dbtype"; then
-    awk '$3==1 {print $1}' "${TMP_PATH}/newSeqsHits.index" > "${TMP_PATH}/noHitSeqList" \
+    if notExists "${TMP_PATH}/newSeqsHits.index_txt"; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" convertdbindex "${TMP_PATH}/newSeqsHits" "${TMP_PATH}/newSeqsHits.index_txt" --index-format 0 ${VERBOSITY} \
+            || fail "convertdbindex died"
+    fi
+    awk '$3==1 {print $1}' "${TMP_PATH}/newSeqsHits.index_txt" > "${TMP_PATH}/noHitSeqList" \
         || fail "awk died"
 fi
 if notExists "${TMP_PATH}/toBeClusteredSeparately.dbtype"; then
@@ -260,7 +186,13 @@ echo "==================================================="
 
 mkdir -p "${TMP_PATH}/cluster"
 if notExists "${TMP_PATH}/newClusters.dbtype"; then
-    if  [ -s "${TMP_PATH}/toBeClusteredSeparately" ]; then
+    # a binary index always has a header, only its text copy is empty for an empty DB
+    if notExists "${TMP_PATH}/toBeClusteredSeparately.index_txt"; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" convertdbindex "${TMP_PATH}/toBeClusteredSeparately" "${TMP_PATH}/toBeClusteredSeparately.index_txt" --index-format 0 ${VERBOSITY} \
+            || fail "convertdbindex died"
+    fi
+    if  [ -s "${TMP_PATH}/toBeClusteredSeparately.index_txt" ]; then
         # shellcheck disable=SC2086
         "$MMSEQS" cluster "${TMP_PATH}/toBeClusteredSeparately" "${TMP_PATH}/newClusters" "${TMP_PATH}/cluster" ${CLUST_PAR} \
             || fail "Clustering of new seq. died"
@@ -283,8 +215,8 @@ fi
 
 debugWait
 if [ -n "$REMOVE_TMP" ]; then
-    rm -f "${TMP_PATH}/newSeqs.mapped" "${TMP_PATH}/mappingSeqs.reverse" "${TMP_PATH}/newMappingSeqs"
-	rm -f  "${TMP_PATH}/noHitSeqList" "${TMP_PATH}/mappingSeqs" "${TMP_PATH}/newSeqs" "${TMP_PATH}/removedSeqs"
+	rm -f  "${TMP_PATH}/noHitSeqList" "${TMP_PATH}/mappingSeqs" "${TMP_PATH}/newSeqs" "${TMP_PATH}/newSeqs.mapped" "${TMP_PATH}/removedSeqs"
+	rm -f "${TMP_PATH}/newSeqsHits.index_txt" "${TMP_PATH}/newSeqsHits.swapped.all.index_txt" "${TMP_PATH}/toBeClusteredSeparately.index_txt"
 
     # shellcheck disable=SC2086
 	"$MMSEQS" rmdb "${TMP_PATH}/newSeqsHits.swapped" ${VERBOSITY}
@@ -162,31 +162,31 @@ typedef __m512i simd_int;
 #define SIMD_INT
 #define ALIGN_INT           AVX2_ALIGN_INT
 #define VECSIZE_INT         AVX2_VECSIZE_INT
-uint16_t simd_hmax16_sse(const __m128i buffer);
-uint8_t simd_hmax8_sse(const __m128i buffer);
-inline uint16_t simd_hmax16_avx(const __m256i buffer) {
+static inline uint16_t simd_hmax16_sse(const __m128i buffer);
+static inline uint8_t simd_hmax8_sse(const __m128i buffer);
+static inline uint16_t simd_hmax16_avx(const __m256i buffer) {
     const __m128i abcd = _mm256_castsi256_si128(buffer);
     const uint16_t first = simd_hmax16_sse(abcd);
     const __m128i efgh = _mm256_extracti128_si256(buffer, 1);
     const uint16_t second = simd_hmax16_sse(efgh);
-    return std::max(first, second);
+    return (first > second) ? first : second;
 }
 
-inline uint8_t simd_hmax8_avx(const __m256i buffer) {
+static inline uint8_t simd_hmax8_avx(const __m256i buffer) {
     const __m128i abcd = _mm256_castsi256_si128(buffer);
     const uint8_t first = simd_hmax8_sse(abcd);
     const __m128i efgh = _mm256_extracti128_si256(buffer, 1);
     const uint8_t second = simd_hmax8_sse(efgh);
-    return std::max(first, second);
+    return (first > second) ? first : second;
 }
 
 template  <unsigned int N>
-inline __m256i _mm256_shift_left(__m256i a) {
+static inline __m256i _mm256_shift_left(__m256i a) {
     __m256i mask = _mm256_permute2x128_si256(a, a, _MM_SHUFFLE(0,0,3,0) );
     return _mm256_alignr_epi8(a,mask,16-N);
 }
 
-inline unsigned short extract_epi16(__m256i v, int pos) {
+static inline unsigned short extract_epi16(__m256i v, int pos) {
     switch(pos){
         case 0: return _mm256_extract_epi16(v, 0);
         case 1: return _mm256_extract_epi16(v, 1);
@@ -314,13 +314,13 @@ typedef __m256 simd_float;
 #endif
 
 #include <simde/x86/sse4.1.h>
-inline uint16_t simd_hmax16_sse(const __m128i buffer) {
+static inline uint16_t simd_hmax16_sse(const __m128i buffer) {
     __m128i tmp1 = _mm_subs_epu16(_mm_set1_epi16((short)65535), buffer);
     __m128i tmp3 = _mm_minpos_epu16(tmp1);
     return (65535 - _mm_cvtsi128_si32(tmp3));
 }
 
-inline uint8_t simd_hmax8_sse(const __m128i buffer) {
+static inline uint8_t simd_hmax8_sse(const __m128i buffer) {
     __m128i tmp1 = _mm_subs_epu8(_mm_set1_epi8((char)255), buffer);
     __m128i tmp2 = _mm_min_epu8(tmp1, _mm_srli_epi16(tmp1, 8));
     __m128i tmp3 = _mm_minpos_epu16(tmp2);
@@ -381,7 +381,7 @@ typedef __m128  simd_float;
 // integer support
 #ifndef SIMD_INT
 #define SIMD_INT
-inline unsigned short extract_epi16(__m128i v, int pos) {
+static inline unsigned short extract_epi16(__m128i v, int pos) {
     switch(pos){
         case 0: return _mm_extract_epi16(v, 0);
         case 1: return _mm_extract_epi16(v, 1);
@@ -448,7 +448,7 @@ typedef __m128i simd_int;
 #define simdi_i2fcast(x)    _mm_castsi128_ps(x)
 #endif //SIMD_INT
 
-inline void *mem_align(size_t boundary, size_t size) {
+static inline void *mem_align(size_t boundary, size_t size) {
     void *pointer;
     if (posix_memalign(&pointer, boundary, size) != 0) {
 #define MEM_ALIGN_ERROR "mem_align could not allocate memory.\n"
@@ -459,23 +459,23 @@ inline void *mem_align(size_t boundary, size_t size) {
     return pointer;
 }
 #ifdef SIMD_FLOAT
-inline simd_float * malloc_simd_float(const size_t size) {
+static inline simd_float * malloc_simd_float(const size_t size) {
     return (simd_float *) mem_align(ALIGN_FLOAT, size);
 }
 #endif
 #ifdef SIMD_DOUBLE
-inline simd_double * malloc_simd_double(const size_t size) {
+static inline simd_double * malloc_simd_double(const size_t size) {
     return (simd_double *) mem_align(ALIGN_DOUBLE, size);
 }
 #endif
 #ifdef SIMD_INT
-inline simd_int * malloc_simd_int(const size_t size) {
+static inline simd_int * malloc_simd_int(const size_t size) {
     return (simd_int *) mem_align(ALIGN_INT, size);
 }
 #endif
 
 template <typename T>
-T** malloc_matrix(int dim1, int dim2) {
+static inline T** malloc_matrix(int dim1, int dim2) {
 #define ICEIL(x_int, fac_int) ((x_int + fac_int - 1) / fac_int) * fac_int
     // Compute mem sizes rounded up to nearest multiple of ALIGN_FLOAT
     size_t size_pointer_array = ICEIL(dim1*sizeof(T*), ALIGN_FLOAT);
@@ -495,7 +495,7 @@ T** malloc_matrix(int dim1, int dim2) {
 }
 
 
-inline float ScalarProd20(const float* qi, const float* tj) {
+static inline float ScalarProd20(const float* qi, const float* tj) {
 //#ifdef AVX
 //  float __attribute__((aligned(ALIGN_FLOAT))) res;
 //  __m256 P; // query 128bit SSE2 register holding 4 floats
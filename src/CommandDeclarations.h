@@ -26,7 +26,9 @@ extern int createindex(int argc, const char **argv, const Command& command);
 extern int createlinindex(int argc, const char **argv, const Command& command);
 extern int createseqfiledb(int argc, const char **argv, const Command& command);
 extern int createsubdb(int argc, const char **argv, const Command& command);
+extern int convertdbindex(int argc, const char **argv, const Command& command);
 extern int view(int argc, const char **argv, const Command& command);
+extern int renumberdbs(int argc, const char **argv, const Command& command);
 extern int rmdb(int argc, const char **argv, const Command& command);
 extern int mvdb(int argc, const char **argv, const Command& command);
 extern int createtsv(int argc, const char **argv, const Command& command);
@@ -71,6 +73,7 @@ extern int offsetalignment(int argc, const char **argv, const Command& command);
 extern int orftocontig(int argc, const char **argv, const Command& command);
 extern int touchdb(int argc, const char **argv, const Command& command);
 extern int prefilter(int argc, const char **argv, const Command& command);
+extern int prefilteralign(int argc, const char **argv, const Command& command);
 extern int prefixid(int argc, const char **argv, const Command& command);
 extern int profile2cs(int argc, const char **argv, const Command& command);
 extern int profile2pssm(int argc, const char **argv, const Command& command);
@@ -90,6 +93,7 @@ extern int result2repseq(int argc, const char **argv, const Command& command);
 extern int result2stats(int argc, const char **argv, const Command& command);
 extern int reverseseq(int argc, const char **argv, const Command& command);
 extern int search(int argc, const char **argv, const Command& command);
+extern int server(int argc, const char **argv, const Command& command);
 extern int linsearch(int argc, const char **argv, const Command& command);
 extern int sortresult(int argc, const char **argv, const Command& command);
 extern int splitdb(int argc, const char **argv, const Command& command);
@@ -106,6 +110,8 @@ extern int taxonomy(int argc, const char **argv, const Command& command);
 extern int taxpercontig(int argc, const char **argv, const Command& command);
 extern int easytaxonomy(int argc, const char **argv, const Command& command);
 extern int createtaxdb(int argc, const char **argv, const Command& command);
+extern int createbintaxonomy(int argc, const char **argv, const Command& command);
+extern int createbintaxmapping(int argc, const char **argv, const Command& command);
 extern int translateaa(int argc, const char **argv, const Command& command);
 extern int translatenucs(int argc, const char **argv, const Command& command);
 extern int tsv2db(int argc, const char **argv, const Command& command);
@@ -205,6 +205,20 @@ std::vector<Command> baseCommands = {
                                                            {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                                            {"alignmentDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
                                                            {"tmpDir", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::directory }}},
+        {"server",               server,               &par.server,               COMMAND_MAIN|COMMAND_EXPERT,
+                "Answer searches against a resident target index over a UNIX socket",
+                "# Keep the index of targetDB in memory and listen on search.sock\n"
+                "mmseqs createindex targetDB tmp\n"
+                "mmseqs server targetDB search.sock tmp\n\n"
+                "# Send FASTA (or a line with the path of a query DB) and read the hits\n"
+                "# Columns: query, target, bit score, seq. identity, E-value,\n"
+                "#  query start, end, length, target start, end, length (0-based positions)\n"
+                "socat -t 3600 - UNIX-CONNECT:search.sock < query.fasta\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:targetDB> <o:socketPath> <tmpDir>",
+                CITATION_MMSEQS2, {{"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA|DbType::NEED_HEADER, &DbValidator::sequenceDb },
+                                          {"socketPath", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                          {"tmpDir", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::directory }}},
         {"map",                  map,                  &par.mapworkflow,          COMMAND_MAIN,
                 "Map nearly identical sequences",
                 NULL,
@@ -367,6 +381,22 @@ std::vector<Command> baseCommands = {
                 "<i:sequenceDB> <tmpDir>",
                 CITATION_MMSEQS2, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                                            {"tmpDir", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::directory }}},
+        {"createbintaxonomy",    createbintaxonomy,    &par.onlyverbosity,        COMMAND_TAXONOMY | COMMAND_EXPERT,
+                "Create a binary taxonomy from the NCBI taxdump files",
+                "Parses names.dmp, nodes.dmp and merged.dmp once and stores the taxonomy with its LCA lookup tables.\nTaxonomy modules memory map <taxDB>_taxonomy instead of parsing the dump files if it exists.",
+                "Milot Mirdita <milot@mirdita.de>",
+                "<i:names.dmp> <i:nodes.dmp> <i:merged.dmp> <o:taxonomyFile>",
+                CITATION_MMSEQS2, {{"names.dmp", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                                           {"nodes.dmp", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                                           {"merged.dmp", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                                           {"taxonomyFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile }}},
+        {"createbintaxmapping",  createbintaxmapping,  &par.onlyverbosity,        COMMAND_TAXONOMY | COMMAND_EXPERT,
+                "Convert a taxonomy mapping to the binary format",
+                "Stores the taxon of every key of a text <taxDB>_mapping in one array indexed by key.\nWritten to <taxDB>_mapping.bin, taxonomy modules memory map it instead of parsing the text <taxDB>_mapping.",
+                "Milot Mirdita <milot@mirdita.de>",
+                "<i:mappingFile> <o:binaryMappingFile>",
+                CITATION_MMSEQS2, {{"mappingFile", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                                           {"binaryMappingFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile }}},
         {"addtaxonomy",          addtaxonomy,          &par.addtaxonomy,          COMMAND_TAXONOMY | COMMAND_EXPERT,
                 "Add taxonomic labels to result DB",
                 NULL,
@@ -576,6 +606,14 @@ std::vector<Command> baseCommands = {
                                                            {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                                            {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultDb },
                                                            {"alignmentDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb }}},
+        {"prefilteralign",       prefilteralign,       &par.prefilteralign,       COMMAND_ALIGNMENT | COMMAND_EXPERT,
+                "Prefilter and gapped local alignment in one pass without a prefilter database",
+                NULL,
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:queryDB> <i:targetDB> <o:alignmentDB>",
+                CITATION_MMSEQS2, {{"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                                           {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                                           {"alignmentDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb }}},
         {"alignall",             alignall,             &par.alignall,             COMMAND_ALIGNMENT,
                 "Within-result all-vs-all gapped local alignment",
                 NULL,
@@ -654,6 +692,18 @@ std::vector<Command> baseCommands = {
                 "<i:DB> <o:DB>",
                 CITATION_MMSEQS2, {{"DB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::allDb },
                                                            {"DB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::allDb }}},
+        {"convertdbindex",       convertdbindex,       &par.convertdbindex,       COMMAND_STORAGE,
+                "Convert a DB index between text and memory-mappable binary format",
+                "# Convert the index of a large DB in place to the binary format for fast loading\n"
+                "mmseqs convertdbindex sequenceDB sequenceDB.index --index-format 1\n\n"
+                "# Write a tab-separated copy of a binary index\n"
+                "mmseqs convertdbindex sequenceDB sequenceDB.txt --index-format 0\n\n"
+                "# New databases are written with binary indices if MMSEQS_INDEX_FORMAT=1 is set\n"
+                "MMSEQS_INDEX_FORMAT=1 mmseqs createdb examples/DB.fasta sequenceDB\n",
+                "Milot Mirdita <milot@mirdita.de>",
+                "<i:DB> <o:indexFile>",
+                CITATION_MMSEQS2, {{"DB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::allDb },
+                                          {"indexFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile }}},
         {"rmdb",                 rmdb,                 &par.onlyverbosity,        COMMAND_STORAGE,
                 "Remove a DB",
                 NULL,
@@ -1091,6 +1141,17 @@ std::vector<Command> baseCommands = {
                                                            {"rmSeqKeysFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile },
                                                            {"keptSeqKeysFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile },
                                                            {"newSeqKeysFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile }}},
+        {"renumberdbs",          renumberdbs,          &par.renumberdbs,          COMMAND_SPECIAL,
+                "Renumber an updated sequence DB with the keys of the previous DB",
+                "Uses the files of diffseqdbs. Kept sequences get their previous key, added sequences are numbered after the highest key of both DBs.\nWith --recover-deleted the removed sequences are added with their previous key. Data files are linked, not copied.\nThe new keys of the added sequences are written to <newSeqKeysFile>.mapped.",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:oldSequenceDB> <i:newSequenceDB> <i:rmSeqKeysFile> <i:keptSeqKeysFile> <i:newSeqKeysFile> <o:newMappedSequenceDB>",
+                CITATION_MMSEQS2, {{"oldSequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                                           {"newSequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                                           {"rmSeqKeysFile", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                                           {"keptSeqKeysFile", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                                           {"newSeqKeysFile", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::flatfile },
+                                                           {"newMappedSequenceDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb }}},
         {"summarizetabs",        summarizetabs,        &par.summarizetabs,        COMMAND_SPECIAL,
                 "Extract annotations from HHblits BLAST-tab-formatted results",
                 NULL,
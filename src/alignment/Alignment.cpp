@@ -14,11 +14,64 @@
 #include "IndexReader.h"
 #include "Parameters.h"
 #include "FastSort.h"
+#include "PerfReport.h"
+#include "Timer.h"
 
 #ifdef OPENMP
 #include <omp.h>
 #endif
 
+struct Alignment::ThreadData {
+    ThreadData(const Alignment &aln, EvalueComputation *evaluer, bool wrappedScoring) :
+            qSeq(aln.maxSeqLen, aln.querySeqType, aln.m, 0, false, aln.compBiasCorrection),
+            dbSeq(aln.maxSeqLen, aln.targetSeqType, aln.m, 0, false, aln.compBiasCorrection),
+            matcher(aln.querySeqType, getMatcherMaxSeqLen(aln), aln.m, evaluer, aln.compBiasCorrection, aln.gapOpen, aln.gapExtend, aln.zdrop),
+            realigner(NULL),
+            batchSeq(aln.maxSeqLen, aln.targetSeqType, aln.m, 0, false, aln.compBiasCorrection),
+            alignmentsNum(0), totalPassedNum(0), queries(0), swCells(0) {
+        if (aln.realign == true && wrappedScoring == false) {
+            realigner = new Matcher(aln.querySeqType, getMatcherMaxSeqLen(aln), aln.realign_m, evaluer, aln.compBiasCorrection, aln.gapOpen, aln.gapExtend, aln.zdrop);
+        }
+        swResults.reserve(300);
+        swRealignResults.reserve(300);
+        shortResults.reserve(300);
+        hits.reserve(300);
+    }
+
+    ~ThreadData() {
+        if (realigner != NULL) {
+            delete realigner;
+        }
+    }
+
+    static size_t getMatcherMaxSeqLen(const Alignment &aln) {
+        return (Parameters::isEqualDbtype(aln.querySeqType, Parameters::DBTYPE_NUCLEOTIDES)) ? aln.maxSeqLen : std::max(aln.tdbr->getMaxSeqLen(), aln.qdbr->getMaxSeqLen());
+    }
+
+    Sequence qSeq;
+    Sequence dbSeq;
+    Matcher matcher;
+    Matcher *realigner;
+
+    std::vector<Matcher::result_t> swResults;
+    std::vector<Matcher::result_t> swRealignResults;
+    std::vector<hit_t> shortResults;
+    std::vector<hit_t> hits;
+    // short targets aligned ahead of time by the inter-sequence kernel
+    Sequence batchSeq;
+    std::vector<size_t> batchHits;
+    std::vector<Matcher::result_t> batchResults;
+    char buffer[1024+32768];
+    std::string queryToWrap;
+
+    // statistics of the hit consumer
+    size_t alignmentsNum;
+    size_t totalPassedNum;
+    size_t queries;
+    // dynamic programming matrix cells of all alignments of this thread
+    size_t swCells;
+};
+
 Alignment::Alignment(const std::string &querySeqDB,
                      const std::string &targetSeqDB,
                      const std::string &prefDB, const std::string &prefDBIndex,
@@ -27,9 +80,9 @@ Alignment::Alignment(const std::string &querySeqDB,
 
         covThr(par.covThr), canCovThr(par.covThr), covMode(par.covMode), seqIdMode(par.seqIdMode), evalThr(par.evalThr), seqIdThr(par.seqIdThr),
         alnLenThr(par.alnLenThr), includeIdentity(par.includeIdentity), addBacktrace(par.addBacktrace), realign(par.realign), scoreBias(par.scoreBias),
-        threads(static_cast<unsigned int>(par.threads)), compressed(par.compressed), outDB(outDB), outDBIndex(outDBIndex),
+        threads(static_cast<unsigned int>(par.threads)), compressed(par.compressed), preloadMode(par.preloadMode), outDB(outDB), outDBIndex(outDBIndex),
         maxSeqLen(par.maxSeqLen), compBiasCorrection(par.compBiasCorrection), altAlignment(par.altAlignment), qdbr(NULL), qDbrIdx(NULL),
-        tdbr(NULL), tDbrIdx(NULL) {
+        tdbr(NULL), tDbrIdx(NULL), consumerEvaluer(NULL), alignmentCount(0), passedCount(0) {
 
 
     unsigned int alignmentMode = par.alignmentMode;
@@ -63,7 +116,7 @@ Alignment::Alignment(const std::string &querySeqDB,
         querySeqType = targetSeqType;
     } else {
         // open the sequence, prefiltering and output databases
-        qDbrIdx = new IndexReader(par.db1, par.threads,  IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0 );
+        qDbrIdx = new IndexReader(querySeqDB, par.threads,  IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0 );
         qdbr = qDbrIdx->sequenceReader;
         querySeqType = qdbr->getDbtype();
     }
@@ -124,9 +177,14 @@ Alignment::Alignment(const std::string &querySeqDB,
     Debug(Debug::INFO) << "Query database size: "  << qdbr->getSize() << " type: " << Parameters::getDbTypeName(querySeqType) << "\n";
     Debug(Debug::INFO) << "Target database size: " << tdbr->getSize() << " type: " << Parameters::getDbTypeName(targetSeqType) << "\n";
 
-    prefdbr = new DBReader<unsigned int>(prefDB.c_str(), prefDBIndex.c_str(), threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
-    prefdbr->open(DBReader<unsigned int>::LINEAR_ACCCESS);
-    reversePrefilterResult = (Parameters::isEqualDbtype(prefdbr->getDbtype(), Parameters::DBTYPE_PREFILTER_REV_RES));
+    // without a prefilter database setQueryDatabase has to be called before run
+    prefdbr = NULL;
+    reversePrefilterResult = false;
+    if (prefDB.empty() == false) {
+        prefdbr = new DBReader<unsigned int>(prefDB.c_str(), prefDBIndex.c_str(), threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+        prefdbr->open(DBReader<unsigned int>::LINEAR_ACCCESS);
+        reversePrefilterResult = (Parameters::isEqualDbtype(prefdbr->getDbtype(), Parameters::DBTYPE_PREFILTER_REV_RES));
+    }
 
     if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_NUCLEOTIDES)) {
         m = new NucleotideMatrix(par.scoringMatrixFile.nucleotides, 1.0, scoreBias);
@@ -198,6 +256,12 @@ unsigned int Alignment::initSWMode(unsigned int alignmentMode, float covThr, flo
 }
 
 Alignment::~Alignment() {
+    for (size_t i = 0; i < consumerData.size(); i++) {
+        delete consumerData[i];
+    }
+    if (consumerEvaluer != NULL) {
+        delete consumerEvaluer;
+    }
     if (realign == true) {
         delete realign_m;
     }
@@ -219,8 +283,37 @@ Alignment::~Alignment() {
         }
     }
 
-    prefdbr->close();
-    delete prefdbr;
+    if (prefdbr != NULL) {
+        prefdbr->close();
+        delete prefdbr;
+    }
+}
+
+void Alignment::setQueryDatabase(const std::string &querySeqDB, const std::string &prefDB, const std::string &prefDBIndex) {
+    if (sameQTDB == false) {
+        delete qDbrIdx;
+    }
+    if (prefdbr != NULL) {
+        prefdbr->close();
+        delete prefdbr;
+    }
+
+    // the target database is only used as query if the names match
+    sameQTDB = false;
+    bool touch = (preloadMode != Parameters::PRELOAD_MODE_MMAP);
+    qDbrIdx = new IndexReader(querySeqDB, threads, IndexReader::SEQUENCES, (touch) ? IndexReader::PRELOAD_INDEX : 0);
+    qdbr = qDbrIdx->sequenceReader;
+    const int expectedType = Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_PROFILE_STATE_PROFILE) ? Parameters::DBTYPE_HMM_PROFILE : querySeqType;
+    if (Parameters::isEqualDbtype(qdbr->getDbtype(), expectedType) == false) {
+        Debug(Debug::ERROR) << "Query database " << querySeqDB << " has type " << Parameters::getDbTypeName(qdbr->getDbtype())
+                            << " but the alignment was set up for " << Parameters::getDbTypeName(expectedType) << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    Debug(Debug::INFO) << "Query database size: "  << qdbr->getSize() << " type: " << Parameters::getDbTypeName(querySeqType) << "\n";
+
+    prefdbr = new DBReader<unsigned int>(prefDB.c_str(), prefDBIndex.c_str(), threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    prefdbr->open(DBReader<unsigned int>::LINEAR_ACCCESS);
+    reversePrefilterResult = (Parameters::isEqualDbtype(prefdbr->getDbtype(), Parameters::DBTYPE_PREFILTER_REV_RES));
 }
 
 void Alignment::run(const unsigned int mpiRank, const unsigned int mpiNumProc,
@@ -256,13 +349,18 @@ void Alignment::run(const unsigned int maxAlnNum, const unsigned int maxRejected
 void Alignment::run(const std::string &outDB, const std::string &outDBIndex,
                     const size_t dbFrom, const size_t dbSize,
                     const unsigned int maxAlnNum, const unsigned int maxRejected, bool merge, bool wrappedScoring) {
+    PerfReport::startPhase("alignment");
     size_t alignmentsNum = 0;
     size_t totalPassedNum = 0;
+    size_t swCells = 0;
+    std::vector<double> busyTime(threads, 0.0);
     DBWriter dbw(outDB.c_str(), outDBIndex.c_str(), threads, compressed, Parameters::DBTYPE_ALIGNMENT_RES);
     dbw.open();
 
     // handle no alignment case early, below would divide by 0 otherwise
     if (dbSize == 0) {
+        alignmentCount = 0;
+        passedCount = 0;
         dbw.close(merge);
         return;
     }
@@ -280,6 +378,35 @@ void Alignment::run(const std::string &outDB, const std::string &outDBIndex,
         size_t bucketSize = std::min(dbSize - (i * flushSize), flushSize);
         Debug::Progress progress(bucketSize);
 
+        // estimated cost of a query is its length times the length of its prefilter list
+        std::vector<size_t> costs(bucketSize);
+        size_t totalCost = 0;
+        for (size_t k = 0; k < bucketSize; k++) {
+            const size_t qId = qdbr->getId(prefdbr->getDbKey(start + k));
+            const size_t queryLen = (qId != UINT_MAX) ? qdbr->getSeqLen(qId) : 1;
+            costs[k] = queryLen * prefdbr->getEntryLen(start + k);
+            totalCost += costs[k];
+        }
+        // expensive queries first, queries that cost more than an even share of all threads are
+        // aligned by all threads together, if every hit is aligned anyway (no early stop by --max-accept/--max-rejected)
+        const std::vector<size_t> order = Util::orderByDecreasingCost(costs);
+        std::vector<size_t> splitQueries;
+        std::vector<size_t> queue;
+        queue.reserve(bucketSize);
+        std::vector<hit_t> splitHits;
+        for (size_t k = 0; k < bucketSize; k++) {
+            const size_t id = start + order[k];
+            if (threads > 1 && costs[order[k]] * threads > totalCost) {
+                parsePrefilterEntry(prefdbr->getData(id, 0), splitHits);
+                if (splitHits.size() >= 2 * threads && splitHits.size() <= maxAlnNum && splitHits.size() < maxRejected) {
+                    splitQueries.emplace_back(id);
+                    continue;
+                }
+            }
+            queue.emplace_back(id);
+        }
+        std::vector<Matcher::result_t> splitResults;
+
 #pragma omp parallel num_threads(threads)
         {
             unsigned int thread_idx = 0;
@@ -288,179 +415,78 @@ void Alignment::run(const std::string &outDB, const std::string &outDBIndex,
 #endif
             std::string alnResultsOutString;
             alnResultsOutString.reserve(1024*1024);
-            char buffer[1024+32768];
-            Sequence qSeq(maxSeqLen, querySeqType, m, 0, false, compBiasCorrection);
-            Sequence dbSeq(maxSeqLen, targetSeqType, m, 0, false, compBiasCorrection);
-            Matcher matcher(querySeqType,
-                                (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_NUCLEOTIDES)) ? maxSeqLen : std::max(tdbr->getMaxSeqLen(), qdbr->getMaxSeqLen()),
-                                 m, &evaluer, compBiasCorrection, gapOpen, gapExtend, zdrop);
-            Matcher *realigner = NULL;
-            if (realign ==  true && wrappedScoring == false) {
-                realigner = new Matcher(querySeqType,
-                                       (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_NUCLEOTIDES)) ? maxSeqLen : std::max(tdbr->getMaxSeqLen(), qdbr->getMaxSeqLen()),
-                                       realign_m, &evaluer, compBiasCorrection, gapOpen, gapExtend, zdrop);
-            }
-
-            std::vector<Matcher::result_t> swResults;
-            swResults.reserve(300);
-            std::vector<Matcher::result_t> swRealignResults;
-            swRealignResults.reserve(300);
-            std::vector<hit_t> shortResults;
-            shortResults.reserve(300);
-
-#pragma omp for schedule(dynamic, 5) reduction(+: alignmentsNum, totalPassedNum)
-            for (size_t id = start; id < (start + bucketSize); id++) {
-                progress.updateProgress();
-
-                // get the prefiltering list
-                char *data = prefdbr->getData(id, thread_idx);
-                unsigned int queryDbKey = prefdbr->getDbKey(id);
-                size_t origQueryLen = 0;
-                std::string queryToWrap;
-                // only load query data if data != \0
-                if(*data != '\0'){
-                    size_t qId = qdbr->getId(queryDbKey);
-                    char *querySeqData = qdbr->getData(qId, thread_idx);
-                    if (querySeqData == NULL) {
-                        Debug(Debug::ERROR) << "Query sequence " << queryDbKey
-                                            << " is required in the prefiltering, but is not contained in the query sequence database.\nPlease check your database.\n";
-                        EXIT(EXIT_FAILURE);
-                    }
-                    size_t queryLen = qdbr->getSeqLen(qId);
-                    origQueryLen = queryLen;
-                    if (wrappedScoring) {
-                        queryToWrap = std::string(querySeqData,queryLen);
-                        queryToWrap = queryToWrap + queryToWrap;
-                        querySeqData = (char*)(queryToWrap).c_str();
-                        queryLen = origQueryLen*2;
-                    }
-
-                    qSeq.mapSequence(qId, queryDbKey, querySeqData, queryLen);
-                    matcher.initQuery(&qSeq);
+            ThreadData state(*this, &evaluer, wrappedScoring);
+            std::vector<hit_t> &hits = state.hits;
+            Timer busyTimer;
+
+            for (size_t k = 0; k < splitQueries.size(); k++) {
+                const size_t id = splitQueries[k];
+                const unsigned int queryDbKey = prefdbr->getDbKey(id);
+#pragma omp single
+                {
+                    parsePrefilterEntry(prefdbr->getData(id, thread_idx), splitHits);
+                    splitResults.clear();
+                    splitResults.resize(splitHits.size());
                 }
-
-                // parse the prefiltering list and calculate a Smith-Waterman alignment for each sequence in the list
-                size_t passedNum = 0;
-                unsigned int rejected = 0;
-                while (*data != '\0' && passedNum < maxAlnNum && rejected < maxRejected) {
-                    // DB key of the db sequence
-                    char dbKeyBuffer[255 + 1];
-                    const char* words[10];
-                    Util::parseKey(data, dbKeyBuffer);
-                    const unsigned int dbKey = (unsigned int) strtoul(dbKeyBuffer, NULL, 10);
-
-                    size_t elements = Util::getWordsOfLine(data, words, 10);
-                    short diagonal = 0;
-                    bool isReverse = false;
-                    // Prefilter result (need to make this better)
-                    if(elements == 3){
-                        hit_t hit = QueryMatcher::parsePrefilterHit(data);
-                        isReverse = reversePrefilterResult && (hit.prefScore < 0);
-                        diagonal = static_cast<short>(hit.diagonal);
+                const size_t origQueryLen = initQuery(queryDbKey, state, wrappedScoring, thread_idx);
+#pragma omp for schedule(dynamic, 4)
+                for (size_t hitIdx = 0; hitIdx < splitHits.size(); hitIdx++) {
+                    if (PerfReport::isEnabled()) {
+                        busyTimer.reset();
                     }
+                    const unsigned int dbKey = splitHits[hitIdx].seqId;
                     size_t dbId = tdbr->getId(dbKey);
                     char *dbSeqData = tdbr->getData(dbId, thread_idx);
-
                     if (dbSeqData == NULL) {
                         Debug(Debug::ERROR) << "Sequence " << dbKey <<" is required in the prefiltering, but is not contained in the target sequence database!\nPlease check your database.\n";
                         EXIT(EXIT_FAILURE);
                     }
-                    dbSeq.mapSequence(dbId, dbKey, dbSeqData, tdbr->getSeqLen(dbId));
-                    // check if the sequences could pass the coverage threshold
-                    if(Util::canBeCovered(canCovThr, covMode, static_cast<float>(origQueryLen), static_cast<float>(dbSeq.L)) == false) {
-                        rejected++;
-                        data = Util::skipLine(data);
+                    state.dbSeq.mapSequence(dbId, dbKey, dbSeqData, tdbr->getSeqLen(dbId));
+                    // alignQuery skips these itself
+                    if (Util::canBeCovered(canCovThr, covMode, static_cast<float>(origQueryLen), static_cast<float>(state.dbSeq.L)) == false) {
                         continue;
                     }
                     const bool isIdentity = (queryDbKey == dbKey && (includeIdentity || sameQTDB)) ? true : false;
-
-                    // calculate Smith-Waterman alignment
-                    Matcher::result_t res = matcher.getSWResult(&dbSeq, static_cast<int>(diagonal), isReverse, covMode, covThr, evalThr, swMode, seqIdMode, isIdentity, wrappedScoring);
-                    alignmentsNum++;
-
-                    //set coverage and seqid if identity
-                    if (isIdentity) {
-                        res.qcov = 1.0f;
-                        res.dbcov = 1.0f;
-                        res.seqId = 1.0f;
-                    }
-                    if(checkCriteria(res, isIdentity, evalThr, seqIdThr, alnLenThr, covMode, covThr)){
-
-                        swResults.emplace_back(res);
-                        passedNum++;
-                        totalPassedNum++;
-                        rejected = 0;
-                    }else{
-                        rejected++;
+                    const bool isReverse = reversePrefilterResult && (splitHits[hitIdx].prefScore < 0);
+                    const short diagonal = static_cast<short>(splitHits[hitIdx].diagonal);
+                    splitResults[hitIdx] = state.matcher.getSWResult(&state.dbSeq, static_cast<int>(diagonal), isReverse, covMode, covThr, evalThr,
+                                                                     swMode, seqIdMode, isIdentity, wrappedScoring);
+                    if (PerfReport::isEnabled()) {
+                        busyTime[thread_idx] += busyTimer.getTimediff();
                     }
-
-                    data = Util::skipLine(data);
-                }
-                if(altAlignment > 0 && realign == false && wrappedScoring == false){
-                    computeAlternativeAlignment(queryDbKey, dbSeq, swResults, matcher, evalThr, swMode, thread_idx);
                 }
-
-                if(wrappedScoring && shortResults.size() > 1)
-                    SORT_SERIAL(shortResults.begin(), shortResults.end(), hit_t::compareHitsByScoreAndId);
-
-                // write the results
-                if(swResults.size() > 1)
-                    SORT_SERIAL(swResults.begin(), swResults.end(), Matcher::compareHits);
-                if (realign == true) {
-                    realigner->initQuery(&qSeq);
-                    for (size_t result = 0; result < swResults.size(); result++) {
-                        size_t dbId = tdbr->getId(swResults[result].dbKey);
-                        char *dbSeqData = tdbr->getData(dbId, thread_idx);
-                        if (dbSeqData == NULL) {
-                            Debug(Debug::ERROR) << "Sequence " << swResults[result].dbKey <<" is required in the prefiltering, but is not contained in the target sequence database!\nPlease check your database.\n";
-                            EXIT(EXIT_FAILURE);
-                        }
-                        dbSeq.mapSequence(static_cast<size_t>(-1), swResults[result].dbKey, dbSeqData,
-                                          tdbr->getSeqLen(dbId));
-                        const bool isIdentity = (queryDbKey == swResults[result].dbKey && (includeIdentity || sameQTDB)) ? true : false;
-                        Matcher::result_t res = realigner->getSWResult(&dbSeq, INT_MAX, false, covMode, covThr, FLT_MAX,
-                                                                       Matcher::SCORE_COV_SEQID, seqIdMode, isIdentity);
-                        const bool covOK = Util::hasCoverage(realignCov, covMode, res.qcov, res.dbcov);
-                        if(covOK == true|| isIdentity){
-                            swResults[result].backtrace  = res.backtrace;
-                            swResults[result].qStartPos  = res.qStartPos;
-                            swResults[result].qEndPos    = res.qEndPos;
-                            swResults[result].dbStartPos = res.dbStartPos;
-                            swResults[result].dbEndPos   = res.dbEndPos;
-                            swResults[result].alnLength  = res.alnLength;
-                            swResults[result].seqId      = res.seqId;
-                            swResults[result].qcov       = res.qcov;
-                            swResults[result].dbcov      = res.dbcov;
-                            swRealignResults.push_back(swResults[result]);
-                        }
-                    }
-                    swResults = swRealignResults;
-                    if(altAlignment > 0){
-                        computeAlternativeAlignment(queryDbKey, dbSeq, swResults, matcher, FLT_MAX, Matcher::SCORE_COV_SEQID, thread_idx);
-                    }
+#pragma omp single
+                {
+                    progress.updateProgress();
+                    alignQuery(queryDbKey, splitHits, state, maxAlnNum, maxRejected, wrappedScoring, thread_idx,
+                               alignmentsNum, totalPassedNum, alnResultsOutString, &splitResults);
+                    dbw.writeData(alnResultsOutString.c_str(), alnResultsOutString.length(), queryDbKey, thread_idx);
+                    alnResultsOutString.clear();
                 }
+            }
 
-                // put the contents of the swResults list into a result DB
-                for (size_t result = 0; result < swResults.size(); result++) {
-                    size_t len = Matcher::resultToBuffer(buffer, swResults[result], addBacktrace);
-                    alnResultsOutString.append(buffer, len);
+#pragma omp for schedule(dynamic, 1) reduction(+: alignmentsNum, totalPassedNum)
+            for (size_t k = 0; k < queue.size(); k++) {
+                progress.updateProgress();
+                if (PerfReport::isEnabled()) {
+                    busyTimer.reset();
                 }
+                const size_t id = queue[k];
 
-                for (size_t result = 0; result < shortResults.size(); result++) {
-                    size_t len = snprintf(buffer, 100, "%u\t%d\t%d\n", shortResults[result].seqId, shortResults[result].prefScore,
-                                          shortResults[result].diagonal);
-                    alnResultsOutString.append(buffer, len);
-                }
+                // get and parse the prefiltering list
+                char *data = prefdbr->getData(id, thread_idx);
+                unsigned int queryDbKey = prefdbr->getDbKey(id);
+                parsePrefilterEntry(data, hits);
 
+                alignQuery(queryDbKey, hits, state, maxAlnNum, maxRejected, wrappedScoring, thread_idx,
+                           alignmentsNum, totalPassedNum, alnResultsOutString);
                 dbw.writeData(alnResultsOutString.c_str(), alnResultsOutString.length(), queryDbKey, thread_idx);
                 alnResultsOutString.clear();
-                swResults.clear();
-                swRealignResults.clear();
-                shortResults.clear();
-            }
-            if (realign == true) {
-                delete realigner;
+                if (PerfReport::isEnabled()) {
+                    busyTime[thread_idx] += busyTimer.getTimediff();
+                }
             }
+            __sync_fetch_and_add(&swCells, state.swCells);
 #pragma omp barrier
             if (thread_idx == 0) {
                 prefdbr->remapData();
@@ -473,13 +499,291 @@ void Alignment::run(const std::string &outDB, const std::string &outDBIndex,
 
     dbw.close(merge);
 
+    alignmentCount = alignmentsNum;
+    passedCount = totalPassedNum;
+    PerfReport::addThreadBusyTime(busyTime);
+    PerfReport::addCounter("alignments", alignmentsNum);
+    PerfReport::addCounter("acceptedAlignments", totalPassedNum);
+    PerfReport::addCounter("swCells", swCells);
+    printStatistics(alignmentsNum, totalPassedNum, dbSize);
+}
+
+size_t Alignment::initQuery(unsigned int queryDbKey, ThreadData &state, bool wrappedScoring, unsigned int thread_idx) {
+    size_t qId = qdbr->getId(queryDbKey);
+    char *querySeqData = qdbr->getData(qId, thread_idx);
+    if (querySeqData == NULL) {
+        Debug(Debug::ERROR) << "Query sequence " << queryDbKey
+                            << " is required in the prefiltering, but is not contained in the query sequence database.\nPlease check your database.\n";
+        EXIT(EXIT_FAILURE);
+    }
+    size_t queryLen = qdbr->getSeqLen(qId);
+    size_t origQueryLen = queryLen;
+    if (wrappedScoring) {
+        state.queryToWrap = std::string(querySeqData,queryLen);
+        state.queryToWrap = state.queryToWrap + state.queryToWrap;
+        querySeqData = (char*)(state.queryToWrap).c_str();
+        queryLen = origQueryLen*2;
+    }
+
+    state.qSeq.mapSequence(qId, queryDbKey, querySeqData, queryLen);
+    state.matcher.initQuery(&state.qSeq);
+    return origQueryLen;
+}
+
+void Alignment::parsePrefilterEntry(char *data, std::vector<hit_t> &hits) {
+    hits.clear();
+    if (QueryMatcher::isBinaryPrefilterEntry(data)) {
+        QueryMatcher::parseBinaryPrefilterHits(data, hits);
+        return;
+    }
+    while (*data != '\0') {
+        // DB key of the db sequence
+        char dbKeyBuffer[255 + 1];
+        const char* words[10];
+        Util::parseKey(data, dbKeyBuffer);
+        hit_t hit;
+        hit.seqId = (unsigned int) strtoul(dbKeyBuffer, NULL, 10);
+        hit.prefScore = 0;
+        hit.diagonal = 0;
+        size_t elements = Util::getWordsOfLine(data, words, 10);
+        // Prefilter result (need to make this better)
+        if(elements == 3){
+            hit = QueryMatcher::parsePrefilterHit(data);
+        }
+        hits.push_back(hit);
+        data = Util::skipLine(data);
+    }
+}
+
+void Alignment::alignQuery(unsigned int queryDbKey, std::vector<hit_t> &hits, ThreadData &state,
+                           const unsigned int maxAlnNum, const unsigned int maxRejected, bool wrappedScoring, unsigned int thread_idx,
+                           size_t &alignmentsNum, size_t &totalPassedNum, std::string &alnResultsOutString,
+                           const std::vector<Matcher::result_t> *precomputed) {
+    Sequence &qSeq = state.qSeq;
+    Sequence &dbSeq = state.dbSeq;
+    Matcher &matcher = state.matcher;
+    Matcher *realigner = state.realigner;
+    std::vector<Matcher::result_t> &swResults = state.swResults;
+    std::vector<Matcher::result_t> &swRealignResults = state.swRealignResults;
+    std::vector<hit_t> &shortResults = state.shortResults;
+    Sequence &batchSeq = state.batchSeq;
+    std::vector<size_t> &batchHits = state.batchHits;
+    std::vector<Matcher::result_t> &batchResults = state.batchResults;
+    char *buffer = state.buffer;
+
+    // only load query data if there are hits
+    size_t origQueryLen = 0;
+    if (hits.empty() == false) {
+        origQueryLen = initQuery(queryDbKey, state, wrappedScoring, thread_idx);
+    }
+
+    // calculate a Smith-Waterman alignment for each sequence in the list
+    size_t passedNum = 0;
+    unsigned int rejected = 0;
+    const bool batchQuery = precomputed == NULL && hits.empty() == false && wrappedScoring == false && matcher.canAlignBatch(swMode);
+    size_t batchEnd = 0;
+    size_t batchPos = 0;
+    batchHits.clear();
+    batchResults.clear();
+    for (size_t hitIdx = 0; hitIdx < hits.size() && passedNum < maxAlnNum && rejected < maxRejected; hitIdx++) {
+        const unsigned int dbKey = hits[hitIdx].seqId;
+        const bool isReverse = reversePrefilterResult && (hits[hitIdx].prefScore < 0);
+        const short diagonal = static_cast<short>(hits[hitIdx].diagonal);
+        size_t dbId = tdbr->getId(dbKey);
+        char *dbSeqData = tdbr->getData(dbId, thread_idx);
+
+        if (dbSeqData == NULL) {
+            Debug(Debug::ERROR) << "Sequence " << dbKey <<" is required in the prefiltering, but is not contained in the target sequence database!\nPlease check your database.\n";
+            EXIT(EXIT_FAILURE);
+        }
+        dbSeq.mapSequence(dbId, dbKey, dbSeqData, tdbr->getSeqLen(dbId));
+        // check if the sequences could pass the coverage threshold
+        if(Util::canBeCovered(canCovThr, covMode, static_cast<float>(origQueryLen), static_cast<float>(dbSeq.L)) == false) {
+            rejected++;
+            continue;
+        }
+        const bool isIdentity = (queryDbKey == dbKey && (includeIdentity || sameQTDB)) ? true : false;
+
+        // calculate Smith-Waterman alignment
+        Matcher::result_t res;
+        if (precomputed != NULL) {
+            res = (*precomputed)[hitIdx];
+        } else if (batchPos < batchHits.size() && batchHits[batchPos] == hitIdx) {
+            res = batchResults[batchPos++];
+        } else if (batchQuery && hitIdx >= batchEnd && isIdentity == false && Matcher::isBatchTarget(dbSeq.L)) {
+            // align this and the following short targets at once, the loop might stop
+            // before all of them are used but the results stay the same
+            batchHits.clear();
+            batchResults.clear();
+            batchPos = 0;
+            matcher.addBatchTarget(&dbSeq, isReverse);
+            batchHits.push_back(hitIdx);
+            const size_t batchSize = std::min(matcher.getBatchSize(), static_cast<size_t>(maxAlnNum - passedNum));
+            for (batchEnd = hitIdx + 1; batchEnd < hits.size() && batchHits.size() < batchSize; batchEnd++) {
+                const unsigned int batchKey = hits[batchEnd].seqId;
+                size_t batchId = tdbr->getId(batchKey);
+                char *batchSeqData = tdbr->getData(batchId, thread_idx);
+                if (batchSeqData == NULL) {
+                    Debug(Debug::ERROR) << "Sequence " << batchKey <<" is required in the prefiltering, but is not contained in the target sequence database!\nPlease check your database.\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                batchSeq.mapSequence(batchId, batchKey, batchSeqData, tdbr->getSeqLen(batchId));
+                if (Matcher::isBatchTarget(batchSeq.L) == false
+                    || (queryDbKey == batchKey && (includeIdentity || sameQTDB))
+                    || Util::canBeCovered(canCovThr, covMode, static_cast<float>(origQueryLen), static_cast<float>(batchSeq.L)) == false) {
+                    continue;
+                }
+                matcher.addBatchTarget(&batchSeq, reversePrefilterResult && (hits[batchEnd].prefScore < 0));
+                batchHits.push_back(batchEnd);
+            }
+            matcher.getBatchSWResults(covMode, covThr, evalThr, swMode, seqIdMode, batchResults);
+            res = batchResults[batchPos++];
+        } else {
+            res = matcher.getSWResult(&dbSeq, static_cast<int>(diagonal), isReverse, covMode, covThr, evalThr, swMode, seqIdMode, isIdentity, wrappedScoring);
+        }
+        alignmentsNum++;
+        state.swCells += static_cast<size_t>(qSeq.L) * static_cast<size_t>(dbSeq.L);
+
+        //set coverage and seqid if identity
+        if (isIdentity) {
+            res.qcov = 1.0f;
+            res.dbcov = 1.0f;
+            res.seqId = 1.0f;
+        }
+        if(checkCriteria(res, isIdentity, evalThr, seqIdThr, alnLenThr, covMode, covThr)){
+
+            swResults.emplace_back(res);
+            passedNum++;
+            totalPassedNum++;
+            rejected = 0;
+        }else{
+            rejected++;
+        }
+    }
+    if(altAlignment > 0 && realign == false && wrappedScoring == false){
+        computeAlternativeAlignment(queryDbKey, dbSeq, swResults, matcher, evalThr, swMode, thread_idx);
+    }
+
+    if(wrappedScoring && shortResults.size() > 1)
+        SORT_SERIAL(shortResults.begin(), shortResults.end(), hit_t::compareHitsByScoreAndId);
+
+    // write the results
+    if(swResults.size() > 1)
+        SORT_SERIAL(swResults.begin(), swResults.end(), Matcher::compareHits);
+    if (realign == true) {
+        realigner->initQuery(&qSeq);
+        for (size_t result = 0; result < swResults.size(); result++) {
+            size_t dbId = tdbr->getId(swResults[result].dbKey);
+            char *dbSeqData = tdbr->getData(dbId, thread_idx);
+            if (dbSeqData == NULL) {
+                Debug(Debug::ERROR) << "Sequence " << swResults[result].dbKey <<" is required in the prefiltering, but is not contained in the target sequence database!\nPlease check your database.\n";
+                EXIT(EXIT_FAILURE);
+            }
+            dbSeq.mapSequence(static_cast<size_t>(-1), swResults[result].dbKey, dbSeqData,
+                              tdbr->getSeqLen(dbId));
+            const bool isIdentity = (queryDbKey == swResults[result].dbKey && (includeIdentity || sameQTDB)) ? true : false;
+            Matcher::result_t res = realigner->getSWResult(&dbSeq, INT_MAX, false, covMode, covThr, FLT_MAX,
+                                                           Matcher::SCORE_COV_SEQID, seqIdMode, isIdentity);
+            const bool covOK = Util::hasCoverage(realignCov, covMode, res.qcov, res.dbcov);
+            if(covOK == true|| isIdentity){
+                swResults[result].backtrace  = res.backtrace;
+                swResults[result].qStartPos  = res.qStartPos;
+                swResults[result].qEndPos    = res.qEndPos;
+                swResults[result].dbStartPos = res.dbStartPos;
+                swResults[result].dbEndPos   = res.dbEndPos;
+                swResults[result].alnLength  = res.alnLength;
+                swResults[result].seqId      = res.seqId;
+                swResults[result].qcov       = res.qcov;
+                swResults[result].dbcov      = res.dbcov;
+                swRealignResults.push_back(swResults[result]);
+            }
+        }
+        swResults = swRealignResults;
+        if(altAlignment > 0){
+            computeAlternativeAlignment(queryDbKey, dbSeq, swResults, matcher, FLT_MAX, Matcher::SCORE_COV_SEQID, thread_idx);
+        }
+    }
+
+    // put the contents of the swResults list into a result DB
+    for (size_t result = 0; result < swResults.size(); result++) {
+        size_t len = Matcher::resultToBuffer(buffer, swResults[result], addBacktrace);
+        alnResultsOutString.append(buffer, len);
+    }
+
+    for (size_t result = 0; result < shortResults.size(); result++) {
+        size_t len = snprintf(buffer, 100, "%u\t%d\t%d\n", shortResults[result].seqId, shortResults[result].prefScore,
+                              shortResults[result].diagonal);
+        alnResultsOutString.append(buffer, len);
+    }
+
+    swResults.clear();
+    swRealignResults.clear();
+    shortResults.clear();
+}
+
+void Alignment::initHitConsumer(const unsigned int consumerThreads, const unsigned int maxAlnNum, const unsigned int maxRejected, bool wrappedScoring) {
+    consumerMaxAlnNum = maxAlnNum;
+    consumerMaxRejected = maxRejected;
+    consumerWrappedScoring = wrappedScoring;
+    consumerEvaluer = new EvalueComputation(tdbr->getAminoAcidDBSize(), this->m, gapOpen, gapExtend);
+    for (unsigned int i = 0; i < consumerThreads; i++) {
+        consumerData.push_back(new ThreadData(*this, consumerEvaluer, wrappedScoring));
+    }
+}
+
+void Alignment::consumeHits(unsigned int queryKey, std::vector<hit_t> &hits, unsigned int thread_idx, std::string &result) {
+    ThreadData &state = *consumerData[thread_idx];
+    alignQuery(queryKey, hits, state, consumerMaxAlnNum, consumerMaxRejected, consumerWrappedScoring, thread_idx,
+               state.alignmentsNum, state.totalPassedNum, result);
+    state.queries++;
+}
+
+int Alignment::getResultDbType() {
+    return Parameters::DBTYPE_ALIGNMENT_RES;
+}
+
+size_t Alignment::getThreadMemory() {
+    size_t matcherMemory = Matcher::estimateMemoryConsumption(querySeqType, ThreadData::getMatcherMaxSeqLen(*this), m->alphabetSize);
+    if (realign) {
+        matcherMemory *= 2;
+    }
+    // the query, target and batch sequence keep two residue buffers each
+    return matcherMemory + 3 * 2 * (maxSeqLen + 1);
+}
+
+void Alignment::finishHitConsumer() {
+    size_t alignmentsNum = 0;
+    size_t totalPassedNum = 0;
+    size_t queries = 0;
+    size_t swCells = 0;
+    for (size_t i = 0; i < consumerData.size(); i++) {
+        alignmentsNum += consumerData[i]->alignmentsNum;
+        swCells += consumerData[i]->swCells;
+        totalPassedNum += consumerData[i]->totalPassedNum;
+        queries += consumerData[i]->queries;
+        delete consumerData[i];
+    }
+    consumerData.clear();
+    delete consumerEvaluer;
+    consumerEvaluer = NULL;
+    alignmentCount = alignmentsNum;
+    passedCount = totalPassedNum;
+    PerfReport::addCounter("alignments", alignmentsNum);
+    PerfReport::addCounter("acceptedAlignments", totalPassedNum);
+    PerfReport::addCounter("swCells", swCells);
+    if (queries > 0) {
+        printStatistics(alignmentsNum, totalPassedNum, queries);
+    }
+}
+
+void Alignment::printStatistics(size_t alignmentsNum, size_t totalPassedNum, size_t queries) {
     Debug(Debug::INFO) << "\n" << alignmentsNum << " alignments calculated.\n";
     Debug(Debug::INFO) << totalPassedNum << " sequence pairs passed the thresholds ("
                        << ((float) totalPassedNum / (float) alignmentsNum) << " of overall calculated).\n";
 
-    size_t hits = totalPassedNum / dbSize;
-    size_t hits_rest = totalPassedNum % dbSize;
-    float hits_f = ((float) hits) + ((float) hits_rest) / (float) dbSize;
+    size_t hits = totalPassedNum / queries;
+    size_t hits_rest = totalPassedNum % queries;
+    float hits_f = ((float) hits) + ((float) hits_rest) / (float) queries;
     Debug(Debug::INFO) << hits_f << " hits per query sequence.\n";
 }
 
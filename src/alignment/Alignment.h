@@ -10,8 +10,9 @@
 #include "Sequence.h"
 #include "SequenceLookup.h"
 #include "Matcher.h"
+#include "QueryMatcher.h"
 
-class Alignment {
+class Alignment : public PrefilterHitConsumer {
 
 public:
 
@@ -23,6 +24,9 @@ public:
 
     ~Alignment();
 
+    // replaces the query and prefilter databases, the target database stays loaded
+    void setQueryDatabase(const std::string &querySeqDB, const std::string &prefDB, const std::string &prefDBIndex);
+
     //None MPI
     void run(const unsigned int maxAlnNum, const unsigned int maxRejected, bool wrappedScoring=false);
 
@@ -35,6 +39,18 @@ public:
              const size_t dbFrom, const size_t dbSize,
              const unsigned int maxAlnNum, const unsigned int maxRejected, bool merge, bool wrappedScoring=false);
 
+    // aligns the prefilter hits of each query in the prefilter thread that computed them,
+    // initHitConsumer has to be called before and finishHitConsumer after the prefilter run
+    void initHitConsumer(const unsigned int consumerThreads, const unsigned int maxAlnNum, const unsigned int maxRejected, bool wrappedScoring=false);
+    void consumeHits(unsigned int queryKey, std::vector<hit_t> &hits, unsigned int thread_idx, std::string &result);
+    int getResultDbType();
+    size_t getThreadMemory();
+    void finishHitConsumer();
+
+    // alignments computed by the last run or hit consumer and how many of them passed the thresholds
+    size_t getAlignmentCount() const { return alignmentCount; }
+    size_t getPassedCount() const { return passedCount; }
+
     static bool checkCriteria(Matcher::result_t &res, bool isIdentity, double evalThr, double seqIdThr, int alnLenThr, int covMode, float covThr);
 
     static unsigned int initSWMode(unsigned int alignmentMode, float covThr, float seqIdThr);
@@ -80,6 +96,7 @@ private:
     unsigned int swMode;
     unsigned int threads;
     unsigned int compressed;
+    int preloadMode;
 
     const std::string outDB;
     const std::string outDBIndex;
@@ -113,6 +130,33 @@ private:
 
     bool reversePrefilterResult;
 
+    // sequences, matchers and result buffers of one thread
+    struct ThreadData;
+
+    // state of the hit consumer
+    EvalueComputation *consumerEvaluer;
+    std::vector<ThreadData *> consumerData;
+    unsigned int consumerMaxAlnNum;
+    unsigned int consumerMaxRejected;
+    bool consumerWrappedScoring;
+
+    size_t alignmentCount;
+    size_t passedCount;
+
+    // aligns the hits of a query and appends the accepted alignments, with precomputed the result of every
+    // hit that could be covered is taken from there instead of being aligned
+    void alignQuery(unsigned int queryDbKey, std::vector<hit_t> &hits, ThreadData &state,
+                    const unsigned int maxAlnNum, const unsigned int maxRejected, bool wrappedScoring, unsigned int thread_idx,
+                    size_t &alignmentsNum, size_t &totalPassedNum, std::string &alnResultsOutString,
+                    const std::vector<Matcher::result_t> *precomputed = NULL);
+
+    // maps the query and initializes the matcher of the thread, returns the query length before wrapping
+    size_t initQuery(unsigned int queryDbKey, ThreadData &state, bool wrappedScoring, unsigned int thread_idx);
+
+    static void parsePrefilterEntry(char *data, std::vector<hit_t> &hits);
+
+    static void printStatistics(size_t alignmentsNum, size_t totalPassedNum, size_t queries);
+
     static size_t estimateHDDMemoryConsumption(int dbSize, int maxSeqs);
 
     void computeAlternativeAlignment(unsigned int queryDbKey, Sequence &dbSeq,
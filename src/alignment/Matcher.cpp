@@ -24,6 +24,15 @@ Matcher::Matcher(int querySeqType, int maxSeqLen, BaseMatrix *m, EvalueComputati
 }
 
 
+size_t Matcher::estimateMemoryConsumption(int querySeqType, size_t maxSeqLen, int alphabetSize) {
+    size_t subMatSize = alphabetSize * alphabetSize;
+    if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_NUCLEOTIDES)) {
+        // reversed and reverse complemented sequences of the BandedNucleotideAligner
+        return subMatSize * 2 + 5 * (maxSeqLen + 1);
+    }
+    return subMatSize + SmithWaterman::estimateMemoryConsumption(maxSeqLen, alphabetSize);
+}
+
 void Matcher::setSubstitutionMatrix(BaseMatrix *m){
     tinySubMat = new int8_t[m->alphabetSize*m->alphabetSize];
     for (int i = 0; i < m->alphabetSize; i++) {
@@ -132,6 +141,12 @@ Matcher::result_t Matcher::getSWResult(Sequence* dbSeq, const int diagonal, bool
 
     }
 
+    return alignmentToResult(alignment, backtrace, aaIds, dbSeq->getDbKey(), dbSeq->L, origQueryLen, isReverse, alignmentMode, seqIdMode);
+}
+
+Matcher::result_t Matcher::alignmentToResult(s_align &alignment, const std::string &backtrace, int aaIds,
+                                             unsigned int dbKey, unsigned int dbLen, int origQueryLen, bool isReverse,
+                                             unsigned int alignmentMode, unsigned int seqIdMode) {
     // calculation of the coverage and e-value
     float qcov = 0.0;
     float dbcov = 0.0;
@@ -156,7 +171,7 @@ Matcher::result_t Matcher::getSWResult(Sequence* dbSeq, const int diagonal, bool
             // OVERWRITE alnLength with gapped value
             alnLength = backtrace.size();
         }
-        seqId = Util::computeSeqId(seqIdMode, aaIds, origQueryLen, dbSeq->L, alnLength);
+        seqId = Util::computeSeqId(seqIdMode, aaIds, origQueryLen, dbLen, alnLength);
 
     }else if( alignmentMode == Matcher::SCORE_COV){
         // "20%   30%   40%   50%   60%   70%   80%   90%   99%"
@@ -178,9 +193,9 @@ Matcher::result_t Matcher::getSWResult(Sequence* dbSeq, const int diagonal, bool
 
     result_t result;
     if(isReverse){
-        result = result_t(dbSeq->getDbKey(), bitScore, qcov, dbcov, seqId, evalue, alnLength, qStartPos, qEndPos, origQueryLen, dbEndPos, dbStartPos, dbSeq->L, backtrace);
+        result = result_t(dbKey, bitScore, qcov, dbcov, seqId, evalue, alnLength, qStartPos, qEndPos, origQueryLen, dbEndPos, dbStartPos, dbLen, backtrace);
     }else{
-        result = result_t(dbSeq->getDbKey(), bitScore, qcov, dbcov, seqId, evalue, alnLength, qStartPos, qEndPos, origQueryLen, dbStartPos, dbEndPos, dbSeq->L, backtrace);
+        result = result_t(dbKey, bitScore, qcov, dbcov, seqId, evalue, alnLength, qStartPos, qEndPos, origQueryLen, dbStartPos, dbEndPos, dbLen, backtrace);
     }
 
 
@@ -189,6 +204,63 @@ Matcher::result_t Matcher::getSWResult(Sequence* dbSeq, const int diagonal, bool
 }
 
 
+bool Matcher::canAlignBatch(unsigned int alignmentMode) const {
+    return aligner != NULL && (alignmentMode == Matcher::SCORE_ONLY || alignmentMode == Matcher::SCORE_COV)
+           && aligner->canAlignBatch();
+}
+
+size_t Matcher::getBatchSize() const {
+    return aligner->getBatchLanes() * BATCH_PASSES;
+}
+
+void Matcher::addBatchTarget(Sequence *dbSeq, bool isReverse) {
+    batchOffsets.push_back(batchData.size());
+    batchData.insert(batchData.end(), dbSeq->numSequence, dbSeq->numSequence + dbSeq->L);
+    batchLengths.push_back(dbSeq->L);
+    batchKeys.push_back(dbSeq->getDbKey());
+    batchReverse.push_back(isReverse);
+}
+
+void Matcher::clearBatch() {
+    batchData.clear();
+    batchOffsets.clear();
+    batchLengths.clear();
+    batchKeys.clear();
+    batchReverse.clear();
+}
+
+void Matcher::getBatchSWResults(const int covMode, const float covThr, const double evalThr, unsigned int alignmentMode,
+                                unsigned int seqIdMode, std::vector<result_t> &results) {
+    const size_t count = batchLengths.size();
+    // similar lengths end up in the same pass, every pass runs as long as its longest target
+    batchOrder.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        batchOrder[i] = i;
+    }
+    std::stable_sort(batchOrder.begin(), batchOrder.end(), [this](size_t a, size_t b) {
+        return batchLengths[a] < batchLengths[b];
+    });
+    batchSequences.resize(count);
+    batchSortedLengths.resize(count);
+    batchAlignments.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        batchSequences[i] = &batchData[batchOffsets[batchOrder[i]]];
+        batchSortedLengths[i] = batchLengths[batchOrder[i]];
+    }
+    aligner->ssw_align_batch(batchSequences.data(), batchSortedLengths.data(), count, gapOpen, gapExtend, alignmentMode,
+                             evalThr, evaluer, covMode, covThr, currentQuery->L / 2, batchAlignments.data());
+
+    const size_t offset = results.size();
+    results.resize(offset + count);
+    const std::string backtrace;
+    for (size_t i = 0; i < count; i++) {
+        const size_t idx = batchOrder[i];
+        results[offset + idx] = alignmentToResult(batchAlignments[i], backtrace, 0, batchKeys[idx], batchLengths[idx],
+                                                  currentQuery->L, batchReverse[idx], alignmentMode, seqIdMode);
+    }
+    clearBatch();
+}
+
 void Matcher::readAlignmentResults(std::vector<result_t> &result, char *data, bool readCompressed) {
     if(data == NULL) {
         return;
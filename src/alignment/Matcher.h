@@ -146,12 +146,35 @@ public:
             EvalueComputation * evaluer, bool aaBiasCorrection,
             int gapOpen, int gapExtend, int zdrop = 40);
 
+    // memory allocated by the constructor
+    static size_t estimateMemoryConsumption(int querySeqType, size_t maxSeqLen, int alphabetSize);
+
     ~Matcher();
 
     // run SSE2 parallelized Smith-Waterman alignment calculation and traceback
     result_t getSWResult(Sequence* dbSeq, const int diagonal, bool isReverse, const int covMode, const float covThr, const double evalThr,
                          unsigned int alignmentMode, unsigned int seqIdMode, bool isIdentical, bool wrappedScoring=false);
 
+    // the inter-sequence kernel aligns many short targets at once, results are the same as with getSWResult
+    // only for SCORE_ONLY and SCORE_COV of sequence queries
+    bool canAlignBatch(unsigned int alignmentMode) const;
+
+    static bool isBatchTarget(unsigned int dbLen) {
+        return dbLen <= BATCH_MAX_TARGET_LEN;
+    }
+
+    // number of targets worth collecting for one getBatchSWResults call
+    size_t getBatchSize() const;
+
+    // copies the target, dbSeq can be reused afterwards
+    void addBatchTarget(Sequence *dbSeq, bool isReverse);
+
+    void clearBatch();
+
+    // align all added targets, appends one result per target in the order they were added and clears the batch
+    void getBatchSWResults(const int covMode, const float covThr, const double evalThr, unsigned int alignmentMode,
+                           unsigned int seqIdMode, std::vector<result_t> &results);
+
     // need for sorting the results
     static bool compareHits(const result_t &first, const result_t &second) {
         if (first.eval != second.eval) {
@@ -223,6 +246,25 @@ public:
                                                     int gapOpen, int gapExtend, result_t &result);
 
 private:
+    // longest target that goes through the inter-sequence kernel
+    static const unsigned int BATCH_MAX_TARGET_LEN = 256;
+    // kernel passes per batch, more passes give better length grouping
+    static const size_t BATCH_PASSES = 4;
+
+    result_t alignmentToResult(s_align &alignment, const std::string &backtrace, int aaIds,
+                               unsigned int dbKey, unsigned int dbLen, int origQueryLen, bool isReverse,
+                               unsigned int alignmentMode, unsigned int seqIdMode);
+
+    // targets collected by addBatchTarget
+    std::vector<unsigned char> batchData;
+    std::vector<size_t> batchOffsets;
+    std::vector<int32_t> batchLengths;
+    std::vector<unsigned int> batchKeys;
+    std::vector<bool> batchReverse;
+    std::vector<size_t> batchOrder;
+    std::vector<const unsigned char *> batchSequences;
+    std::vector<int32_t> batchSortedLengths;
+    std::vector<s_align> batchAlignments;
 
     // costs to open a gap
     int gapOpen;
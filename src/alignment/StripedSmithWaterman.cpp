@@ -35,16 +35,17 @@
 SmithWaterman::SmithWaterman(size_t maxSequenceLength, int aaSize, bool aaBiasCorrection) {
 	maxSequenceLength += 1;
 	this->aaBiasCorrection = aaBiasCorrection;
+	kernel = SIMD_SELECT_KERNEL(smithWatermanKernel);
 	const int segSize = (maxSequenceLength+7)/8;
-	vHStore = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
-	vHLoad  = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
-	vE      = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
-	vHmax   = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
+	buffers.vHStore = mem_align(MAX_ALIGN_INT, segSize * kernel->vectorBytes);
+	buffers.vHLoad  = mem_align(MAX_ALIGN_INT, segSize * kernel->vectorBytes);
+	buffers.vE      = mem_align(MAX_ALIGN_INT, segSize * kernel->vectorBytes);
+	buffers.vHmax   = mem_align(MAX_ALIGN_INT, segSize * kernel->vectorBytes);
 	profile = new s_profile();
-	profile->profile_byte = (simd_int*)mem_align(ALIGN_INT, aaSize * segSize * sizeof(simd_int));
-	profile->profile_word = (simd_int*)mem_align(ALIGN_INT, aaSize * segSize * sizeof(simd_int));
-	profile->profile_rev_byte = (simd_int*)mem_align(ALIGN_INT, aaSize * segSize * sizeof(simd_int));
-	profile->profile_rev_word = (simd_int*)mem_align(ALIGN_INT, aaSize * segSize * sizeof(simd_int));
+	profile->profile_byte = (simd_int*)mem_align(MAX_ALIGN_INT, aaSize * segSize * kernel->vectorBytes);
+	profile->profile_word = (simd_int*)mem_align(MAX_ALIGN_INT, aaSize * segSize * kernel->vectorBytes);
+	profile->profile_rev_byte = (simd_int*)mem_align(MAX_ALIGN_INT, aaSize * segSize * kernel->vectorBytes);
+	profile->profile_rev_word = (simd_int*)mem_align(MAX_ALIGN_INT, aaSize * segSize * kernel->vectorBytes);
 	profile->query_rev_sequence = new int8_t[maxSequenceLength];
 	profile->query_sequence     = new int8_t[maxSequenceLength];
 	profile->composition_bias   = new int8_t[maxSequenceLength];
@@ -54,9 +55,15 @@ SmithWaterman::SmithWaterman(size_t maxSequenceLength, int aaSize, bool aaBiasCo
 	profile->mat_rev            = new int8_t[maxSequenceLength * aaSize * 2];
 	profile->mat                = new int8_t[maxSequenceLength * aaSize * 2];
 	tmp_composition_bias   = new float[maxSequenceLength];
+	// the batch kernel keeps H and E of the full query for each lane
+	batch_query_table = (uint8_t*)mem_align(MAX_ALIGN_INT, std::min(maxSequenceLength, (size_t)BATCH_MAX_QUERY_LEN) * 32);
+	batch_buffer = mem_align(MAX_ALIGN_INT, 2 * std::min(maxSequenceLength, (size_t)BATCH_MAX_QUERY_LEN) * kernel->vectorBytes);
+	batch_targets = NULL;
+	batch_targets_size = 0;
+	batch_query = false;
 	/* array to record the largest score of each reference position */
-	maxColumn = new uint8_t[maxSequenceLength*sizeof(uint16_t)];
-	memset(maxColumn, 0, maxSequenceLength*sizeof(uint16_t));
+	buffers.maxColumn = new uint8_t[maxSequenceLength*sizeof(uint16_t)];
+	memset(buffers.maxColumn, 0, maxSequenceLength*sizeof(uint16_t));
 
 	memset(profile->query_sequence, 0, maxSequenceLength * sizeof(int8_t));
 	memset(profile->query_rev_sequence, 0, maxSequenceLength * sizeof(int8_t));
@@ -65,11 +72,24 @@ SmithWaterman::SmithWaterman(size_t maxSequenceLength, int aaSize, bool aaBiasCo
 	memset(profile->composition_bias_rev, 0, maxSequenceLength * sizeof(int8_t));
 }
 
+size_t SmithWaterman::estimateMemoryConsumption(size_t maxSequenceLength, int aaSize) {
+	maxSequenceLength += 1;
+	const size_t vectorBytes = SIMD_SELECT_KERNEL(smithWatermanKernel)->vectorBytes;
+	const size_t segBytes = ((maxSequenceLength + 7) / 8) * vectorBytes;
+	const size_t batchLen = std::min(maxSequenceLength, (size_t)BATCH_MAX_QUERY_LEN);
+	// striped buffers and profiles
+	return (4 + 4 * aaSize) * segBytes
+	       // query sequences, composition bias, linear profile, mat and mat_rev, maxColumn
+	       + maxSequenceLength * (4 + sizeof(float) + aaSize * (sizeof(short) + 4) + sizeof(uint16_t))
+	       // inter-sequence kernel
+	       + batchLen * (32 + 2 * vectorBytes);
+}
+
 SmithWaterman::~SmithWaterman(){
-	free(vHStore);
-	free(vHLoad);
-	free(vE);
-	free(vHmax);
+	free(buffers.vHStore);
+	free(buffers.vHLoad);
+	free(buffers.vE);
+	free(buffers.vHmax);
 	free(profile->profile_byte);
 	free(profile->profile_word);
 	free(profile->profile_rev_byte);
@@ -83,18 +103,21 @@ SmithWaterman::~SmithWaterman(){
 	delete [] profile->mat_rev;
 	delete [] profile->mat;
 	delete [] tmp_composition_bias;
-	delete [] maxColumn;
+	free(batch_query_table);
+	free(batch_buffer);
+	delete [] batch_targets;
+	delete [] buffers.maxColumn;
 	delete profile;
 }
 
 
 /* Generate query profile rearrange query sequence & calculate the weight of match/mismatch. */
-template <typename T, size_t Elements, const unsigned int type>
-void SmithWaterman::createQueryProfile(simd_int *profile, const int8_t *query_sequence, const int8_t * composition_bias, const int8_t *mat,
+template <typename T, const unsigned int type>
+void SmithWaterman::createQueryProfile(simd_int *profile, const size_t elements, const int8_t *query_sequence, const int8_t * composition_bias, const int8_t *mat,
 									   const int32_t query_length, const int32_t aaSize, uint8_t bias,
 									   const int32_t offset, const int32_t entryLength) {
 
-	const int32_t segLen = (query_length+Elements-1)/Elements;
+	const int32_t segLen = (query_length+elements-1)/elements;
 	T* t = (T*)profile;
 
 	/* Generate query profile rearrange query sequence & calculate the weight of match/mismatch */
@@ -103,7 +126,7 @@ void SmithWaterman::createQueryProfile(simd_int *profile, const int8_t *query_se
 		for (int32_t i = 0; i < segLen; i ++) {
 			int32_t  j = i;
 //			printf("(");
-			for (size_t segNum = 0; LIKELY(segNum < Elements) ; segNum ++) {
+			for (size_t segNum = 0; LIKELY(segNum < elements) ; segNum ++) {
 				// if will be optmized out by compiler
 				if(type == SUBSTITUTIONMATRIX) {     // substitution score for query_seq constrained by nt
 					// query_sequence starts from 1 to n
@@ -139,8 +162,6 @@ s_align SmithWaterman::ssw_align (
 		const int32_t maskLen) {
 
 	int32_t word = 0, query_length = profile->query_length;
-	int32_t band_width = 0;
-	cigar* path;
 	s_align r;
 	r.dbStartPos1 = -1;
 	r.qStartPos1 = -1;
@@ -151,7 +172,6 @@ s_align SmithWaterman::ssw_align (
 	//}
 
     std::pair<alignment_end, alignment_end> bests;
-    std::pair<alignment_end, alignment_end> bests_reverse;
     // Find the alignment scores and ending positions
 	if (profile->profile_byte) {
 		bests = sw_sse2_byte(db_sequence, 0, db_length, query_length, gap_open, gap_extend, profile->profile_byte, UCHAR_MAX, profile->bias, maskLen);
@@ -182,6 +202,24 @@ s_align SmithWaterman::ssw_align (
 		r.ref_end2 = -1;
 	}
 
+	return ssw_align_from_end(r, word, db_sequence, db_length, gap_open, gap_extend, alignmentMode, evalueThr, evaluer, covMode, covThr, maskLen);
+}
+
+s_align SmithWaterman::ssw_align_from_end(s_align r, bool word,
+		const unsigned char *db_sequence,
+		int32_t db_length,
+		const uint8_t gap_open,
+		const uint8_t gap_extend,
+		const uint8_t alignmentMode,
+		const double  evalueThr,
+		EvalueComputation * evaluer,
+		const int covMode, const float covThr,
+		const int32_t maskLen) {
+	int32_t query_length = profile->query_length;
+	int32_t band_width = 0;
+	cigar* path;
+	std::pair<alignment_end, alignment_end> bests_reverse;
+
     const bool isProfile = Parameters::isEqualDbtype(profile->sequence_type, Parameters::DBTYPE_HMM_PROFILE)
                          || Parameters::isEqualDbtype(profile->sequence_type, Parameters::DBTYPE_PROFILE_STATE_PROFILE);
     // no residue could be aligned
@@ -202,21 +240,21 @@ s_align SmithWaterman::ssw_align (
 	// Find the beginning position of the best alignment.
 	if (word == 0) {
 		if (isProfile) {
-			createQueryProfile<int8_t, VECSIZE_INT * 4, PROFILE>(profile->profile_rev_byte, profile->query_rev_sequence, NULL, profile->mat_rev,
+			createQueryProfile<int8_t, PROFILE>(profile->profile_rev_byte, kernel->vectorBytes, profile->query_rev_sequence, NULL, profile->mat_rev,
 																 r.qEndPos1 + 1, profile->alphabetSize, profile->bias, queryOffset, profile->query_length);
 		} else {
-			createQueryProfile<int8_t, VECSIZE_INT * 4, SUBSTITUTIONMATRIX>(profile->profile_rev_byte, profile->query_rev_sequence, profile->composition_bias_rev, profile->mat,
+			createQueryProfile<int8_t, SUBSTITUTIONMATRIX>(profile->profile_rev_byte, kernel->vectorBytes, profile->query_rev_sequence, profile->composition_bias_rev, profile->mat,
 																			r.qEndPos1 + 1, profile->alphabetSize, profile->bias, queryOffset, 0);
 		}
 		bests_reverse = sw_sse2_byte(db_sequence, 1, r.dbEndPos1 + 1, r.qEndPos1 + 1, gap_open, gap_extend, profile->profile_rev_byte,
 									 r.score1, profile->bias, maskLen);
 	} else {
 		if (isProfile) {
-			createQueryProfile<int16_t, VECSIZE_INT * 2, PROFILE>(profile->profile_rev_word, profile->query_rev_sequence, NULL, profile->mat_rev,
+			createQueryProfile<int16_t, PROFILE>(profile->profile_rev_word, kernel->vectorBytes / 2, profile->query_rev_sequence, NULL, profile->mat_rev,
 																  r.qEndPos1 + 1, profile->alphabetSize, 0, queryOffset, profile->query_length);
 
 		} else {
-			createQueryProfile<int16_t, VECSIZE_INT * 2, SUBSTITUTIONMATRIX>(profile->profile_rev_word, profile->query_rev_sequence, profile->composition_bias_rev, profile->mat,
+			createQueryProfile<int16_t, SUBSTITUTIONMATRIX>(profile->profile_rev_word, kernel->vectorBytes / 2, profile->query_rev_sequence, profile->composition_bias_rev, profile->mat,
 																			 r.qEndPos1 + 1, profile->alphabetSize, 0, queryOffset, 0);
 		}
 		bests_reverse = sw_sse2_word(db_sequence, 1, r.dbEndPos1 + 1, r.qEndPos1 + 1, gap_open, gap_extend, profile->profile_rev_word,
@@ -271,6 +309,72 @@ s_align SmithWaterman::ssw_align (
 
 
 
+void SmithWaterman::ssw_align_batch(const unsigned char **db_sequences,
+		const int32_t *db_lengths,
+		size_t count,
+		const uint8_t gap_open,
+		const uint8_t gap_extend,
+		const uint8_t alignmentMode,
+		const double  evalueThr,
+		EvalueComputation * evaluer,
+		const int covMode, const float covThr,
+		const int32_t maskLen,
+		s_align *results) {
+	const size_t lanes = getBatchLanes();
+	for (size_t from = 0; from < count; from += lanes) {
+		const size_t n = std::min(count - from, lanes);
+		// a mostly empty pass is slower than aligning the few targets one by one
+		if (n < lanes / 2) {
+			for (size_t k = 0; k < n; k++) {
+				results[from + k] = ssw_align(db_sequences[from + k], db_lengths[from + k], gap_open, gap_extend, alignmentMode,
+				                              evalueThr, evaluer, covMode, covThr, maskLen);
+			}
+			break;
+		}
+		int32_t target_length = 0;
+		for (size_t k = 0; k < n; k++) {
+			target_length = std::max(target_length, db_lengths[from + k]);
+		}
+		if (static_cast<size_t>(target_length) * lanes > batch_targets_size) {
+			delete [] batch_targets;
+			batch_targets_size = static_cast<size_t>(target_length) * lanes;
+			batch_targets = new unsigned char[batch_targets_size];
+		}
+		// interleave the targets, unused lanes and positions get a residue that never scores
+		memset(batch_targets, BATCH_PADDING, static_cast<size_t>(target_length) * lanes);
+		for (size_t k = 0; k < n; k++) {
+			for (int32_t i = 0; i < db_lengths[from + k]; i++) {
+				batch_targets[i * lanes + k] = db_sequences[from + k][i];
+			}
+		}
+		kernel->batchByte(batch_query_table, profile->query_length, batch_targets, target_length,
+		                  gap_open, gap_extend, profile->bias, batch_buffer, batch_ends);
+
+		for (size_t k = 0; k < n; k++) {
+			const alignment_end &end = batch_ends[k];
+			// saturated byte score, ssw_align switches to the word kernels
+			if (end.score + profile->bias >= UCHAR_MAX) {
+				results[from + k] = ssw_align(db_sequences[from + k], db_lengths[from + k], gap_open, gap_extend, alignmentMode,
+				                              evalueThr, evaluer, covMode, covThr, maskLen);
+				continue;
+			}
+			// the batch kernel does not search for a suboptimal alignment
+			s_align r;
+			r.dbStartPos1 = -1;
+			r.qStartPos1 = -1;
+			r.cigar = 0;
+			r.cigarLen = 0;
+			r.score1 = end.score;
+			r.dbEndPos1 = end.ref;
+			r.qEndPos1 = end.read;
+			r.score2 = 0;
+			r.ref_end2 = -1;
+			results[from + k] = ssw_align_from_end(r, false, db_sequences[from + k], db_lengths[from + k], gap_open, gap_extend,
+			                                       alignmentMode, evalueThr, evaluer, covMode, covThr, maskLen);
+		}
+	}
+}
+
 char SmithWaterman::cigar_int_to_op(uint32_t cigar_int) {
 	uint8_t letter_code = cigar_int & 0xfU;
 	static const char map[] = {
@@ -305,217 +409,14 @@ std::pair<SmithWaterman::alignment_end, SmithWaterman::alignment_end> SmithWater
 														   const uint8_t gap_open, /* will be used as - */
 														   const uint8_t gap_extend, /* will be used as - */
 														   const simd_int* query_profile_byte,
-														   uint8_t terminate,	/* the best alignment score: used to terminate
-                                                         the matrix calculation when locating the
-                                                         alignment beginning point. If this score
-                                                         is set to 0, it will not be used */
+														   uint8_t terminate,
 														   uint8_t bias,  /* Shift 0 point to a positive value. */
 														   int32_t maskLen) {
-#define max16(m, vm) ((m) = simdi8_hmax((vm)));
-
-	uint8_t max = 0;		                     /* the max alignment score */
-	int32_t end_query = query_length - 1;
-	int32_t end_db = -1; /* 0_based best alignment ending point; Initialized as isn't aligned -1. */
-	const int SIMD_SIZE = VECSIZE_INT * 4;
-	int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
-	/* array to record the largest score of each reference position */
-	memset(this->maxColumn, 0, db_length * sizeof(uint8_t));
-	uint8_t * maxColumn = (uint8_t *) this->maxColumn;
-
-	/* Define 16 byte 0 vector. */
-	simd_int vZero = simdi32_set(0);
-	simd_int* pvHStore = vHStore;
-	simd_int* pvHLoad = vHLoad;
-	simd_int* pvE = vE;
-	simd_int* pvHmax = vHmax;
-	memset(pvHStore,0,segLen*sizeof(simd_int));
-	memset(pvHLoad,0,segLen*sizeof(simd_int));
-	memset(pvE,0,segLen*sizeof(simd_int));
-	memset(pvHmax,0,segLen*sizeof(simd_int));
-
-	int32_t i, j;
-	/* 16 byte insertion begin vector */
-	simd_int vGapO = simdi8_set(gap_open);
-
-	/* 16 byte insertion extension vector */
-	simd_int vGapE = simdi8_set(gap_extend);
-
-	/* 16 byte bias vector */
-	simd_int vBias = simdi8_set(bias);
-
-	simd_int vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
-	simd_int vMaxMark = vZero; /* Trace the highest score till the previous column. */
-	simd_int vTemp;
-	int32_t edge, begin = 0, end = db_length, step = 1;
-	//	int32_t distance = query_length * 2 / 3;
-	//	int32_t distance = query_length / 2;
-	//	int32_t distance = query_length;
-
-	/* outer loop to process the reference sequence */
-	if (ref_dir == 1) {
-		begin = db_length - 1;
-		end = -1;
-		step = -1;
-	}
-	for (i = begin; LIKELY(i != end); i += step) {
-		simd_int e, vF = vZero, vMaxColumn = vZero; /* Initialize F value to 0.
-                                                    Any errors to vH values will be corrected in the Lazy_F loop.
-                                                    */
-		//		max16(maxColumn[i], vMaxColumn);
-		//		fprintf(stderr, "middle[%d]: %d\n", i, maxColumn[i]);
-
-		simd_int vH = pvHStore[segLen - 1];
-		vH = simdi8_shiftl (vH, 1); /* Shift the 128-bit value in vH left by 1 byte. */
-		const simd_int* vP = query_profile_byte + db_sequence[i] * segLen; /* Right part of the query_profile_byte */
-		//	int8_t* t;
-		//	int32_t ti;
-		//        fprintf(stderr, "i: %d of %d:\t ", i,segLen);
-		//for (t = (int8_t*)vP, ti = 0; ti < segLen; ++ti) fprintf(stderr, "%d\t", *t++);
-		//fprintf(stderr, "\n");
-
-		/* Swap the 2 H buffers. */
-		simd_int* pv = pvHLoad;
-		pvHLoad = pvHStore;
-		pvHStore = pv;
-
-		/* inner loop to process the query sequence */
-		for (j = 0; LIKELY(j < segLen); ++j) {
-			vH = simdui8_adds(vH, simdi_load(vP + j));
-			vH = simdui8_subs(vH, vBias); /* vH will be always > 0 */
-			//	max16(maxColumn[i], vH);
-			//	fprintf(stderr, "H[%d]: %d\n", i, maxColumn[i]);
-			//	int8_t* t;
-			//	int32_t ti;
-			//for (t = (int8_t*)&vH, ti = 0; ti < 16; ++ti) fprintf(stderr, "%d\t", *t++);
-
-			/* Get max from vH, vE and vF. */
-			e = simdi_load(pvE + j);
-			vH = simdui8_max(vH, e);
-			vH = simdui8_max(vH, vF);
-			vMaxColumn = simdui8_max(vMaxColumn, vH);
-
-			//	max16(maxColumn[i], vMaxColumn);
-			//	fprintf(stderr, "middle[%d]: %d\n", i, maxColumn[i]);
-			//	for (t = (int8_t*)&vMaxColumn, ti = 0; ti < 16; ++ti) fprintf(stderr, "%d\t", *t++);
-
-			/* Save vH values. */
-			simdi_store(pvHStore + j, vH);
-
-			/* Update vE value. */
-			vH = simdui8_subs(vH, vGapO); /* saturation arithmetic, result >= 0 */
-			e = simdui8_subs(e, vGapE);
-			e = simdui8_max(e, vH);
-			simdi_store(pvE + j, e);
-
-			/* Update vF value. */
-			vF = simdui8_subs(vF, vGapE);
-			vF = simdui8_max(vF, vH);
-
-			/* Load the next vH. */
-			vH = simdi_load(pvHLoad + j);
-		}
-
-		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
-		/* reset pointers to the start of the saved data */
-		j = 0;
-		vH = simdi_load (pvHStore + j);
-
-		/*  the computed vF value is for the given column.  since */
-		/*  we are at the end, we need to shift the vF value over */
-		/*  to the next column. */
-		vF = simdi8_shiftl (vF, 1);
-		vTemp = simdui8_subs (vH, vGapO);
-		vTemp = simdui8_subs (vF, vTemp);
-		vTemp = simdi8_eq (vTemp, vZero);
-		uint32_t cmp = simdi8_movemask (vTemp);
-		while (cmp != SIMD_MOVEMASK_MAX) {
-			vH = simdui8_max (vH, vF);
-			vMaxColumn = simdui8_max(vMaxColumn, vH);
-			simdi_store (pvHStore + j, vH);
-			vF = simdui8_subs (vF, vGapE);
-			j++;
-			if (j >= segLen)
-			{
-				j = 0;
-				vF = simdi8_shiftl (vF, 1);
-			}
-			vH = simdi_load (pvHStore + j);
-
-			vTemp = simdui8_subs (vH, vGapO);
-			vTemp = simdui8_subs (vF, vTemp);
-			vTemp = simdi8_eq (vTemp, vZero);
-			cmp  = simdi8_movemask (vTemp);
-		}
-
-		vMaxScore = simdui8_max(vMaxScore, vMaxColumn);
-		vTemp = simdi8_eq(vMaxMark, vMaxScore);
-		cmp = simdi8_movemask(vTemp);
-		if (cmp != SIMD_MOVEMASK_MAX) {
-			uint8_t temp;
-			vMaxMark = vMaxScore;
-			max16(temp, vMaxScore);
-			vMaxScore = vMaxMark;
-
-			if (LIKELY(temp > max)) {
-				max = temp;
-				if (max + bias >= 255) break;	//overflow
-				end_db = i;
-
-				/* Store the column with the highest alignment score in order to trace the alignment ending position on read. */
-				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
-			}
-		}
-
-		/* Record the max score of current column. */
-		max16(maxColumn[i], vMaxColumn);
-		//		fprintf(stderr, "maxColumn[%d]: %d\n", i, maxColumn[i]);
-		if (maxColumn[i] == terminate) break;
-	}
-
-	/* Trace the alignment ending position on read. */
-	uint8_t *t = (uint8_t*)pvHmax;
-	int32_t column_len = segLen * SIMD_SIZE;
-	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
-		int32_t temp;
-		if (*t == max) {
-			temp = i / SIMD_SIZE + i % SIMD_SIZE * segLen;
-			if (temp < end_query) end_query = temp;
-		}
-	}
-
-	/* Find the most possible 2nd best alignment. */
-	alignment_end best0;
-    best0.score = max + bias >= 255 ? 255 : max;
-    best0.ref = end_db;
-    best0.read = end_query;
-
-    alignment_end best1;
-    best1.score = 0;
-    best1.ref = 0;
-    best1.read = 0;
-
-	edge = (end_db - maskLen) > 0 ? (end_db - maskLen) : 0;
-	for (i = 0; i < edge; i ++) {
-		//			fprintf (stderr, "maxColumn[%d]: %d\n", i, maxColumn[i]);
-		if (maxColumn[i] > best1.score) {
-            best1.score = maxColumn[i];
-            best1.ref = i;
-		}
-	}
-	edge = (end_db + maskLen) > db_length ? db_length : (end_db + maskLen);
-	for (i = edge + 1; i < db_length; i ++) {
-		//			fprintf (stderr, "db_length: %d\tmaxColumn[%d]: %d\n", db_length, i, maxColumn[i]);
-		if (maxColumn[i] > best1.score) {
-            best1.score = maxColumn[i];
-            best1.ref = i;
-		}
-	}
-
-	return std::make_pair(best0, best1);
-#undef max16
+	SmithWatermanKernel::AlignmentEnds bests = kernel->swByte(db_sequence, ref_dir, db_length, query_length, gap_open, gap_extend,
+															  query_profile_byte, terminate, bias, maskLen, buffers);
+	return std::make_pair(bests.best, bests.second);
 }
 
-
 std::pair<SmithWaterman::alignment_end, SmithWaterman::alignment_end> SmithWaterman::sw_sse2_word (const unsigned char* db_sequence,
 														   int8_t ref_dir,	// 0: forward ref; 1: reverse ref
 														   int32_t db_length,
@@ -525,165 +426,9 @@ std::pair<SmithWaterman::alignment_end, SmithWaterman::alignment_end> SmithWater
 														   const simd_int*query_profile_word,
 														   uint16_t terminate,
 														   int32_t maskLen) {
-
-#define max8(m, vm) ((m) = simdi16_hmax((vm)));
-
-	uint16_t max = 0;		                     /* the max alignment score */
-	int32_t end_read = query_length - 1;
-	int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
-	const unsigned int SIMD_SIZE = VECSIZE_INT * 2;
-	int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
-	/* array to record the alignment read ending position of the largest score of each reference position */
-	memset(this->maxColumn, 0, db_length * sizeof(uint16_t));
-	uint16_t * maxColumn = (uint16_t *) this->maxColumn;
-
-	/* Define 16 byte 0 vector. */
-	simd_int vZero = simdi32_set(0);
-	simd_int* pvHStore = vHStore;
-	simd_int* pvHLoad = vHLoad;
-	simd_int* pvE = vE;
-	simd_int* pvHmax = vHmax;
-	memset(pvHStore,0,segLen*sizeof(simd_int));
-	memset(pvHLoad,0, segLen*sizeof(simd_int));
-	memset(pvE,0,     segLen*sizeof(simd_int));
-	memset(pvHmax,0,  segLen*sizeof(simd_int));
-
-	int32_t i, j, k;
-	/* 16 byte insertion begin vector */
-	simd_int vGapO = simdi16_set(gap_open);
-
-	/* 16 byte insertion extension vector */
-	simd_int vGapE = simdi16_set(gap_extend);
-
-	simd_int vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
-	simd_int vMaxMark = vZero; /* Trace the highest score till the previous column. */
-	simd_int vTemp;
-	int32_t edge, begin = 0, end = db_length, step = 1;
-
-	/* outer loop to process the reference sequence */
-	if (ref_dir == 1) {
-		begin = db_length - 1;
-		end = -1;
-		step = -1;
-	}
-	for (i = begin; LIKELY(i != end); i += step) {
-		simd_int e, vF = vZero; /* Initialize F value to 0.
-                                Any errors to vH values will be corrected in the Lazy_F loop.
-                                */
-		simd_int vH = pvHStore[segLen - 1];
-		vH = simdi8_shiftl (vH, 2); /* Shift the 128-bit value in vH left by 2 byte. */
-
-		/* Swap the 2 H buffers. */
-		simd_int* pv = pvHLoad;
-
-		simd_int vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
-
-		const simd_int* vP = query_profile_word + db_sequence[i] * segLen; /* Right part of the query_profile_byte */
-		pvHLoad = pvHStore;
-		pvHStore = pv;
-
-		/* inner loop to process the query sequence */
-		for (j = 0; LIKELY(j < segLen); j ++) {
-			vH = simdi16_adds(vH, simdi_load(vP + j));
-
-			/* Get max from vH, vE and vF. */
-			e = simdi_load(pvE + j);
-			vH = simdi16_max(vH, e);
-			vH = simdi16_max(vH, vF);
-			vMaxColumn = simdi16_max(vMaxColumn, vH);
-
-			/* Save vH values. */
-			simdi_store(pvHStore + j, vH);
-
-			/* Update vE value. */
-			vH = simdui16_subs(vH, vGapO); /* saturation arithmetic, result >= 0 */
-			e = simdui16_subs(e, vGapE);
-			e = simdi16_max(e, vH);
-			simdi_store(pvE + j, e);
-
-			/* Update vF value. */
-			vF = simdui16_subs(vF, vGapE);
-			vF = simdi16_max(vF, vH);
-
-			/* Load the next vH. */
-			vH = simdi_load(pvHLoad + j);
-		}
-
-		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
-		for (k = 0; LIKELY(k < (int32_t) SIMD_SIZE); ++k) {
-			vF = simdi8_shiftl (vF, 2);
-			for (j = 0; LIKELY(j < segLen); ++j) {
-				vH = simdi_load(pvHStore + j);
-				vH = simdi16_max(vH, vF);
-				vMaxColumn = simdi16_max(vMaxColumn, vH); //newly added line
-				simdi_store(pvHStore + j, vH);
-				vH = simdui16_subs(vH, vGapO);
-				vF = simdui16_subs(vF, vGapE);
-				if (UNLIKELY(! simdi8_movemask(simdi16_gt(vF, vH)))) goto end;
-			}
-		}
-
-		end:
-		vMaxScore = simdi16_max(vMaxScore, vMaxColumn);
-		vTemp = simdi16_eq(vMaxMark, vMaxScore);
-		uint32_t cmp = simdi8_movemask(vTemp);
-		if (cmp != SIMD_MOVEMASK_MAX) {
-			uint16_t temp;
-			vMaxMark = vMaxScore;
-			max8(temp, vMaxScore);
-			vMaxScore = vMaxMark;
-
-			if (LIKELY(temp > max)) {
-				max = temp;
-				end_ref = i;
-				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
-			}
-		}
-
-		/* Record the max score of current column. */
-		max8(maxColumn[i], vMaxColumn);
-		if (maxColumn[i] == terminate) break;
-	}
-
-	/* Trace the alignment ending position on read. */
-	uint16_t *t = (uint16_t*)pvHmax;
-	int32_t column_len = segLen * SIMD_SIZE;
-	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
-		int32_t temp;
-		if (*t == max) {
-			temp = i / SIMD_SIZE + i % SIMD_SIZE * segLen;
-			if (temp < end_read) end_read = temp;
-		}
-	}
-
-	/* Find the most possible 2nd best alignment. */
-	alignment_end best0;
-    best0.score = max;
-    best0.ref = end_ref;
-    best0.read = end_read;
-
-    alignment_end best1;
-    best1.score = 0;
-    best1.ref = 0;
-    best1.read = 0;
-
-	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
-	for (i = 0; i < edge; i ++) {
-		if (maxColumn[i] > best1.score) {
-            best1.score = maxColumn[i];
-            best1.ref = i;
-		}
-	}
-	edge = (end_ref + maskLen) > db_length ? db_length : (end_ref + maskLen);
-	for (i = edge; i < db_length; i ++) {
-		if (maxColumn[i] > best1.score) {
-            best1.score = maxColumn[i];
-            best1.ref = i;
-		}
-	}
-
-	return std::make_pair(best0, best1);
-#undef max8
+	SmithWatermanKernel::AlignmentEnds bests = kernel->swWord(db_sequence, ref_dir, db_length, query_length, gap_open, gap_extend,
+															  query_profile_word, terminate, maskLen, buffers);
+	return std::make_pair(bests.best, bests.second);
 }
 
 void SmithWaterman::ssw_init(const Sequence* q,
@@ -736,14 +481,14 @@ void SmithWaterman::ssw_init(const Sequence* q,
 		bias = abs(bias) + abs(compositionBias);
 		profile->bias = bias;
 		if (isProfile) {
-			createQueryProfile<int8_t, VECSIZE_INT * 4, PROFILE>(profile->profile_byte, profile->query_sequence, NULL, profile->mat, q->L, alphabetSize, bias, 1, q->L);
+			createQueryProfile<int8_t, PROFILE>(profile->profile_byte, kernel->vectorBytes, profile->query_sequence, NULL, profile->mat, q->L, alphabetSize, bias, 1, q->L);
 		} else {
-			createQueryProfile<int8_t, VECSIZE_INT * 4, SUBSTITUTIONMATRIX>(profile->profile_byte, profile->query_sequence, profile->composition_bias, profile->mat, q->L, alphabetSize, bias, 0, 0);
+			createQueryProfile<int8_t, SUBSTITUTIONMATRIX>(profile->profile_byte, kernel->vectorBytes, profile->query_sequence, profile->composition_bias, profile->mat, q->L, alphabetSize, bias, 0, 0);
 		}
 	}
 	if (score_size == 1 || score_size == 2) {
 		if (isProfile) {
-			createQueryProfile<int16_t, VECSIZE_INT * 2, PROFILE>(profile->profile_word, profile->query_sequence, NULL, profile->mat, q->L, alphabetSize, 0, 1, q->L);
+			createQueryProfile<int16_t, PROFILE>(profile->profile_word, kernel->vectorBytes / 2, profile->query_sequence, NULL, profile->mat, q->L, alphabetSize, 0, 1, q->L);
 			for (int32_t i = 0; i< alphabetSize; i++) {
 				profile->profile_word_linear[i] = &profile_word_linear_data[i*q->L];
 				for (int j = 0; j < q->L; j++) {
@@ -752,7 +497,7 @@ void SmithWaterman::ssw_init(const Sequence* q,
 				}
 			}
 		}else{
-			createQueryProfile<int16_t, VECSIZE_INT * 2, SUBSTITUTIONMATRIX>(profile->profile_word, profile->query_sequence, profile->composition_bias, profile->mat, q->L, alphabetSize, 0, 0, 0);
+			createQueryProfile<int16_t, SUBSTITUTIONMATRIX>(profile->profile_word, kernel->vectorBytes / 2, profile->query_sequence, profile->composition_bias, profile->mat, q->L, alphabetSize, 0, 0, 0);
 			for(int32_t i = 0; i< alphabetSize; i++) {
 				profile->profile_word_linear[i] = &profile_word_linear_data[i*q->L];
 				for (int j = 0; j < q->L; j++) {
@@ -776,6 +521,17 @@ void SmithWaterman::ssw_init(const Sequence* q,
 	}
 	profile->query_length = q->L;
 	profile->alphabetSize = alphabetSize;
+
+	batch_query = !isProfile && q->L <= BATCH_MAX_QUERY_LEN && alphabetSize <= BATCH_PADDING;
+	if (batch_query) {
+		// same biased scores as in profile_byte, the padding residue scores 0
+		for (int32_t j = 0; j < q->L; j++) {
+			uint8_t *row = batch_query_table + j * 32;
+			for (int32_t t = 0; t < 32; t++) {
+				row[t] = (t < alphabetSize) ? profile->mat[t * alphabetSize + q->numSequence[j]] + profile->composition_bias[j] + profile->bias : 0;
+			}
+		}
+	}
 }
 template <const unsigned int type>
 SmithWaterman::cigar * SmithWaterman::banded_sw(const unsigned char *db_sequence, const int8_t *query_sequence, const int8_t * compositionBias,
@@ -1092,73 +848,6 @@ s_align SmithWaterman::scoreIdentical(unsigned char *dbSeq, int L, EvalueComputa
 	return r;
 }
 
-template <typename F>
-inline F simd_hmax(const F * in, unsigned int n) {
-    F current = std::numeric_limits<F>::min();
-    do {
-        current = std::max(current, *in++);
-    } while(--n);
-
-    return current;
-}
-
 int SmithWaterman::ungapped_alignment(const unsigned char *db_sequence, int32_t db_length) {
-#define SWAP(tmp, arg1, arg2) tmp = arg1; arg1 = arg2; arg2 = tmp;
-
-	int i; // position in query bands (0,..,W-1)
-	int j; // position in db sequence (0,..,dbseq_length-1)
-	int element_count = (VECSIZE_INT * 4);
-	const int W = (profile->query_length + (element_count - 1)) / element_count; // width of bands in query and score matrix = hochgerundetes LQ/16
-
-	simd_int *p;
-	simd_int S;              // 16 unsigned bytes holding S(b*W+i,j) (b=0,..,15)
-	simd_int Smax = simdi_setzero();
-	simd_int Soffset; // all scores in query profile are shifted up by Soffset to obtain pos values
-	simd_int *s_prev, *s_curr; // pointers to Score(i-1,j-1) and Score(i,j), resp.
-	simd_int *qji;             // query profile score in row j (for residue x_j)
-	simd_int *s_prev_it, *s_curr_it;
-	simd_int *query_profile_it = (simd_int *) profile->profile_byte;
-
-	// Load the score offset to all 16 unsigned byte elements of Soffset
-	Soffset = simdi8_set(profile->bias);
-	s_curr = vHStore;
-	s_prev = vHLoad;
-
-	memset(vHStore,0,W*sizeof(simd_int));
-	memset(vHLoad,0,W*sizeof(simd_int));
-
-	for (j = 0; j < db_length; ++j) // loop over db sequence positions
-	{
-
-		// Get address of query scores for row j
-		qji = query_profile_it + db_sequence[j] * W;
-
-		// Load the next S value
-		S = simdi_load(s_curr + W - 1);
-		S = simdi8_shiftl(S, 1);
-
-		// Swap s_prev and s_curr, smax_prev and smax_curr
-		SWAP(p, s_prev, s_curr);
-
-		s_curr_it = s_curr;
-		s_prev_it = s_prev;
-
-		for (i = 0; i < W; ++i) // loop over query band positions
-		{
-			// Saturated addition and subtraction to score S(i,j)
-			S = simdui8_adds(S, *(qji++)); // S(i,j) = S(i-1,j-1) + (q(i,x_j) + Soffset)
-			S = simdui8_subs(S, Soffset);       // S(i,j) = max(0, S(i,j) - Soffset)
-			simdi_store(s_curr_it++, S);       // store S to s_curr[i]
-			Smax = simdui8_max(Smax, S);       // Smax(i,j) = max(Smax(i,j), S(i,j))
-
-			// Load the next S and Smax values
-			S = simdi_load(s_prev_it++);
-		}
-	}
-	int score = simd_hmax((unsigned char *) &Smax, element_count);
-
-	/* return largest score */
-	return score;
-#undef SWAP
+	return kernel->ungappedByte(db_sequence, db_length, profile->query_length, profile->profile_byte, profile->bias, buffers);
 }
-
@@ -45,6 +45,8 @@
 
 #include "Sequence.h"
 #include "EvalueComputation.h"
+#include "StripedSmithWatermanKernel.h"
+
 typedef struct {
     short qStartPos;
     short dbStartPos;
@@ -74,6 +76,9 @@ public:
     SmithWaterman(size_t maxSequenceLength, int aaSize, bool aaBiasCorrection);
     ~SmithWaterman();
 
+    // memory allocated by the constructor
+    static size_t estimateMemoryConsumption(size_t maxSequenceLength, int aaSize);
+
     // prints a __m128 vector containing 8 signed shorts
     static void printVector (__m128i v);
 
@@ -141,6 +146,36 @@ public:
                         const int32_t maskLen);
 
 
+    // longest query the inter-sequence kernel keeps scratch memory for
+    static const int32_t BATCH_MAX_QUERY_LEN = 512;
+
+    // true if the query of the last ssw_init call can be aligned with ssw_align_batch
+    bool canAlignBatch() const {
+        return batch_query;
+    }
+
+    // number of targets the inter-sequence kernel aligns in one pass
+    size_t getBatchLanes() const {
+        return kernel->vectorBytes;
+    }
+
+    /*!	@function	Inter-sequence alignment of the query against count targets, one target per SIMD lane.
+     Gives the same results as calling ssw_align for every target, except that no suboptimal alignment
+     (score2, ref_end2) is reported. Only works for queries with canAlignBatch(). Profits mostly
+     from short targets, since every pass computes getBatchLanes() targets up to the longest one.
+     */
+    void ssw_align_batch(const unsigned char **db_sequences,
+                         const int32_t *db_lengths,
+                         size_t count,
+                         const uint8_t gap_open,
+                         const uint8_t gap_extend,
+                         const uint8_t alignmentMode,
+                         const double filters,
+                         EvalueComputation * filterd,
+                         const int covMode, const float covThr,
+                         const int32_t maskLen,
+                         s_align *results);
+
     /*!	@function computed ungapped alignment score
 
    @param	db_sequence	pointer to the target sequence; the target sequence needs to be numbers and corresponding to the mat parameter of
@@ -225,17 +260,11 @@ private:
         uint8_t bias;
         short ** profile_word_linear;
     };
-    simd_int* vHStore;
-    simd_int* vHLoad;
-    simd_int* vE;
-    simd_int* vHmax;
-    uint8_t * maxColumn;
+    // SIMD kernels selected at runtime and their scratch memory (vHStore, vHLoad, vE, vHmax, maxColumn)
+    const SmithWatermanKernel *kernel;
+    SmithWatermanKernel::Buffers buffers;
 
-    typedef struct {
-        uint16_t score;
-        int32_t ref;	 //0-based position
-        int32_t read;    //alignment ending position on read, 0-based
-    } alignment_end;
+    typedef SmithWatermanKernel::AlignmentEnd alignment_end;
 
 
     typedef struct {
@@ -274,6 +303,18 @@ private:
                                  uint16_t terminate,
                                  int32_t maskLen);
 
+    // finds start position and cigar of the alignment given its score and end position (r.score1, r.dbEndPos1, r.qEndPos1)
+    s_align ssw_align_from_end(s_align r, bool word,
+                               const unsigned char *db_sequence,
+                               int32_t db_length,
+                               const uint8_t gap_open,
+                               const uint8_t gap_extend,
+                               const uint8_t alignmentMode,
+                               const double evalueThr,
+                               EvalueComputation * evaluer,
+                               const int covMode, const float covThr,
+                               const int32_t maskLen);
+
     template <const unsigned int type>
     SmithWaterman::cigar *banded_sw(const unsigned char *db_sequence, const int8_t *query_sequence, const int8_t * compositionBias, int32_t db_length, int32_t query_length, int32_t queryStart, int32_t score, const uint32_t gap_open, const uint32_t gap_extend, int32_t band_width, const int8_t *mat, int32_t n);
 
@@ -290,11 +331,21 @@ private:
     const static unsigned int SUBSTITUTIONMATRIX = 1;
     const static unsigned int PROFILE = 2;
 
-    template <typename T, size_t Elements, const unsigned int type>
-    void createQueryProfile(simd_int *profile, const int8_t *query_sequence, const int8_t * composition_bias, const int8_t *mat, const int32_t query_length, const int32_t aaSize, uint8_t bias, const int32_t offset, const int32_t entryLength);
+    template <typename T, const unsigned int type>
+    void createQueryProfile(simd_int *profile, const size_t elements, const int8_t *query_sequence, const int8_t * composition_bias, const int8_t *mat, const int32_t query_length, const int32_t aaSize, uint8_t bias, const int32_t offset, const int32_t entryLength);
 
     float *tmp_composition_bias;
     short * profile_word_linear_data;
     bool aaBiasCorrection;
+
+    // residue used to pad targets in the inter-sequence kernel, scores 0 (-bias) against everything
+    const static unsigned char BATCH_PADDING = 31;
+    // 32 biased scores per query position, indexed by the target residue
+    uint8_t *batch_query_table;
+    unsigned char *batch_targets;
+    size_t batch_targets_size;
+    void *batch_buffer;
+    alignment_end batch_ends[MAX_ALIGN_INT];
+    bool batch_query;
 };
 #endif /* SMITH_WATERMAN_SSE2_H */
@@ -0,0 +1,600 @@
+/* The MIT License
+   Copyright (c) 2012-1015 Boston College.
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+
+/*
+   Written by Michael Farrar, 2006 (alignment), Mengyao Zhao (SSW Library) and Martin Steinegger (change structure add aa composition, profile and AVX2 support).
+   Please send bug reports and/or suggestions to martin.steinegger@snu.ac.kr.
+*/
+
+// This file is compiled with different instruction set flags, only include
+// headers without non-static inline functions (see SimdDispatch.h)
+#include "StripedSmithWatermanKernel.h"
+#include "simd.h"
+
+#include <cstring>
+
+#ifndef LIKELY
+#define LIKELY(x) __builtin_expect((x),1)
+#define UNLIKELY(x) __builtin_expect((x),0)
+#endif
+
+namespace SIMD_VARIANT {
+
+typedef SmithWatermanKernel::AlignmentEnd alignment_end;
+typedef SmithWatermanKernel::AlignmentEnds alignment_ends;
+
+static alignment_ends sw_sse2_byte(const unsigned char* db_sequence,
+                                   int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+                                   int32_t db_length,
+                                   int32_t query_length,
+                                   const uint8_t gap_open, /* will be used as - */
+                                   const uint8_t gap_extend, /* will be used as - */
+                                   const void* profile,
+                                   uint8_t terminate,	/* the best alignment score: used to terminate
+                                                         the matrix calculation when locating the
+                                                         alignment beginning point. If this score
+                                                         is set to 0, it will not be used */
+                                   uint8_t bias,  /* Shift 0 point to a positive value. */
+                                   int32_t maskLen,
+                                   const SmithWatermanKernel::Buffers &buffers) {
+#define max16(m, vm) ((m) = simdi8_hmax((vm)));
+
+	const simd_int* query_profile_byte = (const simd_int*) profile;
+	uint8_t max = 0;		                     /* the max alignment score */
+	int32_t end_query = query_length - 1;
+	int32_t end_db = -1; /* 0_based best alignment ending point; Initialized as isn't aligned -1. */
+	const int SIMD_SIZE = VECSIZE_INT * 4;
+	int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
+	/* array to record the largest score of each reference position */
+	memset(buffers.maxColumn, 0, db_length * sizeof(uint8_t));
+	uint8_t * maxColumn = (uint8_t *) buffers.maxColumn;
+
+	/* Define 16 byte 0 vector. */
+	simd_int vZero = simdi32_set(0);
+	simd_int* pvHStore = (simd_int*) buffers.vHStore;
+	simd_int* pvHLoad = (simd_int*) buffers.vHLoad;
+	simd_int* pvE = (simd_int*) buffers.vE;
+	simd_int* pvHmax = (simd_int*) buffers.vHmax;
+	memset(pvHStore,0,segLen*sizeof(simd_int));
+	memset(pvHLoad,0,segLen*sizeof(simd_int));
+	memset(pvE,0,segLen*sizeof(simd_int));
+	memset(pvHmax,0,segLen*sizeof(simd_int));
+
+	int32_t i, j;
+	/* 16 byte insertion begin vector */
+	simd_int vGapO = simdi8_set(gap_open);
+
+	/* 16 byte insertion extension vector */
+	simd_int vGapE = simdi8_set(gap_extend);
+
+	/* 16 byte bias vector */
+	simd_int vBias = simdi8_set(bias);
+
+	simd_int vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	simd_int vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	simd_int vTemp;
+	int32_t edge, begin = 0, end = db_length, step = 1;
+	//	int32_t distance = query_length * 2 / 3;
+	//	int32_t distance = query_length / 2;
+	//	int32_t distance = query_length;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = db_length - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		simd_int e, vF = vZero, vMaxColumn = vZero; /* Initialize F value to 0.
+                                                    Any errors to vH values will be corrected in the Lazy_F loop.
+                                                    */
+		//		max16(maxColumn[i], vMaxColumn);
+		//		fprintf(stderr, "middle[%d]: %d\n", i, maxColumn[i]);
+
+		simd_int vH = pvHStore[segLen - 1];
+		vH = simdi8_shiftl (vH, 1); /* Shift the 128-bit value in vH left by 1 byte. */
+		const simd_int* vP = query_profile_byte + db_sequence[i] * segLen; /* Right part of the query_profile_byte */
+		//	int8_t* t;
+		//	int32_t ti;
+		//        fprintf(stderr, "i: %d of %d:\t ", i,segLen);
+		//for (t = (int8_t*)vP, ti = 0; ti < segLen; ++ti) fprintf(stderr, "%d\t", *t++);
+		//fprintf(stderr, "\n");
+
+		/* Swap the 2 H buffers. */
+		simd_int* pv = pvHLoad;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			vH = simdui8_adds(vH, simdi_load(vP + j));
+			vH = simdui8_subs(vH, vBias); /* vH will be always > 0 */
+			//	max16(maxColumn[i], vH);
+			//	fprintf(stderr, "H[%d]: %d\n", i, maxColumn[i]);
+			//	int8_t* t;
+			//	int32_t ti;
+			//for (t = (int8_t*)&vH, ti = 0; ti < 16; ++ti) fprintf(stderr, "%d\t", *t++);
+
+			/* Get max from vH, vE and vF. */
+			e = simdi_load(pvE + j);
+			vH = simdui8_max(vH, e);
+			vH = simdui8_max(vH, vF);
+			vMaxColumn = simdui8_max(vMaxColumn, vH);
+
+			//	max16(maxColumn[i], vMaxColumn);
+			//	fprintf(stderr, "middle[%d]: %d\n", i, maxColumn[i]);
+			//	for (t = (int8_t*)&vMaxColumn, ti = 0; ti < 16; ++ti) fprintf(stderr, "%d\t", *t++);
+
+			/* Save vH values. */
+			simdi_store(pvHStore + j, vH);
+
+			/* Update vE value. */
+			vH = simdui8_subs(vH, vGapO); /* saturation arithmetic, result >= 0 */
+			e = simdui8_subs(e, vGapE);
+			e = simdui8_max(e, vH);
+			simdi_store(pvE + j, e);
+
+			/* Update vF value. */
+			vF = simdui8_subs(vF, vGapE);
+			vF = simdui8_max(vF, vH);
+
+			/* Load the next vH. */
+			vH = simdi_load(pvHLoad + j);
+		}
+
+		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
+		/* reset pointers to the start of the saved data */
+		j = 0;
+		vH = simdi_load (pvHStore + j);
+
+		/*  the computed vF value is for the given column.  since */
+		/*  we are at the end, we need to shift the vF value over */
+		/*  to the next column. */
+		vF = simdi8_shiftl (vF, 1);
+		vTemp = simdui8_subs (vH, vGapO);
+		vTemp = simdui8_subs (vF, vTemp);
+		vTemp = simdi8_eq (vTemp, vZero);
+		uint32_t cmp = simdi8_movemask (vTemp);
+		while (cmp != SIMD_MOVEMASK_MAX) {
+			vH = simdui8_max (vH, vF);
+			vMaxColumn = simdui8_max(vMaxColumn, vH);
+			simdi_store (pvHStore + j, vH);
+			vF = simdui8_subs (vF, vGapE);
+			j++;
+			if (j >= segLen)
+			{
+				j = 0;
+				vF = simdi8_shiftl (vF, 1);
+			}
+			vH = simdi_load (pvHStore + j);
+
+			vTemp = simdui8_subs (vH, vGapO);
+			vTemp = simdui8_subs (vF, vTemp);
+			vTemp = simdi8_eq (vTemp, vZero);
+			cmp  = simdi8_movemask (vTemp);
+		}
+
+		vMaxScore = simdui8_max(vMaxScore, vMaxColumn);
+		vTemp = simdi8_eq(vMaxMark, vMaxScore);
+		cmp = simdi8_movemask(vTemp);
+		if (cmp != SIMD_MOVEMASK_MAX) {
+			uint8_t temp;
+			vMaxMark = vMaxScore;
+			max16(temp, vMaxScore);
+			vMaxScore = vMaxMark;
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				if (max + bias >= 255) break;	//overflow
+				end_db = i;
+
+				/* Store the column with the highest alignment score in order to trace the alignment ending position on read. */
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		/* Record the max score of current column. */
+		max16(maxColumn[i], vMaxColumn);
+		//		fprintf(stderr, "maxColumn[%d]: %d\n", i, maxColumn[i]);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint8_t *t = (uint8_t*)pvHmax;
+	int32_t column_len = segLen * SIMD_SIZE;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / SIMD_SIZE + i % SIMD_SIZE * segLen;
+			if (temp < end_query) end_query = temp;
+		}
+	}
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_ends bests;
+	bests.best.score = max + bias >= 255 ? 255 : max;
+	bests.best.ref = end_db;
+	bests.best.read = end_query;
+
+	bests.second.score = 0;
+	bests.second.ref = 0;
+	bests.second.read = 0;
+
+	edge = (end_db - maskLen) > 0 ? (end_db - maskLen) : 0;
+	for (i = 0; i < edge; i ++) {
+		//			fprintf (stderr, "maxColumn[%d]: %d\n", i, maxColumn[i]);
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+	edge = (end_db + maskLen) > db_length ? db_length : (end_db + maskLen);
+	for (i = edge + 1; i < db_length; i ++) {
+		//			fprintf (stderr, "db_length: %d\tmaxColumn[%d]: %d\n", db_length, i, maxColumn[i]);
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+
+	return bests;
+#undef max16
+}
+
+
+static alignment_ends sw_sse2_word(const unsigned char* db_sequence,
+                                   int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+                                   int32_t db_length,
+                                   int32_t query_length,
+                                   const uint8_t gap_open, /* will be used as - */
+                                   const uint8_t gap_extend, /* will be used as - */
+                                   const void* profile,
+                                   uint16_t terminate,
+                                   int32_t maskLen,
+                                   const SmithWatermanKernel::Buffers &buffers) {
+
+#define max8(m, vm) ((m) = simdi16_hmax((vm)));
+
+	const simd_int* query_profile_word = (const simd_int*) profile;
+	uint16_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = query_length - 1;
+	int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
+	const unsigned int SIMD_SIZE = VECSIZE_INT * 2;
+	int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
+	/* array to record the alignment read ending position of the largest score of each reference position */
+	memset(buffers.maxColumn, 0, db_length * sizeof(uint16_t));
+	uint16_t * maxColumn = (uint16_t *) buffers.maxColumn;
+
+	/* Define 16 byte 0 vector. */
+	simd_int vZero = simdi32_set(0);
+	simd_int* pvHStore = (simd_int*) buffers.vHStore;
+	simd_int* pvHLoad = (simd_int*) buffers.vHLoad;
+	simd_int* pvE = (simd_int*) buffers.vE;
+	simd_int* pvHmax = (simd_int*) buffers.vHmax;
+	memset(pvHStore,0,segLen*sizeof(simd_int));
+	memset(pvHLoad,0, segLen*sizeof(simd_int));
+	memset(pvE,0,     segLen*sizeof(simd_int));
+	memset(pvHmax,0,  segLen*sizeof(simd_int));
+
+	int32_t i, j, k;
+	/* 16 byte insertion begin vector */
+	simd_int vGapO = simdi16_set(gap_open);
+
+	/* 16 byte insertion extension vector */
+	simd_int vGapE = simdi16_set(gap_extend);
+
+	simd_int vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	simd_int vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	simd_int vTemp;
+	int32_t edge, begin = 0, end = db_length, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = db_length - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		simd_int e, vF = vZero; /* Initialize F value to 0.
+                                Any errors to vH values will be corrected in the Lazy_F loop.
+                                */
+		simd_int vH = pvHStore[segLen - 1];
+		vH = simdi8_shiftl (vH, 2); /* Shift the 128-bit value in vH left by 2 byte. */
+
+		/* Swap the 2 H buffers. */
+		simd_int* pv = pvHLoad;
+
+		simd_int vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
+
+		const simd_int* vP = query_profile_word + db_sequence[i] * segLen; /* Right part of the query_profile_byte */
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		for (j = 0; LIKELY(j < segLen); j ++) {
+			vH = simdi16_adds(vH, simdi_load(vP + j));
+
+			/* Get max from vH, vE and vF. */
+			e = simdi_load(pvE + j);
+			vH = simdi16_max(vH, e);
+			vH = simdi16_max(vH, vF);
+			vMaxColumn = simdi16_max(vMaxColumn, vH);
+
+			/* Save vH values. */
+			simdi_store(pvHStore + j, vH);
+
+			/* Update vE value. */
+			vH = simdui16_subs(vH, vGapO); /* saturation arithmetic, result >= 0 */
+			e = simdui16_subs(e, vGapE);
+			e = simdi16_max(e, vH);
+			simdi_store(pvE + j, e);
+
+			/* Update vF value. */
+			vF = simdui16_subs(vF, vGapE);
+			vF = simdi16_max(vF, vH);
+
+			/* Load the next vH. */
+			vH = simdi_load(pvHLoad + j);
+		}
+
+		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
+		for (k = 0; LIKELY(k < (int32_t) SIMD_SIZE); ++k) {
+			vF = simdi8_shiftl (vF, 2);
+			for (j = 0; LIKELY(j < segLen); ++j) {
+				vH = simdi_load(pvHStore + j);
+				vH = simdi16_max(vH, vF);
+				vMaxColumn = simdi16_max(vMaxColumn, vH); //newly added line
+				simdi_store(pvHStore + j, vH);
+				vH = simdui16_subs(vH, vGapO);
+				vF = simdui16_subs(vF, vGapE);
+				if (UNLIKELY(! simdi8_movemask(simdi16_gt(vF, vH)))) goto end;
+			}
+		}
+
+		end:
+		vMaxScore = simdi16_max(vMaxScore, vMaxColumn);
+		vTemp = simdi16_eq(vMaxMark, vMaxScore);
+		uint32_t cmp = simdi8_movemask(vTemp);
+		if (cmp != SIMD_MOVEMASK_MAX) {
+			uint16_t temp;
+			vMaxMark = vMaxScore;
+			max8(temp, vMaxScore);
+			vMaxScore = vMaxMark;
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				end_ref = i;
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		/* Record the max score of current column. */
+		max8(maxColumn[i], vMaxColumn);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint16_t *t = (uint16_t*)pvHmax;
+	int32_t column_len = segLen * SIMD_SIZE;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / SIMD_SIZE + i % SIMD_SIZE * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_ends bests;
+	bests.best.score = max;
+	bests.best.ref = end_ref;
+	bests.best.read = end_read;
+
+	bests.second.score = 0;
+	bests.second.ref = 0;
+	bests.second.read = 0;
+
+	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
+	for (i = 0; i < edge; i ++) {
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+	edge = (end_ref + maskLen) > db_length ? db_length : (end_ref + maskLen);
+	for (i = edge; i < db_length; i ++) {
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+
+	return bests;
+#undef max8
+}
+
+/* Inter-sequence Smith-Waterman, every byte lane aligns the query against another target.
+   Computes the same score and ending positions as sw_sse2_byte: the first target column reaching the
+   maximum and the first query position with the maximum in this column. */
+static void sw_batch_byte(const uint8_t *query_table,
+                          int32_t query_length,
+                          const unsigned char *targets,
+                          int32_t target_length,
+                          const uint8_t gap_open, /* will be used as - */
+                          const uint8_t gap_extend, /* will be used as - */
+                          uint8_t bias,  /* Shift 0 point to a positive value. */
+                          void *buffer,
+                          alignment_end *ends) {
+	const int LANES = VECSIZE_INT * 4;
+	simd_int* pvH = (simd_int*) buffer;
+	simd_int* pvE = pvH + query_length;
+	memset(pvH, 0, query_length * sizeof(simd_int));
+	memset(pvE, 0, query_length * sizeof(simd_int));
+
+	const simd_int vZero = simdi_setzero();
+	const simd_int vGapO = simdi8_set(gap_open);
+	const simd_int vGapE = simdi8_set(gap_extend);
+	const simd_int vBias = simdi8_set(bias);
+	const simd_int vFifteen = simdi8_set(15);
+	simd_int vMaxScore = vZero;
+	int32_t end_ref[LANES], end_read[LANES];
+	for (int lane = 0; lane < LANES; ++lane) {
+		end_ref[lane] = -1;
+		end_read[lane] = query_length - 1;
+	}
+
+	for (int32_t i = 0; LIKELY(i < target_length); ++i) {
+		/* residues of all targets at position i, residues >= 16 are looked up in the upper half of the table */
+		const simd_int vTarget = simdi_loadu((const simd_int *) (targets + i * LANES));
+		const simd_int vUpper = simdi8_gt(vTarget, vFifteen);
+
+		simd_int vH, vDiag = vZero, vF = vZero, vMaxColumn = vZero;
+		for (int32_t j = 0; LIKELY(j < query_length); ++j) {
+#ifdef AVX2
+			const simd_int vLow = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) (query_table + j * 32)));
+			const simd_int vHigh = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) (query_table + j * 32 + 16)));
+			const simd_int vScore = _mm256_blendv_epi8(_mm256_shuffle_epi8(vLow, vTarget), _mm256_shuffle_epi8(vHigh, vTarget), vUpper);
+#else
+			const simd_int vLow = _mm_load_si128((const __m128i *) (query_table + j * 32));
+			const simd_int vHigh = _mm_load_si128((const __m128i *) (query_table + j * 32 + 16));
+			const simd_int vScore = _mm_blendv_epi8(_mm_shuffle_epi8(vLow, vTarget), _mm_shuffle_epi8(vHigh, vTarget), vUpper);
+#endif
+			vH = simdui8_adds(vDiag, vScore);
+			vH = simdui8_subs(vH, vBias); /* vH will be always > 0 */
+			vDiag = simdi_load(pvH + j);
+			simd_int e = simdi_load(pvE + j);
+			vH = simdui8_max(vH, e);
+			vH = simdui8_max(vH, vF);
+			vMaxColumn = simdui8_max(vMaxColumn, vH);
+			simdi_store(pvH + j, vH);
+
+			/* Update vE and vF value. */
+			vH = simdui8_subs(vH, vGapO); /* saturation arithmetic, result >= 0 */
+			e = simdui8_subs(e, vGapE);
+			e = simdui8_max(e, vH);
+			simdi_store(pvE + j, e);
+			vF = simdui8_subs(vF, vGapE);
+			vF = simdui8_max(vF, vH);
+		}
+
+		/* lanes where this column has a higher score than all previous ones */
+		const simd_int vNewMax = simdui8_max(vMaxScore, vMaxColumn);
+		uint32_t improved = ~simdi8_movemask(simdi8_eq(vNewMax, vMaxScore)) & SIMD_MOVEMASK_MAX;
+		if (UNLIKELY(improved != 0)) {
+			vMaxScore = vNewMax;
+			for (uint32_t m = improved; m != 0; m &= m - 1) {
+				end_ref[__builtin_ctz(m)] = i;
+			}
+			/* Trace the alignment ending position on read for the improved lanes. */
+			for (int32_t j = 0; j < query_length && improved != 0; ++j) {
+				uint32_t hit = simdi8_movemask(simdi8_eq(simdi_load(pvH + j), vMaxColumn)) & improved;
+				for (uint32_t m = hit; m != 0; m &= m - 1) {
+					end_read[__builtin_ctz(m)] = j;
+				}
+				improved &= ~hit;
+			}
+		}
+	}
+
+	uint8_t score[LANES];
+	simdi_storeu((simd_int *) score, vMaxScore);
+	for (int lane = 0; lane < LANES; ++lane) {
+		ends[lane].score = score[lane];
+		ends[lane].ref = end_ref[lane];
+		ends[lane].read = end_read[lane];
+	}
+}
+
+static int ungapped_alignment(const unsigned char *db_sequence, int32_t db_length, int32_t query_length,
+                              const void *profile, uint8_t bias, const SmithWatermanKernel::Buffers &buffers) {
+#define SWAP(tmp, arg1, arg2) tmp = arg1; arg1 = arg2; arg2 = tmp;
+
+	int i; // position in query bands (0,..,W-1)
+	int j; // position in db sequence (0,..,dbseq_length-1)
+	int element_count = (VECSIZE_INT * 4);
+	const int W = (query_length + (element_count - 1)) / element_count; // width of bands in query and score matrix = hochgerundetes LQ/16
+
+	simd_int *p;
+	simd_int S;              // 16 unsigned bytes holding S(b*W+i,j) (b=0,..,15)
+	simd_int Smax = simdi_setzero();
+	simd_int Soffset; // all scores in query profile are shifted up by Soffset to obtain pos values
+	simd_int *s_prev, *s_curr; // pointers to Score(i-1,j-1) and Score(i,j), resp.
+	const simd_int *qji;       // query profile score in row j (for residue x_j)
+	simd_int *s_prev_it, *s_curr_it;
+	const simd_int *query_profile_it = (const simd_int *) profile;
+
+	// Load the score offset to all 16 unsigned byte elements of Soffset
+	Soffset = simdi8_set(bias);
+	s_curr = (simd_int*) buffers.vHStore;
+	s_prev = (simd_int*) buffers.vHLoad;
+
+	memset(s_curr,0,W*sizeof(simd_int));
+	memset(s_prev,0,W*sizeof(simd_int));
+
+	for (j = 0; j < db_length; ++j) // loop over db sequence positions
+	{
+
+		// Get address of query scores for row j
+		qji = query_profile_it + db_sequence[j] * W;
+
+		// Load the next S value
+		S = simdi_load(s_curr + W - 1);
+		S = simdi8_shiftl(S, 1);
+
+		// Swap s_prev and s_curr, smax_prev and smax_curr
+		SWAP(p, s_prev, s_curr);
+
+		s_curr_it = s_curr;
+		s_prev_it = s_prev;
+
+		for (i = 0; i < W; ++i) // loop over query band positions
+		{
+			// Saturated addition and subtraction to score S(i,j)
+			S = simdui8_adds(S, *(qji++)); // S(i,j) = S(i-1,j-1) + (q(i,x_j) + Soffset)
+			S = simdui8_subs(S, Soffset);       // S(i,j) = max(0, S(i,j) - Soffset)
+			simdi_store(s_curr_it++, S);       // store S to s_curr[i]
+			Smax = simdui8_max(Smax, S);       // Smax(i,j) = max(Smax(i,j), S(i,j))
+
+			// Load the next S and Smax values
+			S = simdi_load(s_prev_it++);
+		}
+	}
+
+	const unsigned char *in = (const unsigned char *) &Smax;
+	unsigned char score = 0;
+	for (i = 0; i < element_count; ++i) {
+		score = (in[i] > score) ? in[i] : score;
+	}
+
+	/* return largest score */
+	return score;
+#undef SWAP
+}
+
+extern const SmithWatermanKernel smithWatermanKernel = {
+	VECSIZE_INT * 4,
+	sw_sse2_byte,
+	sw_sse2_word,
+	ungapped_alignment,
+	sw_batch_byte
+};
+
+}
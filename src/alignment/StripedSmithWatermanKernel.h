@@ -0,0 +1,56 @@
+#ifndef MMSEQS_STRIPEDSMITHWATERMANKERNEL_H
+#define MMSEQS_STRIPEDSMITHWATERMANKERNEL_H
+
+// SIMD inner loops of SmithWaterman. StripedSmithWatermanKernel.cpp is compiled once
+// per instruction set (see SimdDispatch.h), SmithWaterman picks one table at runtime.
+#include <stdint.h>
+#include "SimdDispatch.h"
+
+struct SmithWatermanKernel {
+    struct AlignmentEnd {
+        uint16_t score;
+        int32_t ref;	 //0-based position
+        int32_t read;    //alignment ending position on read, 0-based
+    };
+
+    struct AlignmentEnds {
+        AlignmentEnd best;
+        AlignmentEnd second;
+    };
+
+    // scratch memory owned by SmithWaterman, aligned to MAX_ALIGN_INT
+    struct Buffers {
+        void *vHStore;
+        void *vHLoad;
+        void *vE;
+        void *vHmax;
+        uint8_t *maxColumn;
+    };
+
+    // width of one vector in bytes, query profiles are striped with this many lanes
+    unsigned int vectorBytes;
+
+    AlignmentEnds (*swByte)(const unsigned char *db_sequence, int8_t ref_dir, int32_t db_length, int32_t query_length,
+                            const uint8_t gap_open, const uint8_t gap_extend, const void *query_profile_byte,
+                            uint8_t terminate, uint8_t bias, int32_t maskLen, const Buffers &buffers);
+
+    AlignmentEnds (*swWord)(const unsigned char *db_sequence, int8_t ref_dir, int32_t db_length, int32_t query_length,
+                            const uint8_t gap_open, const uint8_t gap_extend, const void *query_profile_word,
+                            uint16_t terminate, int32_t maskLen, const Buffers &buffers);
+
+    int (*ungappedByte)(const unsigned char *db_sequence, int32_t db_length, int32_t query_length,
+                        const void *query_profile_byte, uint8_t bias, const Buffers &buffers);
+
+    // inter-sequence kernel, aligns the query against vectorBytes targets at once (one target per byte lane)
+    // query_table holds 32 biased scores per query position, indexed by the target residue
+    // targets are interleaved by position (targets[i * vectorBytes + lane]) and padded with a residue scoring 0
+    // buffer needs 2 * query_length * vectorBytes bytes, ends receives one entry per lane
+    // lanes with score + bias >= 255 saturated and have to be realigned
+    void (*batchByte)(const uint8_t *query_table, int32_t query_length, const unsigned char *targets,
+                      int32_t target_length, const uint8_t gap_open, const uint8_t gap_extend, uint8_t bias,
+                      void *buffer, AlignmentEnd *ends);
+};
+
+SIMD_DECLARE_KERNEL(SmithWatermanKernel, smithWatermanKernel)
+
+#endif
@@ -0,0 +1,543 @@
+/* The MIT License
+   Copyright (c) 2012-1015 Boston College.
+   Permission is hereby granted, free of charge, to any person obtaining
+   a copy of this software and associated documentation files (the
+   "Software"), to deal in the Software without restriction, including
+   without limitation the rights to use, copy, modify, merge, publish,
+   distribute, sublicense, and/or sell copies of the Software, and to
+   permit persons to whom the Software is furnished to do so, subject to
+   the following conditions:
+   The above copyright notice and this permission notice shall be
+   included in all copies or substantial portions of the Software.
+   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+   EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+   NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+   BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+   ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+   CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+   SOFTWARE.
+*/
+
+/*
+   Written by Michael Farrar, 2006 (alignment), Mengyao Zhao (SSW Library) and Martin Steinegger (change structure add aa composition, profile and AVX2 support).
+   Please send bug reports and/or suggestions to martin.steinegger@snu.ac.kr.
+*/
+
+// AVX-512BW version of StripedSmithWatermanKernel.cpp. simd.h has no complete 512-bit
+// integer abstraction, so the kernels use intrinsics directly. Comparisons produce mask
+// registers instead of movemask results, everything else follows the SSE/AVX2 kernels.
+// Only compiled with -mavx512f -mavx512bw (see SimdDispatch.h).
+#include "StripedSmithWatermanKernel.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 warns about _mm512_undefined_* inside its own intrinsic headers (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#include <cstring>
+
+#ifndef LIKELY
+#define LIKELY(x) __builtin_expect((x),1)
+#define UNLIKELY(x) __builtin_expect((x),0)
+#endif
+
+namespace simd_avx512 {
+
+typedef SmithWatermanKernel::AlignmentEnd alignment_end;
+typedef SmithWatermanKernel::AlignmentEnds alignment_ends;
+
+// shift the whole 512-bit register left by N bytes, shifting in zeros
+template <unsigned int N>
+static inline __m512i shiftLeft(const __m512i a) {
+    // each 128-bit lane needs the top bytes of the lane below
+    const __m512i below = _mm512_alignr_epi64(a, _mm512_setzero_si512(), 6);
+    return _mm512_alignr_epi8(a, below, 16 - N);
+}
+
+static inline uint8_t hmax8(const __m512i a) {
+    __m256i tmp256 = _mm256_max_epu8(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1));
+    __m128i tmp = _mm_max_epu8(_mm256_castsi256_si128(tmp256), _mm256_extracti128_si256(tmp256, 1));
+    tmp = _mm_subs_epu8(_mm_set1_epi8((char)255), tmp);
+    tmp = _mm_min_epu8(tmp, _mm_srli_epi16(tmp, 8));
+    tmp = _mm_minpos_epu16(tmp);
+    return (uint8_t)(255 - _mm_cvtsi128_si32(tmp));
+}
+
+static inline uint16_t hmax16(const __m512i a) {
+    __m256i tmp256 = _mm256_max_epu16(_mm512_castsi512_si256(a), _mm512_extracti64x4_epi64(a, 1));
+    __m128i tmp = _mm_max_epu16(_mm256_castsi256_si128(tmp256), _mm256_extracti128_si256(tmp256, 1));
+    tmp = _mm_subs_epu16(_mm_set1_epi16((short)65535), tmp);
+    tmp = _mm_minpos_epu16(tmp);
+    return (uint16_t)(65535 - _mm_cvtsi128_si32(tmp));
+}
+
+static alignment_ends sw_avx512_byte(const unsigned char* db_sequence,
+                                     int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+                                     int32_t db_length,
+                                     int32_t query_length,
+                                     const uint8_t gap_open, /* will be used as - */
+                                     const uint8_t gap_extend, /* will be used as - */
+                                     const void* profile,
+                                     uint8_t terminate,	/* the best alignment score: used to terminate
+                                                           the matrix calculation when locating the
+                                                           alignment beginning point. If this score
+                                                           is set to 0, it will not be used */
+                                     uint8_t bias,  /* Shift 0 point to a positive value. */
+                                     int32_t maskLen,
+                                     const SmithWatermanKernel::Buffers &buffers) {
+	const __m512i* query_profile_byte = (const __m512i*) profile;
+	uint8_t max = 0;		                     /* the max alignment score */
+	int32_t end_query = query_length - 1;
+	int32_t end_db = -1; /* 0_based best alignment ending point; Initialized as isn't aligned -1. */
+	const int SIMD_SIZE = 64;
+	int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
+	/* array to record the largest score of each reference position */
+	memset(buffers.maxColumn, 0, db_length * sizeof(uint8_t));
+	uint8_t * maxColumn = (uint8_t *) buffers.maxColumn;
+
+	__m512i vZero = _mm512_setzero_si512();
+	__m512i* pvHStore = (__m512i*) buffers.vHStore;
+	__m512i* pvHLoad = (__m512i*) buffers.vHLoad;
+	__m512i* pvE = (__m512i*) buffers.vE;
+	__m512i* pvHmax = (__m512i*) buffers.vHmax;
+	memset(pvHStore,0,segLen*sizeof(__m512i));
+	memset(pvHLoad,0,segLen*sizeof(__m512i));
+	memset(pvE,0,segLen*sizeof(__m512i));
+	memset(pvHmax,0,segLen*sizeof(__m512i));
+
+	int32_t i, j;
+	__m512i vGapO = _mm512_set1_epi8(gap_open);
+	__m512i vGapE = _mm512_set1_epi8(gap_extend);
+	__m512i vBias = _mm512_set1_epi8(bias);
+
+	__m512i vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	__m512i vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	int32_t edge, begin = 0, end = db_length, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = db_length - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		__m512i e, vF = vZero, vMaxColumn = vZero; /* Initialize F value to 0.
+                                                   Any errors to vH values will be corrected in the Lazy_F loop.
+                                                   */
+		__m512i vH = pvHStore[segLen - 1];
+		vH = shiftLeft<1>(vH);
+		const __m512i* vP = query_profile_byte + db_sequence[i] * segLen; /* Right part of the query_profile_byte */
+
+		/* Swap the 2 H buffers. */
+		__m512i* pv = pvHLoad;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			vH = _mm512_adds_epu8(vH, _mm512_load_si512(vP + j));
+			vH = _mm512_subs_epu8(vH, vBias); /* vH will be always > 0 */
+
+			/* Get max from vH, vE and vF. */
+			e = _mm512_load_si512(pvE + j);
+			vH = _mm512_max_epu8(vH, e);
+			vH = _mm512_max_epu8(vH, vF);
+			vMaxColumn = _mm512_max_epu8(vMaxColumn, vH);
+
+			/* Save vH values. */
+			_mm512_store_si512(pvHStore + j, vH);
+
+			/* Update vE value. */
+			vH = _mm512_subs_epu8(vH, vGapO); /* saturation arithmetic, result >= 0 */
+			e = _mm512_subs_epu8(e, vGapE);
+			e = _mm512_max_epu8(e, vH);
+			_mm512_store_si512(pvE + j, e);
+
+			/* Update vF value. */
+			vF = _mm512_subs_epu8(vF, vGapE);
+			vF = _mm512_max_epu8(vF, vH);
+
+			/* Load the next vH. */
+			vH = _mm512_load_si512(pvHLoad + j);
+		}
+
+		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
+		/* continue as long as any lane has F > H - gapO */
+		j = 0;
+		vH = _mm512_load_si512(pvHStore + j);
+		vF = shiftLeft<1>(vF);
+		__mmask64 cmp = _mm512_cmpgt_epu8_mask(vF, _mm512_subs_epu8(vH, vGapO));
+		while (cmp != 0) {
+			vH = _mm512_max_epu8(vH, vF);
+			vMaxColumn = _mm512_max_epu8(vMaxColumn, vH);
+			_mm512_store_si512(pvHStore + j, vH);
+			vF = _mm512_subs_epu8(vF, vGapE);
+			j++;
+			if (j >= segLen)
+			{
+				j = 0;
+				vF = shiftLeft<1>(vF);
+			}
+			vH = _mm512_load_si512(pvHStore + j);
+			cmp = _mm512_cmpgt_epu8_mask(vF, _mm512_subs_epu8(vH, vGapO));
+		}
+
+		vMaxScore = _mm512_max_epu8(vMaxScore, vMaxColumn);
+		if (_mm512_cmpneq_epu8_mask(vMaxMark, vMaxScore) != 0) {
+			uint8_t temp;
+			vMaxMark = vMaxScore;
+			temp = hmax8(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				if (max + bias >= 255) break;	//overflow
+				end_db = i;
+
+				/* Store the column with the highest alignment score in order to trace the alignment ending position on read. */
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		/* Record the max score of current column. */
+		maxColumn[i] = hmax8(vMaxColumn);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint8_t *t = (uint8_t*)pvHmax;
+	int32_t column_len = segLen * SIMD_SIZE;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / SIMD_SIZE + i % SIMD_SIZE * segLen;
+			if (temp < end_query) end_query = temp;
+		}
+	}
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_ends bests;
+	bests.best.score = max + bias >= 255 ? 255 : max;
+	bests.best.ref = end_db;
+	bests.best.read = end_query;
+
+	bests.second.score = 0;
+	bests.second.ref = 0;
+	bests.second.read = 0;
+
+	edge = (end_db - maskLen) > 0 ? (end_db - maskLen) : 0;
+	for (i = 0; i < edge; i ++) {
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+	edge = (end_db + maskLen) > db_length ? db_length : (end_db + maskLen);
+	for (i = edge + 1; i < db_length; i ++) {
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+
+	return bests;
+}
+
+static alignment_ends sw_avx512_word(const unsigned char* db_sequence,
+                                     int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+                                     int32_t db_length,
+                                     int32_t query_length,
+                                     const uint8_t gap_open, /* will be used as - */
+                                     const uint8_t gap_extend, /* will be used as - */
+                                     const void* profile,
+                                     uint16_t terminate,
+                                     int32_t maskLen,
+                                     const SmithWatermanKernel::Buffers &buffers) {
+	const __m512i* query_profile_word = (const __m512i*) profile;
+	uint16_t max = 0;		                     /* the max alignment score */
+	int32_t end_read = query_length - 1;
+	int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
+	const unsigned int SIMD_SIZE = 32;
+	int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
+	/* array to record the alignment read ending position of the largest score of each reference position */
+	memset(buffers.maxColumn, 0, db_length * sizeof(uint16_t));
+	uint16_t * maxColumn = (uint16_t *) buffers.maxColumn;
+
+	__m512i vZero = _mm512_setzero_si512();
+	__m512i* pvHStore = (__m512i*) buffers.vHStore;
+	__m512i* pvHLoad = (__m512i*) buffers.vHLoad;
+	__m512i* pvE = (__m512i*) buffers.vE;
+	__m512i* pvHmax = (__m512i*) buffers.vHmax;
+	memset(pvHStore,0,segLen*sizeof(__m512i));
+	memset(pvHLoad,0, segLen*sizeof(__m512i));
+	memset(pvE,0,     segLen*sizeof(__m512i));
+	memset(pvHmax,0,  segLen*sizeof(__m512i));
+
+	int32_t i, j, k;
+	__m512i vGapO = _mm512_set1_epi16(gap_open);
+	__m512i vGapE = _mm512_set1_epi16(gap_extend);
+
+	__m512i vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+	__m512i vMaxMark = vZero; /* Trace the highest score till the previous column. */
+	int32_t edge, begin = 0, end = db_length, step = 1;
+
+	/* outer loop to process the reference sequence */
+	if (ref_dir == 1) {
+		begin = db_length - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		__m512i e, vF = vZero; /* Initialize F value to 0.
+                               Any errors to vH values will be corrected in the Lazy_F loop.
+                               */
+		__m512i vH = pvHStore[segLen - 1];
+		vH = shiftLeft<2>(vH);
+
+		/* Swap the 2 H buffers. */
+		__m512i* pv = pvHLoad;
+
+		__m512i vMaxColumn = vZero; /* vMaxColumn is used to record the max values of column i. */
+
+		const __m512i* vP = query_profile_word + db_sequence[i] * segLen; /* Right part of the query_profile_byte */
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		/* inner loop to process the query sequence */
+		for (j = 0; LIKELY(j < segLen); j ++) {
+			vH = _mm512_adds_epi16(vH, _mm512_load_si512(vP + j));
+
+			/* Get max from vH, vE and vF. */
+			e = _mm512_load_si512(pvE + j);
+			vH = _mm512_max_epi16(vH, e);
+			vH = _mm512_max_epi16(vH, vF);
+			vMaxColumn = _mm512_max_epi16(vMaxColumn, vH);
+
+			/* Save vH values. */
+			_mm512_store_si512(pvHStore + j, vH);
+
+			/* Update vE value. */
+			vH = _mm512_subs_epu16(vH, vGapO); /* saturation arithmetic, result >= 0 */
+			e = _mm512_subs_epu16(e, vGapE);
+			e = _mm512_max_epi16(e, vH);
+			_mm512_store_si512(pvE + j, e);
+
+			/* Update vF value. */
+			vF = _mm512_subs_epu16(vF, vGapE);
+			vF = _mm512_max_epi16(vF, vH);
+
+			/* Load the next vH. */
+			vH = _mm512_load_si512(pvHLoad + j);
+		}
+
+		/* Lazy_F loop: has been revised to disallow adjecent insertion and then deletion, so don't update E(i, j), learn from SWPS3 */
+		for (k = 0; LIKELY(k < (int32_t) SIMD_SIZE); ++k) {
+			vF = shiftLeft<2>(vF);
+			for (j = 0; LIKELY(j < segLen); ++j) {
+				vH = _mm512_load_si512(pvHStore + j);
+				vH = _mm512_max_epi16(vH, vF);
+				vMaxColumn = _mm512_max_epi16(vMaxColumn, vH); //newly added line
+				_mm512_store_si512(pvHStore + j, vH);
+				vH = _mm512_subs_epu16(vH, vGapO);
+				vF = _mm512_subs_epu16(vF, vGapE);
+				if (UNLIKELY(_mm512_cmpgt_epi16_mask(vF, vH) == 0)) goto end;
+			}
+		}
+
+		end:
+		vMaxScore = _mm512_max_epi16(vMaxScore, vMaxColumn);
+		if (_mm512_cmpneq_epi16_mask(vMaxMark, vMaxScore) != 0) {
+			uint16_t temp;
+			vMaxMark = vMaxScore;
+			temp = hmax16(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				end_ref = i;
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		/* Record the max score of current column. */
+		maxColumn[i] = hmax16(vMaxColumn);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint16_t *t = (uint16_t*)pvHmax;
+	int32_t column_len = segLen * SIMD_SIZE;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / SIMD_SIZE + i % SIMD_SIZE * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_ends bests;
+	bests.best.score = max;
+	bests.best.ref = end_ref;
+	bests.best.read = end_read;
+
+	bests.second.score = 0;
+	bests.second.ref = 0;
+	bests.second.read = 0;
+
+	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
+	for (i = 0; i < edge; i ++) {
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+	edge = (end_ref + maskLen) > db_length ? db_length : (end_ref + maskLen);
+	for (i = edge; i < db_length; i ++) {
+		if (maxColumn[i] > bests.second.score) {
+			bests.second.score = maxColumn[i];
+			bests.second.ref = i;
+		}
+	}
+
+	return bests;
+}
+
+/* Inter-sequence Smith-Waterman over 64 targets, see sw_batch_byte in StripedSmithWatermanKernel.cpp */
+static void sw_avx512_batch_byte(const uint8_t *query_table,
+                                 int32_t query_length,
+                                 const unsigned char *targets,
+                                 int32_t target_length,
+                                 const uint8_t gap_open, /* will be used as - */
+                                 const uint8_t gap_extend, /* will be used as - */
+                                 uint8_t bias,  /* Shift 0 point to a positive value. */
+                                 void *buffer,
+                                 alignment_end *ends) {
+	__m512i* pvH = (__m512i*) buffer;
+	__m512i* pvE = pvH + query_length;
+	memset(pvH, 0, query_length * sizeof(__m512i));
+	memset(pvE, 0, query_length * sizeof(__m512i));
+
+	const __m512i vZero = _mm512_setzero_si512();
+	const __m512i vGapO = _mm512_set1_epi8(gap_open);
+	const __m512i vGapE = _mm512_set1_epi8(gap_extend);
+	const __m512i vBias = _mm512_set1_epi8(bias);
+	const __m512i vFifteen = _mm512_set1_epi8(15);
+	__m512i vMaxScore = vZero;
+	int32_t end_ref[64], end_read[64];
+	for (int lane = 0; lane < 64; ++lane) {
+		end_ref[lane] = -1;
+		end_read[lane] = query_length - 1;
+	}
+
+	for (int32_t i = 0; LIKELY(i < target_length); ++i) {
+		const __m512i vTarget = _mm512_loadu_si512((const __m512i *) (targets + i * 64));
+		const __mmask64 upper = _mm512_cmpgt_epi8_mask(vTarget, vFifteen);
+
+		__m512i vH, vDiag = vZero, vF = vZero, vMaxColumn = vZero;
+		for (int32_t j = 0; LIKELY(j < query_length); ++j) {
+			const __m512i vLow = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) (query_table + j * 32)));
+			const __m512i vHigh = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *) (query_table + j * 32 + 16)));
+			__m512i vScore = _mm512_shuffle_epi8(vLow, vTarget);
+			vScore = _mm512_mask_shuffle_epi8(vScore, upper, vHigh, vTarget);
+
+			vH = _mm512_adds_epu8(vDiag, vScore);
+			vH = _mm512_subs_epu8(vH, vBias);
+			vDiag = _mm512_load_si512(pvH + j);
+			__m512i e = _mm512_load_si512(pvE + j);
+			vH = _mm512_max_epu8(vH, e);
+			vH = _mm512_max_epu8(vH, vF);
+			vMaxColumn = _mm512_max_epu8(vMaxColumn, vH);
+			_mm512_store_si512(pvH + j, vH);
+
+			vH = _mm512_subs_epu8(vH, vGapO);
+			e = _mm512_subs_epu8(e, vGapE);
+			e = _mm512_max_epu8(e, vH);
+			_mm512_store_si512(pvE + j, e);
+			vF = _mm512_subs_epu8(vF, vGapE);
+			vF = _mm512_max_epu8(vF, vH);
+		}
+
+		__mmask64 improved = _mm512_cmpgt_epu8_mask(vMaxColumn, vMaxScore);
+		if (UNLIKELY(improved != 0)) {
+			vMaxScore = _mm512_max_epu8(vMaxScore, vMaxColumn);
+			for (__mmask64 m = improved; m != 0; m &= m - 1) {
+				end_ref[__builtin_ctzll(m)] = i;
+			}
+			for (int32_t j = 0; j < query_length && improved != 0; ++j) {
+				__mmask64 hit = _mm512_mask_cmpeq_epi8_mask(improved, _mm512_load_si512(pvH + j), vMaxColumn);
+				for (__mmask64 m = hit; m != 0; m &= m - 1) {
+					end_read[__builtin_ctzll(m)] = j;
+				}
+				improved &= ~hit;
+			}
+		}
+	}
+
+	uint8_t score[64];
+	_mm512_storeu_si512(score, vMaxScore);
+	for (int lane = 0; lane < 64; ++lane) {
+		ends[lane].score = score[lane];
+		ends[lane].ref = end_ref[lane];
+		ends[lane].read = end_read[lane];
+	}
+}
+
+static int ungapped_alignment(const unsigned char *db_sequence, int32_t db_length, int32_t query_length,
+                              const void *profile, uint8_t bias, const SmithWatermanKernel::Buffers &buffers) {
+	const int element_count = 64;
+	const int W = (query_length + (element_count - 1)) / element_count; // width of bands in query and score matrix
+
+	__m512i Smax = _mm512_setzero_si512();
+	const __m512i Soffset = _mm512_set1_epi8(bias); // all scores in query profile are shifted up by Soffset to obtain pos values
+	__m512i *s_curr = (__m512i*) buffers.vHStore; // Score(i,j)
+	__m512i *s_prev = (__m512i*) buffers.vHLoad;  // Score(i-1,j-1)
+	const __m512i *query_profile_it = (const __m512i *) profile;
+
+	memset(s_curr,0,W*sizeof(__m512i));
+	memset(s_prev,0,W*sizeof(__m512i));
+
+	for (int j = 0; j < db_length; ++j) // loop over db sequence positions
+	{
+		// Get address of query scores for row j
+		const __m512i *qji = query_profile_it + db_sequence[j] * W;
+
+		// Load the next S value
+		__m512i S = _mm512_load_si512(s_curr + W - 1);
+		S = shiftLeft<1>(S);
+
+		__m512i *p = s_prev;
+		s_prev = s_curr;
+		s_curr = p;
+
+		__m512i *s_curr_it = s_curr;
+		__m512i *s_prev_it = s_prev;
+		for (int i = 0; i < W; ++i) // loop over query band positions
+		{
+			S = _mm512_adds_epu8(S, _mm512_load_si512(qji++)); // S(i,j) = S(i-1,j-1) + (q(i,x_j) + Soffset)
+			S = _mm512_subs_epu8(S, Soffset);                // S(i,j) = max(0, S(i,j) - Soffset)
+			_mm512_store_si512(s_curr_it++, S);              // store S to s_curr[i]
+			Smax = _mm512_max_epu8(Smax, S);                  // Smax(i,j) = max(Smax(i,j), S(i,j))
+
+			// Load the next S value
+			S = _mm512_load_si512(s_prev_it++);
+		}
+	}
+
+	/* return largest score */
+	return hmax8(Smax);
+}
+
+extern const SmithWatermanKernel smithWatermanKernel = {
+	64,
+	sw_avx512_byte,
+	sw_avx512_word,
+	ungapped_alignment,
+	sw_avx512_batch_byte
+};
+
+}
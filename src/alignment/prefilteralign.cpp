@@ -0,0 +1,73 @@
+#include "Prefiltering.h"
+#include "Alignment.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "MMseqsMPI.h"
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+int prefilteralign(int argc, const char **argv, const Command& command) {
+    MMseqsMPI::init(argc, argv);
+
+    Parameters& par = Parameters::getInstance();
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_ALIGN);
+
+    int queryDbType = FileUtil::parseDbType(par.db1.c_str());
+    int targetDbType = FileUtil::parseDbType(par.db2.c_str());
+    if (Parameters::isEqualDbtype(targetDbType, Parameters::DBTYPE_INDEX_DB) == true) {
+        DBReader<unsigned int> dbr(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        dbr.open(DBReader<unsigned int>::NOSORT);
+        PrefilteringIndexData data = PrefilteringIndexReader::getMetadata(&dbr);
+        targetDbType = data.seqType;
+        dbr.close();
+    }
+    if (queryDbType == -1 || targetDbType == -1) {
+        Debug(Debug::ERROR) << "Please recreate your database or add a .dbtype file to your sequence/profile database.\n";
+        return EXIT_FAILURE;
+    }
+    if (Parameters::isEqualDbtype(queryDbType, Parameters::DBTYPE_HMM_PROFILE) && Parameters::isEqualDbtype(targetDbType, Parameters::DBTYPE_PROFILE_STATE_SEQ)) {
+        queryDbType = Parameters::DBTYPE_PROFILE_STATE_PROFILE;
+    }
+
+    // the aligner is passed to the prefilter, so that its memory is part of the split estimate
+    Alignment aln(par.db1, par.db2, "", "", par.db3, par.db3Index, par);
+    Prefiltering pref(par.db1, par.db1Index, par.db2, par.db2Index, queryDbType, targetDbType, par, &aln);
+
+#ifdef HAVE_MPI
+    int runRandomId = 0;
+    if (par.localTmp != "") {
+        std::srand(std::time(nullptr));
+        runRandomId = std::rand();
+        runRandomId = runRandomId / 2;
+    }
+    if (pref.getSplitMode() == Parameters::TARGET_DB_SPLIT) {
+        // target splits are merged by the master only, keep the alignment distributed over all ranks instead
+        pref.setHitConsumer(NULL);
+        std::pair<std::string, std::string> prefDB = Util::databaseNames(par.db3 + "_pref");
+        pref.runMpiSplits(prefDB.first, prefDB.second, par.localTmp, runRandomId);
+        MPI_Barrier(MPI_COMM_WORLD);
+        Debug(Debug::INFO) << "Calculation of alignments\n";
+        aln.setQueryDatabase(par.db1, prefDB.first, prefDB.second);
+        aln.run(MMseqsMPI::rank, MMseqsMPI::numProc, par.maxAccept, par.maxRejected, par.wrappedScoring);
+        if (MMseqsMPI::isMaster()) {
+            DBReader<unsigned int>::removeDb(prefDB.first);
+        }
+        return EXIT_SUCCESS;
+    }
+#endif
+
+    // each prefilter thread aligns the hits of its query right away
+    aln.initHitConsumer(par.threads, par.maxAccept, par.maxRejected, par.wrappedScoring);
+#ifdef HAVE_MPI
+    pref.runMpiSplits(par.db3, par.db3Index, par.localTmp, runRandomId);
+#else
+    pref.runAllSplits(par.db3, par.db3Index);
+#endif
+    aln.finishHitConsumer();
+
+    return EXIT_SUCCESS;
+}
@@ -8,10 +8,12 @@
 Clustering::Clustering(const std::string &seqDB, const std::string &seqDBIndex,
                        const std::string &alnDB, const std::string &alnDBIndex,
                        const std::string &outDB, const std::string &outDBIndex,
-                       unsigned int maxIteration, int similarityScoreType, int threads, int compressed) : maxIteration(maxIteration),
+                       unsigned int maxIteration, int similarityScoreType, int threads, int compressed,
+                       size_t memoryLimit) : maxIteration(maxIteration),
                                                                similarityScoreType(similarityScoreType),
                                                                threads(threads),
                                                                compressed(compressed),
+                                                               memoryLimit(memoryLimit),
                                                                outDB(outDB),
                                                                outDBIndex(outDBIndex) {
 
@@ -37,7 +39,7 @@ void Clustering::run(int mode) {
     std::pair<unsigned int, unsigned int> * ret;
     ClusteringAlgorithms *algorithm = new ClusteringAlgorithms(seqDbr, alnDbr,
                                                                threads, similarityScoreType,
-                                                               maxIteration);
+                                                               maxIteration, Util::computeMemory(memoryLimit), outDB);
 
     if (mode == Parameters::GREEDY) {
         Debug(Debug::INFO) << "Clustering mode: Greedy\n";
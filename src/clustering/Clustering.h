@@ -11,7 +11,8 @@ public:
     Clustering(const std::string &seqDB, const std::string &seqDBIndex,
                const std::string &alnResultsDB, const std::string &alnResultsDBIndex,
                const std::string &outDB, const std::string &outDBIndex,
-               unsigned int maxIteration, int similarityScoreType, int threads, int compressed);
+               unsigned int maxIteration, int similarityScoreType, int threads, int compressed,
+               size_t memoryLimit);
 
     void run(int mode);
 
@@ -31,6 +32,7 @@ private:
 
     int threads;
     int compressed;
+    size_t memoryLimit;
     std::string outDB;
     std::string outDBIndex;
 };
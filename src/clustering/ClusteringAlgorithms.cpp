@@ -1,13 +1,12 @@
 #include "ClusteringAlgorithms.h"
 #include "Util.h"
 #include "Debug.h"
-#include "AlignmentSymmetry.h"
-#include "Timer.h"
+#include "ClusteringGraph.h"
 
-#include <queue>
 #include <algorithm>
 #include <climits>
 #include <unordered_map>
+#include <vector>
 #include <FastSort.h>
 
 #ifdef OPENMP
@@ -15,7 +14,8 @@
 #endif
 
 ClusteringAlgorithms::ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, DBReader<unsigned int>* alnDbr,
-                                           int threads, int scoretype, int maxiterations){
+                                           int threads, int scoretype, int maxiterations,
+                                           size_t memoryLimit, const std::string &spillPrefix){
     this->seqDbr=seqDbr;
     if(seqDbr->getSize() != alnDbr->getSize()){
         Debug(Debug::ERROR) << "Sequence db size != result db size\n";
@@ -26,6 +26,8 @@ ClusteringAlgorithms::ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, DBRea
     this->threads=threads;
     this->scoretype=scoretype;
     this->maxiterations=maxiterations;
+    this->memoryLimit=memoryLimit;
+    this->spillPrefix=spillPrefix;
     ///time
     this->clustersizes=new int[dbSize];
     std::fill_n(clustersizes, dbSize, 0);
@@ -46,81 +48,25 @@ std::pair<unsigned int, unsigned int> * ClusteringAlgorithms::execute(int mode)
     if (mode==4 || mode==2) {
         greedyIncrementalLowMem(assignedcluster);
     }else {
-        size_t elementCount = 0;
-#pragma omp parallel reduction (+:elementCount)
-        {
-            int thread_idx = 0;
-#ifdef OPENMP
-            thread_idx = omp_get_thread_num();
-#endif
-#pragma omp for schedule(dynamic, 10)
-            for (size_t i = 0; i < alnDbr->getSize(); i++) {
-                const char *data = alnDbr->getData(i, thread_idx);
-                const size_t dataSize = alnDbr->getEntryLen(i);
-                elementCount += (*data == '\0') ? 1 : Util::countLines(data, dataSize);
-            }
+        ClusteringGraph graph(memoryLimit, spillPrefix);
+        graph.load(seqDbr, alnDbr, scoretype, threads);
+        maxClustersize = 0;
+        for (size_t i = 0; i < dbSize; i++) {
+            const size_t elementCount = graph.getElementCount(i);
+            maxClustersize = std::max((unsigned int) elementCount, maxClustersize);
+            clustersizes[i] = elementCount;
         }
-        unsigned int * elements = new(std::nothrow) unsigned int[elementCount];
-        Util::checkAllocation(elements, "Can not allocate elements memory in ClusteringAlgorithms::execute");
-        unsigned int ** elementLookupTable = new(std::nothrow) unsigned int*[dbSize];
-        Util::checkAllocation(elementLookupTable, "Can not allocate elementLookupTable memory in ClusteringAlgorithms::execute");
-        unsigned short **scoreLookupTable = new(std::nothrow) unsigned short *[dbSize];
-        Util::checkAllocation(scoreLookupTable, "Can not allocate scoreLookupTable memory in ClusteringAlgorithms::execute");
-        unsigned short *score = NULL;
-        size_t *elementOffsets = new(std::nothrow) size_t[dbSize + 1];
-        Util::checkAllocation(elementOffsets, "Can not allocate elementOffsets memory in ClusteringAlgorithms::execute");
-        elementOffsets[dbSize] = 0;
-        short *bestscore = new(std::nothrow) short[dbSize];
-        Util::checkAllocation(bestscore, "Can not allocate bestscore memory in ClusteringAlgorithms::execute");
-        std::fill_n(bestscore, dbSize, SHRT_MIN);
-
-        readInClusterData(elementLookupTable, elements, scoreLookupTable, score, elementOffsets, elementCount);
         ClusteringAlgorithms::initClustersizes();
         if (mode == 1) {
-            setCover(elementLookupTable, scoreLookupTable, assignedcluster, bestscore, elementOffsets);
+            setCover(graph, assignedcluster);
         } else if (mode == 3) {
             Debug(Debug::INFO) << "connected component mode" << "\n";
-            for (int cl_size = dbSize - 1; cl_size >= 0; cl_size--) {
-                unsigned int representative = sorted_clustersizes[cl_size];
-                if (assignedcluster[representative] == UINT_MAX) {
-                    assignedcluster[representative] = representative;
-                    std::queue<int> myqueue;
-                    myqueue.push(representative);
-                    std::queue<int> iterationcutoffs;
-                    iterationcutoffs.push(0);
-                    //delete clusters of members;
-                    while (!myqueue.empty()) {
-                        int currentid = myqueue.front();
-                        int iterationcutoff = iterationcutoffs.front();
-                        assignedcluster[currentid] = representative;
-                        myqueue.pop();
-                        iterationcutoffs.pop();
-                        size_t elementSize = (elementOffsets[currentid + 1] - elementOffsets[currentid]);
-                        for (size_t elementId = 0; elementId < elementSize; elementId++) {
-                            unsigned int elementtodelete = elementLookupTable[currentid][elementId];
-                            if (assignedcluster[elementtodelete] == UINT_MAX && iterationcutoff < maxiterations) {
-                                myqueue.push(elementtodelete);
-                                iterationcutoffs.push((iterationcutoff + 1));
-                            }
-                            assignedcluster[elementtodelete] = representative;
-                        }
-                    }
-
-                }
-            }
+            connectedComponents(graph, assignedcluster);
         }
         //delete unnecessary datastructures
         delete [] sorted_clustersizes;
         delete [] clusterid_to_arrayposition;
         delete [] borders_of_set;
-
-
-        delete [] elementLookupTable;
-        delete [] elements;
-        delete [] elementOffsets;
-        delete [] scoreLookupTable;
-        delete [] score;
-        delete [] bestscore;
     }
 
 
@@ -201,8 +147,16 @@ void ClusteringAlgorithms::decreaseClustersize(int clusterid){
     clustersizes[clusterid]--;
 }
 
-void ClusteringAlgorithms::setCover(unsigned int **elementLookupTable, unsigned short ** elementScoreLookupTable,
-                                    unsigned int *assignedcluster, short *bestscore, size_t *newElementOffsets) {
+void ClusteringAlgorithms::setCover(const ClusteringGraph &graph, unsigned int *assignedcluster) {
+    // the choice of representatives depends on all previous choices and stays serial
+    std::vector<unsigned int> representatives;
+    // members of the current representative that leave the remaining sets
+    std::vector<unsigned int> deleted;
+    // per deleted member the sets whose size decreases, filled in parallel and applied in the serial order
+    std::vector<size_t> decreaseOffsets;
+    std::vector<unsigned int> decrease;
+    std::vector<size_t> decreaseCounts;
+    std::vector<char> representativeFound;
     for (int cl_size = dbSize - 1; cl_size >= 0; cl_size--) {
         const unsigned int representative = sorted_clustersizes[cl_size];
         if (representative == UINT_MAX) {
@@ -210,21 +164,13 @@ void ClusteringAlgorithms::setCover(unsigned int **elementLookupTable, unsigned
         }
 //          Debug(Debug::INFO)<<alnDbr->getDbKey(representative)<<"\n";
         removeClustersize(representative);
-        assignedcluster[representative] = representative;
+        representatives.push_back(representative);
 
         //delete clusters of members;
-        size_t elementSize = (newElementOffsets[representative + 1] - newElementOffsets[representative]);
+        const size_t elementSize = graph.getElementCount(representative);
+        const unsigned int *elements = graph.getElements(representative);
         for (size_t elementId = 0; elementId < elementSize; elementId++) {
-            const unsigned int elementtodelete = elementLookupTable[representative][elementId];
-            // float seqId = elementScoreTable[representative][elementId];
-            const short seqId = elementScoreLookupTable[representative][elementId];
-            //  Debug(Debug::INFO)<<seqId<<"\t"<<bestscore[elementtodelete]<<"\n";
-            // becareful of this criteria
-            if (seqId > bestscore[elementtodelete]) {
-                assignedcluster[elementtodelete] = representative;
-                bestscore[elementtodelete] = seqId;
-            }
-            //Debug(Debug::INFO)<<bestscore[elementtodelete]<<"\n";
+            const unsigned int elementtodelete = elements[elementId];
             if (elementtodelete == representative) {
                 continue;
             }
@@ -234,11 +180,11 @@ void ClusteringAlgorithms::setCover(unsigned int **elementLookupTable, unsigned
             removeClustersize(elementtodelete);
         }
 
+        deleted.clear();
+        decreaseOffsets.clear();
+        decreaseOffsets.push_back(0);
         for (size_t elementId = 0; elementId < elementSize; elementId++) {
-            bool representativefound = false;
-            const unsigned int elementtodelete = elementLookupTable[representative][elementId];
-            const unsigned int currElementSize = (newElementOffsets[elementtodelete + 1] -
-                                                  newElementOffsets[elementtodelete]);
+            const unsigned int elementtodelete = elements[elementId];
             if (elementtodelete == representative) {
                 clustersizes[elementtodelete] = -1;
                 continue;
@@ -247,26 +193,204 @@ void ClusteringAlgorithms::setCover(unsigned int **elementLookupTable, unsigned
                 continue;
             }
             clustersizes[elementtodelete] = -1;
-            //decrease clustersize of sets that contain the element
+            deleted.push_back(elementtodelete);
+            decreaseOffsets.push_back(decreaseOffsets.back() + graph.getElementCount(elementtodelete));
+        }
+        decrease.resize(decreaseOffsets.back());
+        decreaseCounts.resize(deleted.size());
+        representativeFound.resize(deleted.size());
+
+        // All members of the representative are removed now, so no set with a size above zero drops to zero
+        // in this loop and the sets to decrease only depend on the sizes before it.
+#pragma omp parallel for schedule(dynamic, 10) num_threads(threads) if(decreaseOffsets.back() > 100000)
+        for (size_t i = 0; i < deleted.size(); i++) {
+            const unsigned int elementtodelete = deleted[i];
+            const unsigned int currElementSize = graph.getElementCount(elementtodelete);
+            const unsigned int *currElements = graph.getElements(elementtodelete);
+            unsigned int *currDecrease = decrease.data() + decreaseOffsets[i];
+            size_t count = 0;
+            bool representativefound = false;
             for (size_t elementId2 = 0; elementId2 < currElementSize; elementId2++) {
-                const unsigned int elementtodecrease = elementLookupTable[elementtodelete][elementId2];
+                const unsigned int elementtodecrease = currElements[elementId2];
                 if (representative == elementtodecrease) {
                     representativefound = true;
                 }
+                if (clustersizes[elementtodecrease] > 0) {
+                    currDecrease[count++] = elementtodecrease;
+                }
+            }
+            decreaseCounts[i] = count;
+            representativeFound[i] = representativefound;
+        }
+
+        //decrease clustersize of sets that contain the element, in the same order as the serial loop
+        for (size_t i = 0; i < deleted.size(); i++) {
+            const unsigned int elementtodelete = deleted[i];
+            const unsigned int *currDecrease = decrease.data() + decreaseOffsets[i];
+            for (size_t j = 0; j < decreaseCounts[i]; j++) {
+                const unsigned int elementtodecrease = currDecrease[j];
                 if (clustersizes[elementtodecrease] == 1) {
                     Debug(Debug::ERROR) << "there must be an error: " << seqDbr->getDbKey(elementtodelete) <<
                                         " deleted from " << seqDbr->getDbKey(elementtodecrease) <<
                                         " that now is empty, but not assigned to a cluster\n";
-                } else if (clustersizes[elementtodecrease] > 0) {
+                } else {
                     decreaseClustersize(elementtodecrease);
                 }
             }
-            if (!representativefound) {
+            if (!representativeFound[i]) {
                 Debug(Debug::ERROR) << "error with cluster:\t" << seqDbr->getDbKey(representative) <<
                                     "\tis not contained in set:\t" << seqDbr->getDbKey(elementtodelete) << ".\n";
             }
         }
     }
+
+    // Every member goes to the representative with the best score, ties go to the earlier representative
+    // in sorted_clustersizes order. All representatives claim their members at once, a claim holds the score
+    // in the upper and the inverted representative order in the lower bits, so the largest claim wins.
+    uint64_t *claims = new(std::nothrow) uint64_t[dbSize];
+    Util::checkAllocation(claims, "Can not allocate claims memory in ClusteringAlgorithms::setCover");
+    std::fill_n(claims, dbSize, 0);
+#pragma omp parallel for schedule(dynamic, 100) num_threads(threads)
+    for (size_t i = 0; i < representatives.size(); i++) {
+        const unsigned int representative = representatives[i];
+        const size_t elementSize = graph.getElementCount(representative);
+        const unsigned int *elements = graph.getElements(representative);
+        const unsigned short *scores = graph.getScores(representative);
+        for (size_t elementId = 0; elementId < elementSize; elementId++) {
+            const unsigned int element = elements[elementId];
+            const short seqId = scores[elementId];
+            // becareful of this criteria
+            if (seqId == SHRT_MIN) {
+                continue;
+            }
+            const uint64_t claim = (static_cast<uint64_t>(seqId - SHRT_MIN) << 32) | (UINT_MAX - i);
+            uint64_t currClaim = __atomic_load_n(&claims[element], __ATOMIC_RELAXED);
+            while (claim > currClaim && !__atomic_compare_exchange_n(&claims[element], &currClaim, claim, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+        }
+    }
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t i = 0; i < dbSize; i++) {
+        if (claims[i] != 0) {
+            assignedcluster[i] = representatives[UINT_MAX - static_cast<unsigned int>(claims[i])];
+        }
+    }
+    // a representative is not contained in the set of any other representative
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t i = 0; i < representatives.size(); i++) {
+        assignedcluster[representatives[i]] = representatives[i];
+    }
+    delete[] claims;
+}
+
+static unsigned int findRoot(unsigned int *parent, unsigned int id) {
+    unsigned int currParent = __atomic_load_n(&parent[id], __ATOMIC_RELAXED);
+    while (currParent != id) {
+        // path halving, a lost update only leaves a longer path
+        const unsigned int grandParent = __atomic_load_n(&parent[currParent], __ATOMIC_RELAXED);
+        __atomic_compare_exchange_n(&parent[id], &currParent, grandParent, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        id = grandParent;
+        currParent = __atomic_load_n(&parent[id], __ATOMIC_RELAXED);
+    }
+    return id;
+}
+
+void ClusteringAlgorithms::connectedComponents(const ClusteringGraph &graph, unsigned int *assignedcluster) {
+    // The search from a representative never leaves its component, so components are searched in parallel.
+    // Within a component the representatives are tried in the order of sorted_clustersizes as before.
+    unsigned int *parent = new(std::nothrow) unsigned int[dbSize];
+    Util::checkAllocation(parent, "Can not allocate parent memory in ClusteringAlgorithms::connectedComponents");
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t i = 0; i < dbSize; i++) {
+        parent[i] = i;
+    }
+    // union by smaller root id, a root only changes through a successful CAS on itself
+#pragma omp parallel for schedule(dynamic, 1000) num_threads(threads)
+    for (size_t i = 0; i < dbSize; i++) {
+        const size_t elementSize = graph.getElementCount(i);
+        const unsigned int *elements = graph.getElements(i);
+        for (size_t elementId = 0; elementId < elementSize; elementId++) {
+            unsigned int rootA = findRoot(parent, i);
+            unsigned int rootB = findRoot(parent, elements[elementId]);
+            while (rootA != rootB) {
+                if (rootA < rootB) {
+                    std::swap(rootA, rootB);
+                }
+                unsigned int expected = rootA;
+                if (__atomic_compare_exchange_n(&parent[rootA], &expected, rootB, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    break;
+                }
+                rootA = findRoot(parent, rootA);
+                rootB = findRoot(parent, rootB);
+            }
+        }
+    }
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t i = 0; i < dbSize; i++) {
+        parent[i] = findRoot(parent, i);
+    }
+
+    // members of each component in descending order of their position in sorted_clustersizes
+    size_t *componentOffsets = new(std::nothrow) size_t[dbSize + 1];
+    Util::checkAllocation(componentOffsets, "Can not allocate componentOffsets memory in ClusteringAlgorithms::connectedComponents");
+    std::fill_n(componentOffsets, dbSize + 1, 0);
+    for (size_t i = 0; i < dbSize; i++) {
+        componentOffsets[parent[i] + 1]++;
+    }
+    std::vector<unsigned int> components;
+    for (size_t i = 0; i < dbSize; i++) {
+        if (componentOffsets[i + 1] > 0) {
+            components.push_back(i);
+        }
+        componentOffsets[i + 1] += componentOffsets[i];
+    }
+    unsigned int *members = new(std::nothrow) unsigned int[dbSize];
+    Util::checkAllocation(members, "Can not allocate members memory in ClusteringAlgorithms::connectedComponents");
+    for (int cl_size = dbSize - 1; cl_size >= 0; cl_size--) {
+        const unsigned int id = sorted_clustersizes[cl_size];
+        members[componentOffsets[parent[id]]++] = id;
+    }
+    // restore start offsets
+    for (size_t i = dbSize; i > 0; i--) {
+        componentOffsets[i] = componentOffsets[i - 1];
+    }
+    componentOffsets[0] = 0;
+    delete[] parent;
+
+    Debug(Debug::INFO) << "Found " << components.size() << " connected components\n";
+#pragma omp parallel num_threads(threads)
+    {
+        std::vector<std::pair<unsigned int, int>> queue;
+#pragma omp for schedule(dynamic, 1)
+        for (size_t i = 0; i < components.size(); i++) {
+            const size_t start = componentOffsets[components[i]];
+            const size_t end = componentOffsets[components[i] + 1];
+            for (size_t memberId = start; memberId < end; memberId++) {
+                const unsigned int representative = members[memberId];
+                if (assignedcluster[representative] != UINT_MAX) {
+                    continue;
+                }
+                assignedcluster[representative] = representative;
+                queue.clear();
+                queue.emplace_back(representative, 0);
+                for (size_t head = 0; head < queue.size(); head++) {
+                    const unsigned int currentid = queue[head].first;
+                    const int iterationcutoff = queue[head].second;
+                    assignedcluster[currentid] = representative;
+                    const size_t elementSize = graph.getElementCount(currentid);
+                    const unsigned int *elements = graph.getElements(currentid);
+                    for (size_t elementId = 0; elementId < elementSize; elementId++) {
+                        const unsigned int elementtodelete = elements[elementId];
+                        if (assignedcluster[elementtodelete] == UINT_MAX && iterationcutoff < maxiterations) {
+                            queue.emplace_back(elementtodelete, iterationcutoff + 1);
+                        }
+                        assignedcluster[elementtodelete] = representative;
+                    }
+                }
+            }
+        }
+    }
+    delete[] members;
+    delete[] componentOffsets;
 }
 
 void ClusteringAlgorithms::greedyIncrementalLowMem( unsigned int *assignedcluster) {
@@ -331,72 +455,3 @@ void ClusteringAlgorithms::greedyIncrementalLowMem( unsigned int *assignedcluste
     }
 
 }
-
-void ClusteringAlgorithms::readInClusterData(unsigned int **elementLookupTable, unsigned int *&elements,
-                                             unsigned short **scoreLookupTable, unsigned short *&scores,
-                                             size_t *elementOffsets, size_t totalElementCount) {
-    Timer timer;
-#pragma omp parallel
-    {
-        int thread_idx = 0;
-#ifdef OPENMP
-        thread_idx = omp_get_thread_num();
-#endif
-#pragma omp for schedule(dynamic, 1000)
-        for (size_t i = 0; i < dbSize; i++) {
-            const unsigned int clusterId = seqDbr->getDbKey(i);
-            const size_t alnId = alnDbr->getId(clusterId);
-            const char *data = alnDbr->getData(alnId, thread_idx);
-            const size_t dataSize = alnDbr->getEntryLen(alnId);
-            elementOffsets[i] = (*data == '\0') ? 1 : Util::countLines(data, dataSize);
-        }
-    }
-
-    // make offset table
-    AlignmentSymmetry::computeOffsetFromCounts(elementOffsets, dbSize);
-    // set element edge pointers by using the offset table
-    AlignmentSymmetry::setupPointers<unsigned int>(elements, elementLookupTable, elementOffsets, dbSize,
-                                                   totalElementCount);
-    // fill elements
-    AlignmentSymmetry::readInData(alnDbr, seqDbr, elementLookupTable, NULL, 0, elementOffsets);
-    Debug(Debug::INFO) << "Sort entries\n";
-    AlignmentSymmetry::sortElements(elementLookupTable, elementOffsets, dbSize);
-    Debug(Debug::INFO) << "Find missing connections\n";
-
-    size_t *newElementOffsets = new size_t[dbSize + 1];
-    memcpy(newElementOffsets, elementOffsets, sizeof(size_t) * (dbSize + 1));
-
-    // findMissingLinks detects new possible connections and updates the elementOffsets with new sizes
-    const size_t symmetricElementCount = AlignmentSymmetry::findMissingLinks(elementLookupTable,
-                                                                             newElementOffsets, dbSize,
-                                                                             threads);
-    // resize elements
-    delete[] elements;
-    elements = new(std::nothrow) unsigned int[symmetricElementCount];
-    Util::checkAllocation(elements, "Can not allocate elements memory in readInClusterData");
-    std::fill_n(elements, symmetricElementCount, UINT_MAX);
-    // init score vector
-    scores = new(std::nothrow) unsigned short[symmetricElementCount];
-    Util::checkAllocation(scores, "Can not allocate scores memory in readInClusterData");
-    std::fill_n(scores, symmetricElementCount, 0);
-    Debug(Debug::INFO) << "Found " << symmetricElementCount - totalElementCount << " new connections.\n";
-    AlignmentSymmetry::setupPointers<unsigned int>  (elements, elementLookupTable, newElementOffsets, dbSize, symmetricElementCount);
-    AlignmentSymmetry::setupPointers<unsigned short>(scores, scoreLookupTable, newElementOffsets, dbSize, symmetricElementCount);
-    //time
-    Debug(Debug::INFO) << "Reconstruct initial order\n";
-    alnDbr->remapData(); // need to free memory
-    AlignmentSymmetry::readInData(alnDbr, seqDbr, elementLookupTable, scoreLookupTable, scoretype, elementOffsets);
-    alnDbr->remapData(); // need to free memory
-    Debug(Debug::INFO) << "Add missing connections\n";
-    AlignmentSymmetry::addMissingLinks(elementLookupTable, elementOffsets, newElementOffsets, dbSize, scoreLookupTable);
-    maxClustersize = 0;
-    for (size_t i = 0; i < dbSize; i++) {
-        size_t elementCount = newElementOffsets[i + 1] - newElementOffsets[i];
-        maxClustersize = std::max((unsigned int) elementCount, maxClustersize);
-        clustersizes[i] = elementCount;
-    }
-
-    memcpy(elementOffsets, newElementOffsets, sizeof(size_t) * (dbSize + 1));
-    delete[] newElementOffsets;
-    Debug(Debug::INFO) << "\nTime for read in: " << timer.lap() << "\n";
-}
@@ -11,10 +11,12 @@
 #include <unordered_map>
 
 #include "DBReader.h"
+#include "ClusteringGraph.h"
 
 class ClusteringAlgorithms {
 public:
-    ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, DBReader<unsigned int>* alnDbr, int threads,int scoretype, int maxiterations);
+    ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, DBReader<unsigned int>* alnDbr, int threads,int scoretype, int maxiterations,
+                         size_t memoryLimit, const std::string &spillPrefix);
     ~ClusteringAlgorithms();
     std::pair<unsigned int, unsigned int> * execute(int mode);
 private:
@@ -25,6 +27,9 @@ private:
 
     int threads;
     int scoretype;
+    // graph links above this size are kept in memory mapped files at spillPrefix
+    size_t memoryLimit;
+    std::string spillPrefix;
 //datastructures
     unsigned int maxClustersize;
     unsigned int dbSize;
@@ -44,8 +49,9 @@ private:
     int maxiterations;
 
 
-    void setCover(unsigned int **elementLookup, unsigned short ** elementScoreLookupTable,
-                  unsigned int *assignedcluster, short *bestscore, size_t *offsets);
+    void setCover(const ClusteringGraph &graph, unsigned int *assignedcluster);
+
+    void connectedComponents(const ClusteringGraph &graph, unsigned int *assignedcluster);
 
     void greedyIncremental(unsigned int **elementLookupTable, size_t *elementOffsets,
                            size_t n, unsigned int *assignedcluster) ;
@@ -54,10 +60,6 @@ private:
     void greedyIncrementalLowMem(unsigned int *assignedcluster) ;
 
 
-    void readInClusterData(unsigned int **elementLookupTable, unsigned int *&elements,
-                           unsigned short **scoreLookupTable, unsigned short *&scores,
-                           size_t *elementOffsets, size_t totalElementCount)  ;
-
 };
 
 
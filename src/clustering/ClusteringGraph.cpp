@@ -0,0 +1,296 @@
+#include "ClusteringGraph.h"
+#include "AlignmentSymmetry.h"
+#include "Parameters.h"
+#include "FastSort.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+ClusteringGraph::ClusteringGraph(size_t memoryLimit, const std::string &spillPrefix)
+        : memoryLimit(memoryLimit), spillPrefix(spillPrefix), nodeCount(0), offsets(NULL), elements(NULL), scores(NULL) {}
+
+ClusteringGraph::~ClusteringGraph() {
+    delete[] offsets;
+}
+
+void *ClusteringGraph::Storage::allocate(size_t bytes, const std::string &spillFile) {
+    release();
+    size = std::max(bytes, static_cast<size_t>(1));
+    if (spillFile.empty()) {
+        data = malloc(size);
+        Util::checkAllocation(data, "Can not allocate memory in ClusteringGraph");
+        return data;
+    }
+    fd = open(spillFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        Debug(Debug::ERROR) << "Can not create file " << spillFile << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    // the file disappears once it is closed
+    unlink(spillFile.c_str());
+    if (ftruncate(fd, size) != 0) {
+        Debug(Debug::ERROR) << "Can not resize file " << spillFile << " to " << size << " bytes\n";
+        EXIT(EXIT_FAILURE);
+    }
+    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        Debug(Debug::ERROR) << "Can not mmap file " << spillFile << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return data;
+}
+
+void *ClusteringGraph::Storage::resize(size_t bytes) {
+    bytes = std::max(bytes, static_cast<size_t>(1));
+    if (fd < 0) {
+        data = realloc(data, bytes);
+        Util::checkAllocation(data, "Can not allocate memory in ClusteringGraph");
+    } else {
+        if (ftruncate(fd, bytes) != 0) {
+            Debug(Debug::ERROR) << "Can not resize spill file to " << bytes << " bytes\n";
+            EXIT(EXIT_FAILURE);
+        }
+        munmap(data, size);
+        data = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            Debug(Debug::ERROR) << "Can not mmap spill file\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    size = bytes;
+    return data;
+}
+
+void ClusteringGraph::Storage::release() {
+    if (data != NULL) {
+        if (fd < 0) {
+            free(data);
+        } else {
+            munmap(data, size);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    data = NULL;
+    size = 0;
+    fd = -1;
+}
+
+void ClusteringGraph::load(DBReader<unsigned int> *seqDbr, DBReader<unsigned int> *alnDbr, int scoretype, int threads) {
+    if (seqDbr->getSize() != alnDbr->getSize()) {
+        Debug(Debug::ERROR) << "Sequence db size != result db size\n";
+        EXIT(EXIT_FAILURE);
+    }
+    nodeCount = seqDbr->getSize();
+    delete[] offsets;
+    offsets = new(std::nothrow) size_t[nodeCount + 1];
+    Util::checkAllocation(offsets, "Can not allocate offsets memory in ClusteringGraph::load");
+    offsets[nodeCount] = 0;
+#pragma omp parallel num_threads(threads)
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+#pragma omp for schedule(dynamic, 1000)
+        for (size_t i = 0; i < nodeCount; i++) {
+            const size_t alnId = alnDbr->getId(seqDbr->getDbKey(i));
+            const char *data = alnDbr->getData(alnId, thread_idx);
+            // empty results still link the node to itself
+            offsets[i] = (*data == '\0') ? 1 : Util::countLines(data, alnDbr->getEntryLen(alnId));
+        }
+    }
+    AlignmentSymmetry::computeOffsetFromCounts(offsets, nodeCount);
+    const size_t elementCount = offsets[nodeCount];
+
+    // at most every link is missing on the other side, the sorted copy is only needed to find them
+    const size_t memoryNeeded = 2 * sizeof(size_t) * (nodeCount + 1) + sizeof(unsigned int) * nodeCount
+                                + elementCount * (2 * (sizeof(unsigned int) + sizeof(unsigned short)) + sizeof(unsigned int));
+    const bool spill = memoryNeeded > memoryLimit;
+    if (spill) {
+        Debug(Debug::INFO) << "Graph with " << elementCount << " links needs up to " << (memoryNeeded >> 20)
+                           << "M, links are kept in memory mapped files at " << spillPrefix << "\n";
+    }
+    elements = static_cast<unsigned int *>(elementStorage.allocate(sizeof(unsigned int) * elementCount, spill ? spillPrefix + "_graph_elements" : ""));
+    scores = static_cast<unsigned short *>(scoreStorage.allocate(sizeof(unsigned short) * elementCount, spill ? spillPrefix + "_graph_scores" : ""));
+
+    readElements(seqDbr, alnDbr, scoretype, threads);
+    addMissingLinks(spill, threads);
+}
+
+void ClusteringGraph::readElements(DBReader<unsigned int> *seqDbr, DBReader<unsigned int> *alnDbr, int scoretype, int threads) {
+    const int alnType = alnDbr->getDbtype();
+    const bool isAlignment = Parameters::isEqualDbtype(alnType, Parameters::DBTYPE_ALIGNMENT_RES);
+    const bool isPrefilter = Parameters::isEqualDbtype(alnType, Parameters::DBTYPE_PREFILTER_RES)
+                             || Parameters::isEqualDbtype(alnType, Parameters::DBTYPE_PREFILTER_REV_RES);
+    if (isAlignment == false && isPrefilter == false) {
+        Debug(Debug::ERROR) << "Alignment format is not supported!\n";
+        EXIT(EXIT_FAILURE);
+    }
+    const size_t flushSize = 1000000;
+    Debug::Progress progress(nodeCount);
+    for (size_t start = 0; start < nodeCount; start += flushSize) {
+        const size_t end = std::min(nodeCount, start + flushSize);
+#pragma omp parallel num_threads(threads)
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+            char similarity[255 + 1];
+            char dbKey[255 + 1];
+#pragma omp for schedule(dynamic, 100)
+            for (size_t i = start; i < end; i++) {
+                progress.updateProgress();
+                // seqDbr is descending sorted by length
+                // the assumption is that clustering is B -> B (not A -> B)
+                const unsigned int clusterKey = seqDbr->getDbKey(i);
+                char *data = alnDbr->getDataByDBKey(clusterKey, thread_idx);
+                unsigned int *setElements = elements + offsets[i];
+                unsigned short *setScores = scores + offsets[i];
+                if (*data == '\0') {
+                    setElements[0] = i;
+                    if (isAlignment) {
+                        // alignment score or sequence identity [0-1]
+                        setScores[0] = (scoretype == Parameters::APC_ALIGNMENTSCORE) ? USHRT_MAX : static_cast<unsigned short>(1.0 * 1000.0f);
+                    } else {
+                        setScores[0] = USHRT_MAX;
+                    }
+                    continue;
+                }
+                size_t writePos = 0;
+                while (*data != '\0') {
+                    Util::parseKey(data, dbKey);
+                    const unsigned int key = static_cast<unsigned int>(strtoul(dbKey, NULL, 10));
+                    const size_t currElement = seqDbr->getId(key);
+                    if (currElement == UINT_MAX || currElement >= nodeCount) {
+                        Debug(Debug::ERROR) << "Element " << dbKey
+                                            << " contained in some alignment list, but not contained in the sequence database!\n";
+                        EXIT(EXIT_FAILURE);
+                    }
+                    if (isAlignment) {
+                        if (scoretype == Parameters::APC_ALIGNMENTSCORE) {
+                            //column 1 = alignment score
+                            Util::parseByColumnNumber(data, similarity, 1);
+                            setScores[writePos] = static_cast<unsigned short>(atof(similarity));
+                        } else {
+                            //column 2 = sequence identity [0-1]
+                            Util::parseByColumnNumber(data, similarity, 2);
+                            setScores[writePos] = static_cast<unsigned short>(atof(similarity) * 1000.0f);
+                        }
+                    } else {
+                        //column 1 = alignment score or sequence identity [0-100]
+                        Util::parseByColumnNumber(data, similarity, 1);
+                        const short sim = atoi(similarity);
+                        setScores[writePos] = static_cast<unsigned short>(sim > 0 ? sim : -sim);
+                    }
+                    setElements[writePos] = currElement;
+                    writePos++;
+                    data = Util::skipLine(data);
+                }
+            }
+        }
+        alnDbr->remapData();
+    }
+}
+
+void ClusteringGraph::addMissingLinks(bool spill, int threads) {
+    const size_t elementCount = offsets[nodeCount];
+    Storage sortedStorage;
+    unsigned int *sorted = static_cast<unsigned int *>(sortedStorage.allocate(sizeof(unsigned int) * elementCount, spill ? spillPrefix + "_graph_sorted" : ""));
+#pragma omp parallel for schedule(dynamic, 1000) num_threads(threads)
+    for (size_t i = 0; i < nodeCount; i++) {
+        std::copy(elements + offsets[i], elements + offsets[i + 1], sorted + offsets[i]);
+        SORT_SERIAL(sorted + offsets[i], sorted + offsets[i + 1]);
+    }
+
+    // count links i -> j where the result of j does not contain i
+    unsigned int *missing = new(std::nothrow) unsigned int[nodeCount];
+    Util::checkAllocation(missing, "Can not allocate missing memory in ClusteringGraph::addMissingLinks");
+    std::fill_n(missing, nodeCount, 0);
+#pragma omp parallel for schedule(dynamic, 1000) num_threads(threads)
+    for (size_t i = 0; i < nodeCount; i++) {
+        for (size_t pos = offsets[i]; pos < offsets[i + 1]; pos++) {
+            const unsigned int j = elements[pos];
+            if (std::binary_search(sorted + offsets[j], sorted + offsets[j + 1], i) == false) {
+                __sync_fetch_and_add(&missing[j], 1);
+            }
+        }
+    }
+    size_t *newOffsets = new(std::nothrow) size_t[nodeCount + 1];
+    Util::checkAllocation(newOffsets, "Can not allocate newOffsets memory in ClusteringGraph::addMissingLinks");
+    newOffsets[0] = 0;
+    for (size_t i = 0; i < nodeCount; i++) {
+        newOffsets[i + 1] = newOffsets[i] + (offsets[i + 1] - offsets[i]) + missing[i];
+    }
+    const size_t missingCount = newOffsets[nodeCount] - elementCount;
+    Debug(Debug::INFO) << "Found " << missingCount << " new connections.\n";
+    if (missingCount == 0) {
+        delete[] newOffsets;
+        delete[] missing;
+        return;
+    }
+
+    // grow the arrays and move every list to its new start, the last list moves the farthest
+    elements = static_cast<unsigned int *>(elementStorage.resize(sizeof(unsigned int) * newOffsets[nodeCount]));
+    scores = static_cast<unsigned short *>(scoreStorage.resize(sizeof(unsigned short) * newOffsets[nodeCount]));
+    for (size_t i = nodeCount; i > 0; i--) {
+        const size_t length = offsets[i] - offsets[i - 1];
+        memmove(elements + newOffsets[i - 1], elements + offsets[i - 1], sizeof(unsigned int) * length);
+        memmove(scores + newOffsets[i - 1], scores + offsets[i - 1], sizeof(unsigned short) * length);
+    }
+
+    // missing links of j are appended behind its own result
+    std::fill_n(missing, nodeCount, 0);
+#pragma omp parallel for schedule(dynamic, 1000) num_threads(threads)
+    for (size_t i = 0; i < nodeCount; i++) {
+        const size_t length = offsets[i + 1] - offsets[i];
+        for (size_t k = 0; k < length; k++) {
+            const unsigned int j = elements[newOffsets[i] + k];
+            if (std::binary_search(sorted + offsets[j], sorted + offsets[j + 1], i) == false) {
+                const size_t pos = newOffsets[j] + (offsets[j + 1] - offsets[j]) + __sync_fetch_and_add(&missing[j], 1);
+                elements[pos] = i;
+                scores[pos] = scores[newOffsets[i] + k];
+            }
+        }
+    }
+    sortedStorage.release();
+
+    // links from the same node were appended in order, order the appended links by node without
+    // changing the order within a node
+#pragma omp parallel num_threads(threads)
+    {
+        std::vector<std::pair<uint64_t, unsigned short>> buffer;
+#pragma omp for schedule(dynamic, 1000)
+        for (size_t j = 0; j < nodeCount; j++) {
+            if (missing[j] < 2) {
+                continue;
+            }
+            const size_t start = newOffsets[j] + (offsets[j + 1] - offsets[j]);
+            buffer.clear();
+            for (size_t k = 0; k < missing[j]; k++) {
+                buffer.emplace_back((static_cast<uint64_t>(elements[start + k]) << 32) | k, scores[start + k]);
+            }
+            std::sort(buffer.begin(), buffer.end());
+            for (size_t k = 0; k < missing[j]; k++) {
+                elements[start + k] = static_cast<unsigned int>(buffer[k].first >> 32);
+                scores[start + k] = buffer[k].second;
+            }
+        }
+    }
+    delete[] missing;
+    delete[] offsets;
+    offsets = newOffsets;
+}
@@ -0,0 +1,71 @@
+#ifndef MMSEQS_CLUSTERINGGRAPH_H
+#define MMSEQS_CLUSTERINGGRAPH_H
+
+// Symmetric graph of an alignment result in CSR layout, the input of set cover and connected component
+// clustering. Node ids are the ids of the sequence DB (sorted by length). Every node keeps the order of its
+// alignment result, the links that were only found in the result of the other node are appended ordered by
+// that node. The neighbor and score arrays are moved to memory mapped files if they exceed the memory limit.
+#include "DBReader.h"
+
+#include <string>
+
+class ClusteringGraph {
+public:
+    ClusteringGraph(size_t memoryLimit, const std::string &spillPrefix);
+    ~ClusteringGraph();
+
+    void load(DBReader<unsigned int> *seqDbr, DBReader<unsigned int> *alnDbr, int scoretype, int threads);
+
+    size_t getSize() const {
+        return nodeCount;
+    }
+
+    size_t getElementCount(unsigned int id) const {
+        return offsets[id + 1] - offsets[id];
+    }
+
+    const unsigned int *getElements(unsigned int id) const {
+        return elements + offsets[id];
+    }
+
+    const unsigned short *getScores(unsigned int id) const {
+        return scores + offsets[id];
+    }
+
+    size_t *getOffsets() const {
+        return offsets;
+    }
+
+private:
+    // heap memory or an unlinked memory mapped file
+    class Storage {
+    public:
+        Storage() : data(NULL), size(0), fd(-1) {}
+        ~Storage() {
+            release();
+        }
+        void *allocate(size_t bytes, const std::string &spillFile);
+        void *resize(size_t bytes);
+        void release();
+
+    private:
+        void *data;
+        size_t size;
+        int fd;
+    };
+
+    size_t memoryLimit;
+    std::string spillPrefix;
+
+    size_t nodeCount;
+    size_t *offsets;
+    unsigned int *elements;
+    unsigned short *scores;
+    Storage elementStorage;
+    Storage scoreStorage;
+
+    void readElements(DBReader<unsigned int> *seqDbr, DBReader<unsigned int> *alnDbr, int scoretype, int threads);
+    void addMissingLinks(bool spill, int threads);
+};
+
+#endif
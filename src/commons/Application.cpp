@@ -3,6 +3,7 @@
 #include "Command.h"
 #include "DistanceCalculator.h"
 #include "Timer.h"
+#include "PerfReport.h"
 
 #include <iomanip>
 
@@ -37,6 +38,7 @@ int runCommand(Command *p, int argc, const char **argv) {
     Timer timer;
     int status = p->commandFunction(argc, argv, *p);
     Debug(Debug::INFO) << "Time for processing: " << timer.lap() << "\n";
+    PerfReport::write(*p, argc, argv, version, timer.getTimediff(), status);
     return status;
 }
 
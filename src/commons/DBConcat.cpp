@@ -2,6 +2,7 @@
 #include "DBReader.h"
 #include "DBWriter.h"
 #include "itoa.h"
+#include "MappingReader.h"
 #include "Util.h"
 #include "Debug.h"
 #include "FileUtil.h"
@@ -150,16 +151,17 @@ DBConcat::DBConcat(const std::string &dataFileNameA, const std::string &indexFil
     // handle mapping
     if (shouldConcatMapping) {
         char buffer[1024];
-        std::vector<std::pair<unsigned int, unsigned int>> mappingA;
-        Util::readMapping((dataFileNameA + "_mapping"), mappingA);
-        std::vector<std::pair<unsigned int, unsigned int>> mappingB;
-        Util::readMapping((dataFileNameB + "_mapping"), mappingB);
+        MappingReader mappingA(dataFileNameA + "_mapping");
+        MappingReader mappingB(dataFileNameB + "_mapping");
 
         FILE* mappingFilePtr = fopen((dataFileNameC + "_mapping").c_str(), "w");
 
-        for(size_t i = 0; i < mappingA.size(); ++i) {
-            unsigned int prevKeyA = mappingA[i].first;
-            unsigned int taxidA = mappingA[i].second;
+        for(size_t i = 0; i < mappingA.getSize(); ++i) {
+            unsigned int prevKeyA = i;
+            unsigned int taxidA = mappingA.lookup(prevKeyA);
+            if (taxidA == MappingReader::NOT_FOUND) {
+                continue;
+            }
             unsigned int newKeyA = dbAKeyMap(prevKeyA);
 
             char * basePos = buffer;
@@ -176,9 +178,12 @@ DBConcat::DBConcat(const std::string &dataFileNameA, const std::string &indexFil
             }
         }
 
-        for(size_t i = 0; i < mappingB.size(); ++i) {
-            unsigned int prevKeyB = mappingB[i].first;
-            unsigned int taxidB = mappingB[i].second;
+        for(size_t i = 0; i < mappingB.getSize(); ++i) {
+            unsigned int prevKeyB = i;
+            unsigned int taxidB = mappingB.lookup(prevKeyB);
+            if (taxidB == MappingReader::NOT_FOUND) {
+                continue;
+            }
             unsigned int newKeyB = dbBKeyMap(prevKeyB);
 
             char * basePos = buffer;
@@ -198,6 +203,11 @@ DBConcat::DBConcat(const std::string &dataFileNameA, const std::string &indexFil
             Debug(Debug::ERROR) << "Cannot close data file " << dataFileNameC << "_mapping\n";
             EXIT(EXIT_FAILURE);
         }
+        // a binary mapping of a previous output would be read instead of the new text mapping
+        std::string binaryMappingC = dataFileNameC + "_mapping.bin";
+        if (FileUtil::fileExists(binaryMappingC.c_str())) {
+            FileUtil::remove(binaryMappingC.c_str());
+        }
     }
 
     unsigned int maxSetIdA = 0;
@@ -21,13 +21,51 @@
 #include <omp.h>
 #endif
 
+const char DBIndexHeader::MAGIC[8] = {'M', 'M', 'S', 'I', 'D', 'X', '\0', '\1'};
+const char DBBlockCompression::MAGIC[8] = {'M', 'M', 'S', 'Z', 'S', 'T', '\0', '\1'};
+
+bool DBBlockCompression::readFooter(const char *data, size_t dataSize, Footer &footer, size_t &segmentEnd) {
+    size_t end = dataSize;
+    while (end > 0 && data[end - 1] == '\0') {
+        end--;
+    }
+    if (end < sizeof(Footer)) {
+        return false;
+    }
+    memcpy(&footer, data + end - sizeof(Footer), sizeof(Footer));
+    if (memcmp(footer.magic, MAGIC, sizeof(MAGIC)) != 0 || footer.version != VERSION) {
+        return false;
+    }
+    size_t trailerSize = 2 * sizeof(unsigned int) + footer.blockCount * sizeof(Block) + footer.dictSize + sizeof(Footer);
+    if (footer.compressedSize > end || footer.compressedSize < trailerSize) {
+        return false;
+    }
+    segmentEnd = end;
+    return true;
+}
+
+size_t DBBlockCompression::uncompressedSize(const char *data, size_t dataSize) {
+    Footer footer;
+    size_t segmentEnd;
+    if (readFooter(data, dataSize, footer, segmentEnd) == false) {
+        return SIZE_MAX;
+    }
+    size_t totalSize = 0;
+    do {
+        totalSize += footer.uncompressedSize;
+        dataSize = segmentEnd - footer.compressedSize;
+    } while (dataSize > 0 && readFooter(data, dataSize, footer, segmentEnd));
+    return totalSize;
+}
+
 template <typename T>
 DBReader<T>::DBReader(const char* dataFileName_, const char* indexFileName_, int threads, int dataMode) :
 threads(threads), dataMode(dataMode), dataFileName(strdup(dataFileName_)),
         indexFileName(strdup(indexFileName_)), size(0), dataFiles(NULL), dataSizeOffset(NULL), dataFileCnt(0),
         totalDataSize(0), dataSize(0), lastKey(T()), closed(1), dbtype(Parameters::DBTYPE_GENERIC_DB),
-        compressedBuffers(NULL), compressedBufferSizes(NULL), index(NULL), id2local(NULL), local2id(NULL),
-        dataMapped(false), accessType(0), externalData(false), didMlock(false)
+        compressedBuffers(NULL), compressedBufferSizes(NULL), blockCompressed(false), blockCaches(NULL),
+        index(NULL), indexMapping(NULL), indexMappingSize(0),
+        id2local(NULL), local2id(NULL), dataMapped(false), accessType(0), externalData(false), didMlock(false)
 {}
 
 template <typename T>
@@ -35,7 +73,9 @@ DBReader<T>::DBReader(DBReader<T>::Index *index, size_t size, size_t dataSize, T
         int dbType, unsigned int maxSeqLen, int threads) :
         threads(threads), dataMode(USE_INDEX), dataFileName(NULL), indexFileName(NULL),
         size(size), dataFiles(NULL), dataSizeOffset(NULL), dataFileCnt(0), totalDataSize(0), dataSize(dataSize), lastKey(lastKey),
-        maxSeqLen(maxSeqLen), closed(1), dbtype(dbType), compressedBuffers(NULL), compressedBufferSizes(NULL), index(index), sortedByOffset(true),
+        maxSeqLen(maxSeqLen), closed(1), dbtype(dbType), compressedBuffers(NULL), compressedBufferSizes(NULL),
+        blockCompressed(false), blockCaches(NULL), index(index),
+        indexMapping(NULL), indexMappingSize(0), sortedByOffset(true),
         id2local(NULL), local2id(NULL), dataMapped(false), accessType(NOSORT), externalData(true), didMlock(false)
 {}
 
@@ -168,15 +208,20 @@ template <typename T> bool DBReader<T>::open(int accessType){
         }
         char* indexDataChar = (char *) indexData.getData();
         size_t indexDataSize = indexData.size();
-        size = Util::ompCountLines(indexDataChar, indexDataSize, threads);
+        if (DBIndexHeader::isBinaryIndex(indexDataChar, indexDataSize)) {
+            indexData.close();
+            isSortedById = readBinaryIndex(indexFileName);
+        } else {
+            size = Util::ompCountLines(indexDataChar, indexDataSize, threads);
 
-        index = new(std::nothrow) Index[this->size];
-        incrementMemory(sizeof(Index) * size);
+            index = new(std::nothrow) Index[this->size];
+            incrementMemory(sizeof(Index) * size);
 
-        Util::checkAllocation(index, "Can not allocate index memory in DBReader");
+            Util::checkAllocation(index, "Can not allocate index memory in DBReader");
 
-        bool isSortedById = readIndex(indexDataChar, indexDataSize, index, dataSize);
-        indexData.close();
+            isSortedById = readIndex(indexDataChar, indexDataSize, index, dataSize);
+            indexData.close();
+        }
 
         // sortIndex also handles access modes that don't require sorting
         sortIndex(isSortedById);
@@ -190,7 +235,10 @@ template <typename T> bool DBReader<T>::open(int accessType){
     }
 
     compression = isCompressed(dbtype);
-    if(compression == COMPRESSED){
+    if (compression == COMPRESSED && (dataMode & USE_DATA)) {
+        initBlockCompression();
+    }
+    if(compression == COMPRESSED && blockCompressed == false){
         compressedBufferSizes = new size_t[threads];
         compressedBuffers = new char*[threads];
         dstream = new ZSTD_DStream*[threads];
@@ -493,9 +541,18 @@ template <typename T> void DBReader<T>::close(){
         delete [] compressedBuffers;
         delete [] compressedBufferSizes;
         delete [] dstream;
+        compressedBuffers = NULL;
     }
+    freeBlockCompression();
 
-    if(externalData == false) {
+    if (indexMapping != NULL) {
+        if (munmap(indexMapping, indexMappingSize) < 0) {
+            Debug(Debug::ERROR) << "Failed to munmap index file " << indexFileName << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        indexMapping = NULL;
+        indexMappingSize = 0;
+    } else if (externalData == false) {
         delete[] index;
         decrementMemory(size*sizeof(Index));
     }
@@ -510,6 +567,9 @@ template <typename T> size_t DBReader<T>::bsearch(const Index * index, size_t N,
 }
 
 template <typename T> char* DBReader<T>::getDataCompressed(size_t id, int thrIdx) {
+    if (blockCompressed) {
+        return getDataFromBlock(getOffset(id), thrIdx);
+    }
     char *data = getDataUncompressed(id);
 
     unsigned int cSize = *(reinterpret_cast<unsigned int *>(data));
@@ -538,6 +598,173 @@ template <typename T> char* DBReader<T>::getDataCompressed(size_t id, int thrIdx
     return compressedBuffers[thrIdx];
 }
 
+template <typename T>
+void DBReader<T>::initBlockCompression() {
+    freeBlockCompression();
+    size_t uncompressedOffset = 0;
+    size_t plainFiles = 0;
+    for (size_t fileIdx = 0; fileIdx < dataFileCnt; fileIdx++) {
+        const char *data = dataFiles[fileIdx];
+        size_t end = dataSizeOffset[fileIdx + 1] - dataSizeOffset[fileIdx];
+        if (end == 0) {
+            continue;
+        }
+        // segments can only be found back to front
+        std::vector<std::pair<size_t, DBBlockCompression::Footer> > segments;
+        DBBlockCompression::Footer footer;
+        size_t segmentEnd;
+        while (end > 0 && DBBlockCompression::readFooter(data, end, footer, segmentEnd)) {
+            end = segmentEnd - footer.compressedSize;
+            segments.emplace_back(end, footer);
+        }
+        if (segments.empty()) {
+            plainFiles++;
+            continue;
+        }
+        if (end != 0) {
+            Debug(Debug::ERROR) << "Data file " << dataFileName << " contains data that is not block compressed\n";
+            EXIT(EXIT_FAILURE);
+        }
+        for (size_t i = segments.size(); i > 0; i--) {
+            const size_t segmentStart = segments[i - 1].first;
+            const DBBlockCompression::Footer &segment = segments[i - 1].second;
+            const char *dict = data + segmentStart + segment.compressedSize - sizeof(DBBlockCompression::Footer) - segment.dictSize;
+            const char *table = dict - segment.blockCount * sizeof(DBBlockCompression::Block);
+            unsigned int dictIdx = UINT_MAX;
+            if (segment.dictSize > 0) {
+                ZSTD_DDict *ddict = ZSTD_createDDict(dict, segment.dictSize);
+                if (ddict == NULL) {
+                    Debug(Debug::ERROR) << "Can not load compression dictionary of " << dataFileName << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                dictIdx = blockDicts.size();
+                blockDicts.push_back(ddict);
+            }
+            for (size_t j = 0; j < segment.blockCount; j++) {
+                DBBlockCompression::Block block;
+                memcpy(&block, table + j * sizeof(DBBlockCompression::Block), sizeof(DBBlockCompression::Block));
+                CompressedBlock entry;
+                entry.offset = uncompressedOffset + block.uncompressedOffset;
+                entry.fileOffset = segmentStart + block.compressedOffset;
+                entry.fileIdx = fileIdx;
+                entry.dictIdx = dictIdx;
+                entry.compressedSize = block.compressedSize;
+                entry.uncompressedSize = block.uncompressedSize;
+                blocks.push_back(entry);
+            }
+            uncompressedOffset += segment.uncompressedSize;
+        }
+    }
+    if (blocks.empty() && blockDicts.empty()) {
+        // per entry compressed database
+        return;
+    }
+    if (plainFiles > 0) {
+        Debug(Debug::ERROR) << "Database " << dataFileName << " mixes block compressed and other data files\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    blockCompressed = true;
+    blockCaches = new BlockCache[threads];
+    for (int i = 0; i < threads; i++) {
+        blockCaches[i].dctx = ZSTD_createDCtx();
+        if (blockCaches[i].dctx == NULL) {
+            Debug(Debug::ERROR) << "ZSTD_createDCtx() error\n";
+            EXIT(EXIT_FAILURE);
+        }
+        blockCaches[i].clock = 0;
+        for (size_t slot = 0; slot < BLOCK_CACHE_SLOTS; slot++) {
+            blockCaches[i].block[slot] = SIZE_MAX;
+            blockCaches[i].lastUse[slot] = 0;
+            blockCaches[i].buffer[slot] = NULL;
+            blockCaches[i].capacity[slot] = 0;
+        }
+    }
+}
+
+template <typename T>
+void DBReader<T>::freeBlockCompression() {
+    if (blockCaches != NULL) {
+        for (int i = 0; i < threads; i++) {
+            ZSTD_freeDCtx(blockCaches[i].dctx);
+            for (size_t slot = 0; slot < BLOCK_CACHE_SLOTS; slot++) {
+                free(blockCaches[i].buffer[slot]);
+                decrementMemory(blockCaches[i].capacity[slot]);
+            }
+        }
+        delete[] blockCaches;
+        blockCaches = NULL;
+    }
+    for (size_t i = 0; i < blockDicts.size(); i++) {
+        ZSTD_freeDDict(blockDicts[i]);
+    }
+    blockDicts.clear();
+    blocks.clear();
+    blockCompressed = false;
+}
+
+template <typename T>
+char* DBReader<T>::getDataFromBlock(size_t offset, int thrIdx) {
+    BlockCache &cache = blockCaches[thrIdx];
+    cache.clock++;
+    // sequential reads mostly hit one of the cached blocks
+    for (size_t slot = 0; slot < BLOCK_CACHE_SLOTS; slot++) {
+        if (cache.block[slot] == SIZE_MAX) {
+            continue;
+        }
+        const CompressedBlock &block = blocks[cache.block[slot]];
+        if (offset >= block.offset && offset < block.offset + block.uncompressedSize) {
+            cache.lastUse[slot] = cache.clock;
+            return cache.buffer[slot] + (offset - block.offset);
+        }
+    }
+
+    CompressedBlock val;
+    val.offset = offset;
+    size_t blockIdx = std::upper_bound(blocks.begin(), blocks.end(), val, CompressedBlock::compareByOffset) - blocks.begin();
+    if (blockIdx == 0 || offset >= blocks[blockIdx - 1].offset + blocks[blockIdx - 1].uncompressedSize) {
+        Debug(Debug::ERROR) << "Invalid database read for database data file=" << dataFileName << ", database index=" << indexFileName << "\n";
+        Debug(Debug::ERROR) << "Requested offset " << offset << " is not part of any compressed block\n";
+        EXIT(EXIT_FAILURE);
+    }
+    blockIdx--;
+    const CompressedBlock &block = blocks[blockIdx];
+
+    size_t slot = 0;
+    for (size_t i = 1; i < BLOCK_CACHE_SLOTS; i++) {
+        if (cache.lastUse[i] < cache.lastUse[slot]) {
+            slot = i;
+        }
+    }
+    // keep space for a terminating null byte
+    if (cache.capacity[slot] < block.uncompressedSize + 1) {
+        decrementMemory(cache.capacity[slot]);
+        cache.capacity[slot] = block.uncompressedSize + 1;
+        cache.buffer[slot] = (char*) realloc(cache.buffer[slot], cache.capacity[slot]);
+        Util::checkAllocation(cache.buffer[slot], "Can not allocate block decompression buffer");
+        incrementMemory(cache.capacity[slot]);
+    }
+    const char *src = dataFiles[block.fileIdx] + block.fileOffset;
+    size_t result;
+    if (block.dictIdx != UINT_MAX) {
+        result = ZSTD_decompress_usingDDict(cache.dctx, cache.buffer[slot], cache.capacity[slot], src, block.compressedSize, blockDicts[block.dictIdx]);
+    } else {
+        result = ZSTD_decompressDCtx(cache.dctx, cache.buffer[slot], cache.capacity[slot], src, block.compressedSize);
+    }
+    if (ZSTD_isError(result) || result != block.uncompressedSize) {
+        Debug(Debug::ERROR) << "Can not decompress block " << blockIdx << " of " << dataFileName;
+        if (ZSTD_isError(result)) {
+            Debug(Debug::ERROR) << ". Error " << ZSTD_getErrorName(result);
+        }
+        Debug(Debug::ERROR) << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    cache.buffer[slot][block.uncompressedSize] = '\0';
+    cache.block[slot] = blockIdx;
+    cache.lastUse[slot] = cache.clock;
+    return cache.buffer[slot] + (offset - block.offset);
+}
+
 template <typename T> size_t DBReader<T>::getAminoAcidDBSize() {
     checkClosed();
     if (Parameters::isEqualDbtype(dbtype, Parameters::DBTYPE_HMM_PROFILE) || Parameters::isEqualDbtype(dbtype, Parameters::DBTYPE_PROFILE_STATE_PROFILE)) {
@@ -594,6 +821,16 @@ template <typename T> char* DBReader<T>::getDataByOffset(size_t offset) {
 
 template <typename T>
 void DBReader<T>::touchData(size_t id) {
+    if (blockCompressed && (dataMode & USE_FREAD) == 0) {
+        CompressedBlock val;
+        val.offset = getOffset(id);
+        size_t blockIdx = std::upper_bound(blocks.begin(), blocks.end(), val, CompressedBlock::compareByOffset) - blocks.begin();
+        if (blockIdx > 0) {
+            const CompressedBlock &block = blocks[blockIdx - 1];
+            magicBytes = Util::touchMemory(dataFiles[block.fileIdx] + block.fileOffset, block.compressedSize);
+        }
+        return;
+    }
     if((dataMode & USE_DATA) && (dataMode & USE_FREAD) == 0) {
         char *data = getDataUncompressed(id);
         size_t currDataOffset = getOffset(id);
@@ -834,6 +1071,88 @@ bool DBReader<T>::readIndex(char *data, size_t indexDataSize, Index *index, size
     return isSortedById;
 }
 
+static char* mapBinaryIndex(const char *indexFileName, size_t *mappingSize, DBIndexHeader &header) {
+    FILE *file = fopen(indexFileName, "r");
+    if (file == NULL) {
+        Debug(Debug::ERROR) << "Can not open index file " << indexFileName << "!\n";
+        EXIT(EXIT_FAILURE);
+    }
+    struct stat sb;
+    if (fstat(fileno(file), &sb) < 0) {
+        Debug(Debug::ERROR) << "Failed to fstat index file " << indexFileName << ". Error " << errno << ".\n";
+        EXIT(EXIT_FAILURE);
+    }
+    *mappingSize = sb.st_size;
+    // private writable mapping, pages stay shared in the page cache until someone modifies the index
+    char *mapping = static_cast<char*>(mmap(NULL, *mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(file), 0));
+    if (mapping == MAP_FAILED) {
+        Debug(Debug::ERROR) << "Failed to mmap index file " << indexFileName << ". Error " << errno << ".\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << indexFileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    memcpy(&header, mapping, sizeof(DBIndexHeader));
+    if (header.version != DBIndexHeader::VERSION || header.recordSize != sizeof(DBReader<unsigned int>::Index)
+        || sizeof(DBIndexHeader) + header.entries * header.recordSize > *mappingSize) {
+        Debug(Debug::ERROR) << "Binary index file " << indexFileName << " is corrupt or was written by an incompatible version\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return mapping;
+}
+
+template<>
+bool DBReader<unsigned int>::readBinaryIndex(const char *indexFileName) {
+    DBIndexHeader header;
+    size_t mappingSize;
+    char *mapping = mapBinaryIndex(indexFileName, &mappingSize, header);
+    size = header.entries;
+    dataSize = header.dataSize;
+    maxSeqLen = header.maxSeqLen;
+    lastKey = header.lastKey;
+    bool isSortedById = (header.flags & DBIndexHeader::FLAG_SORTED_BY_ID) != 0;
+    Index *records = reinterpret_cast<Index*>(mapping + sizeof(DBIndexHeader));
+    // use the mapping directly unless the index has to be reordered in place
+    if (isSortedById && accessType != SORT_BY_OFFSET) {
+        index = records;
+        indexMapping = mapping;
+        indexMappingSize = mappingSize;
+        return true;
+    }
+
+    index = new(std::nothrow) Index[size];
+    incrementMemory(sizeof(Index) * size);
+    Util::checkAllocation(index, "Can not allocate index memory in DBReader");
+    memcpy(index, records, sizeof(Index) * size);
+    munmap(mapping, mappingSize);
+    return isSortedById;
+}
+
+template<>
+bool DBReader<std::string>::readBinaryIndex(const char *indexFileName) {
+    DBIndexHeader header;
+    size_t mappingSize;
+    char *mapping = mapBinaryIndex(indexFileName, &mappingSize, header);
+    size = header.entries;
+    dataSize = header.dataSize;
+    maxSeqLen = header.maxSeqLen;
+    lastKey = SSTR(header.lastKey);
+
+    index = new(std::nothrow) Index[size];
+    incrementMemory(sizeof(Index) * size);
+    Util::checkAllocation(index, "Can not allocate index memory in DBReader");
+    DBReader<unsigned int>::Index *records = reinterpret_cast<DBReader<unsigned int>::Index*>(mapping + sizeof(DBIndexHeader));
+    for (size_t i = 0; i < size; ++i) {
+        index[i].id = SSTR(records[i].id);
+        index[i].offset = records[i].offset;
+        index[i].length = records[i].length;
+    }
+    munmap(mapping, mappingSize);
+    // numeric order is not lexicographic order
+    return false;
+}
+
 template<typename T> T DBReader<T>::getLastKey() {
     return lastKey;
 }
@@ -950,6 +1269,9 @@ void DBReader<T>::setData(char *data, size_t dataSize) {
         totalDataSize = dataSize;
         dataFileCnt = 1;
         dataFiles[0] = data;
+        if (compression == COMPRESSED) {
+            initBlockCompression();
+        }
     }else{
         Debug(Debug::ERROR) << "DataFiles is already set." << "\n";
         EXIT(EXIT_FAILURE);
@@ -1129,6 +1451,8 @@ void DBReader<T>::softlinkDb(const std::string &databaseName, const std::string
         { DBFiles::TAX_NAMES,     "_names.dmp"        },
         { DBFiles::TAX_NODES,     "_nodes.dmp"        },
         { DBFiles::TAX_MERGED,    "_merged.dmp"       },
+        { DBFiles::TAX_BINARY,    "_taxonomy"         },
+        { DBFiles::TAX_MAPPING_BIN, "_mapping.bin"    },
         { DBFiles::CA3M_DATA,     "_ca3m.ffdata"      },
         { DBFiles::CA3M_INDEX,    "_ca3m.ffindex"     },
         { DBFiles::CA3M_SEQ,      "_sequence.ffdata"  },
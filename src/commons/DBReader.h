@@ -10,6 +10,7 @@
 #include <utility>
 #include <vector>
 #include <string>
+#include <cstring>
 #include "Sequence.h"
 #include "Parameters.h"
 #include "FileUtil.h"
@@ -38,11 +39,13 @@ struct DBFiles {
         CA3M_SEQ_IDX      = (1ull << 15),
         CA3M_HDR          = (1ull << 16),
         CA3M_HDR_IDX      = (1ull << 17),
+        TAX_BINARY        = (1ull << 18),
+        TAX_MAPPING_BIN   = (1ull << 19),
 
 
         GENERIC           = DATA | DATA_INDEX | DATA_DBTYPE,
         HEADERS           = HEADER | HEADER_INDEX | HEADER_DBTYPE,
-        TAXONOMY          = TAX_MAPPING | TAX_NAMES | TAX_NODES | TAX_MERGED,
+        TAXONOMY          = TAX_MAPPING | TAX_NAMES | TAX_NODES | TAX_MERGED | TAX_BINARY | TAX_MAPPING_BIN,
         SEQUENCE_DB       = GENERIC | HEADERS | TAXONOMY | LOOKUP | SOURCE,
         SEQUENCE_ANCILLARY= SEQUENCE_DB & (~GENERIC),
         SEQUENCE_NO_DATA_INDEX = SEQUENCE_DB & (~DATA_INDEX),
@@ -51,6 +54,67 @@ struct DBFiles {
     };
 };
 
+// Header of the binary .index format. It is followed by fixed-width
+// DBReader<unsigned int>::Index records that are mmapped without parsing.
+struct DBIndexHeader {
+    static const char MAGIC[8];
+    static const unsigned int VERSION = 1;
+    static const unsigned int FLAG_SORTED_BY_ID = 1;
+
+    char magic[8];
+    unsigned int version;
+    unsigned int flags;
+    unsigned int recordSize;
+    unsigned int maxSeqLen;
+    unsigned int lastKey;
+    unsigned int reserved;
+    size_t entries;
+    size_t dataSize;
+
+    static bool isBinaryIndex(const char* data, size_t dataSize) {
+        return dataSize >= sizeof(DBIndexHeader) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+    }
+};
+
+// Layout of block compressed data files. The uncompressed data is cut at entry
+// boundaries into independent zstd frames, followed by a zstd skippable frame
+// containing the seek table, the optional dictionary and a footer:
+// [frame]...[frame][skippable header][Block]...[Block][dictionary][Footer]
+// Index offsets keep pointing into the uncompressed data. Concatenated files
+// stay readable since each footer knows the size of its own segment.
+struct DBBlockCompression {
+    static const char MAGIC[8];
+    static const unsigned int VERSION = 1;
+    static const unsigned int SKIPPABLE_MAGIC = 0x184D2A5E;
+    static const size_t BLOCK_SIZE = 64 * 1024;
+    static const size_t MAX_DICT_SIZE = 112640;
+    static const int COMPRESSION_LEVEL = 3;
+
+    struct Block {
+        size_t compressedOffset;
+        size_t uncompressedOffset;
+        unsigned int compressedSize;
+        unsigned int uncompressedSize;
+    };
+
+    struct Footer {
+        size_t blockCount;
+        size_t dictSize;
+        // size of the whole segment, including frames, seek table and footer
+        size_t compressedSize;
+        size_t uncompressedSize;
+        unsigned int version;
+        unsigned int reserved;
+        char magic[8];
+    };
+
+    // data may be followed by null byte padding (e.g. when embedded in a precomputed index)
+    static bool readFooter(const char* data, size_t dataSize, Footer& footer, size_t& segmentEnd);
+
+    // returns the uncompressed size of all segments in a data file or SIZE_MAX if it is not block compressed
+    static size_t uncompressedSize(const char* data, size_t dataSize);
+};
+
 template <typename T>
 class DBReader : public MemoryTracker {
 public:
@@ -283,6 +347,8 @@ public:
 
     bool readIndex(char *data, size_t indexDataSize, Index *index, size_t & dataSize);
 
+    bool readBinaryIndex(const char *indexFileName);
+
     void readLookup(char *data, size_t dataSize, LookupEntry *lookup);
 
     void readIndexId(T* id, char * line, const char** cols);
@@ -402,6 +468,36 @@ public:
 private:
     void checkClosed() const;
 
+    // builds the block table if the data files are block compressed
+    void initBlockCompression();
+    void freeBlockCompression();
+    char* getDataFromBlock(size_t offset, int thrIdx);
+
+    struct CompressedBlock {
+        // offset of the first uncompressed byte
+        size_t offset;
+        size_t fileOffset;
+        unsigned int fileIdx;
+        unsigned int dictIdx;
+        unsigned int compressedSize;
+        unsigned int uncompressedSize;
+
+        static bool compareByOffset(const CompressedBlock &x, const CompressedBlock &y) {
+            return x.offset < y.offset;
+        }
+    };
+
+    // each thread keeps the most recently decompressed blocks
+    static const size_t BLOCK_CACHE_SLOTS = 4;
+    struct BlockCache {
+        ZSTD_DCtx* dctx;
+        size_t clock;
+        size_t block[BLOCK_CACHE_SLOTS];
+        size_t lastUse[BLOCK_CACHE_SLOTS];
+        char* buffer[BLOCK_CACHE_SLOTS];
+        size_t capacity[BLOCK_CACHE_SLOTS];
+    };
+
     int threads;
 
     int dataMode;
@@ -434,8 +530,15 @@ private:
     char ** compressedBuffers;
     size_t * compressedBufferSizes;
     ZSTD_DStream ** dstream;
+    bool blockCompressed;
+    std::vector<CompressedBlock> blocks;
+    std::vector<ZSTD_DDict*> blockDicts;
+    BlockCache * blockCaches;
 
     Index * index;
+    // set if index points into an mmapped binary index file
+    char * indexMapping;
+    size_t indexMappingSize;
     size_t lookupSize;
     LookupEntry * lookup;
     bool sortedByOffset;
@@ -13,6 +13,8 @@
 #include <sstream>
 #include <unistd.h>
 
+#include "dictBuilder/zdict.h"
+
 #ifdef OPENMP
 #include <omp.h>
 #endif
@@ -29,48 +31,15 @@ DBWriter::DBWriter(const char *dataFileName_, const char *indexFileName_, unsign
 
     indexFiles = new FILE *[threads];
     indexFileNames = new char *[threads];
-    compressedBuffers=NULL;
-    compressedBufferSizes=NULL;
-    if((mode & Parameters::WRITER_COMPRESSED_MODE) != 0){
-        compressedBuffers = new char*[threads];
-        compressedBufferSizes = new size_t[threads];
-        cstream = new ZSTD_CStream*[threads];
-        state = new int[threads];
-        threadBuffer = new char*[threads];
-        threadBufferSize = new size_t[threads];
-        threadBufferOffset = new size_t[threads];
-    }
 
     starts = new size_t[threads];
     std::fill(starts, starts + threads, 0);
     offsets = new size_t[threads];
     std::fill(offsets, offsets + threads, 0);
-    if((mode & Parameters::WRITER_COMPRESSED_MODE) != 0 ){
-        datafileMode = "wb+";
-    } else {
-        datafileMode = "wb";
-    }
 
     closed = true;
 }
 
-size_t DBWriter::addToThreadBuffer(const void *data, size_t itmesize, size_t nitems, int threadIdx) {
-    size_t bytesToWrite = (itmesize*nitems);
-    size_t bytesLeftInBuffer = threadBufferSize[threadIdx] - threadBufferOffset[threadIdx];
-    if( (itmesize*nitems)  >= bytesLeftInBuffer ){
-        size_t newBufferSize = std::max(threadBufferSize[threadIdx] + bytesToWrite, threadBufferSize[threadIdx] * 2 );
-        threadBufferSize[threadIdx] = newBufferSize;
-        threadBuffer[threadIdx] = (char*) realloc(threadBuffer[threadIdx], newBufferSize);
-        if(compressedBuffers[threadIdx] == NULL){
-            Debug(Debug::ERROR) << "Realloc of buffer for " << threadIdx << " failed. Buffer size = " << threadBufferSize[threadIdx] << "\n";
-            EXIT(EXIT_FAILURE);
-        }
-    }
-    memcpy(threadBuffer[threadIdx] + threadBufferOffset[threadIdx], data, bytesToWrite);
-    threadBufferOffset[threadIdx] += bytesToWrite;
-    return bytesToWrite;
-}
-
 DBWriter::~DBWriter() {
     delete[] offsets;
     delete[] starts;
@@ -81,15 +50,6 @@ DBWriter::~DBWriter() {
     delete[] dataFiles;
     free(indexFileName);
     free(dataFileName);
-    if(compressedBuffers){
-        delete [] threadBuffer;
-        delete [] threadBufferSize;
-        delete [] threadBufferOffset;
-        delete [] compressedBuffers;
-        delete [] compressedBufferSizes;
-        delete [] cstream;
-        delete [] state;
-    }
 }
 
 void DBWriter::sortDatafileByIdOrder(DBReader<unsigned int> &dbr) {
@@ -175,7 +135,7 @@ void DBWriter::open(size_t bufferSize) {
         dataFileNames[i] = makeResultFilename(dataFileName, i);
         indexFileNames[i] = makeResultFilename(indexFileName, i);
 
-        dataFiles[i] = FileUtil::openAndDelete(dataFileNames[i], datafileMode.c_str());
+        dataFiles[i] = FileUtil::openAndDelete(dataFileNames[i], "wb");
         int fd = fileno(dataFiles[i]);
         int flags;
         if ((flags = fcntl(fd, F_GETFL, 0)) < 0 || fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
@@ -213,17 +173,6 @@ void DBWriter::open(size_t bufferSize) {
             perror(indexFileNames[i]);
             EXIT(EXIT_FAILURE);
         }
-
-        if((mode & Parameters::WRITER_COMPRESSED_MODE) != 0){
-            compressedBufferSizes[i] = 2097152;
-            threadBufferSize[i] = 2097152;
-            state[i] = false;
-            compressedBuffers[i] = (char*) malloc(compressedBufferSizes[i]);
-            incrementMemory(compressedBufferSizes[i]);
-            threadBuffer[i] = (char*) malloc(threadBufferSize[i]);
-            incrementMemory(threadBufferSize[i]);
-            cstream[i] = ZSTD_createCStream();
-        }
     }
 
     closed = false;
@@ -262,18 +211,15 @@ void DBWriter::close(bool merge, bool needsSort) {
         }
     }
 
-    if(compressedBuffers){
+    // entries are written uncompressed and compressed in blocks once all are known
+    if ((mode & Parameters::WRITER_COMPRESSED_MODE) != 0) {
         for (unsigned int i = 0; i < threads; i++) {
-            free(compressedBuffers[i]);
-            decrementMemory(compressedBufferSizes[i]);
-            free(threadBuffer[i]);
-            decrementMemory(threadBufferSize[i]);
-            ZSTD_freeCStream(cstream[i]);
+            compressDataFile(dataFileNames[i], indexFileNames[i], threads);
         }
     }
 
     mergeResults(dataFileName, indexFileName, (const char **) dataFileNames, (const char **) indexFileNames,
-                 threads, merge, ((mode & Parameters::WRITER_LEXICOGRAPHIC_MODE) != 0), needsSort);
+                 threads, merge, ((mode & Parameters::WRITER_LEXICOGRAPHIC_MODE) != 0), needsSort, useBinaryIndex(mode));
 
     writeDbtypeFile(dataFileName, dbtype, (mode & Parameters::WRITER_COMPRESSED_MODE) != 0);
 
@@ -293,17 +239,6 @@ void DBWriter::writeStart(unsigned int thrIdx) {
         EXIT(EXIT_FAILURE);
     }
     starts[thrIdx] = offsets[thrIdx];
-    if((mode & Parameters::WRITER_COMPRESSED_MODE) != 0){
-        state[thrIdx] = INIT_STATE;
-        threadBufferOffset[thrIdx]=0;
-        int cLevel = 3;
-        size_t const initResult = ZSTD_initCStream(cstream[thrIdx], cLevel);
-        if (ZSTD_isError(initResult)) {
-            Debug(Debug::ERROR) << "ZSTD_initCStream() error in thread " << thrIdx << ". Error "
-                                << ZSTD_getErrorName(initResult) << "\n";
-            EXIT(EXIT_FAILURE);
-        }
-    }
 }
 
 size_t DBWriter::writeAdd(const char* data, size_t dataSize, unsigned int thrIdx) {
@@ -312,114 +247,29 @@ size_t DBWriter::writeAdd(const char* data, size_t dataSize, unsigned int thrIdx
         Debug(Debug::ERROR) << "Thread index " << thrIdx << " > maximum thread number " << threads << "\n";
         EXIT(EXIT_FAILURE);
     }
-    bool isCompressedDB = (mode & Parameters::WRITER_COMPRESSED_MODE) != 0;
-    if(isCompressedDB && state[thrIdx] == INIT_STATE && dataSize < 60){
-        state[thrIdx] = NOTCOMPRESSED;
-    }
-    size_t totalWriten = 0;
-    if(isCompressedDB && (state[thrIdx] == INIT_STATE || state[thrIdx] == COMPRESSED) ) {
-        state[thrIdx] = COMPRESSED;
-        // zstd seems to have a hard time with elements < 60
-        ZSTD_inBuffer input = { data, dataSize, 0 };
-        while (input.pos < input.size) {
-            ZSTD_outBuffer output = {compressedBuffers[thrIdx], compressedBufferSizes[thrIdx], 0};
-            size_t toRead = ZSTD_compressStream( cstream[thrIdx], &output, &input);   /* toRead is guaranteed to be <= ZSTD_CStreamInSize() */
-            if (ZSTD_isError(toRead)) {
-                Debug(Debug::ERROR) << "ZSTD_compressStream() error in thread " << thrIdx << ". Error "
-                                    << ZSTD_getErrorName(toRead) << "\n";
-                EXIT(EXIT_FAILURE);
-            }
-            size_t written = addToThreadBuffer(compressedBuffers[thrIdx], sizeof(char), output.pos, thrIdx);
-            if (written != output.pos) {
-                Debug(Debug::ERROR) << "Can not write to data file " << dataFileNames[thrIdx] << "\n";
-                EXIT(EXIT_FAILURE);
-            }
-            offsets[thrIdx] += written;
-            totalWriten += written;
-        }
-    }else{
-        size_t written;
-        if(isCompressedDB){
-            written = addToThreadBuffer(data, sizeof(char), dataSize,  thrIdx);
-        }else{
-            written = fwrite(data, sizeof(char), dataSize, dataFiles[thrIdx]);
-        }
-        if (written != dataSize) {
-            Debug(Debug::ERROR) << "Can not write to data file " << dataFileNames[thrIdx] << "\n";
-            EXIT(EXIT_FAILURE);
-        }
-        offsets[thrIdx] += written;
+    size_t written = fwrite(data, sizeof(char), dataSize, dataFiles[thrIdx]);
+    if (written != dataSize) {
+        Debug(Debug::ERROR) << "Can not write to data file " << dataFileNames[thrIdx] << "\n";
+        EXIT(EXIT_FAILURE);
     }
-
-    return totalWriten;
+    offsets[thrIdx] += written;
+    return written;
 }
 
 void DBWriter::writeEnd(unsigned int key, unsigned int thrIdx, bool addNullByte, bool addIndexEntry) {
-    // close stream
-    bool isCompressedDB = (mode & Parameters::WRITER_COMPRESSED_MODE) != 0;
-    if(isCompressedDB) {
-        size_t compressedLength = 0;
-        if(state[thrIdx] == COMPRESSED) {
-            ZSTD_outBuffer output = {compressedBuffers[thrIdx], compressedBufferSizes[thrIdx], 0};
-            size_t remainingToFlush = ZSTD_endStream(cstream[thrIdx], &output); /* close frame */
-
-            //        std::cout << compressedLength << std::endl;
-            if (ZSTD_isError(remainingToFlush)) {
-                Debug(Debug::ERROR) << "ZSTD_endStream() error in thread " << thrIdx << ". Error "
-                                    << ZSTD_getErrorName(remainingToFlush) << "\n";
-                EXIT(EXIT_FAILURE);
-            }
-            if (remainingToFlush) {
-                Debug(Debug::ERROR) << "Stream not flushed\n";
-                EXIT(EXIT_FAILURE);
-            }
-            size_t written = addToThreadBuffer(compressedBuffers[thrIdx], sizeof(char), output.pos, thrIdx);
-            compressedLength = threadBufferOffset[thrIdx];
-            offsets[thrIdx] += written;
-            if (written != output.pos) {
-                Debug(Debug::ERROR) << "Can not write to data file " << dataFileNames[thrIdx] << "\n";
-                EXIT(EXIT_FAILURE);
-            }
-        }else {
-            compressedLength = offsets[thrIdx] - starts[thrIdx];
-        }
-        unsigned int compressedLengthInt = static_cast<unsigned int>(compressedLength);
-        size_t written2 = fwrite(&compressedLengthInt, sizeof(unsigned int), 1, dataFiles[thrIdx]);
-        if (written2 != 1) {
-            Debug(Debug::ERROR) << "Can not write entry length to data file " << dataFileNames[thrIdx] << "\n";
-            EXIT(EXIT_FAILURE);
-        }
-        offsets[thrIdx] +=  sizeof(unsigned int);
-        writeThreadBuffer(thrIdx, compressedLength);
-    }
-
-
-    size_t totalWritten = 0;
-// entries are always separated by a null byte
+    // entries are always separated by a null byte
     if (addNullByte == true) {
         char nullByte = '\0';
-        if(isCompressedDB && state[thrIdx]==NOTCOMPRESSED){
-            nullByte = static_cast<char>(0xFF);
-        }
         const size_t written = fwrite(&nullByte, sizeof(char), 1, dataFiles[thrIdx]);
         if (written != 1) {
             Debug(Debug::ERROR) << "Can not write to data file " << dataFileNames[thrIdx] << "\n";
             EXIT(EXIT_FAILURE);
         }
-        totalWritten += written;
         offsets[thrIdx] += 1;
     }
 
     if (addIndexEntry == true) {
         size_t length = offsets[thrIdx] - starts[thrIdx];
-// keep original size in index
-        if (isCompressedDB && state[thrIdx]==COMPRESSED) {
-            ZSTD_frameProgression progression = ZSTD_getFrameProgression(cstream[thrIdx]);
-            length = progression.consumed + totalWritten;
-        }
-        if (isCompressedDB && state[thrIdx]==NOTCOMPRESSED) {
-            length -= sizeof(unsigned int);
-        }
         writeIndexEntry(key, starts[thrIdx], length, thrIdx);
     }
 }
@@ -485,7 +335,8 @@ void DBWriter::mergeResults(const std::string &outFileName, const std::string &o
         datafilesNames[i] = files[i].first.c_str();
         indexFilesNames[i] = files[i].second.c_str();
     }
-    mergeResults(outFileName.c_str(), outFileNameIndex.c_str(), datafilesNames, indexFilesNames, files.size(), true, lexicographicOrder);
+    mergeResults(outFileName.c_str(), outFileNameIndex.c_str(), datafilesNames, indexFilesNames, files.size(), true,
+                 lexicographicOrder, true, useBinaryIndex(Parameters::WRITER_ASCII_MODE));
     delete[] datafilesNames;
     delete[] indexFilesNames;
 
@@ -557,7 +408,7 @@ void DBWriter::writeIndex(FILE *outFile, size_t indexSize, DBReader<std::string>
 void DBWriter::mergeResults(const char *outFileName, const char *outFileNameIndex,
                             const char **dataFileNames, const char **indexFileNames,
                             unsigned long fileCount, bool mergeDatafiles,
-                            bool lexicographicOrder, bool indexNeedsToBeSorted) {
+                            bool lexicographicOrder, bool indexNeedsToBeSorted, bool binaryIndex) {
     Timer timer;
     std::vector<std::vector<std::string>> dataFilenames;
     for (unsigned int i = 0; i < fileCount; ++i) {
@@ -584,7 +435,17 @@ void DBWriter::mergeResults(const char *outFileName, const char *outFileNameInde
                     EXIT(EXIT_FAILURE);
                 }
                 datafiles.emplace_back(fh);
-                cumulativeSize += sb.st_size;
+                // index offsets of block compressed files refer to the uncompressed data
+                size_t fileSize = sb.st_size;
+                if (fileSize > 0) {
+                    char *data = static_cast<char*>(FileUtil::mmapFile(fh, &fileSize));
+                    size_t uncompressedSize = DBBlockCompression::uncompressedSize(data, fileSize);
+                    FileUtil::munmapData(data, fileSize);
+                    if (uncompressedSize != SIZE_MAX) {
+                        fileSize = uncompressedSize;
+                    }
+                }
+                cumulativeSize += fileSize;
             }
             mergedSizes.push_back(cumulativeSize);
         }
@@ -627,7 +488,10 @@ void DBWriter::mergeResults(const char *outFileName, const char *outFileNameInde
         }
     }
     if (indexNeedsToBeSorted) {
-        DBWriter::sortIndex(indexFileNames[0], outFileNameIndex, lexicographicOrder);
+        DBWriter::sortIndex(indexFileNames[0], outFileNameIndex, lexicographicOrder, binaryIndex);
+        FileUtil::remove(indexFileNames[0]);
+    } else if (binaryIndex && lexicographicOrder == false) {
+        convertIndexFormat(indexFileNames[0], outFileNameIndex, Parameters::INDEX_FORMAT_BINARY);
         FileUtil::remove(indexFileNames[0]);
     } else {
         FileUtil::move(indexFileNames[0], outFileNameIndex);
@@ -664,17 +528,22 @@ void DBWriter::mergeIndex(const char** indexFilenames, unsigned int fileCount, c
     }
 }
 
-void DBWriter::sortIndex(const char *inFileNameIndex, const char *outFileNameIndex, const bool lexicographicOrder){
+void DBWriter::sortIndex(const char *inFileNameIndex, const char *outFileNameIndex, const bool lexicographicOrder, const bool binaryIndex){
     if (lexicographicOrder == false) {
         // sort the index
         DBReader<unsigned int> indexReader(inFileNameIndex, inFileNameIndex, 1, DBReader<unsigned int>::USE_INDEX);
         indexReader.open(DBReader<unsigned int>::NOSORT);
         DBReader<unsigned int>::Index *index = indexReader.getIndex();
-        FILE *index_file  = FileUtil::openAndDelete(outFileNameIndex, "w");
-        writeIndex(index_file, indexReader.getSize(), index);
-        if (fclose(index_file) != 0) {
-            Debug(Debug::ERROR) << "Cannot close index file " << outFileNameIndex << "\n";
-            EXIT(EXIT_FAILURE);
+        if (binaryIndex) {
+            writeBinaryIndex(outFileNameIndex, index, indexReader.getSize(), indexReader.getDataSize(),
+                             indexReader.getMaxSeqLen(), indexReader.getLastKey());
+        } else {
+            FILE *index_file  = FileUtil::openAndDelete(outFileNameIndex, "w");
+            writeIndex(index_file, indexReader.getSize(), index);
+            if (fclose(index_file) != 0) {
+                Debug(Debug::ERROR) << "Cannot close index file " << outFileNameIndex << "\n";
+                EXIT(EXIT_FAILURE);
+            }
         }
         indexReader.close();
 
@@ -692,12 +561,247 @@ void DBWriter::sortIndex(const char *inFileNameIndex, const char *outFileNameInd
     }
 }
 
-void DBWriter::writeThreadBuffer(unsigned int idx, size_t dataSize) {
-    size_t written = fwrite(threadBuffer[idx], 1, dataSize, dataFiles[idx]);
-    if (written != dataSize) {
-        Debug(Debug::ERROR) << "writeThreadBuffer: Could not write to data file " << dataFileNames[idx] << "\n";
+bool DBWriter::useBinaryIndex(size_t mode) {
+    if ((mode & Parameters::WRITER_BINARY_INDEX_MODE) != 0) {
+        return true;
+    }
+    const char *formatEnv = getenv("MMSEQS_INDEX_FORMAT");
+    return formatEnv != NULL && Util::fast_atoi<int>(formatEnv) == Parameters::INDEX_FORMAT_BINARY;
+}
+
+void DBWriter::writeBinaryIndex(const char *outFileNameIndex, DBReader<unsigned int>::Index *index, size_t indexSize,
+                                size_t dataSize, unsigned int maxSeqLen, unsigned int lastKey) {
+    DBIndexHeader header;
+    memset(&header, 0, sizeof(DBIndexHeader));
+    memcpy(header.magic, DBIndexHeader::MAGIC, sizeof(DBIndexHeader::MAGIC));
+    header.version = DBIndexHeader::VERSION;
+    header.recordSize = sizeof(DBReader<unsigned int>::Index);
+    header.maxSeqLen = maxSeqLen;
+    header.lastKey = lastKey;
+    header.entries = indexSize;
+    header.dataSize = dataSize;
+    bool isSortedById = true;
+    for (size_t i = 1; i < indexSize && isSortedById; ++i) {
+        isSortedById = index[i - 1].id <= index[i].id;
+    }
+    if (isSortedById) {
+        header.flags |= DBIndexHeader::FLAG_SORTED_BY_ID;
+    }
+
+    // write to a temporary file first, the input index might be mmapped from the output path
+    std::string tmpFileName = std::string(outFileNameIndex) + "_bin_tmp";
+    FILE *outFile = FileUtil::openAndDelete(tmpFileName.c_str(), "wb");
+    if (fwrite(&header, sizeof(DBIndexHeader), 1, outFile) != 1) {
+        Debug(Debug::ERROR) << "Can not write to index file " << outFileNameIndex << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    DBReader<unsigned int>::Index entry;
+    // copy entry by entry to not leak uninitialized padding bytes into the file
+    memset(&entry, 0, sizeof(DBReader<unsigned int>::Index));
+    for (size_t i = 0; i < indexSize; ++i) {
+        entry.id = index[i].id;
+        entry.offset = index[i].offset;
+        entry.length = index[i].length;
+        if (fwrite(&entry, sizeof(DBReader<unsigned int>::Index), 1, outFile) != 1) {
+            Debug(Debug::ERROR) << "Can not write to index file " << outFileNameIndex << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    if (fclose(outFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close index file " << outFileNameIndex << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    std::rename(tmpFileName.c_str(), outFileNameIndex);
+}
+
+void DBWriter::convertIndexFormat(const char *inFileNameIndex, const char *outFileNameIndex, int indexFormat) {
+    // HARDNOSORT keeps the original entry order
+    DBReader<unsigned int> indexReader(inFileNameIndex, inFileNameIndex, 1, DBReader<unsigned int>::USE_INDEX);
+    indexReader.open(DBReader<unsigned int>::HARDNOSORT);
+    DBReader<unsigned int>::Index *index = indexReader.getIndex();
+    if (indexFormat == Parameters::INDEX_FORMAT_BINARY) {
+        writeBinaryIndex(outFileNameIndex, index, indexReader.getSize(), indexReader.getDataSize(),
+                         indexReader.getMaxSeqLen(), indexReader.getLastKey());
+    } else {
+        std::string tmpFileName = std::string(outFileNameIndex) + "_txt_tmp";
+        FILE *outFile = FileUtil::openAndDelete(tmpFileName.c_str(), "w");
+        writeIndex(outFile, indexReader.getSize(), index);
+        if (fclose(outFile) != 0) {
+            Debug(Debug::ERROR) << "Cannot close index file " << outFileNameIndex << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        std::rename(tmpFileName.c_str(), outFileNameIndex);
+    }
+    indexReader.close();
+}
+
+void DBWriter::compressDataFile(const char *dataFileName, const char *indexFileName, unsigned int threads) {
+    FILE *dataFile = FileUtil::openFileOrDie(dataFileName, "r", true);
+    size_t dataSize = FileUtil::getFileSize(dataFileName);
+    if (dataSize == 0) {
+        if (fclose(dataFile) != 0) {
+            Debug(Debug::ERROR) << "Cannot close data file " << dataFileName << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        return;
+    }
+    char *data = static_cast<char*>(FileUtil::mmapFile(dataFile, &dataSize));
+
+    std::vector<std::pair<size_t, size_t>> entries;
+    {
+        DBReader<unsigned int> indexReader(indexFileName, indexFileName, 1, DBReader<unsigned int>::USE_INDEX);
+        indexReader.open(DBReader<unsigned int>::HARDNOSORT);
+        DBReader<unsigned int>::Index *index = indexReader.getIndex();
+        entries.reserve(indexReader.getSize());
+        for (size_t i = 0; i < indexReader.getSize(); ++i) {
+            if (index[i].offset < dataSize) {
+                entries.emplace_back(index[i].offset, std::min(index[i].offset + index[i].length, dataSize));
+            }
+        }
+        indexReader.close();
+    }
+    std::sort(entries.begin(), entries.end());
+
+    // blocks are only cut at entry starts, so that every entry is decompressed in one piece
+    std::vector<DBBlockCompression::Block> blocks;
+    size_t blockStart = 0;
+    size_t maxEnd = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const size_t offset = entries[i].first;
+        if (offset - blockStart >= DBBlockCompression::BLOCK_SIZE && maxEnd <= offset) {
+            DBBlockCompression::Block block;
+            block.uncompressedOffset = blockStart;
+            block.uncompressedSize = static_cast<unsigned int>(offset - blockStart);
+            blocks.push_back(block);
+            blockStart = offset;
+        }
+        maxEnd = std::max(maxEnd, entries[i].second);
+    }
+    DBBlockCompression::Block lastBlock;
+    lastBlock.uncompressedOffset = blockStart;
+    lastBlock.uncompressedSize = static_cast<unsigned int>(dataSize - blockStart);
+    blocks.push_back(lastBlock);
+    // the seek table stores block sizes in 32 bit, a single entry of 4 GiB or more does not fit into a block
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        const size_t blockEnd = (i + 1 < blocks.size()) ? blocks[i + 1].uncompressedOffset : dataSize;
+        if (blockEnd - blocks[i].uncompressedOffset > UINT_MAX) {
+            Debug(Debug::ERROR) << "Block at offset " << blocks[i].uncompressedOffset << " of " << dataFileName << " is too large to compress\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+
+    // train a dictionary on a sample of entries, small blocks compress poorly without one
+    std::string dict;
+    if (blocks.size() > 16) {
+        const size_t maxSampleSize = 16 * 1024;
+        const size_t sampleBudget = 100 * DBBlockCompression::MAX_DICT_SIZE;
+        const size_t stride = std::max(dataSize / sampleBudget, static_cast<size_t>(1));
+        std::string samples;
+        std::vector<size_t> sampleSizes;
+        size_t nextSample = 0;
+        for (size_t i = 0; i < entries.size() && samples.size() < sampleBudget; ++i) {
+            if (entries[i].first < nextSample) {
+                continue;
+            }
+            size_t sampleSize = std::min(entries[i].second - entries[i].first, maxSampleSize);
+            samples.append(data + entries[i].first, sampleSize);
+            sampleSizes.push_back(sampleSize);
+            nextSample = entries[i].first + stride * sampleSize;
+        }
+        dict.resize(DBBlockCompression::MAX_DICT_SIZE);
+        size_t dictSize = ZDICT_trainFromBuffer(&dict[0], dict.size(), samples.data(), sampleSizes.data(), sampleSizes.size());
+        if (ZDICT_isError(dictSize)) {
+            Debug(Debug::INFO) << "Compressing " << FileUtil::baseName(dataFileName) << " without dictionary: " << ZDICT_getErrorName(dictSize) << "\n";
+            dictSize = 0;
+        }
+        dict.resize(dictSize);
+    }
+    ZSTD_CDict *cdict = NULL;
+    if (dict.empty() == false) {
+        cdict = ZSTD_createCDict(dict.data(), dict.size(), DBBlockCompression::COMPRESSION_LEVEL);
+    }
+
+    std::string tmpFileName = std::string(dataFileName) + "_zst_tmp";
+    FILE *outFile = FileUtil::openAndDelete(tmpFileName.c_str(), "wb");
+    size_t compressedOffset = 0;
+    const size_t batchSize = 64 * threads;
+    std::vector<std::string> compressed(std::min(batchSize, blocks.size()));
+    for (size_t batchStart = 0; batchStart < blocks.size(); batchStart += batchSize) {
+        const size_t batchEnd = std::min(batchStart + batchSize, blocks.size());
+#pragma omp parallel num_threads(threads)
+        {
+            ZSTD_CCtx *cctx = ZSTD_createCCtx();
+#pragma omp for schedule(dynamic, 1)
+            for (size_t i = batchStart; i < batchEnd; ++i) {
+                std::string &buffer = compressed[i - batchStart];
+                buffer.resize(ZSTD_compressBound(blocks[i].uncompressedSize));
+                const char *src = data + blocks[i].uncompressedOffset;
+                size_t cSize;
+                if (cdict != NULL) {
+                    cSize = ZSTD_compress_usingCDict(cctx, &buffer[0], buffer.size(), src, blocks[i].uncompressedSize, cdict);
+                } else {
+                    cSize = ZSTD_compressCCtx(cctx, &buffer[0], buffer.size(), src, blocks[i].uncompressedSize, DBBlockCompression::COMPRESSION_LEVEL);
+                }
+                if (ZSTD_isError(cSize)) {
+                    Debug(Debug::ERROR) << "Can not compress block of " << dataFileName << ". Error " << ZSTD_getErrorName(cSize) << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                buffer.resize(cSize);
+            }
+            ZSTD_freeCCtx(cctx);
+        }
+        for (size_t i = batchStart; i < batchEnd; ++i) {
+            const std::string &buffer = compressed[i - batchStart];
+            if (buffer.size() > UINT_MAX) {
+                Debug(Debug::ERROR) << "Compressed block at offset " << blocks[i].uncompressedOffset << " of " << dataFileName << " is too large\n";
+                EXIT(EXIT_FAILURE);
+            }
+            if (fwrite(buffer.data(), sizeof(char), buffer.size(), outFile) != buffer.size()) {
+                Debug(Debug::ERROR) << "Can not write to data file " << tmpFileName << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            blocks[i].compressedOffset = compressedOffset;
+            blocks[i].compressedSize = static_cast<unsigned int>(buffer.size());
+            compressedOffset += buffer.size();
+        }
+    }
+    ZSTD_freeCDict(cdict);
+    FileUtil::munmapData(data, dataSize);
+    if (fclose(dataFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close data file " << dataFileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    // the seek table is hidden in a skippable frame, the file stays a valid sequence of zstd frames
+    DBBlockCompression::Footer footer;
+    memset(&footer, 0, sizeof(DBBlockCompression::Footer));
+    memcpy(footer.magic, DBBlockCompression::MAGIC, sizeof(DBBlockCompression::MAGIC));
+    footer.version = DBBlockCompression::VERSION;
+    footer.blockCount = blocks.size();
+    footer.dictSize = dict.size();
+    footer.uncompressedSize = dataSize;
+    const size_t frameSize = blocks.size() * sizeof(DBBlockCompression::Block) + dict.size() + sizeof(DBBlockCompression::Footer);
+    if (frameSize > UINT_MAX) {
+        Debug(Debug::ERROR) << "Seek table of " << dataFileName << " is too large\n";
         EXIT(EXIT_FAILURE);
     }
+    footer.compressedSize = compressedOffset + 2 * sizeof(unsigned int) + frameSize;
+    unsigned int frameHeader[2] = { DBBlockCompression::SKIPPABLE_MAGIC, static_cast<unsigned int>(frameSize) };
+    bool success = fwrite(frameHeader, sizeof(unsigned int), 2, outFile) == 2;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        success &= fwrite(&blocks[i], sizeof(DBBlockCompression::Block), 1, outFile) == 1;
+    }
+    success &= fwrite(dict.data(), sizeof(char), dict.size(), outFile) == dict.size();
+    success &= fwrite(&footer, sizeof(DBBlockCompression::Footer), 1, outFile) == 1;
+    if (success == false) {
+        Debug(Debug::ERROR) << "Can not write to data file " << tmpFileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(outFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close data file " << tmpFileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    std::rename(tmpFileName.c_str(), dataFileName);
 }
 
 void DBWriter::createRenumberedDB(const std::string& dataFile, const std::string& indexFile, const std::string& origData, const std::string& origIndex, int sortMode) {
@@ -749,6 +853,9 @@ void DBWriter::createRenumberedDB(const std::string& dataFile, const std::string
     }
     reader.close();
     std::rename(indexTmp.c_str(), indexFile.c_str());
+    if (useBinaryIndex(Parameters::WRITER_ASCII_MODE)) {
+        convertIndexFormat(indexFile.c_str(), indexFile.c_str(), Parameters::INDEX_FORMAT_BINARY);
+    }
 
     if (lookupReader != NULL) {
         if (fclose(sLookup) != 0) {
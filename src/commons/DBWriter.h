@@ -63,25 +63,36 @@ public:
     template <typename T>
     static void writeIndexEntryToFile(FILE *outFile, char *buff1, T &index);
 
+    // writes index in the binary .index format
+    static void writeBinaryIndex(const char *outFileNameIndex, DBReader<unsigned int>::Index *index, size_t indexSize,
+                                 size_t dataSize, unsigned int maxSeqLen, unsigned int lastKey);
+
+    // rewrites a text or binary .index file in the requested format
+    static void convertIndexFormat(const char *inFileNameIndex, const char *outFileNameIndex, int indexFormat);
+
+    // binary index output can be requested per writer or globally through MMSEQS_INDEX_FORMAT=1
+    static bool useBinaryIndex(size_t mode);
+
+    // replaces a plain data file with independently decompressible zstd blocks and a seek table
+    static void compressDataFile(const char *dataFileName, const char *indexFileName, unsigned int threads);
+
     static void createRenumberedDB(const std::string& dataFile, const std::string& indexFile, const std::string& origData, const std::string& origIndex, int sortMode = DBReader<unsigned int>::SORT_BY_ID_OFFSET);
 
     bool isClosed(){
         return closed;
     }
 private:
-    size_t addToThreadBuffer(const void *data, size_t itmesize, size_t nitems, int threadIdx);
-    void writeThreadBuffer(unsigned int idx, size_t dataSize);
-
     void checkClosed();
 
     static void mergeResults(const char *outFileName, const char *outFileNameIndex,
                              const char **dataFileNames, const char **indexFileNames,
                              unsigned long fileCount, bool mergeDatafiles,
-                             bool lexicographicOrder = false, bool indexNeedsToBeSorted = true);
+                             bool lexicographicOrder = false, bool indexNeedsToBeSorted = true,
+                             bool binaryIndex = false);
 
     static void mergeIndex(const char** indexFilenames, unsigned int fileCount, const std::vector<size_t> &dataSizes);
 
-    static void sortIndex(const char *inFileNameIndex, const char *outFileNameIndex, const bool lexicographicOrder);
+    static void sortIndex(const char *inFileNameIndex, const char *outFileNameIndex, const bool lexicographicOrder, const bool binaryIndex);
 
     char* dataFileName;
     char* indexFileName;
@@ -93,19 +104,9 @@ private:
 
     char** dataFileNames;
     char** indexFileNames;
-    char** compressedBuffers;
-    size_t * compressedBufferSizes;
-    char** threadBuffer;
-    size_t * threadBufferSize;
-    size_t * threadBufferOffset;
 
     size_t* starts;
     size_t* offsets;
-    int* state;
-    static const int INIT_STATE=0;
-    static const int NOTCOMPRESSED=1;
-    static const int COMPRESSED=2;
-    ZSTD_CStream** cstream;
 
     const unsigned int threads;
     const size_t mode;
@@ -113,9 +114,6 @@ private:
 
     bool closed;
 
-    std::string datafileMode;
-
-
 };
 
 #endif
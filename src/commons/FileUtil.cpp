@@ -274,6 +274,23 @@ size_t FileUtil::getFileSize(const std::string &fileName) {
     return rc == 0 ? stat_buf.st_size : -1;
 }
 
+bool FileUtil::isNewer(const std::string &file, const std::string &reference) {
+    struct stat fileStat;
+    struct stat referenceStat;
+    if (stat(file.c_str(), &fileStat) != 0 || stat(reference.c_str(), &referenceStat) != 0) {
+        return false;
+    }
+#ifdef __APPLE__
+    const struct timespec &fileTime = fileStat.st_mtimespec;
+    const struct timespec &referenceTime = referenceStat.st_mtimespec;
+#else
+    const struct timespec &fileTime = fileStat.st_mtim;
+    const struct timespec &referenceTime = referenceStat.st_mtim;
+#endif
+    return fileTime.tv_sec > referenceTime.tv_sec
+           || (fileTime.tv_sec == referenceTime.tv_sec && fileTime.tv_nsec > referenceTime.tv_nsec);
+}
+
 
 bool FileUtil::symlinkExists(const std::string &path)  {
     struct stat buf;
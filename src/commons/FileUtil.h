@@ -47,6 +47,9 @@ public:
 
     static size_t getFileSize(const std::string &fileName);
 
+    // true if both files exist and file was modified after reference
+    static bool isNewer(const std::string &file, const std::string &reference);
+
     static bool symlinkExists(const std::string &path);
 
     static void copyFile(const char *src, const char *dst);
@@ -2,6 +2,7 @@
 #define KSEQ_BUFFER_READER_H
 
 #include <sys/types.h>
+#include <cstring>
 
 typedef struct kseq_buffer {
     char* buffer;
@@ -25,10 +26,7 @@ inline ssize_t kseq_buffer_reader(kseq_buffer_t *inBuffer, char *outBuffer, size
         return 0;
     }
 
-    for (size_t i = inBuffer->position; i < inBuffer->position + bytes; ++i) {
-        size_t index = i - inBuffer->position;
-        outBuffer[index] = inBuffer->buffer[i];
-    }
+    memcpy(outBuffer, inBuffer->buffer + inBuffer->position, bytes);
 
     inBuffer->position += bytes;
 
@@ -0,0 +1,504 @@
+#include "KSeqChunkReader.h"
+#include "MemoryMapped.h"
+#include "FileUtil.h"
+#include "Util.h"
+#include "Debug.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cctype>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#define ZSTD_STATIC_LINKING_ONLY // ZSTD_findFrameCompressedSize
+#include <zstd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_BZLIB
+#include <bzlib.h>
+#endif
+
+static const size_t NO_RECORD = SIZE_MAX;
+
+// size of the BGZF member at data or 0 if data does not start with a BGZF member
+static size_t bgzfMemberSize(const unsigned char *data, size_t length) {
+    if (length < 18 || data[0] != 31 || data[1] != 139 || data[2] != 8 || (data[3] & 4) == 0) {
+        return 0;
+    }
+    const size_t extraEnd = 12 + (data[10] | (data[11] << 8));
+    size_t pos = 12;
+    while (pos + 4 <= extraEnd && pos + 4 <= length) {
+        const size_t subfieldLength = data[pos + 2] | (data[pos + 3] << 8);
+        if (data[pos] == 'B' && data[pos + 1] == 'C' && subfieldLength == 2 && pos + 6 <= length) {
+            return (data[pos + 4] | (data[pos + 5] << 8)) + 1;
+        }
+        pos += 4 + subfieldLength;
+    }
+    return 0;
+}
+
+bool KSeqChunkReader::isSupported(const char *fileName) {
+    if (strcmp(fileName, "stdin") == 0) {
+        return false;
+    }
+    // pipes and process substitutions cannot be mapped
+    struct stat st;
+    if (stat(fileName, &st) != 0 || S_ISREG(st.st_mode) == false) {
+        return false;
+    }
+#ifndef HAVE_ZLIB
+    if (Util::endsWith(".gz", fileName)) {
+        return false;
+    }
+#endif
+#ifndef HAVE_BZLIB
+    if (Util::endsWith(".bz2", fileName)) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+KSeqChunkReader::KSeqChunkReader(const char *file, size_t chunkSize)
+        : fileName(file), format(FORMAT_PLAIN), chunkSize(std::max(chunkSize, (size_t) 1)), mapped(NULL), input(NULL),
+          inputSize(0), inputPos(0), buffer(NULL), bufferCapacity(0), bufferFill(0), bufferConsumed(0), inputEnd(false),
+          fastq(-1), sequentialRead(false), stream(NULL) {
+    if (FileUtil::fileExists(file) == false) {
+        errno = ENOENT;
+        perror(file);
+        EXIT(EXIT_FAILURE);
+    }
+
+    if (Util::endsWith(".gz", file)) {
+        format = FORMAT_GZIP;
+    } else if (Util::endsWith(".bz2", file)) {
+        format = FORMAT_BZIP;
+    } else if (Util::endsWith(".zst", file)) {
+        format = FORMAT_ZSTD;
+    }
+
+    if (format == FORMAT_PLAIN || format == FORMAT_GZIP || format == FORMAT_ZSTD) {
+        inputSize = FileUtil::getFileSize(file);
+        if (inputSize > 0) {
+            mapped = new MemoryMapped(fileName, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
+            if (mapped->isValid() == false) {
+                Debug(Debug::ERROR) << "Cannot map input file " << fileName << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            input = reinterpret_cast<const char *>(mapped->getData());
+        }
+    }
+
+#ifdef HAVE_ZLIB
+    if (format == FORMAT_GZIP) {
+        if (bgzfMemberSize(reinterpret_cast<const unsigned char *>(input), inputSize) > 0) {
+            format = FORMAT_BGZF;
+        } else {
+            // members of other gzip files can only be found by decompressing them
+            delete mapped;
+            mapped = NULL;
+            input = NULL;
+            gzFile gz = gzopen(file, "r");
+            if (gz == NULL) {
+                perror(file);
+                EXIT(EXIT_FAILURE);
+            }
+            stream = gz;
+        }
+    }
+#endif
+#ifdef HAVE_BZLIB
+    if (format == FORMAT_BZIP) {
+        BZFILE *bz = BZ2_bzopen(file, "rb");
+        if (bz == NULL) {
+            perror(file);
+            EXIT(EXIT_FAILURE);
+        }
+        stream = bz;
+    }
+#endif
+}
+
+KSeqChunkReader::~KSeqChunkReader() {
+#ifdef HAVE_ZLIB
+    if (format == FORMAT_GZIP) {
+        gzclose((gzFile) stream);
+    }
+#endif
+#ifdef HAVE_BZLIB
+    if (format == FORMAT_BZIP) {
+        BZ2_bzclose((BZFILE *) stream);
+    }
+#endif
+    if (format == FORMAT_ZSTD_STREAM) {
+        ZSTD_freeDStream((ZSTD_DStream *) stream);
+    }
+    free(buffer);
+    delete mapped;
+}
+
+void KSeqChunkReader::detectRecordFormat(const char *data, size_t length) {
+    fastq = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (isspace(data[i]) == false) {
+            fastq = (data[i] == '@') ? 1 : 0;
+            if (fastq == 1) {
+                // the quality header of a four line record follows its sequence line
+                const char *line1 = static_cast<const char *>(memchr(data + i, '\n', length - i));
+                const char *line2 = (line1 == NULL) ? NULL : static_cast<const char *>(memchr(line1 + 1, '\n', data + length - line1 - 1));
+                if (line2 != NULL && line2 + 1 < data + length && line2[1] != '+') {
+                    sequentialRead = true;
+                }
+            }
+            return;
+        }
+    }
+}
+
+// first record start at or after from. A FASTA record starts with a '>' line and a FASTQ
+// record with an '@' line two lines before a '+' line, quality lines can also start with '@'
+size_t KSeqChunkReader::findRecordStart(const char *data, size_t length, size_t from) {
+    const char *end = data + length;
+    size_t pos = from;
+    while (pos < length) {
+        if (pos > 0 && data[pos - 1] != '\n') {
+            const char *newline = static_cast<const char *>(memchr(data + pos, '\n', length - pos));
+            if (newline == NULL) {
+                return NO_RECORD;
+            }
+            pos = newline - data + 1;
+            continue;
+        }
+        if (fastq == 1) {
+            if (data[pos] == '@') {
+                const char *line1 = static_cast<const char *>(memchr(data + pos, '\n', length - pos));
+                const char *line2 = (line1 == NULL) ? NULL : static_cast<const char *>(memchr(line1 + 1, '\n', end - line1 - 1));
+                if (line2 == NULL || line2 + 1 >= end) {
+                    return NO_RECORD;
+                }
+                // in wrapped records a quality line can look like a record start,
+                // the quality of a four line record is as long as its sequence
+                const char *line3 = (line2[1] == '+') ? static_cast<const char *>(memchr(line2 + 1, '\n', end - line2 - 1)) : NULL;
+                if (line3 != NULL) {
+                    const char *line4 = static_cast<const char *>(memchr(line3 + 1, '\n', end - line3 - 1));
+                    if (line4 == NULL || line4 - line3 == line2 - line1) {
+                        return pos;
+                    }
+                }
+            }
+        } else if (data[pos] == '>') {
+            return pos;
+        }
+        const char *newline = static_cast<const char *>(memchr(data + pos, '\n', length - pos));
+        if (newline == NULL) {
+            return NO_RECORD;
+        }
+        pos = newline - data + 1;
+    }
+    return NO_RECORD;
+}
+
+std::vector<size_t> KSeqChunkReader::splitChunk(const char *data, size_t length, size_t parts) {
+    std::vector<size_t> starts;
+    starts.push_back(0);
+    const size_t step = length / std::max(parts, (size_t) 1);
+    for (size_t i = 1; i < parts && step > 0; i++) {
+        const size_t from = std::max(i * step, starts.back() + 1);
+        if (from >= length) {
+            break;
+        }
+        const size_t start = findRecordStart(data, length, from);
+        if (start == NO_RECORD) {
+            break;
+        }
+        starts.push_back(start);
+    }
+    starts.push_back(length);
+    return starts;
+}
+
+bool KSeqChunkReader::nextChunk(const char **data, size_t *length) {
+    if (format == FORMAT_PLAIN) {
+        if (inputPos >= inputSize) {
+            return false;
+        }
+        if (fastq == -1) {
+            detectRecordFormat(input, inputSize);
+        }
+        if (sequentialRead) {
+            return false;
+        }
+        size_t end = inputSize;
+        if (inputSize - inputPos > chunkSize) {
+            const size_t window = std::min(inputSize - inputPos, MAX_RECORD_CHUNKS * chunkSize);
+            const size_t start = findRecordStart(input + inputPos, window, chunkSize);
+            if (start != NO_RECORD) {
+                end = inputPos + start;
+            } else if (window < inputSize - inputPos) {
+                sequentialRead = true;
+                return false;
+            }
+        }
+        *data = input + inputPos;
+        *length = end - inputPos;
+        inputPos = end;
+        return true;
+    }
+
+    if (bufferConsumed > 0) {
+        memmove(buffer, buffer + bufferConsumed, bufferFill - bufferConsumed);
+        bufferFill -= bufferConsumed;
+        bufferConsumed = 0;
+    }
+    size_t target = chunkSize;
+    while (true) {
+        if (inputEnd == false && bufferFill < target) {
+            fill(target - bufferFill);
+            continue;
+        }
+        if (bufferFill == 0) {
+            return false;
+        }
+        if (fastq == -1) {
+            detectRecordFormat(buffer, bufferFill);
+        }
+        if (sequentialRead) {
+            return false;
+        }
+        size_t end = bufferFill;
+        if (inputEnd == false) {
+            const size_t start = findRecordStart(buffer, bufferFill, bufferFill / 2);
+            if (start == NO_RECORD) {
+                // a record that is longer than half of the chunk, the buffer grows
+                // until it would hold more than MAX_RECORD_CHUNKS chunks
+                if (bufferFill >= MAX_RECORD_CHUNKS * chunkSize) {
+                    sequentialRead = true;
+                    return false;
+                }
+                target = bufferFill + chunkSize;
+                continue;
+            }
+            end = start;
+        }
+        *data = buffer;
+        *length = end;
+        bufferConsumed = end;
+        return true;
+    }
+}
+
+void KSeqChunkReader::reserve(size_t size) {
+    if (size <= bufferCapacity) {
+        return;
+    }
+    bufferCapacity = std::max(size, bufferCapacity + bufferCapacity / 2);
+    buffer = static_cast<char *>(realloc(buffer, bufferCapacity));
+    Util::checkAllocation(buffer, "Can not allocate buffer in KSeqChunkReader");
+}
+
+void KSeqChunkReader::fill(size_t need) {
+    switch (format) {
+        case FORMAT_BGZF:
+            fillBgzf(need);
+            break;
+        case FORMAT_ZSTD:
+            fillZstd(need);
+            break;
+        default:
+            fillStream(need);
+            break;
+    }
+}
+
+size_t KSeqChunkReader::fillBgzf(size_t need) {
+#ifdef HAVE_ZLIB
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(input);
+    // members know their compressed and uncompressed size, so they can be inflated independently
+    std::vector<size_t> memberStart;
+    std::vector<size_t> memberSize;
+    std::vector<size_t> outStart;
+    size_t total = 0;
+    while (total < need && inputPos < inputSize) {
+        const size_t size = bgzfMemberSize(in + inputPos, inputSize - inputPos);
+        const size_t headerSize = 12 + (in[inputPos + 10] | (in[inputPos + 11] << 8));
+        if (size == 0 || size < headerSize + 8 || inputPos + size > inputSize) {
+            Debug(Debug::ERROR) << "Invalid BGZF block in " << fileName << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        const unsigned char *trailer = in + inputPos + size - 4;
+        const size_t outSize = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((size_t) trailer[3] << 24);
+        memberStart.push_back(inputPos);
+        memberSize.push_back(size);
+        outStart.push_back(total);
+        total += outSize;
+        inputPos += size;
+    }
+    outStart.push_back(total);
+    reserve(bufferFill + total);
+
+    bool failed = false;
+#pragma omp parallel for schedule(dynamic, 16)
+    for (size_t i = 0; i < memberStart.size(); i++) {
+        const size_t outSize = outStart[i + 1] - outStart[i];
+        if (outSize == 0) {
+            continue;
+        }
+        const unsigned char *member = in + memberStart[i];
+        const size_t headerSize = 12 + (member[10] | (member[11] << 8));
+        z_stream strm;
+        memset(&strm, 0, sizeof(z_stream));
+        if (inflateInit2(&strm, -15) != Z_OK) {
+            failed = true;
+            continue;
+        }
+        strm.next_in = (Bytef *) (member + headerSize);
+        strm.avail_in = memberSize[i] - headerSize - 8;
+        strm.next_out = (Bytef *) (buffer + bufferFill + outStart[i]);
+        strm.avail_out = outSize;
+        if (inflate(&strm, Z_FINISH) != Z_STREAM_END || strm.total_out != outSize) {
+            failed = true;
+        }
+        inflateEnd(&strm);
+    }
+    if (failed) {
+        Debug(Debug::ERROR) << "Cannot decompress BGZF block in " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    bufferFill += total;
+    if (inputPos >= inputSize) {
+        inputEnd = true;
+    }
+    return total;
+#else
+    inputEnd = true;
+    return 0;
+#endif
+}
+
+size_t KSeqChunkReader::fillZstd(size_t need) {
+    std::vector<size_t> frameStart;
+    std::vector<size_t> frameSize;
+    std::vector<size_t> outStart;
+    size_t total = 0;
+    while (total < need && inputPos < inputSize) {
+        const size_t size = ZSTD_findFrameCompressedSize(input + inputPos, inputSize - inputPos);
+        if (ZSTD_isError(size)) {
+            Debug(Debug::ERROR) << "Invalid zstd frame in " << fileName << ": " << ZSTD_getErrorName(size) << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        const unsigned long long outSize = ZSTD_getFrameContentSize(input + inputPos, size);
+        if (outSize == ZSTD_CONTENTSIZE_ERROR) {
+            Debug(Debug::ERROR) << "Invalid zstd frame in " << fileName << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        if (outSize == ZSTD_CONTENTSIZE_UNKNOWN) {
+            if (frameStart.empty() == false) {
+                break;
+            }
+            // streamed frames do not store their size, decode the rest of the file with a single stream
+            ZSTD_DStream *dstream = ZSTD_createDStream();
+            ZSTD_initDStream(dstream);
+            stream = dstream;
+            format = FORMAT_ZSTD_STREAM;
+            return fillStream(need);
+        }
+        frameStart.push_back(inputPos);
+        frameSize.push_back(size);
+        outStart.push_back(total);
+        total += outSize;
+        inputPos += size;
+    }
+    outStart.push_back(total);
+    reserve(bufferFill + total);
+
+    bool failed = false;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < frameStart.size(); i++) {
+        const size_t outSize = outStart[i + 1] - outStart[i];
+        const size_t result = ZSTD_decompress(buffer + bufferFill + outStart[i], outSize, input + frameStart[i], frameSize[i]);
+        if (ZSTD_isError(result) || result != outSize) {
+            failed = true;
+        }
+    }
+    if (failed) {
+        Debug(Debug::ERROR) << "Cannot decompress zstd frame in " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    bufferFill += total;
+    if (inputPos >= inputSize) {
+        inputEnd = true;
+    }
+    return total;
+}
+
+size_t KSeqChunkReader::fillStream(size_t need) {
+    reserve(bufferFill + need);
+    char *out = buffer + bufferFill;
+    size_t added = 0;
+    switch (format) {
+#ifdef HAVE_ZLIB
+        case FORMAT_GZIP:
+            while (added < need) {
+                int read = gzread((gzFile) stream, out + added, (unsigned int) std::min(need - added, (size_t) INT_MAX));
+                if (read < 0) {
+                    Debug(Debug::ERROR) << "Cannot decompress " << fileName << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                if (read == 0) {
+                    inputEnd = true;
+                    break;
+                }
+                added += read;
+            }
+            break;
+#endif
+#ifdef HAVE_BZLIB
+        case FORMAT_BZIP:
+            while (added < need) {
+                int read = BZ2_bzread((BZFILE *) stream, out + added, (int) std::min(need - added, (size_t) INT_MAX));
+                if (read < 0) {
+                    Debug(Debug::ERROR) << "Cannot decompress " << fileName << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                if (read == 0) {
+                    inputEnd = true;
+                    break;
+                }
+                added += read;
+            }
+            break;
+#endif
+        case FORMAT_ZSTD_STREAM: {
+            ZSTD_inBuffer in = { input, inputSize, inputPos };
+            ZSTD_outBuffer result = { out, need, 0 };
+            while (result.pos < result.size) {
+                const size_t before = result.pos;
+                const size_t ret = ZSTD_decompressStream((ZSTD_DStream *) stream, &result, &in);
+                if (ZSTD_isError(ret)) {
+                    Debug(Debug::ERROR) << "Cannot decompress " << fileName << ": " << ZSTD_getErrorName(ret) << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                if (in.pos == in.size && result.pos == before) {
+                    break;
+                }
+            }
+            inputPos = in.pos;
+            added = result.pos;
+            if (in.pos == in.size && result.pos < result.size) {
+                inputEnd = true;
+            }
+            break;
+        }
+        default:
+            inputEnd = true;
+            break;
+    }
+    bufferFill += added;
+    return added;
+}
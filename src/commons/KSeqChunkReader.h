@@ -0,0 +1,84 @@
+#ifndef MMSEQS_KSEQCHUNKREADER_H
+#define MMSEQS_KSEQCHUNKREADER_H
+
+// Reads a FASTA/FASTQ file in large chunks that always end at a record boundary, so that
+// the records of a chunk can be split further and parsed independently (e.g. with KSeqBuffer)
+// by several threads. Uncompressed files are memory mapped and returned without a copy.
+// BGZF compressed gzip files and zstd files with multiple frames (as written by pzstd)
+// are decompressed in parallel, other gzip and bzip2 files are decompressed by a single thread.
+// FASTQ records are only recognized if they are written as four lines. FASTQ input with wrapped records
+// and records that span more than MAX_RECORD_CHUNKS chunks cannot be chunked and have to be read by KSeqFactory.
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MemoryMapped;
+
+class KSeqChunkReader {
+public:
+    KSeqChunkReader(const char *fileName, size_t chunkSize);
+    ~KSeqChunkReader();
+
+    // stdin and compression formats that were not compiled in cannot be read in chunks
+    static bool isSupported(const char *fileName);
+
+    // next chunk of complete records, returns false at the end of the input
+    // or if the input has to be read sequentially
+    bool nextChunk(const char **data, size_t *length);
+
+    // true once nextChunk found no record boundary, the remaining input was not returned
+    bool needsSequentialRead() const {
+        return sequentialRead;
+    }
+
+    // splits a chunk into at most parts ranges at record boundaries,
+    // returns the start of every range followed by length
+    std::vector<size_t> splitChunk(const char *data, size_t length, size_t parts);
+
+private:
+    enum Format {
+        FORMAT_PLAIN,
+        FORMAT_GZIP,
+        FORMAT_BGZF,
+        FORMAT_BZIP,
+        FORMAT_ZSTD,
+        FORMAT_ZSTD_STREAM
+    };
+
+    // longest record in chunks that is still searched for its end
+    static const size_t MAX_RECORD_CHUNKS = 4;
+
+    std::string fileName;
+    Format format;
+    size_t chunkSize;
+
+    MemoryMapped *mapped;
+    const char *input;
+    size_t inputSize;
+    size_t inputPos;
+
+    // decompressed data, the records behind the last returned chunk are moved to the front
+    char *buffer;
+    size_t bufferCapacity;
+    size_t bufferFill;
+    size_t bufferConsumed;
+    bool inputEnd;
+
+    // -1 until the first record was seen
+    int fastq;
+    bool sequentialRead;
+
+    void *stream;
+
+    size_t findRecordStart(const char *data, size_t length, size_t from);
+    void detectRecordFormat(const char *data, size_t length);
+    void reserve(size_t size);
+
+    // appends at least need decompressed bytes to buffer unless the input ends
+    void fill(size_t need);
+    size_t fillBgzf(size_t need);
+    size_t fillZstd(size_t need);
+    size_t fillStream(size_t need);
+};
+
+#endif
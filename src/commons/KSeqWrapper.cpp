@@ -5,6 +5,8 @@
 #include "Debug.h"
 #include <unistd.h>
 
+#include <zstd.h>
+
 namespace KSEQFILE {
     KSEQ_INIT(int, read)
 }
@@ -157,6 +159,80 @@ KSeqBzip::~KSeqBzip() {
 }
 #endif
 
+struct ZstdInput {
+    FILE *file;
+    ZSTD_DStream *stream;
+    char *buffer;
+    size_t bufferSize;
+    ZSTD_inBuffer in;
+};
+
+static int zstdRead(ZstdInput *input, void *data, int length) {
+    ZSTD_outBuffer out = { data, static_cast<size_t>(length), 0 };
+    while (out.pos == 0) {
+        if (input->in.pos == input->in.size) {
+            input->in.size = fread(input->buffer, sizeof(char), input->bufferSize, input->file);
+            input->in.pos = 0;
+            if (input->in.size == 0) {
+                break;
+            }
+        }
+        const size_t result = ZSTD_decompressStream(input->stream, &out, &input->in);
+        if (ZSTD_isError(result)) {
+            Debug(Debug::ERROR) << "Cannot decompress zstd input: " << ZSTD_getErrorName(result) << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    return static_cast<int>(out.pos);
+}
+
+namespace KSEQZSTD {
+    KSEQ_INIT(ZstdInput *, zstdRead)
+}
+
+KSeqZstd::KSeqZstd(const char* fileName) {
+    file = new ZstdInput;
+    file->file = FileUtil::openFileOrDie(fileName, "rb", true);
+    file->stream = ZSTD_createDStream();
+    ZSTD_initDStream(file->stream);
+    file->bufferSize = ZSTD_DStreamInSize();
+    file->buffer = static_cast<char *>(malloc(file->bufferSize));
+    Util::checkAllocation(file->buffer, "Can not allocate buffer in KSeqZstd");
+    file->in.src = file->buffer;
+    file->in.size = 0;
+    file->in.pos = 0;
+    seq = (void*) KSEQZSTD::kseq_init(file);
+    type = KSEQ_ZSTD;
+}
+
+bool KSeqZstd::ReadEntry() {
+    KSEQZSTD::kseq_t* s = (KSEQZSTD::kseq_t*) seq;
+    int result = KSEQZSTD::kseq_read(s);
+    if (result < 0)
+        return false;
+
+    entry.name = s->name;
+    entry.comment = s->comment;
+    entry.sequence = s->seq;
+    entry.qual = s->qual;
+    entry.headerOffset = 0;
+    entry.sequenceOffset = 0;
+    entry.multiline = s->multiline;
+
+    return true;
+}
+
+KSeqZstd::~KSeqZstd() {
+    kseq_destroy((KSEQZSTD::kseq_t*)seq);
+    ZSTD_freeDStream(file->stream);
+    free(file->buffer);
+    if (fclose(file->file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close KSeq input file\n";
+        EXIT(EXIT_FAILURE);
+    }
+    delete file;
+}
+
 KSeqWrapper* KSeqFactory(const char* file) {
     KSeqWrapper* kseq = NULL;
     if( strcmp(file, "stdin") == 0 ){
@@ -164,6 +240,11 @@ KSeqWrapper* KSeqFactory(const char* file) {
         return kseq;
     }
 
+    if (Util::endsWith(".zst", file) == true) {
+        kseq = new KSeqZstd(file);
+        return kseq;
+    }
+
     if(Util::endsWith(".gz", file) == false && Util::endsWith(".bz2", file) == false ) {
         kseq = new KSeqFile(file);
         return kseq;
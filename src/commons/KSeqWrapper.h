@@ -23,6 +23,7 @@ public:
         KSEQ_STREAM,
         KSEQ_GZIP,
         KSEQ_BZIP,
+        KSEQ_ZSTD,
         KSEQ_BUFFER
     };
     kseq_type type;
@@ -77,6 +78,17 @@ private:
 };
 #endif
 
+struct ZstdInput;
+
+class KSeqZstd : public KSeqWrapper {
+public:
+    KSeqZstd(const char* file);
+    bool ReadEntry();
+    ~KSeqZstd();
+private:
+    ZstdInput *file;
+};
+
 class KSeqBuffer : public KSeqWrapper {
 public:
     KSeqBuffer(const char* buffer, size_t length);
@@ -0,0 +1,80 @@
+#include "MappingReader.h"
+#include "FileUtil.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+// file layout: magic, number of keys, one taxon per key
+static const uint64_t MAPPING_MAGIC = 0x313050414d534d4dULL; // "MMSMAP01"
+static const size_t MAPPING_HEADER_SIZE = 2 * sizeof(uint64_t);
+
+MappingReader::MappingReader(const std::string &mappingFile, bool preferBinary) : taxa(NULL), size(0), mmapData(NULL), mmapSize(0) {
+    std::string file = mappingFile;
+    const std::string binFile = mappingFile + ".bin";
+    if (preferBinary && FileUtil::fileExists(binFile.c_str())) {
+        if (FileUtil::isNewer(mappingFile, binFile)) {
+            Debug(Debug::WARNING) << "Binary mapping " << binFile << " is older than " << mappingFile << " and is ignored. Please recreate it with createbintaxmapping.\n";
+        } else {
+            file = binFile;
+        }
+    }
+    FILE *handle = FileUtil::openFileOrDie(file.c_str(), "r", true);
+    uint64_t header[2];
+    const bool isBinary = fread(header, sizeof(uint64_t), 2, handle) == 2 && header[0] == MAPPING_MAGIC;
+    if (isBinary) {
+        char *data = static_cast<char *>(FileUtil::mmapFile(handle, &mmapSize));
+        fclose(handle);
+        if (mmapSize != MAPPING_HEADER_SIZE + header[1] * sizeof(unsigned int)) {
+            Debug(Debug::ERROR) << "Binary mapping " << file << " has size " << mmapSize << " instead of "
+                                << MAPPING_HEADER_SIZE + header[1] * sizeof(unsigned int) << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        mmapData = data;
+        size = header[1];
+        taxa = reinterpret_cast<unsigned int *>(mmapData + MAPPING_HEADER_SIZE);
+        return;
+    }
+    const bool isEmpty = (ftell(handle) == 0);
+    fclose(handle);
+
+    std::vector<std::pair<unsigned int, unsigned int>> mapping;
+    if (isEmpty == false) {
+        Util::readMapping(file, mapping);
+    }
+    for (size_t i = 0; i < mapping.size(); ++i) {
+        size = std::max(size, static_cast<size_t>(mapping[i].first) + 1);
+    }
+    taxa = new unsigned int[std::max(size, static_cast<size_t>(1))];
+    std::fill_n(taxa, size, NOT_FOUND);
+    for (size_t i = 0; i < mapping.size(); ++i) {
+        if (taxa[mapping[i].first] == NOT_FOUND) {
+            taxa[mapping[i].first] = mapping[i].second;
+        }
+    }
+}
+
+MappingReader::~MappingReader() {
+    if (mmapData != NULL) {
+        FileUtil::munmapData(mmapData, mmapSize);
+    } else {
+        delete[] taxa;
+    }
+}
+
+void MappingReader::writeBinary(const std::string &file) const {
+    FILE *handle = FileUtil::openAndDelete(file.c_str(), "wb");
+    const uint64_t header[2] = { MAPPING_MAGIC, size };
+    if (fwrite(header, sizeof(uint64_t), 2, handle) != 2
+        || fwrite(taxa, sizeof(unsigned int), size, handle) != size) {
+        Debug(Debug::ERROR) << "Can not write to " << file << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(handle) != 0) {
+        Debug(Debug::ERROR) << "Can not close " << file << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
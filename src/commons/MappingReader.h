@@ -0,0 +1,40 @@
+#ifndef MMSEQS_MAPPINGREADER_H
+#define MMSEQS_MAPPINGREADER_H
+
+// Taxon of every DB key of a _mapping file. The file is either the text format with one
+// "key<TAB>taxid" line per entry or the dense binary format written by createbintaxmapping,
+// one taxon per key, which is memory mapped. For duplicate keys in the text format the
+// first entry is used. If preferBinary is set and <file>.bin exists, it is read instead of
+// the text file, unless the text file was modified after it.
+#include <climits>
+#include <cstddef>
+#include <string>
+
+class MappingReader {
+public:
+    MappingReader(const std::string &file, bool preferBinary = true);
+    ~MappingReader();
+
+    static const unsigned int NOT_FOUND = UINT_MAX;
+
+    unsigned int lookup(unsigned int key) const {
+        return (key < size) ? taxa[key] : NOT_FOUND;
+    }
+
+    // all keys with a taxon are smaller than this
+    size_t getSize() const {
+        return size;
+    }
+
+    void writeBinary(const std::string &file) const;
+
+private:
+    unsigned int *taxa;
+    size_t size;
+
+    // set if taxa points into a memory mapped binary mapping
+    char *mmapData;
+    size_t mmapSize;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "MemoryPlacement.h"
+#include "Debug.h"
+#include "Parameters.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+int MemoryPlacement::mode = Parameters::INDEX_PLACEMENT_DEFAULT;
+int MemoryPlacement::nodeCount = 0;
+unsigned long MemoryPlacement::nodeMask[16];
+
+// only buffers with at least one huge page are worth the system calls
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+void MemoryPlacement::readOnlineNodes() {
+    memset(nodeMask, 0, sizeof(nodeMask));
+    nodeCount = 0;
+    const size_t maxNodes = sizeof(nodeMask) * 8;
+    const size_t bitsPerWord = sizeof(unsigned long) * 8;
+    // e.g. 0-3,6
+    FILE *file = fopen("/sys/devices/system/node/online", "r");
+    if (file == NULL) {
+        return;
+    }
+    unsigned int from, to;
+    while (fscanf(file, "%u", &from) == 1) {
+        to = from;
+        int c = fgetc(file);
+        if (c == '-') {
+            if (fscanf(file, "%u", &to) != 1) {
+                break;
+            }
+            c = fgetc(file);
+        }
+        for (size_t node = from; node <= to && node < maxNodes; node++) {
+            nodeMask[node / bitsPerWord] |= 1UL << (node % bitsPerWord);
+            nodeCount++;
+        }
+        if (c != ',') {
+            break;
+        }
+    }
+    fclose(file);
+}
+
+void MemoryPlacement::setMode(int placementMode) {
+    mode = placementMode;
+    if (mode == Parameters::INDEX_PLACEMENT_INTERLEAVE) {
+        readOnlineNodes();
+        Debug(Debug::INFO) << "Index memory interleaved over " << nodeCount << " NUMA node(s)\n";
+    }
+}
+
+void MemoryPlacement::advise(void *ptr, size_t size) {
+    if (mode == Parameters::INDEX_PLACEMENT_DEFAULT || ptr == NULL || size < HUGE_PAGE_SIZE) {
+        return;
+    }
+    // both calls only work on whole pages inside of the buffer
+    const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const uintptr_t start = (reinterpret_cast<uintptr_t>(ptr) + pageSize - 1) & ~(pageSize - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(pageSize - 1);
+    if (end <= start) {
+        return;
+    }
+    void *alignedPtr = reinterpret_cast<void *>(start);
+    const size_t alignedSize = end - start;
+#ifdef MADV_HUGEPAGE
+    if (madvise(alignedPtr, alignedSize, MADV_HUGEPAGE) != 0) {
+        Debug(Debug::WARNING) << "Could not enable huge pages for index memory\n";
+    }
+#endif
+#if defined(__linux__) && defined(SYS_mbind)
+    if (mode == Parameters::INDEX_PLACEMENT_INTERLEAVE && nodeCount > 1) {
+        if (syscall(SYS_mbind, alignedPtr, alignedSize, MPOL_INTERLEAVE, nodeMask, sizeof(nodeMask) * 8, 0) != 0) {
+            Debug(Debug::WARNING) << "Could not interleave index memory over NUMA nodes\n";
+        }
+    }
+#endif
+}
@@ -0,0 +1,30 @@
+#ifndef MMSEQS_MEMORYPLACEMENT_H
+#define MMSEQS_MEMORYPLACEMENT_H
+
+// Page placement of large randomly accessed buffers such as the prefilter index table.
+// advise has to be called before the buffer is first touched: the pages are then backed by
+// transparent huge pages and, in the interleave mode, spread round-robin over all NUMA nodes,
+// so that random lookups from all sockets share the memory bandwidth of all nodes.
+// Without Linux support advise does nothing.
+#include <cstddef>
+
+class MemoryPlacement {
+public:
+    // one of Parameters::INDEX_PLACEMENT_*
+    static void setMode(int mode);
+
+    static int getMode() {
+        return mode;
+    }
+
+    static void advise(void *ptr, size_t size);
+
+private:
+    static int mode;
+    static int nodeCount;
+    static unsigned long nodeMask[16];
+
+    static void readOnlineNodes();
+};
+
+#endif
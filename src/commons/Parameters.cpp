@@ -5,6 +5,7 @@
 #include "CommandCaller.h"
 #include "ByteParser.h"
 #include "FileUtil.h"
+#include "PerfReport.h"
 
 #include <map>
 #include <iomanip>
@@ -45,6 +46,11 @@ Parameters::Parameters():
         PARAM_SPLIT_MODE(PARAM_SPLIT_MODE_ID, "--split-mode", "Split mode", "0: split target db; 1: split query db; 2: auto, depending on main memory", typeid(int), (void *) &splitMode, "^[0-2]{1}$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
         PARAM_SPLIT_MEMORY_LIMIT(PARAM_SPLIT_MEMORY_LIMIT_ID, "--split-memory-limit", "Split memory limit", "Set max memory per split. E.g. 800B, 5K, 10M, 1G. Default (0) to all available system memory", typeid(ByteParser), (void *) &splitMemoryLimit, "^(0|[1-9]{1}[0-9]*(B|K|M|G|T)?)$", MMseqsParameter::COMMAND_COMMON | MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
         PARAM_DISK_SPACE_LIMIT(PARAM_DISK_SPACE_LIMIT_ID, "--disk-space-limit", "Disk space limit", "Set max disk space to use for reverse profile searches. E.g. 800B, 5K, 10M, 1G. Default (0) to all available disk space in the temp folder", typeid(ByteParser), (void *) &diskSpaceLimit, "^(0|[1-9]{1}[0-9]*(B|K|M|G|T)?)$", MMseqsParameter::COMMAND_COMMON | MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PREF_FORMAT(PARAM_PREF_FORMAT_ID, "--pref-format", "Prefilter result format", "Prefilter result format 0: tab-separated text, 1: delta-encoded binary", typeid(int), (void *) &prefFormat, "^[0-1]{1}$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PACKED_INDEX(PARAM_PACKED_INDEX_ID, "--packed-index", "Packed index", "Pack the index, decoded while matching. Sum of 1: delta/varint packed k-mer lists, 2: bit packed residues", typeid(int), (void *) &packedIndex, "^[0-3]{1}$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_INDEX_PLACEMENT(PARAM_INDEX_PLACEMENT_ID, "--index-placement", "Index placement", "Memory placement of the index table and sequence lookup 0: default, 1: transparent huge pages, 2: huge pages interleaved over all NUMA nodes", typeid(int), (void *) &indexPlacement, "^[0-2]{1}$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PREF_BATCH_SIZE(PARAM_PREF_BATCH_SIZE_ID, "--pref-batch-size", "Prefilter batch size", "Number of queries per thread whose index lookups are sorted by k-mer and done together (1: one query at a time)", typeid(int), (void *) &prefBatchSize, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_SIMILAR_KMER_CACHE(PARAM_SIMILAR_KMER_CACHE_ID, "--similar-kmer-cache", "Similar k-mer cache", "Memory for caching the similar k-mer lists of sequence queries, shared by all threads. createindex stores the lists of the most frequent k-mers in the index, the prefilter only uses them with this option. E.g. 800B, 5K, 10M, 1G. Default (0) no cache", typeid(ByteParser), (void *) &similarKmerCache, "^(0|[1-9]{1}[0-9]*(B|K|M|G|T)?)$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
         PARAM_SPLIT_AMINOACID(PARAM_SPLIT_AMINOACID_ID, "--split-aa", "Split by amino acid", "Try to find the best split boundaries by entry lengths", typeid(bool), (void *) &splitAA, "$", MMseqsParameter::COMMAND_EXPERT),
         PARAM_SUB_MAT(PARAM_SUB_MAT_ID, "--sub-mat", "Substitution matrix", "Substitution matrix file", typeid(MultiParam<char*>), (void *) &scoringMatrixFile, "", MMseqsParameter::COMMAND_COMMON | MMseqsParameter::COMMAND_EXPERT),
         PARAM_SEED_SUB_MAT(PARAM_SEED_SUB_MAT_ID, "--seed-sub-mat", "Seed substitution matrix", "Substitution matrix file for k-mer generation", typeid(MultiParam<char*>), (void *) &seedScoringMatrixFile, "", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
@@ -141,6 +147,7 @@ Parameters::Parameters():
         PARAM_REUSELATEST(PARAM_REUSELATEST_ID, "--force-reuse", "Force restart with latest tmp", "Reuse tmp filse in tmp/latest folder ignoring parameters and version changes", typeid(bool), (void *) &reuseLatest, "", MMseqsParameter::COMMAND_COMMON | MMseqsParameter::COMMAND_EXPERT),
         // search workflow
         PARAM_NUM_ITERATIONS(PARAM_NUM_ITERATIONS_ID, "--num-iterations", "Search iterations", "Number of iterative profile search iterations", typeid(int), (void *) &numIterations, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_PROFILE),
+        PARAM_SKIP_CONVERGED(PARAM_SKIP_CONVERGED_ID, "--skip-converged", "Skip converged queries", "From the third iteration on, only search queries that found new hits in the previous iteration. Converged queries keep their results", typeid(bool), (void *) &skipConverged, "", MMseqsParameter::COMMAND_PROFILE | MMseqsParameter::COMMAND_EXPERT),
         PARAM_START_SENS(PARAM_START_SENS_ID, "--start-sens", "Start sensitivity", "Start sensitivity", typeid(float), (void *) &startSens, "^[0-9]*(\\.[0-9]+)?$"),
         PARAM_SENS_STEPS(PARAM_SENS_STEPS_ID, "--sens-steps", "Search steps", "Number of search steps performed from --start-sens to -s", typeid(int), (void *) &sensSteps, "^[1-9]{1}$"),
         PARAM_SLICE_SEARCH(PARAM_SLICE_SEARCH_ID, "--slice-search", "Slice search mode", "For bigger profile DB, run iteratively the search by greedily swapping the search results", typeid(bool), (void *) &sliceSearch, "", MMseqsParameter::COMMAND_PROFILE | MMseqsParameter::COMMAND_EXPERT),
@@ -255,6 +262,8 @@ Parameters::Parameters():
         PARAM_TAX_OUTPUT_MODE(PARAM_TAX_OUTPUT_MODE_ID, "--tax-output-mode", "Taxonomy output mode", "0: output LCA, 1: output alignment 2: output both", typeid(int), (void *) &taxonomyOutpuMode, "^[0-2]{1}$"),
         // createsubdb, filtertaxseqdb
         PARAM_SUBDB_MODE(PARAM_SUBDB_MODE_ID, "--subdb-mode", "Subdb mode", "Subdb mode 0: copy data 1: soft link data and write index", typeid(int), (void *) &subDbMode, "^[0-1]{1}$"),
+        // convertdbindex
+        PARAM_INDEX_FORMAT(PARAM_INDEX_FORMAT_ID, "--index-format", "Index format", "Index format 0: tab-separated text, 1: memory-mappable binary", typeid(int), (void *) &indexFormat, "^[0-1]{1}$"),
         PARAM_TAR_INCLUDE(PARAM_TAR_INCLUDE_ID, "--tar-include", "Tar Inclusion Regex", "Include file names based on this regex", typeid(std::string), (void *) &tarInclude, "^.*$"),
         PARAM_TAR_EXCLUDE(PARAM_TAR_EXCLUDE_ID, "--tar-exclude", "Tar Exclusion Regex", "Exclude file names based on this regex", typeid(std::string), (void *) &tarExclude, "^.*$"),
         // for modules that should handle -h themselves
@@ -353,6 +362,10 @@ Parameters::Parameters():
     prefilter.push_back(&PARAM_SPLIT);
     prefilter.push_back(&PARAM_SPLIT_MODE);
     prefilter.push_back(&PARAM_SPLIT_MEMORY_LIMIT);
+    prefilter.push_back(&PARAM_PACKED_INDEX);
+    prefilter.push_back(&PARAM_INDEX_PLACEMENT);
+    prefilter.push_back(&PARAM_PREF_BATCH_SIZE);
+    prefilter.push_back(&PARAM_SIMILAR_KMER_CACHE);
     prefilter.push_back(&PARAM_C);
     prefilter.push_back(&PARAM_COV_MODE);
     prefilter.push_back(&PARAM_NO_COMP_BIAS_CORR);
@@ -368,6 +381,7 @@ Parameters::Parameters():
     prefilter.push_back(&PARAM_PCB);
     prefilter.push_back(&PARAM_SPACED_KMER_PATTERN);
     prefilter.push_back(&PARAM_LOCAL_TMP);
+    prefilter.push_back(&PARAM_PREF_FORMAT);
     prefilter.push_back(&PARAM_THREADS);
     prefilter.push_back(&PARAM_COMPRESSED);
     prefilter.push_back(&PARAM_V);
@@ -389,6 +403,7 @@ Parameters::Parameters():
     clust.push_back(&PARAM_MAXITERATIONS);
     clust.push_back(&PARAM_SIMILARITYSCORE);
     clust.push_back(&PARAM_THREADS);
+    clust.push_back(&PARAM_SPLIT_MEMORY_LIMIT);
     clust.push_back(&PARAM_COMPRESSED);
     clust.push_back(&PARAM_V);
 
@@ -676,6 +691,8 @@ Parameters::Parameters():
     indexdb.push_back(&PARAM_SEARCH_TYPE);
     indexdb.push_back(&PARAM_SPLIT);
     indexdb.push_back(&PARAM_SPLIT_MEMORY_LIMIT);
+    indexdb.push_back(&PARAM_PACKED_INDEX);
+    indexdb.push_back(&PARAM_SIMILAR_KMER_CACHE);
     indexdb.push_back(&PARAM_V);
     indexdb.push_back(&PARAM_THREADS);
 
@@ -707,6 +724,7 @@ Parameters::Parameters():
     createdb.push_back(&PARAM_WRITE_LOOKUP);
     createdb.push_back(&PARAM_ID_OFFSET);
     createdb.push_back(&PARAM_COMPRESSED);
+    createdb.push_back(&PARAM_THREADS);
     createdb.push_back(&PARAM_V);
 
     // convert2fasta
@@ -888,6 +906,11 @@ Parameters::Parameters():
     diff.push_back(&PARAM_COMPRESSED);
     diff.push_back(&PARAM_V);
 
+    // renumberdbs
+    renumberdbs.push_back(&PARAM_RECOVER_DELETED);
+    renumberdbs.push_back(&PARAM_THREADS);
+    renumberdbs.push_back(&PARAM_V);
+
     // prefixid
     prefixid.push_back(&PARAM_PREFIX);
     prefixid.push_back(&PARAM_MAPPING_FILE);
@@ -977,6 +1000,10 @@ Parameters::Parameters():
     createsubdb.push_back(&PARAM_SUBDB_MODE);
     createsubdb.push_back(&PARAM_V);
 
+    // convertdbindex
+    convertdbindex.push_back(&PARAM_INDEX_FORMAT);
+    convertdbindex.push_back(&PARAM_V);
+
     // createtaxdb
     createtaxdb.push_back(&PARAM_NCBI_TAX_DUMP);
     createtaxdb.push_back(&PARAM_TAX_MAPPING_FILE);
@@ -1064,6 +1091,7 @@ Parameters::Parameters():
     // needed for slice search, however all its parameters are already present in searchworkflow
     // searchworkflow = combineList(searchworkflow, sortresult);
     searchworkflow.push_back(&PARAM_NUM_ITERATIONS);
+    searchworkflow.push_back(&PARAM_SKIP_CONVERGED);
     searchworkflow.push_back(&PARAM_START_SENS);
     searchworkflow.push_back(&PARAM_SENS_STEPS);
     searchworkflow.push_back(&PARAM_SLICE_SEARCH);
@@ -1074,6 +1102,9 @@ Parameters::Parameters():
     searchworkflow.push_back(&PARAM_REUSELATEST);
     searchworkflow.push_back(&PARAM_REMOVE_TMP_FILES);
 
+    server = combineList(align, prefilter);
+    prefilteralign = combineList(prefilter, align);
+
     linsearchworkflow = combineList(align, kmersearch);
     linsearchworkflow = combineList(linsearchworkflow, swapresult);
     linsearchworkflow = combineList(linsearchworkflow, extractorfs);
@@ -1742,6 +1773,7 @@ void Parameters::parseParameters(int argc, const char *pargv[], const Command &c
     if (ignorePathCountChecks == false) {
         checkIfDatabaseIsValid(command, isStartVar, isMiddleVar, isEndVar);
     }
+    PerfReport::setOutput(command, filenames);
 
     if(printPar == true) {
         printParameters(command.cmd, argc, pargv, par);
@@ -1754,6 +1786,10 @@ void Parameters::checkIfTaxDbIsComplete(std::string & filename){
                                 << "The " << filename << "_mapping is missing.\n";
             EXIT(EXIT_FAILURE);
         }
+        // the binary taxonomy replaces the dump files
+        if (FileUtil::fileExists((filename + "_taxonomy").c_str())) {
+            return;
+        }
         if (FileUtil::fileExists((filename + "_nodes.dmp").c_str()) == false) {
             Debug(Debug::ERROR) << "Database " << filename << " need taxonomical information.\n"
                                 << "The " << filename << "_nodes.dmp is missing.\n";
@@ -1966,6 +2002,7 @@ void Parameters::setDefaults() {
 
     // search workflow
     numIterations = 1;
+    skipConverged = false;
     startSens = 4;
     sensSteps = 1;
     sliceSearch = false;
@@ -1996,6 +2033,11 @@ void Parameters::setDefaults() {
     maskMode = 1;
     maskLowerCaseMode = 0;
     minDiagScoreThr = 15;
+    prefFormat = Parameters::PREF_FORMAT_TEXT;
+    packedIndex = 0;
+    indexPlacement = INDEX_PLACEMENT_DEFAULT;
+    prefBatchSize = 1;
+    similarKmerCache = 0;
     spacedKmer = true;
     includeIdentity = false;
     alignmentMode = ALIGNMENT_MODE_FAST_AUTO;
@@ -2217,6 +2259,9 @@ void Parameters::setDefaults() {
     // createsubdb
     subDbMode = Parameters::SUBDB_MODE_HARD;
 
+    // convertdbindex
+    indexFormat = Parameters::INDEX_FORMAT_BINARY;
+
     // tar2db
     tarInclude = ".*";
     tarExclude = "^$";
@@ -113,6 +113,21 @@ public:
     static const unsigned int WRITER_ASCII_MODE = 0;
     static const unsigned int WRITER_COMPRESSED_MODE = 1;
     static const unsigned int WRITER_LEXICOGRAPHIC_MODE = 2;
+    static const unsigned int WRITER_BINARY_INDEX_MODE = 4;
+
+    static const int INDEX_FORMAT_TEXT = 0;
+    static const int INDEX_FORMAT_BINARY = 1;
+
+    static const int PREF_FORMAT_TEXT = 0;
+    static const int PREF_FORMAT_BINARY = 1;
+
+    // flags of --packed-index
+    static const int PACKED_INDEX_KMERS = 1;
+    static const int PACKED_INDEX_RESIDUES = 2;
+
+    static const int INDEX_PLACEMENT_DEFAULT = 0;
+    static const int INDEX_PLACEMENT_HUGE_PAGES = 1;
+    static const int INDEX_PLACEMENT_INTERLEAVE = 2;
 
     // convertalis alignment
     static const int FORMAT_ALIGNMENT_BLAST_TAB = 0;
@@ -360,6 +375,11 @@ public:
     int    splitMode;                    // Split by query or target DB
     size_t splitMemoryLimit;             // Maximum memory in bytes a split can use
     size_t diskSpaceLimit;               // Maximum disk space in bytes for sliced reverse profile search
+    int    prefFormat;                   // Text or binary prefilter result entries
+    int    packedIndex;                  // Varint packed k-mer lists and bit packed residues in the index
+    int    indexPlacement;               // Huge pages and NUMA interleaving of the index memory
+    int    prefBatchSize;                // Queries per thread whose index lookups are sorted by k-mer together
+    size_t similarKmerCache;             // Memory in bytes for similar k-mer lists shared by all threads
     bool   splitAA;                      // Split database by amino acid count instead
     int    preloadMode;                  // Preload mode of database
     float  scoreBias;                    // Add this bias to the score when computing the alignements
@@ -397,6 +417,7 @@ public:
 
     // SEARCH WORKFLOW
     int numIterations;
+    bool skipConverged;
     float startSens;
     int sensSteps;
     bool sliceSearch;
@@ -613,6 +634,9 @@ public:
     // createsubdb
     int subDbMode;
 
+    // convertdbindex
+    int indexFormat;
+
     // tar2db
     std::string tarInclude;
     std::string tarExclude;
@@ -663,6 +687,11 @@ public:
     PARAMETER(PARAM_SPLIT_MODE)
     PARAMETER(PARAM_SPLIT_MEMORY_LIMIT)
     PARAMETER(PARAM_DISK_SPACE_LIMIT)
+    PARAMETER(PARAM_PREF_FORMAT)
+    PARAMETER(PARAM_PACKED_INDEX)
+    PARAMETER(PARAM_INDEX_PLACEMENT)
+    PARAMETER(PARAM_PREF_BATCH_SIZE)
+    PARAMETER(PARAM_SIMILAR_KMER_CACHE)
     PARAMETER(PARAM_SPLIT_AMINOACID)
     PARAMETER(PARAM_SUB_MAT)
     PARAMETER(PARAM_SEED_SUB_MAT)
@@ -775,6 +804,7 @@ public:
 
     // search workflow
     PARAMETER(PARAM_NUM_ITERATIONS)
+    PARAMETER(PARAM_SKIP_CONVERGED)
     PARAMETER(PARAM_START_SENS)
     PARAMETER(PARAM_SENS_STEPS)
     PARAMETER(PARAM_SLICE_SEARCH)
@@ -923,6 +953,9 @@ public:
     // createsubdb
     PARAMETER(PARAM_SUBDB_MODE)
 
+    // convertdbindex
+    PARAMETER(PARAM_INDEX_FORMAT)
+
     // tar2db
     PARAMETER(PARAM_TAR_INCLUDE)
     PARAMETER(PARAM_TAR_EXCLUDE)
@@ -941,6 +974,7 @@ public:
 
     std::vector<MMseqsParameter*> alignall;
     std::vector<MMseqsParameter*> align;
+    std::vector<MMseqsParameter*> prefilteralign;
     std::vector<MMseqsParameter*> rescorediagonal;
     std::vector<MMseqsParameter*> alignbykmer;
     std::vector<MMseqsParameter*> createFasta;
@@ -978,6 +1012,7 @@ public:
     std::vector<MMseqsParameter*> linclustworkflow;
     std::vector<MMseqsParameter*> easysearchworkflow;
     std::vector<MMseqsParameter*> searchworkflow;
+    std::vector<MMseqsParameter*> server;
     std::vector<MMseqsParameter*> linsearchworkflow;
     std::vector<MMseqsParameter*> easylinsearchworkflow;
     std::vector<MMseqsParameter*> mapworkflow;
@@ -995,6 +1030,7 @@ public:
     std::vector<MMseqsParameter*> offsetalignment;
     std::vector<MMseqsParameter*> subtractdbs;
     std::vector<MMseqsParameter*> diff;
+    std::vector<MMseqsParameter*> renumberdbs;
     std::vector<MMseqsParameter*> concatdbs;
     std::vector<MMseqsParameter*> mergedbs;
     std::vector<MMseqsParameter*> summarizeheaders;
@@ -1015,6 +1051,7 @@ public:
     std::vector<MMseqsParameter*> taxpercontig;
     std::vector<MMseqsParameter*> easytaxonomy;
     std::vector<MMseqsParameter*> createsubdb;
+    std::vector<MMseqsParameter*> convertdbindex;
     std::vector<MMseqsParameter*> createtaxdb;
     std::vector<MMseqsParameter*> profile2pssm;
     std::vector<MMseqsParameter*> profile2seq;
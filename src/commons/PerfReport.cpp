@@ -0,0 +1,289 @@
+#include "PerfReport.h"
+#include "Command.h"
+#include "Debug.h"
+#include "MMseqsMPI.h"
+#include "Util.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool PerfReport::enabled = PerfReport::initEnabled();
+std::vector<PerfReport::Phase> PerfReport::phases;
+std::string PerfReport::phaseName;
+struct timeval PerfReport::phaseStart;
+struct rusage PerfReport::phaseUsage;
+std::map<std::string, size_t> PerfReport::counters;
+std::vector<double> PerfReport::threadBusyTime;
+
+static double toSeconds(const struct timeval &time) {
+    return time.tv_sec + 1e-6 * time.tv_usec;
+}
+
+static void appendJsonString(std::string &out, const char *str) {
+    out.push_back('"');
+    for (const char *c = str; *c != '\0'; c++) {
+        switch (*c) {
+            case '"':  out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\n': out.append("\\n"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                if ((unsigned char) *c < 0x20) {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned char) *c);
+                    out.append(buffer);
+                } else {
+                    out.push_back(*c);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+static void appendJsonNumber(std::string &out, double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6f", value);
+    out.append(buffer);
+}
+
+bool PerfReport::initEnabled() {
+    const char *env = getenv("MMSEQS_PROFILE");
+    if (env == NULL || *env == '\0' || strcmp(env, "0") == 0) {
+        return false;
+    }
+    gettimeofday(&phaseStart, NULL);
+    getrusage(RUSAGE_SELF, &phaseUsage);
+    return true;
+}
+
+void PerfReport::setOutput(const Command &command, const std::vector<std::string> &filenames) {
+    if (enabled == false || filenames.empty() || strcmp(getenv("MMSEQS_PROFILE"), "1") != 0) {
+        return;
+    }
+
+    // variadic inputs come first, so count the database positions from the back
+    std::string output = filenames.back();
+    for (size_t i = 0; i < command.databases.size(); i++) {
+        const DbType &db = command.databases[i];
+        if (db.accessMode == DbType::ACCESS_MODE_OUTPUT && db.validator != &DbValidator::directory) {
+            const size_t fromBack = command.databases.size() - i;
+            if (fromBack <= filenames.size()) {
+                output = filenames[filenames.size() - fromBack];
+            }
+            break;
+        }
+    }
+    std::string path = output + ".profile.json";
+
+    // only the top most command starts a new report, its subprocesses inherit the resolved path
+    // modules that do not initialize MPI run as a single process, even in MPI builds
+    int created = 1;
+    if (MMseqsMPI::active == false || MMseqsMPI::isMaster()) {
+        FILE *file = fopen(path.c_str(), "w");
+        if (file == NULL) {
+            Debug(Debug::WARNING) << "Cannot create profile report " << path << "\n";
+            created = 0;
+        } else {
+            fclose(file);
+        }
+    }
+#ifdef HAVE_MPI
+    // no rank may append its record before the master truncated the report
+    if (MMseqsMPI::active) {
+        MPI_Bcast(&created, 1, MPI_INT, MMseqsMPI::MASTER, MPI_COMM_WORLD);
+    }
+#endif
+    if (created == 0) {
+        enabled = false;
+        return;
+    }
+    setenv("MMSEQS_PROFILE", path.c_str(), 1);
+}
+
+void PerfReport::endPhase() {
+    if (phaseName.empty()) {
+        return;
+    }
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    Phase phase;
+    phase.name = phaseName;
+    phase.wallTime = toSeconds(now) - toSeconds(phaseStart);
+    phase.userTime = toSeconds(usage.ru_utime) - toSeconds(phaseUsage.ru_utime);
+    phase.systemTime = toSeconds(usage.ru_stime) - toSeconds(phaseUsage.ru_stime);
+    phases.push_back(phase);
+    phaseName.clear();
+}
+
+void PerfReport::startPhase(const std::string &name) {
+    if (enabled == false) {
+        return;
+    }
+    endPhase();
+    phaseName = name;
+    gettimeofday(&phaseStart, NULL);
+    getrusage(RUSAGE_SELF, &phaseUsage);
+}
+
+void PerfReport::addCounter(const std::string &name, size_t value) {
+    if (enabled == false) {
+        return;
+    }
+    counters[name] += value;
+}
+
+void PerfReport::addThreadBusyTime(const std::vector<double> &busyTime) {
+    if (enabled == false) {
+        return;
+    }
+    if (threadBusyTime.size() < busyTime.size()) {
+        threadBusyTime.resize(busyTime.size(), 0.0);
+    }
+    for (size_t i = 0; i < busyTime.size(); i++) {
+        threadBusyTime[i] += busyTime[i];
+    }
+}
+
+// rchar/wchar include page cache hits, read_bytes/write_bytes only what reached the storage layer
+static void readIoCounters(std::map<std::string, size_t> &io) {
+    io["readChars"] = 0;
+    io["writeChars"] = 0;
+    io["readBytes"] = 0;
+    io["writeBytes"] = 0;
+    FILE *file = fopen("/proc/self/io", "r");
+    if (file == NULL) {
+        return;
+    }
+    char name[64];
+    unsigned long long value;
+    while (fscanf(file, "%63[^:]: %llu\n", name, &value) == 2) {
+        if (strcmp(name, "rchar") == 0) {
+            io["readChars"] = value;
+        } else if (strcmp(name, "wchar") == 0) {
+            io["writeChars"] = value;
+        } else if (strcmp(name, "read_bytes") == 0) {
+            io["readBytes"] = value;
+        } else if (strcmp(name, "write_bytes") == 0) {
+            io["writeBytes"] = value;
+        }
+    }
+    fclose(file);
+}
+
+void PerfReport::write(const Command &command, int argc, const char **argv, const char *version, double wallTime, int status) {
+    if (enabled == false) {
+        return;
+    }
+    endPhase();
+
+    const char *path = getenv("MMSEQS_PROFILE");
+    if (strcmp(path, "1") == 0) {
+        // command without database arguments
+        return;
+    }
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    size_t peakRss = usage.ru_maxrss;
+#else
+    size_t peakRss = usage.ru_maxrss * 1024;
+#endif
+    std::map<std::string, size_t> io;
+    readIoCounters(io);
+
+    std::string record;
+    record.append("{\"module\": ");
+    appendJsonString(record, command.cmd);
+    record.append(", \"arguments\": [");
+    for (int i = 0; i < argc; i++) {
+        if (i > 0) {
+            record.append(", ");
+        }
+        appendJsonString(record, argv[i]);
+    }
+    record.append("], \"version\": ");
+    appendJsonString(record, version);
+    record.append(", \"status\": ");
+    record.append(SSTR(status));
+    record.append(", \"mpiRank\": ");
+    record.append(SSTR(MMseqsMPI::rank < 0 ? 0 : MMseqsMPI::rank));
+    record.append(",\n  \"wallTime\": ");
+    appendJsonNumber(record, wallTime);
+    record.append(", \"userTime\": ");
+    appendJsonNumber(record, toSeconds(usage.ru_utime));
+    record.append(", \"systemTime\": ");
+    appendJsonNumber(record, toSeconds(usage.ru_stime));
+    record.append(", \"peakRss\": ");
+    record.append(SSTR(peakRss));
+    for (std::map<std::string, size_t>::const_iterator it = io.begin(); it != io.end(); ++it) {
+        record.append(", ");
+        appendJsonString(record, it->first.c_str());
+        record.append(": ");
+        record.append(SSTR(it->second));
+    }
+    record.append(",\n  \"phases\": [");
+    for (size_t i = 0; i < phases.size(); i++) {
+        record.append(i > 0 ? ", " : "");
+        record.append("{\"name\": ");
+        appendJsonString(record, phases[i].name.c_str());
+        record.append(", \"wallTime\": ");
+        appendJsonNumber(record, phases[i].wallTime);
+        record.append(", \"userTime\": ");
+        appendJsonNumber(record, phases[i].userTime);
+        record.append(", \"systemTime\": ");
+        appendJsonNumber(record, phases[i].systemTime);
+        record.append("}");
+    }
+    record.append("],\n  \"threadBusyTime\": [");
+    for (size_t i = 0; i < threadBusyTime.size(); i++) {
+        record.append(i > 0 ? ", " : "");
+        appendJsonNumber(record, threadBusyTime[i]);
+    }
+    record.append("],\n  \"counters\": {");
+    for (std::map<std::string, size_t>::const_iterator it = counters.begin(); it != counters.end(); ++it) {
+        record.append(it == counters.begin() ? "" : ", ");
+        appendJsonString(record, it->first.c_str());
+        record.append(": ");
+        record.append(SSTR(it->second));
+    }
+    record.append("}}");
+
+    // workflow steps and MPI ranks share the file, the lock keeps the document valid
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) {
+        Debug(Debug::WARNING) << "Cannot open profile report " << path << "\n";
+        return;
+    }
+    if (flock(fd, LOCK_EX) != 0) {
+        Debug(Debug::WARNING) << "Cannot lock profile report " << path << "\n";
+        close(fd);
+        return;
+    }
+    const char *footer = "\n]}\n";
+    const size_t footerLength = strlen(footer);
+    struct stat st;
+    std::string out;
+    off_t offset = 0;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size > footerLength) {
+        offset = st.st_size - footerLength;
+        out.append(",\n");
+    } else {
+        out.append("{\"modules\": [\n");
+    }
+    out.append(record);
+    out.append(footer);
+    if (pwrite(fd, out.c_str(), out.length(), offset) != (ssize_t) out.length()) {
+        Debug(Debug::WARNING) << "Cannot write profile report " << path << "\n";
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+}
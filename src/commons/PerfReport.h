@@ -0,0 +1,58 @@
+#ifndef MMSEQS_PERFREPORT_H
+#define MMSEQS_PERFREPORT_H
+
+// Machine readable runtime report, enabled with the MMSEQS_PROFILE environment variable.
+// MMSEQS_PROFILE=1 writes <first output of the command>.profile.json, any other value is used as
+// the report path. The path is passed on to the subprocesses of a workflow, every module appends
+// its record to the same file:
+// {"modules": [{"module": ..., "wallTime": ..., "phases": [...], "threadBusyTime": [...], "counters": {...}}, ...]}
+//
+// All functions except isEnabled must be called outside of parallel regions.
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+struct Command;
+
+class PerfReport {
+public:
+    static bool isEnabled() {
+        return enabled;
+    }
+
+    // resolves MMSEQS_PROFILE=1 to a path next to the output of the top most command
+    static void setOutput(const Command &command, const std::vector<std::string> &filenames);
+
+    // ends the current phase and starts a new one, phases are reported in the order they ran
+    static void startPhase(const std::string &name);
+
+    static void addCounter(const std::string &name, size_t value);
+
+    // busy time of each thread of a parallel region, summed up by thread index
+    static void addThreadBusyTime(const std::vector<double> &busyTime);
+
+    static void write(const Command &command, int argc, const char **argv, const char *version, double wallTime, int status);
+
+private:
+    struct Phase {
+        std::string name;
+        double wallTime;
+        double userTime;
+        double systemTime;
+    };
+
+    static bool enabled;
+    static std::vector<Phase> phases;
+    static std::string phaseName;
+    static struct timeval phaseStart;
+    static struct rusage phaseUsage;
+    static std::map<std::string, size_t> counters;
+    static std::vector<double> threadBusyTime;
+
+    static bool initEnabled();
+    static void endPhase();
+};
+
+#endif
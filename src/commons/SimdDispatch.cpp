@@ -0,0 +1,63 @@
+#include "SimdDispatch.h"
+#include "Debug.h"
+
+#include <cstdlib>
+#include <cstring>
+
+SimdDispatch::Variant SimdDispatch::detectVariant() {
+    Variant supported = VARIANT_NATIVE;
+#if defined(HAVE_SIMD_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        supported = VARIANT_AVX2;
+    }
+#endif
+#if defined(HAVE_SIMD_AVX512) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        supported = VARIANT_AVX512;
+    }
+#endif
+
+    // the AVX-512 kernels were slower than AVX2 in our benchmarks (frequency throttling),
+    // so they are only used when requested explicitly
+    Variant variant = supported < VARIANT_AVX2 ? supported : VARIANT_AVX2;
+
+    const char *simdEnv = getenv("MMSEQS_SIMD");
+    if (simdEnv != NULL) {
+        Variant requested;
+        if (strcmp(simdEnv, "native") == 0) {
+            requested = VARIANT_NATIVE;
+        } else if (strcmp(simdEnv, "avx2") == 0) {
+            requested = VARIANT_AVX2;
+        } else if (strcmp(simdEnv, "avx512") == 0) {
+            requested = VARIANT_AVX512;
+        } else {
+            Debug(Debug::WARNING) << "Unknown MMSEQS_SIMD value " << simdEnv << ". Using " << getVariantName(variant) << "\n";
+            return variant;
+        }
+        // never select kernels the CPU cannot run
+        if (requested > supported) {
+            Debug(Debug::WARNING) << "MMSEQS_SIMD=" << simdEnv << " is not supported by this CPU or build. Using " << getVariantName(supported) << "\n";
+            requested = supported;
+        }
+        variant = requested;
+    }
+    return variant;
+}
+
+SimdDispatch::Variant SimdDispatch::getVariant() {
+    static const Variant variant = detectVariant();
+    return variant;
+}
+
+const char* SimdDispatch::getVariantName(Variant variant) {
+    switch (variant) {
+        case VARIANT_AVX512:
+            return "avx512";
+        case VARIANT_AVX2:
+            return "avx2";
+        case VARIANT_NATIVE:
+        default:
+            return "native";
+    }
+}
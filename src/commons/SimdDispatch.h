@@ -0,0 +1,54 @@
+#ifndef MMSEQS_SIMDDISPATCH_H
+#define MMSEQS_SIMDDISPATCH_H
+
+// Hot SIMD kernels are compiled once per instruction set. Each compilation puts its
+// kernel table into the namespace given by SIMD_VARIANT. Without HAVE_RUNTIME_DISPATCH
+// only the simd_native variant, built with the regular compiler flags, exists.
+//
+// This header is included by kernel translation units that are compiled with extra
+// instruction set flags. It must not contain inline function definitions, otherwise
+// the linker could pick a copy that uses instructions the CPU does not support.
+// Memory shared with kernels has to be aligned to MAX_ALIGN_INT from simd.h.
+#ifndef SIMD_VARIANT
+#define SIMD_VARIANT simd_native
+#endif
+
+#if defined(HAVE_SIMD_AVX512)
+#define SIMD_DECLARE_KERNEL(type, name) \
+    namespace simd_native { extern const type name; } \
+    namespace simd_avx2 { extern const type name; } \
+    namespace simd_avx512 { extern const type name; }
+#define SIMD_SELECT_KERNEL(name) \
+    (SimdDispatch::getVariant() == SimdDispatch::VARIANT_AVX512 ? &simd_avx512::name : \
+     SimdDispatch::getVariant() == SimdDispatch::VARIANT_AVX2 ? &simd_avx2::name : &simd_native::name)
+#elif defined(HAVE_SIMD_AVX2)
+#define SIMD_DECLARE_KERNEL(type, name) \
+    namespace simd_native { extern const type name; } \
+    namespace simd_avx2 { extern const type name; }
+#define SIMD_SELECT_KERNEL(name) \
+    (SimdDispatch::getVariant() == SimdDispatch::VARIANT_AVX2 ? &simd_avx2::name : &simd_native::name)
+#else
+#define SIMD_DECLARE_KERNEL(type, name) \
+    namespace simd_native { extern const type name; }
+#define SIMD_SELECT_KERNEL(name) (&simd_native::name)
+#endif
+
+class SimdDispatch {
+public:
+    enum Variant {
+        VARIANT_NATIVE = 0,
+        VARIANT_AVX2 = 1,
+        VARIANT_AVX512 = 2
+    };
+
+    // best variant up to AVX2 that is compiled in and supported by the CPU
+    // MMSEQS_SIMD=native|avx2|avx512 overrides the choice, AVX-512 is opt-in only
+    static Variant getVariant();
+
+    static const char* getVariantName(Variant variant);
+
+private:
+    static Variant detectVariant();
+};
+
+#endif
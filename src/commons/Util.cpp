@@ -80,6 +80,34 @@ void Util::decomposeDomain(size_t domain_size, size_t world_rank,
     }
 }
 
+static bool compareByDecreasingCost(const std::pair<size_t, size_t> &first, const std::pair<size_t, size_t> &second) {
+    if (first.first != second.first) {
+        return first.first > second.first;
+    }
+    return first.second < second.second;
+}
+
+std::vector<size_t> Util::orderByDecreasingCost(const std::vector<size_t> &costs, size_t maxWindowCost) {
+    std::vector<std::pair<size_t, size_t>> costAndPos(costs.size());
+    for (size_t i = 0; i < costs.size(); i++) {
+        costAndPos[i] = std::make_pair(costs[i], i);
+    }
+    size_t windowStart = 0;
+    size_t windowCost = 0;
+    for (size_t i = 0; i < costs.size(); i++) {
+        windowCost += costs[i];
+        if (windowCost >= maxWindowCost || i + 1 == costs.size()) {
+            std::sort(costAndPos.begin() + windowStart, costAndPos.begin() + i + 1, compareByDecreasingCost);
+            windowStart = i + 1;
+            windowCost = 0;
+        }
+    }
+    std::vector<size_t> order(costs.size());
+    for (size_t i = 0; i < costs.size(); i++) {
+        order[i] = costAndPos[i].second;
+    }
+    return order;
+}
 
 // http://jgamble.ripco.net/cgi-bin/nw.cgi?inputs=8&algorithm=batcher&output=svg
 // sorting networks
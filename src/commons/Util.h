@@ -3,6 +3,7 @@
 
 #include <string>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <vector>
 #include <limits>
@@ -75,6 +76,12 @@ public:
                                 size_t world_size, size_t *subdomain_start,
                                 size_t *subdomain_size);
 
+    // returns the positions of costs ordered by decreasing cost (ties by position). Handing them out with
+    // schedule(dynamic, 1) starts the most expensive items first, so no thread picks up a long one at the end
+    // With maxWindowCost only consecutive positions are reordered, within windows that end once their summed
+    // cost reaches maxWindowCost. Data stored in position order is then still read front to back, 0 keeps the order.
+    static std::vector<size_t> orderByDecreasingCost(const std::vector<size_t> &costs, size_t maxWindowCost = SIZE_MAX);
+
     static void rankedDescSort8(short *val, unsigned int *index);
     static void rankedDescSort32(short *val, unsigned int *index);
     static void rankedDescSort20(short *val, unsigned int *index);
@@ -0,0 +1,273 @@
+#ifndef MMSEQS_KMERRADIXSORT_H
+#define MMSEQS_KMERRADIXSORT_H
+
+// In-place MSD radix sort for KmerPosition arrays. Elements are partitioned byte by byte
+// on the kmer field, runs of equal kmers are finished with the comparator of the
+// corresponding SORT_PARALLEL call (seqLen, id, pos or diagonal). The result is the same
+// order as sorting with the comparator alone. The first level is partitioned by all
+// threads together, the resulting buckets are sorted by one thread each.
+#include "kmermatcher.h"
+#include "FastSort.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+namespace KmerRadixSort {
+    const size_t SERIAL_CUTOFF = 64;
+    const size_t PARALLEL_CUTOFF = 1 << 16;
+    // bucket heads of the parallel partition are kept on their own cache line
+    const size_t HEAD_STRIDE = 8;
+
+    template <bool REVERSE, typename T>
+    inline size_t key(const KmerPosition<T> &kmer) {
+        // the reverse comparators ignore the strand bit
+        return REVERSE ? BIT_CLEAR(kmer.kmer, 63) : kmer.kmer;
+    }
+
+    template <bool REVERSE, typename T>
+    inline unsigned int digit(const KmerPosition<T> &kmer, int shift) {
+        return (key<REVERSE>(kmer) >> shift) & 0xFF;
+    }
+
+    template <bool REVERSE, typename T, typename Compare>
+    void sortSerial(KmerPosition<T> *begin, KmerPosition<T> *end, int shift, Compare comp) {
+        const size_t n = end - begin;
+        if (shift < 0 || n <= SERIAL_CUTOFF) {
+            std::sort(begin, end, comp);
+            return;
+        }
+
+        size_t count[256];
+        // skip bytes that are equal for all elements
+        while (true) {
+            std::fill(count, count + 256, 0);
+            for (size_t i = 0; i < n; i++) {
+                count[digit<REVERSE>(begin[i], shift)]++;
+            }
+            if (count[digit<REVERSE>(begin[0], shift)] != n) {
+                break;
+            }
+            shift -= 8;
+            if (shift < 0) {
+                std::sort(begin, end, comp);
+                return;
+            }
+        }
+
+        size_t head[256];
+        size_t tail[256];
+        size_t offset = 0;
+        for (size_t b = 0; b < 256; b++) {
+            head[b] = offset;
+            offset += count[b];
+            tail[b] = offset;
+        }
+        for (size_t b = 0; b < 256; b++) {
+            while (head[b] < tail[b]) {
+                KmerPosition<T> element = begin[head[b]];
+                unsigned int d = digit<REVERSE>(element, shift);
+                while (d != b) {
+                    std::swap(element, begin[head[d]++]);
+                    d = digit<REVERSE>(element, shift);
+                }
+                begin[head[b]++] = element;
+            }
+        }
+
+        size_t start = 0;
+        for (size_t b = 0; b < 256; b++) {
+            if (count[b] > 1) {
+                sortSerial<REVERSE>(begin + start, begin + start + count[b], shift - 8, comp);
+            }
+            start += count[b];
+        }
+    }
+
+    template <bool REVERSE, typename T, typename Compare>
+    void sortParallel(KmerPosition<T> *begin, KmerPosition<T> *end, int shift, Compare comp, int threads) {
+        const size_t n = end - begin;
+        if (threads <= 1 || n <= PARALLEL_CUTOFF) {
+            sortSerial<REVERSE>(begin, end, shift, comp);
+            return;
+        }
+        if (shift < 0) {
+            SORT_PARALLEL(begin, end, comp);
+            return;
+        }
+
+        std::vector<size_t> count(256);
+        std::vector<size_t> threadCount(256 * threads);
+        while (true) {
+            std::fill(threadCount.begin(), threadCount.end(), 0);
+#pragma omp parallel num_threads(threads)
+            {
+                unsigned int thread_idx = 0;
+#ifdef OPENMP
+                thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+                size_t *local = &threadCount[256 * thread_idx];
+#pragma omp for schedule(static)
+                for (size_t i = 0; i < n; i++) {
+                    local[digit<REVERSE>(begin[i], shift)]++;
+                }
+            }
+            for (size_t b = 0; b < 256; b++) {
+                count[b] = 0;
+                for (int t = 0; t < threads; t++) {
+                    count[b] += threadCount[256 * t + b];
+                }
+            }
+            if (count[digit<REVERSE>(begin[0], shift)] != n) {
+                break;
+            }
+            shift -= 8;
+            if (shift < 0) {
+                SORT_PARALLEL(begin, end, comp);
+                return;
+            }
+        }
+
+        // Every thread claims a slot, takes its element and moves it to the next unclaimed slot of its
+        // bucket, continuing with the element found there. The claimed slot stays empty (a hole) until
+        // an element of its bucket arrives. If all slots of a bucket are claimed, the held element
+        // belongs into one of the holes of that bucket, which might still be registered by another thread.
+        std::vector<size_t> head(256 * HEAD_STRIDE);
+        std::vector<size_t> tail(256);
+        std::vector<size_t> holes(256 * threads);
+        std::vector<size_t> holeCount(256 * HEAD_STRIDE);
+        std::vector<int> holeLock(256 * HEAD_STRIDE);
+        size_t offset = 0;
+        for (size_t b = 0; b < 256; b++) {
+            head[b * HEAD_STRIDE] = offset;
+            offset += count[b];
+            tail[b] = offset;
+        }
+#pragma omp parallel num_threads(threads)
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+            for (size_t i = 0; i < 256; i++) {
+                const size_t b = (i + thread_idx * (256 / threads)) % 256;
+                while (true) {
+                    const size_t slot = __sync_fetch_and_add(&head[b * HEAD_STRIDE], 1);
+                    if (slot >= tail[b]) {
+                        break;
+                    }
+                    KmerPosition<T> element = begin[slot];
+                    unsigned int d = digit<REVERSE>(element, shift);
+                    if (d == b) {
+                        continue;
+                    }
+                    while (__sync_lock_test_and_set(&holeLock[b * HEAD_STRIDE], 1)) {}
+                    holes[b * threads + holeCount[b * HEAD_STRIDE]++] = slot;
+                    __sync_lock_release(&holeLock[b * HEAD_STRIDE]);
+                    while (true) {
+                        const size_t target = (head[d * HEAD_STRIDE] < tail[d]) ? __sync_fetch_and_add(&head[d * HEAD_STRIDE], 1) : SIZE_MAX;
+                        if (target < tail[d]) {
+                            std::swap(element, begin[target]);
+                            d = digit<REVERSE>(element, shift);
+                            continue;
+                        }
+                        // a hole is registered right after its slot was claimed
+                        size_t hole = SIZE_MAX;
+                        while (hole == SIZE_MAX) {
+                            while (__sync_lock_test_and_set(&holeLock[d * HEAD_STRIDE], 1)) {}
+                            if (holeCount[d * HEAD_STRIDE] > 0) {
+                                hole = holes[d * threads + --holeCount[d * HEAD_STRIDE]];
+                            }
+                            __sync_lock_release(&holeLock[d * HEAD_STRIDE]);
+                        }
+                        begin[hole] = element;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // buckets that are too large to be sorted by a single thread are split again with all threads
+        std::vector<std::pair<size_t, size_t>> buckets;
+        size_t start = 0;
+        for (size_t b = 0; b < 256; b++) {
+            if (count[b] > n / threads && count[b] > PARALLEL_CUTOFF) {
+                sortParallel<REVERSE>(begin + start, begin + start + count[b], shift - 8, comp, threads);
+            } else if (count[b] > 1) {
+                buckets.emplace_back(start, count[b]);
+            }
+            start += count[b];
+        }
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t i = 0; i < buckets.size(); i++) {
+            KmerPosition<T> *bucket = begin + buckets[i].first;
+            sortSerial<REVERSE>(bucket, bucket + buckets[i].second, shift - 8, comp);
+        }
+    }
+
+    // highest byte that differs between any two kmers, diff is the OR of all kmers XOR the first one
+    inline int firstShift(size_t diff) {
+        return (diff == 0) ? -8 : ((63 - __builtin_clzll(diff)) / 8) * 8;
+    }
+
+    // comp has to order by kmer first (ignoring bit 63 if REVERSE), as the KmerPosition comparators do
+    template <bool REVERSE, typename T, typename Compare>
+    void sort(KmerPosition<T> *begin, KmerPosition<T> *end, Compare comp) {
+        const size_t n = end - begin;
+        if (n < 2) {
+            return;
+        }
+        int threads = 1;
+#ifdef OPENMP
+        threads = omp_get_max_threads();
+#endif
+        size_t first = key<REVERSE>(begin[0]);
+        size_t diff = 0;
+#pragma omp parallel for schedule(static) reduction(|:diff) num_threads(threads)
+        for (size_t i = 1; i < n; i++) {
+            diff |= key<REVERSE>(begin[i]) ^ first;
+        }
+        const int shift = firstShift(diff);
+        if (shift < 0) {
+            SORT_PARALLEL(begin, end, comp);
+            return;
+        }
+        sortParallel<REVERSE>(begin, end, shift, comp, threads);
+    }
+
+    // Sorts every bucket [offsets[i], offsets[i + 1]) on its own. Runs of equal kmers must not span
+    // two buckets, then the buckets are grouped like a full sort but not ordered among each other.
+    template <bool REVERSE, typename T, typename Compare>
+    void sortBuckets(KmerPosition<T> *begin, const std::vector<size_t> &offsets, Compare comp) {
+        int threads = 1;
+#ifdef OPENMP
+        threads = omp_get_max_threads();
+#endif
+        const size_t n = offsets.back() - offsets.front();
+        std::vector<size_t> buckets;
+        for (size_t i = 0; i + 1 < offsets.size(); i++) {
+            const size_t size = offsets[i + 1] - offsets[i];
+            if (size > n / threads && size > PARALLEL_CUTOFF) {
+                sort<REVERSE>(begin + offsets[i], begin + offsets[i + 1], comp);
+            } else if (size > 1) {
+                buckets.push_back(i);
+            }
+        }
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t i = 0; i < buckets.size(); i++) {
+            KmerPosition<T> *bucketBegin = begin + offsets[buckets[i]];
+            KmerPosition<T> *bucketEnd = begin + offsets[buckets[i] + 1];
+            size_t first = key<REVERSE>(*bucketBegin);
+            size_t diff = 0;
+            for (KmerPosition<T> *it = bucketBegin + 1; it < bucketEnd; it++) {
+                diff |= key<REVERSE>(*it) ^ first;
+            }
+            sortSerial<REVERSE>(bucketBegin, bucketEnd, firstShift(diff), comp);
+        }
+    }
+}
+
+#endif
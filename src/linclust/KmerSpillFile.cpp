@@ -0,0 +1,181 @@
+#include "KmerSpillFile.h"
+#include "FileUtil.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <cstring>
+#include <fcntl.h>
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
+
+static const char SPILL_MAGIC[4] = { 'K', 'S', 'P', 'L' };
+static const int SPILL_COMPRESSION_LEVEL = 1;
+
+void KmerSpillWriter::wait() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void KmerSpillWriter::write(const std::string &fileName, std::string &data) {
+    // only one file is pending at a time, callers wait() before encoding the next split
+    wait();
+    std::string pending;
+    pending.swap(data);
+    thread = std::thread(writeFile, fileName, std::move(pending), compressed);
+}
+
+void KmerSpillWriter::writeFile(std::string fileName, std::string data, bool compressed) {
+    FILE *file = FileUtil::openFileOrDie(fileName.c_str(), "wb", false);
+    const char flags = compressed ? 1 : 0;
+    if (fwrite(SPILL_MAGIC, sizeof(char), sizeof(SPILL_MAGIC), file) != sizeof(SPILL_MAGIC)
+        || fwrite(&flags, sizeof(char), 1, file) != 1) {
+        Debug(Debug::ERROR) << "Cannot write to file " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (compressed) {
+        ZSTD_CStream *cstream = ZSTD_createCStream();
+        ZSTD_initCStream(cstream, SPILL_COMPRESSION_LEVEL);
+        std::vector<char> out(ZSTD_CStreamOutSize());
+        ZSTD_inBuffer in = { data.c_str(), data.size(), 0 };
+        size_t remaining = 0;
+        do {
+            ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+            remaining = (in.pos < in.size) ? ZSTD_compressStream(cstream, &output, &in) : ZSTD_endStream(cstream, &output);
+            if (ZSTD_isError(remaining)) {
+                Debug(Debug::ERROR) << "Cannot compress " << fileName << ": " << ZSTD_getErrorName(remaining) << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            if (fwrite(out.data(), sizeof(char), output.pos, file) != output.pos) {
+                Debug(Debug::ERROR) << "Cannot write to file " << fileName << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+        } while (in.pos < in.size || remaining != 0);
+        ZSTD_freeCStream(cstream);
+    } else if (data.size() > 0 && fwrite(data.c_str(), sizeof(char), data.size(), file) != data.size()) {
+        Debug(Debug::ERROR) << "Cannot write to file " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    std::string doneFile = fileName + ".done";
+    FILE *done = FileUtil::openFileOrDie(doneFile.c_str(), "w", false);
+    if (fclose(done) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << doneFile << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+KmerSpillReader::KmerSpillReader(const std::string &fileName, size_t bufferSize)
+        : fileName(fileName), file(NULL), compressed(false), stream(NULL), bufferSize(bufferSize), input(NULL),
+          inputPos(0), inputFill(0), buffer(NULL), bufferPos(0), bufferFill(0), fileOffset(0), inputEnd(false),
+          outputPending(false), lastRepSeq(0) {
+    file = FileUtil::openFileOrDie(fileName.c_str(), "rb", true);
+    char header[sizeof(SPILL_MAGIC) + 1];
+    if (fread(header, sizeof(char), sizeof(header), file) != sizeof(header)
+        || memcmp(header, SPILL_MAGIC, sizeof(SPILL_MAGIC)) != 0) {
+        Debug(Debug::ERROR) << "Split file " << fileName << " is invalid or was written by an older version. Please delete it and its .done file\n";
+        EXIT(EXIT_FAILURE);
+    }
+    fileOffset = sizeof(header);
+    compressed = header[sizeof(SPILL_MAGIC)] == 1;
+#if HAVE_POSIX_FADVISE
+    if (posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL) != 0) {
+        Debug(Debug::WARNING) << "posix_fadvise returned an error for file " << fileName << "\n";
+    }
+#endif
+    buffer = static_cast<char *>(malloc(bufferSize));
+    Util::checkAllocation(buffer, "Can not allocate buffer in KmerSpillReader");
+    if (compressed) {
+        input = static_cast<char *>(malloc(bufferSize));
+        Util::checkAllocation(input, "Can not allocate input buffer in KmerSpillReader");
+        ZSTD_DStream *dstream = ZSTD_createDStream();
+        ZSTD_initDStream(dstream);
+        stream = dstream;
+    }
+}
+
+KmerSpillReader::~KmerSpillReader() {
+    if (stream != NULL) {
+        ZSTD_freeDStream(static_cast<ZSTD_DStream *>(stream));
+    }
+    free(input);
+    free(buffer);
+    if (fclose(file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+bool KmerSpillReader::refill() {
+    char *target = compressed ? input : buffer;
+    size_t *targetPos = compressed ? &inputPos : &bufferPos;
+    size_t *targetFill = compressed ? &inputFill : &bufferFill;
+    while (true) {
+        if (compressed && (inputPos < inputFill || outputPending)) {
+            ZSTD_inBuffer in = { input, inputFill, inputPos };
+            ZSTD_outBuffer out = { buffer, bufferSize, 0 };
+            const size_t ret = ZSTD_decompressStream(static_cast<ZSTD_DStream *>(stream), &out, &in);
+            if (ZSTD_isError(ret)) {
+                Debug(Debug::ERROR) << "Cannot decompress " << fileName << ": " << ZSTD_getErrorName(ret) << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            inputPos = in.pos;
+            bufferPos = 0;
+            bufferFill = out.pos;
+            // a full output buffer might leave decompressed data inside the stream
+            outputPending = out.pos == out.size;
+            if (bufferFill > 0) {
+                return true;
+            }
+            continue;
+        }
+        if (inputEnd) {
+            return false;
+        }
+        // read the next block and let the kernel fetch the one behind it while this one is decoded
+        const size_t read = fread(target, sizeof(char), bufferSize, file);
+        if (read < bufferSize) {
+            if (ferror(file)) {
+                Debug(Debug::ERROR) << "Cannot read from file " << fileName << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            inputEnd = true;
+        }
+        fileOffset += read;
+#if HAVE_POSIX_FADVISE
+        if (inputEnd == false) {
+            posix_fadvise(fileno(file), fileOffset, bufferSize, POSIX_FADV_WILLNEED);
+        }
+#endif
+        *targetPos = 0;
+        *targetFill = read;
+        if (compressed == false && read > 0) {
+            return true;
+        }
+        if (read == 0) {
+            return false;
+        }
+    }
+}
+
+unsigned char KmerSpillReader::readByteOrDie() {
+    unsigned char value;
+    if (readByte(value) == false) {
+        Debug(Debug::ERROR) << "Split file " << fileName << " is truncated\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return value;
+}
+
+uint64_t KmerSpillReader::readVarintOrDie() {
+    uint64_t value;
+    if (readVarint(value) == false) {
+        Debug(Debug::ERROR) << "Split file " << fileName << " is truncated\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return value;
+}
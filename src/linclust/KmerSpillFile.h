@@ -0,0 +1,165 @@
+#ifndef MMSEQS_KMERSPILLFILE_H
+#define MMSEQS_KMERSPILLFILE_H
+
+// Split files of kmermatcher and kmersearch. Every set (rep. sequence followed by its hits)
+// is stored as varints: the difference to the previous rep. sequence, the number of hits and
+// for each hit the difference to the previous target id, the diagonal and the score.
+// Files are optionally zstd compressed and written by a background thread, so that the next
+// split can be computed in the meantime.
+#include <cstdio>
+#include <climits>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "Parameters.h"
+
+namespace KmerSpillFile {
+    inline void writeVarint(std::string &out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    // encoded sets take at least one byte per k-mer, the initial buffer is capped for large splits
+    inline size_t reserveSize(size_t kmerCount) {
+        return std::min(kmerCount, static_cast<size_t>(512) * 1024 * 1024);
+    }
+
+    inline uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // entries[0] is the rep. sequence, followed by count - 1 hits
+    template <int TYPE, typename T>
+    void encodeSet(std::string &out, unsigned int &lastRepSeq, T *entries, size_t count) {
+        const bool hasRev = TYPE == Parameters::DBTYPE_NUCLEOTIDES;
+        writeVarint(out, zigzag(static_cast<int64_t>(entries[0].seqId) - static_cast<int64_t>(lastRepSeq)));
+        lastRepSeq = entries[0].seqId;
+        writeVarint(out, hasRev ? (((count - 1) << 1) | entries[0].getRev()) : (count - 1));
+        unsigned int lastId = 0;
+        for (size_t i = 1; i < count; i++) {
+            writeVarint(out, zigzag(static_cast<int64_t>(entries[i].seqId) - static_cast<int64_t>(lastId)));
+            lastId = entries[i].seqId;
+            const uint64_t diagonal = zigzag(entries[i].diagonal);
+            writeVarint(out, hasRev ? ((diagonal << 1) | entries[i].getRev()) : diagonal);
+            out.push_back(static_cast<char>(entries[i].score));
+        }
+    }
+}
+
+class KmerSpillWriter {
+public:
+    KmerSpillWriter(bool compressed) : compressed(compressed) {}
+    ~KmerSpillWriter() {
+        wait();
+    }
+
+    // takes the content of data and writes it to fileName in the background,
+    // fileName.done is created once the file is complete
+    void write(const std::string &fileName, std::string &data);
+
+    void wait();
+
+private:
+    bool compressed;
+    std::thread thread;
+
+    static void writeFile(std::string fileName, std::string data, bool compressed);
+};
+
+class KmerSpillReader {
+public:
+    KmerSpillReader(const std::string &fileName, size_t bufferSize);
+    ~KmerSpillReader();
+
+    // decodes the next set into entries including the rep. sequence and the terminating UINT_MAX entry
+    template <int TYPE, typename T>
+    bool nextSet(std::vector<T> &entries) {
+        const bool hasRev = TYPE == Parameters::DBTYPE_NUCLEOTIDES;
+        uint64_t value;
+        if (readVarint(value) == false) {
+            return false;
+        }
+        lastRepSeq = static_cast<unsigned int>(static_cast<int64_t>(lastRepSeq) + KmerSpillFile::unzigzag(value));
+        uint64_t count = readVarintOrDie();
+        entries.resize((hasRev ? (count >> 1) : count) + 2);
+        entries[0].seqId = lastRepSeq;
+        entries[0].score = 0;
+        entries[0].diagonal = 0;
+        entries[0].setReverse(hasRev && (count & 1));
+        count = hasRev ? (count >> 1) : count;
+        unsigned int lastId = 0;
+        for (size_t i = 1; i <= count; i++) {
+            lastId = static_cast<unsigned int>(static_cast<int64_t>(lastId) + KmerSpillFile::unzigzag(readVarintOrDie()));
+            entries[i].seqId = lastId;
+            uint64_t diagonal = readVarintOrDie();
+            entries[i].setReverse(hasRev && (diagonal & 1));
+            diagonal = hasRev ? (diagonal >> 1) : diagonal;
+            entries[i].diagonal = KmerSpillFile::unzigzag(diagonal);
+            entries[i].score = readByteOrDie();
+        }
+        entries[count + 1].seqId = UINT_MAX;
+        entries[count + 1].score = 0;
+        entries[count + 1].diagonal = 0;
+        entries[count + 1].setReverse(false);
+        return true;
+    }
+
+private:
+    std::string fileName;
+    FILE *file;
+    bool compressed;
+    void *stream;
+
+    size_t bufferSize;
+    char *input;
+    size_t inputPos;
+    size_t inputFill;
+    char *buffer;
+    size_t bufferPos;
+    size_t bufferFill;
+    size_t fileOffset;
+    bool inputEnd;
+    bool outputPending;
+
+    unsigned int lastRepSeq;
+
+    bool refill();
+
+    inline bool readByte(unsigned char &value) {
+        if (bufferPos == bufferFill && refill() == false) {
+            return false;
+        }
+        value = static_cast<unsigned char>(buffer[bufferPos++]);
+        return true;
+    }
+
+    inline bool readVarint(uint64_t &value) {
+        value = 0;
+        unsigned char byte;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (readByte(byte) == false) {
+                return false;
+            }
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    unsigned char readByteOrDie();
+    uint64_t readVarintOrDie();
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "kmermatcher.h"
+#include "KmerRadixSort.h"
 #include "Indexer.h"
 #include "ReducedMatrix.h"
 #include "DBWriter.h"
@@ -25,7 +26,6 @@
 #include <vector>
 #include <iomanip>
 #include <algorithm>
-#include <sys/mman.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include "FastSort.h"
@@ -74,10 +74,92 @@ void maskSequence(int maskMode, int maskLowerCase, Sequence &seq, int maskLetter
     }
 }
 
+KmerBuckets::KmerBuckets(const std::vector<size_t> &hashDist, size_t hashStartRange, size_t hashEndRange) : hashStart(hashStartRange) {
+    const size_t hashEnd = std::min(hashEndRange, static_cast<size_t>(USHRT_MAX));
+    bucketOfHash.resize(hashEnd - hashStart + 1);
+    offsets.push_back(0);
+    size_t currBucketSize = 0;
+    for (size_t hash = hashStart; hash <= hashEnd; hash++) {
+        if (currBucketSize > 0 && currBucketSize + hashDist[hash] > BUCKET_SIZE) {
+            offsets.push_back(offsets.back() + currBucketSize);
+            currBucketSize = 0;
+        }
+        bucketOfHash[hash - hashStart] = offsets.size() - 1;
+        currBucketSize += hashDist[hash];
+    }
+    offsets.push_back(offsets.back() + currBucketSize);
+    writePos.assign(offsets.begin(), offsets.end() - 1);
+}
+
+// Collects the k-mers of one thread in small blocks per bucket. A full block is copied to its
+// bucket, so threads only synchronize once per block and write to few cache lines at a time.
+template <typename T>
+class KmerBucketWriter {
+public:
+    static const size_t BLOCK_SIZE = 16;
+
+    KmerBucketWriter(KmerBuckets &buckets, KmerPosition<T> *kmerArray) : buckets(buckets), kmerArray(kmerArray) {
+        blocks = new KmerPosition<T>[buckets.size() * BLOCK_SIZE];
+        blockFill = new unsigned char[buckets.size()];
+        memset(blockFill, 0, sizeof(unsigned char) * buckets.size());
+    }
+
+    ~KmerBucketWriter() {
+        delete[] blocks;
+        delete[] blockFill;
+    }
+
+    void add(unsigned short hash, size_t kmer, unsigned int id, T pos, T seqLen) {
+        const size_t bucket = buckets.bucketOfHash[hash - buckets.hashStart];
+        KmerPosition<T> &entry = blocks[bucket * BLOCK_SIZE + blockFill[bucket]];
+        entry.kmer = kmer;
+        entry.id = id;
+        entry.pos = pos;
+        entry.seqLen = seqLen;
+        blockFill[bucket]++;
+        if (blockFill[bucket] == BLOCK_SIZE) {
+            flush(bucket);
+        }
+    }
+
+    void flush() {
+        for (size_t bucket = 0; bucket < buckets.size(); bucket++) {
+            if (blockFill[bucket] > 0) {
+                flush(bucket);
+            }
+        }
+    }
+
+private:
+    KmerBuckets &buckets;
+    KmerPosition<T> *kmerArray;
+    KmerPosition<T> *blocks;
+    unsigned char *blockFill;
+
+    void flush(size_t bucket) {
+        const size_t count = blockFill[bucket];
+        const size_t writeOffset = __sync_fetch_and_add(&buckets.writePos[bucket], count);
+        if (writeOffset + count > buckets.offsets[bucket + 1]) {
+            Debug(Debug::ERROR) << "Kmer bucket overflow. bucket=" << bucket
+                                << ", writeOffset=" << writeOffset
+                                << ", bucketEnd=" << buckets.offsets[bucket + 1] << ".\n";
+            EXIT(EXIT_FAILURE);
+        }
+        memcpy(kmerArray + writeOffset, blocks + bucket * BLOCK_SIZE, sizeof(KmerPosition<T>) * count);
+        blockFill[bucket] = 0;
+    }
+};
+
 template <int TYPE, typename T>
 std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
                                                 Parameters & par, BaseMatrix * subMat, bool hashWholeSequence,
-                                                size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution){
+                                                size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution,
+                                                KmerBuckets * buckets){
+    if (buckets != NULL && buckets->kmerCount() >= kmerArraySize) {
+        Debug(Debug::ERROR) << "Kmer array overflow. kmerCount=" << buckets->kmerCount()
+                            << ", kmerArraySize=" << kmerArraySize << ".\n";
+        EXIT(EXIT_FAILURE);
+    }
     size_t offset = 0;
     int querySeqType  =  seqDbr.getDbtype();
     size_t longestKmer = par.kmerSize;
@@ -113,7 +195,13 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
         Indexer idxer(subMat->alphabetSize - 1,  par.kmerSize);
         const unsigned int BUFFER_SIZE = 1048576;
         size_t bufferPos = 0;
-        KmerPosition<T> * threadKmerBuffer = new KmerPosition<T>[BUFFER_SIZE];
+        KmerPosition<T> * threadKmerBuffer = NULL;
+        KmerBucketWriter<T> * bucketWriter = NULL;
+        if (buckets != NULL) {
+            bucketWriter = new KmerBucketWriter<T>(*buckets, kmerArray);
+        } else {
+            threadKmerBuffer = new KmerPosition<T>[BUFFER_SIZE];
+        }
         SequencePosition * kmers = (SequencePosition *) malloc((par.pickNbest * (par.maxSeqLen + 1) + 1) * sizeof(SequencePosition));
         size_t kmersArraySize = par.maxSeqLen;
         const size_t flushSize = 100000000;
@@ -239,27 +327,31 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
 
                 // add k-mer to represent the identity
                 if (static_cast<unsigned short>(seqHash) >= hashStartRange && static_cast<unsigned short>(seqHash) <= hashEndRange) {
-                    threadKmerBuffer[bufferPos].kmer = seqHash;
-                    threadKmerBuffer[bufferPos].id = seqId;
-                    threadKmerBuffer[bufferPos].pos = 0;
-                    threadKmerBuffer[bufferPos].seqLen = seq.L;
                     if(hashDistribution != NULL){
                         __sync_fetch_and_add(&hashDistribution[static_cast<unsigned short>(seqHash)], 1);
                     }
-                    bufferPos++;
-                    if (bufferPos >= BUFFER_SIZE) {
-                        size_t writeOffset = __sync_fetch_and_add(&offset, bufferPos);
-                        if(writeOffset + bufferPos < kmerArraySize){
-                            if(kmerArray!=NULL){
-                                memcpy(kmerArray + writeOffset, threadKmerBuffer, sizeof(KmerPosition<T>) * bufferPos);
+                    if (bucketWriter != NULL) {
+                        bucketWriter->add(static_cast<unsigned short>(seqHash), seqHash, seqId, 0, seq.L);
+                    } else {
+                        threadKmerBuffer[bufferPos].kmer = seqHash;
+                        threadKmerBuffer[bufferPos].id = seqId;
+                        threadKmerBuffer[bufferPos].pos = 0;
+                        threadKmerBuffer[bufferPos].seqLen = seq.L;
+                        bufferPos++;
+                        if (bufferPos >= BUFFER_SIZE) {
+                            size_t writeOffset = __sync_fetch_and_add(&offset, bufferPos);
+                            if(writeOffset + bufferPos < kmerArraySize){
+                                if(kmerArray!=NULL){
+                                    memcpy(kmerArray + writeOffset, threadKmerBuffer, sizeof(KmerPosition<T>) * bufferPos);
+                                }
+                            } else{
+                                Debug(Debug::ERROR) << "Kmer array overflow. currKmerArrayOffset="<< writeOffset
+                                                    << ", kmerBufferPos=" << bufferPos
+                                                    << ", kmerArraySize=" << kmerArraySize <<".\n";
+                                EXIT(EXIT_FAILURE);
                             }
-                        } else{
-                            Debug(Debug::ERROR) << "Kmer array overflow. currKmerArrayOffset="<< writeOffset
-                                                << ", kmerBufferPos=" << bufferPos
-                                                << ", kmerArraySize=" << kmerArraySize <<".\n";
-                            EXIT(EXIT_FAILURE);
+                            bufferPos = 0;
                         }
-                        bufferPos = 0;
                     }
                 }
 
@@ -306,31 +398,35 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
 //                                tmpKmerIdx=BIT_CLEAR(tmpKmerIdx, 63);
 //                                std::cout << seqId << "\t" << (kmers + kmerIdx)->score << "\t" << tmpKmerIdx << std::endl;
 //                            }
-                            threadKmerBuffer[bufferPos].kmer = (kmers + kmerIdx)->kmer;
-                            threadKmerBuffer[bufferPos].id = seqId;
-                            threadKmerBuffer[bufferPos].pos = (kmers + kmerIdx)->pos;
-                            threadKmerBuffer[bufferPos].seqLen = seq.L;
-                            bufferPos++;
                             if(hashDistribution != NULL){
                                 __sync_fetch_and_add(&hashDistribution[(kmers + kmerIdx)->score], 1);
                             }
-
-                            if (bufferPos >= BUFFER_SIZE) {
-                                size_t writeOffset = __sync_fetch_and_add(&offset, bufferPos);
-                                if(writeOffset + bufferPos < kmerArraySize){
-                                    if(kmerArray!=NULL) {
-                                        memcpy(kmerArray + writeOffset, threadKmerBuffer,
-                                               sizeof(KmerPosition<T>) * bufferPos);
+                            if (bucketWriter != NULL) {
+                                bucketWriter->add((kmers + kmerIdx)->score, (kmers + kmerIdx)->kmer, seqId, (kmers + kmerIdx)->pos, seq.L);
+                            } else {
+                                threadKmerBuffer[bufferPos].kmer = (kmers + kmerIdx)->kmer;
+                                threadKmerBuffer[bufferPos].id = seqId;
+                                threadKmerBuffer[bufferPos].pos = (kmers + kmerIdx)->pos;
+                                threadKmerBuffer[bufferPos].seqLen = seq.L;
+                                bufferPos++;
+
+                                if (bufferPos >= BUFFER_SIZE) {
+                                    size_t writeOffset = __sync_fetch_and_add(&offset, bufferPos);
+                                    if(writeOffset + bufferPos < kmerArraySize){
+                                        if(kmerArray!=NULL) {
+                                            memcpy(kmerArray + writeOffset, threadKmerBuffer,
+                                                   sizeof(KmerPosition<T>) * bufferPos);
+                                        }
+                                    } else{
+                                        Debug(Debug::ERROR) << "Kmer array overflow. currKmerArrayOffset="<< writeOffset
+                                                            << ", kmerBufferPos=" << bufferPos
+                                                            << ", kmerArraySize=" << kmerArraySize <<".\n";
+
+                                        EXIT(EXIT_FAILURE);
                                     }
-                                } else{
-                                    Debug(Debug::ERROR) << "Kmer array overflow. currKmerArrayOffset="<< writeOffset
-                                                        << ", kmerBufferPos=" << bufferPos
-                                                        << ", kmerArraySize=" << kmerArraySize <<".\n";
 
-                                    EXIT(EXIT_FAILURE);
+                                    bufferPos = 0;
                                 }
-
-                                bufferPos = 0;
                             }
                         }
                     }
@@ -354,6 +450,10 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
                 memcpy(kmerArray+writeOffset, threadKmerBuffer, sizeof(KmerPosition<T>) * bufferPos);
             }
         }
+        if (bucketWriter != NULL) {
+            bucketWriter->flush();
+            delete bucketWriter;
+        }
         free(kmers);
         delete[] threadKmerBuffer;
         delete[] hierarchicalScoreDist;
@@ -368,6 +468,18 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
         ExtendedSubstitutionMatrix::freeScoreMatrix(two);
     }
 
+    if (buckets != NULL) {
+        // the k-mer counts of setupKmerSplits have to match this pass exactly
+        for (size_t bucket = 0; bucket < buckets->size(); bucket++) {
+            if (buckets->writePos[bucket] != buckets->offsets[bucket + 1]) {
+                Debug(Debug::ERROR) << "Kmer bucket " << bucket << " has " << (buckets->writePos[bucket] - buckets->offsets[bucket])
+                                    << " k-mers, expected " << (buckets->offsets[bucket + 1] - buckets->offsets[bucket]) << ".\n";
+                EXIT(EXIT_FAILURE);
+            }
+        }
+        offset = buckets->kmerCount();
+    }
+
     if (probMatrix != NULL) {
         delete probMatrix;
     }
@@ -376,17 +488,25 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
 
 template <typename T>
 KmerPosition<T> * doComputation(size_t totalKmers, size_t hashStartRange, size_t hashEndRange, std::string splitFile,
-                                DBReader<unsigned int> & seqDbr, Parameters & par, BaseMatrix  * subMat) {
+                                KmerSpillWriter &spillWriter, DBReader<unsigned int> & seqDbr, Parameters & par, BaseMatrix  * subMat,
+                                const std::vector<size_t> &hashDist) {
 
     KmerPosition<T> * hashSeqPair = initKmerPositionMemory<T>(totalKmers);
+    // if the k-mer count of each hash is known, k-mers are placed in buckets of their hash that are sorted independently
+    // adjusted nucleotide k-mers are hashed before their length is adjusted, equal k-mers might have different hashes
+    KmerBuckets *buckets = NULL;
+    const bool isNucl = Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES);
+    if (hashDist.empty() == false && (isNucl == false || par.adjustKmerLength == false)) {
+        buckets = new KmerBuckets(hashDist, hashStartRange, hashEndRange);
+    }
     size_t elementsToSort;
-    if(Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)){
-        std::pair<size_t, size_t > ret = fillKmerPositionArray<Parameters::DBTYPE_NUCLEOTIDES, T>(hashSeqPair, totalKmers, seqDbr, par, subMat, true, hashStartRange, hashEndRange, NULL);
+    if(isNucl){
+        std::pair<size_t, size_t > ret = fillKmerPositionArray<Parameters::DBTYPE_NUCLEOTIDES, T>(hashSeqPair, totalKmers, seqDbr, par, subMat, true, hashStartRange, hashEndRange, NULL, buckets);
         elementsToSort = ret.first;
         par.kmerSize = ret.second;
         Debug(Debug::INFO) << "\nAdjusted k-mer length " << par.kmerSize << "\n";
     }else{
-        std::pair<size_t, size_t > ret = fillKmerPositionArray<Parameters::DBTYPE_AMINO_ACIDS, T>(hashSeqPair, totalKmers, seqDbr, par, subMat, true, hashStartRange, hashEndRange, NULL);
+        std::pair<size_t, size_t > ret = fillKmerPositionArray<Parameters::DBTYPE_AMINO_ACIDS, T>(hashSeqPair, totalKmers, seqDbr, par, subMat, true, hashStartRange, hashEndRange, NULL, buckets);
         elementsToSort = ret.first;
     }
     if(hashEndRange == SIZE_T_MAX){
@@ -395,10 +515,17 @@ KmerPosition<T> * doComputation(size_t totalKmers, size_t hashStartRange, size_t
 
     Debug(Debug::INFO) << "Sort kmer ";
     Timer timer;
-    if(Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)) {
-        SORT_PARALLEL(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<T>::compareRepSequenceAndIdAndPosReverse);
+    if (buckets != NULL) {
+        if (isNucl) {
+            KmerRadixSort::sortBuckets<true>(hashSeqPair, buckets->offsets, KmerPosition<T>::compareRepSequenceAndIdAndPosReverse);
+        } else {
+            KmerRadixSort::sortBuckets<false>(hashSeqPair, buckets->offsets, KmerPosition<T>::compareRepSequenceAndIdAndPos);
+        }
+        delete buckets;
+    } else if(isNucl) {
+        KmerRadixSort::sort<true>(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<T>::compareRepSequenceAndIdAndPosReverse);
     }else{
-        SORT_PARALLEL(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<T>::compareRepSequenceAndIdAndPos);
+        KmerRadixSort::sort<false>(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<T>::compareRepSequenceAndIdAndPos);
     }
     Debug(Debug::INFO) << timer.lap() << "\n";
 
@@ -415,9 +542,9 @@ KmerPosition<T> * doComputation(size_t totalKmers, size_t hashStartRange, size_t
     Debug(Debug::INFO) << "Sort by rep. sequence ";
     timer.reset();
     if(Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)){
-        SORT_PARALLEL(hashSeqPair, hashSeqPair + writePos, KmerPosition<T>::compareRepSequenceAndIdAndDiagReverse);
+        KmerRadixSort::sort<true>(hashSeqPair, hashSeqPair + writePos, KmerPosition<T>::compareRepSequenceAndIdAndDiagReverse);
     }else{
-        SORT_PARALLEL(hashSeqPair, hashSeqPair + writePos, KmerPosition<T>::compareRepSequenceAndIdAndDiag);
+        KmerRadixSort::sort<false>(hashSeqPair, hashSeqPair + writePos, KmerPosition<T>::compareRepSequenceAndIdAndDiag);
     }
     //kx::radix_sort(hashSeqPair, hashSeqPair + elementsToSort, SequenceComparision());
 //    for(size_t i = 0; i < writePos; i++){
@@ -427,9 +554,9 @@ KmerPosition<T> * doComputation(size_t totalKmers, size_t hashStartRange, size_t
 
     if(hashEndRange != SIZE_T_MAX){
         if(Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)){
-            writeKmersToDisk<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev, T>(splitFile, hashSeqPair, writePos + 1);
+            writeKmersToDisk<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev, T>(spillWriter, splitFile, hashSeqPair, writePos + 1);
         }else{
-            writeKmersToDisk<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry, T>(splitFile, hashSeqPair, writePos + 1);
+            writeKmersToDisk<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry, T>(spillWriter, splitFile, hashSeqPair, writePos + 1);
         }
         delete [] hashSeqPair;
         hashSeqPair = NULL;
@@ -579,6 +706,24 @@ size_t computeMemoryNeededLinearfilter(size_t totalKmer) {
     return sizeof(KmerPosition<T>) * totalKmer;
 }
 
+template <typename T>
+size_t computeSplitOverheadLinearfilter(size_t splitKmers, int bucketThreads) {
+    // buffer of the encoded split file in writeKmersToDisk
+    size_t overhead = KmerSpillFile::reserveSize(splitKmers);
+    // blocks of the KmerBucketWriter of each thread, two consecutive buckets hold more than BUCKET_SIZE k-mers
+    const size_t buckets = std::min(static_cast<size_t>(USHRT_MAX) + 1, 2 * splitKmers / KmerBuckets::BUCKET_SIZE + 1);
+    overhead += static_cast<size_t>(bucketThreads) * buckets * (KmerBucketWriter<T>::BLOCK_SIZE * sizeof(KmerPosition<T>) + sizeof(unsigned char));
+    return overhead;
+}
+
+template <typename T>
+size_t computeKmersPerSplitLinearfilter(size_t memoryLimit, int bucketThreads) {
+    // the overhead grows with the k-mer count, so the overhead of a split that uses all memory is an upper bound
+    const size_t maxKmers = memoryLimit / sizeof(KmerPosition<T>);
+    const size_t overhead = computeSplitOverheadLinearfilter<T>(maxKmers, bucketThreads);
+    return overhead < memoryLimit ? (memoryLimit - overhead) / sizeof(KmerPosition<T>) : 0;
+}
+
 
 template <typename T>
 int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
@@ -610,13 +755,19 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
     size_t splits = static_cast<size_t>(std::ceil(static_cast<float>(totalSizeNeeded) / memoryLimit));
     size_t totalKmersPerSplit = std::max(static_cast<size_t>(1024+1),
                                          static_cast<size_t>(std::min(totalSizeNeeded, memoryLimit)/sizeof(KmerPosition<T>))+1);
+    if (splits > 1) {
+        totalKmersPerSplit = std::max(static_cast<size_t>(1024+1), computeKmersPerSplitLinearfilter<T>(memoryLimit, par.threads) + 1);
+    }
 
-    std::vector<std::pair<size_t, size_t>> hashRanges = setupKmerSplits<T>(par, subMat, seqDbr, totalKmersPerSplit, splits);
+    std::vector<size_t> hashDist;
+    std::vector<std::pair<size_t, size_t>> hashRanges = setupKmerSplits<T>(par, subMat, seqDbr, totalKmersPerSplit, splits, &hashDist);
     if(splits > 1){
         Debug(Debug::INFO) << "Process file into " << hashRanges.size() << " parts\n";
     }
     std::vector<std::string> splitFiles;
     KmerPosition<T> *hashSeqPair = NULL;
+    // split files are written in the background while the next split is computed
+    KmerSpillWriter spillWriter(par.compressed);
 
     size_t mpiRank = 0;
 #ifdef HAVE_MPI
@@ -639,8 +790,9 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
 
     for(size_t split = fromSplit; split < fromSplit+splitCount; split++) {
         std::string splitFileName = par.db2 + "_split_" +SSTR(split);
-        hashSeqPair = doComputation<T>(totalKmers, hashRanges[split].first, hashRanges[split].second, splitFileName, seqDbr, par, subMat);
+        hashSeqPair = doComputation<T>(totalKmers, hashRanges[split].first, hashRanges[split].second, splitFileName, spillWriter, seqDbr, par, subMat, hashDist);
     }
+    spillWriter.wait();
     MPI_Barrier(MPI_COMM_WORLD);
     if(mpiRank == 0){
         for(size_t split = 0; split < splits; split++) {
@@ -655,11 +807,12 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
 
         std::string splitFileNameDone = splitFileName + ".done";
         if(FileUtil::fileExists(splitFileNameDone.c_str()) == false){
-            hashSeqPair = doComputation<T>(totalKmersPerSplit, hashRanges[split].first, hashRanges[split].second, splitFileName, seqDbr, par, subMat);
+            hashSeqPair = doComputation<T>(totalKmersPerSplit, hashRanges[split].first, hashRanges[split].second, splitFileName, spillWriter, seqDbr, par, subMat, hashDist);
         }
 
         splitFiles.push_back(splitFileName);
     }
+    spillWriter.wait();
 #endif
     if(mpiRank == 0){
         std::vector<char> repSequence(seqDbr.getLastKey()+1);
@@ -724,7 +877,8 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
 }
 
 template <typename T>
-std::vector<std::pair<size_t, size_t>> setupKmerSplits(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits){
+std::vector<std::pair<size_t, size_t>> setupKmerSplits(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits,
+                                                       std::vector<size_t> *hashDistribution){
     std::vector<std::pair<size_t, size_t>> hashRanges;
     if (splits > 1) {
         Debug(Debug::INFO) << "Not enough memory to process at once need to split\n";
@@ -760,6 +914,9 @@ std::vector<std::pair<size_t, size_t>> setupKmerSplits(Parameters &par, BaseMatr
             currBucketSize+=hashDist[i];
         }
         hashRanges.emplace_back(currBucketStart, (USHRT_MAX+1));
+        if (hashDistribution != NULL) {
+            hashDistribution->assign(hashDist, hashDist + (USHRT_MAX+1));
+        }
         delete [] hashDist;
     }else{
         hashRanges.emplace_back(0, SIZE_T_MAX);
@@ -933,6 +1090,13 @@ size_t queueNextEntry(KmerPositionQueue &queue, int file, size_t offsetPos, T *e
     return offsetPos+pos;
 }
 
+template <int TYPE, typename T>
+void queueNextSet(KmerPositionQueue &queue, int file, KmerSpillReader &reader, std::vector<T> &set) {
+    if (reader.nextSet<TYPE>(set)) {
+        queueNextEntry<TYPE, T>(queue, file, 0, set.data(), set.size());
+    }
+}
+
 template <int TYPE, typename T>
 void mergeKmerFilesAndOutput(DBWriter & dbw,
                              std::vector<std::string> tmpFiles,
@@ -940,35 +1104,18 @@ void mergeKmerFilesAndOutput(DBWriter & dbw,
     Debug(Debug::INFO) << "Merge splits ... ";
 
     const int fileCnt = tmpFiles.size();
-    FILE ** files       = new FILE*[fileCnt];
-    T **entries = new T*[fileCnt];
-    size_t * entrySizes = new size_t[fileCnt];
-    size_t * offsetPos  = new size_t[fileCnt];
-    size_t * dataSizes  = new size_t[fileCnt];
-    // init structures
-    for(size_t file = 0; file < tmpFiles.size(); file++){
-        files[file] = FileUtil::openFileOrDie(tmpFiles[file].c_str(),"r",true);
-        size_t dataSize;
-        struct stat sb;
-        fstat(fileno(files[file]) , &sb);
-        if(sb.st_size > 0){
-            entries[file]    = (T*)FileUtil::mmapFile(files[file], &dataSize);
-#if HAVE_POSIX_MADVISE
-            if (posix_madvise (entries[file], dataSize, POSIX_MADV_SEQUENTIAL) != 0){
-                Debug(Debug::ERROR) << "posix_madvise returned an error for file " << tmpFiles[file] << "\n";
-            }
-#endif
-        }else{
-            dataSize = 0;
-        }
-
-        dataSizes[file]  = dataSize;
-        entrySizes[file] = dataSize/sizeof(T);
+    // large reads keep the merge sequential on disk even though it alternates between many files
+    const size_t readBufferSize = std::max((size_t) 1024 * 1024, std::min((size_t) 64 * 1024 * 1024, (size_t) 1024 * 1024 * 1024 / std::max(fileCnt, 1)));
+    std::vector<KmerSpillReader *> readers(fileCnt);
+    // the set of each file that is currently in the queue
+    std::vector<std::vector<T>> sets(fileCnt);
+    for(int file = 0; file < fileCnt; file++){
+        readers[file] = new KmerSpillReader(tmpFiles[file], readBufferSize);
     }
     KmerPositionQueue queue;
     // read one entry for each file
     for(int file = 0; file < fileCnt; file++ ){
-        offsetPos[file] = queueNextEntry<TYPE,T>(queue, file, 0, entries[file], entrySizes[file]);
+        queueNextSet<TYPE,T>(queue, file, *readers[file], sets[file]);
     }
     std::string prefResultsOutString;
     prefResultsOutString.reserve(100000000);
@@ -989,19 +1136,11 @@ void mergeKmerFilesAndOutput(DBWriter & dbw,
         }
     }
 
-//    while(queue.empty() == false) {
-//        res = queue.top();
-//        std::cout << (int)res.repSeq << "\t" << (int)res.id << "\t" <<(int) res.pos << "\t" << (int) res.reverse << std::endl;
-//        queue.pop();
-//        offsetPos[res.file] = queueNextEntry<TYPE,T>(queue, res.file, offsetPos[res.file],
-//                                                     entries[res.file], entrySizes[res.file]);
-//    }
     while(queue.empty() == false) {
         res = queue.top();
         queue.pop();
         if(res.id == UINT_MAX) {
-            offsetPos[res.file] = queueNextEntry<TYPE,T>(queue, res.file, offsetPos[res.file],
-                                                         entries[res.file], entrySizes[res.file]);
+            queueNextSet<TYPE,T>(queue, res.file, *readers[res.file], sets[res.file]);
             dbw.writeData(prefResultsOutString.c_str(), prefResultsOutString.length(), res.repSeq, 0);
             if(hasRepSeq){
                 repSequence[res.repSeq]=true;
@@ -1011,8 +1150,7 @@ void mergeKmerFilesAndOutput(DBWriter & dbw,
             while(queue.empty() == false && queue.top().id==UINT_MAX) {
                 res = queue.top();
                 queue.pop();
-                offsetPos[res.file] = queueNextEntry<TYPE,T>(queue, res.file, offsetPos[res.file],
-                                                             entries[res.file], entrySizes[res.file]);
+                queueNextSet<TYPE,T>(queue, res.file, *readers[res.file], sets[res.file]);
             }
             if(queue.empty() == false) {
                 res = queue.top();
@@ -1074,42 +1212,26 @@ void mergeKmerFilesAndOutput(DBWriter & dbw,
         int len = QueryMatcher::prefilterHitToBuffer(buffer, h);
         prefResultsOutString.append(buffer, len);
     }
-    for(size_t file = 0; file < tmpFiles.size(); file++) {
-        if (fclose(files[file]) != 0) {
-            Debug(Debug::ERROR) << "Cannot close file " << tmpFiles[file] << "\n";
-            EXIT(EXIT_FAILURE);
-        }
-        if(dataSizes[file] > 0 && munmap((void*)entries[file], dataSizes[file]) < 0){
-            Debug(Debug::ERROR) << "Failed to munmap memory dataSize=" << dataSizes[file] <<"\n";
-            EXIT(EXIT_FAILURE);
-        }
+    for(int file = 0; file < fileCnt; file++) {
+        delete readers[file];
     }
-
-
-    delete [] dataSizes;
-    delete [] offsetPos;
-    delete [] entries;
-    delete [] entrySizes;
-    delete [] files;
 }
 
 
 template <int TYPE, typename T, typename seqLenType>
-void writeKmersToDisk(std::string tmpFile, KmerPosition<seqLenType> *hashSeqPair, size_t totalKmers) {
+void writeKmersToDisk(KmerSpillWriter &writer, std::string tmpFile, KmerPosition<seqLenType> *hashSeqPair, size_t totalKmers) {
     size_t repSeqId = SIZE_T_MAX;
     size_t lastTargetId = SIZE_T_MAX;
     seqLenType lastDiagonal=0;
     int diagonalScore=0;
-    FILE* filePtr = fopen(tmpFile.c_str(), "wb");
-    if(filePtr == NULL) { perror(tmpFile.c_str()); EXIT(EXIT_FAILURE); }
     unsigned int writeSets = 0;
-    const size_t BUFFER_SIZE = 2048;
-    size_t bufferPos = 0;
     size_t elemenetCnt = 0;
-    T writeBuffer[BUFFER_SIZE];
-    T nullEntry;
-    nullEntry.seqId=UINT_MAX;
-    nullEntry.diagonal=0;
+    unsigned int lastRepSeqId = 0;
+    std::vector<T> set;
+    // the previous split has to be on disk before this one is encoded, so only one encoded split is kept in memory
+    writer.wait();
+    std::string data;
+    data.reserve(KmerSpillFile::reserveSize(totalKmers));
     for(size_t kmerPos = 0; kmerPos < totalKmers && hashSeqPair[kmerPos].kmer != SIZE_T_MAX; kmerPos++){
         size_t currKmer=hashSeqPair[kmerPos].kmer;
         if(TYPE == Parameters::DBTYPE_NUCLEOTIDES){
@@ -1117,23 +1239,21 @@ void writeKmersToDisk(std::string tmpFile, KmerPosition<seqLenType> *hashSeqPair
         }
         if(repSeqId != currKmer) {
             if (writeSets > 0 && elemenetCnt > 0) {
-                if(bufferPos > 0){
-                    fwrite(writeBuffer, sizeof(T), bufferPos, filePtr);
-                }
-                fwrite(&nullEntry, sizeof(T), 1, filePtr);
+                KmerSpillFile::encodeSet<TYPE>(data, lastRepSeqId, set.data(), set.size());
             }
             lastTargetId = SIZE_T_MAX;
-            bufferPos=0;
+            set.clear();
             elemenetCnt=0;
             repSeqId = currKmer;
-            writeBuffer[bufferPos].seqId = repSeqId;
-            writeBuffer[bufferPos].score = 0;
-            writeBuffer[bufferPos].diagonal = 0;
+            T repEntry;
+            repEntry.seqId = repSeqId;
+            repEntry.score = 0;
+            repEntry.diagonal = 0;
             if(TYPE == Parameters::DBTYPE_NUCLEOTIDES){
                 bool isReverse = BIT_CHECK(hashSeqPair[kmerPos].kmer, 63)==false;
-                writeBuffer[bufferPos].setReverse(isReverse);
+                repEntry.setReverse(isReverse);
             }
-            bufferPos++;
+            set.push_back(repEntry);
         }
 
         unsigned int targetId = hashSeqPair[kmerPos].id;
@@ -1155,36 +1275,23 @@ void writeKmersToDisk(std::string tmpFile, KmerPosition<seqLenType> *hashSeqPair
         kmerPos--;
 
         elemenetCnt++;
-        writeBuffer[bufferPos].seqId = targetId;
-        writeBuffer[bufferPos].score = diagonalScore;
+        T entry;
+        entry.seqId = targetId;
+        entry.score = diagonalScore;
         diagonalScore = 0;
-        writeBuffer[bufferPos].diagonal = diagonal;
+        entry.diagonal = diagonal;
         if(TYPE == Parameters::DBTYPE_NUCLEOTIDES){
             bool isReverse = (reverse>forward)? true : false;
-            writeBuffer[bufferPos].setReverse(isReverse);
-        }
-        bufferPos++;
-        if(bufferPos >= BUFFER_SIZE){
-            fwrite(writeBuffer, sizeof(T), bufferPos, filePtr);
-            bufferPos=0;
+            entry.setReverse(isReverse);
         }
+        set.push_back(entry);
         lastTargetId = targetId;
         writeSets++;
     }
-    if (writeSets > 0 && elemenetCnt > 0 && bufferPos > 0) {
-        fwrite(writeBuffer, sizeof(T), bufferPos, filePtr);
-        fwrite(&nullEntry,  sizeof(T), 1, filePtr);
-    }
-    if (fclose(filePtr) != 0) {
-        Debug(Debug::ERROR) << "Cannot close file " << tmpFile << "\n";
-        EXIT(EXIT_FAILURE);
-    }
-    std::string fileName = tmpFile + ".done";
-    FILE* done = FileUtil::openFileOrDie(fileName.c_str(),"w", false);
-    if (fclose(done) != 0) {
-        Debug(Debug::ERROR) << "Cannot close file " << fileName << "\n";
-        EXIT(EXIT_FAILURE);
+    if (writeSets > 0 && elemenetCnt > 0) {
+        KmerSpillFile::encodeSet<TYPE>(data, lastRepSeqId, set.data(), set.size());
     }
+    writer.write(tmpFile, data);
 }
 
 void setKmerLengthAndAlphabet(Parameters &parameters, size_t aaDbSize, int seqTyp) {
@@ -1217,25 +1324,27 @@ void setKmerLengthAndAlphabet(Parameters &parameters, size_t aaDbSize, int seqTy
 }
 
 template std::pair<size_t, size_t>  fillKmerPositionArray<0, short>(KmerPosition<short> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
-                                                                    Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution);
+                                                                    Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution, KmerBuckets * buckets);
 template std::pair<size_t, size_t>  fillKmerPositionArray<1, short>(KmerPosition<short> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
-                                                                    Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution);
+                                                                    Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution, KmerBuckets * buckets);
 template std::pair<size_t, size_t>  fillKmerPositionArray<2, short>(KmerPosition<short> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
-                                                                    Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution);
+                                                                    Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution, KmerBuckets * buckets);
 template std::pair<size_t, size_t>  fillKmerPositionArray<0, int>(KmerPosition<int> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
-                                                                  Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution);
+                                                                  Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution, KmerBuckets * buckets);
 template std::pair<size_t, size_t>  fillKmerPositionArray<1, int>(KmerPosition <int>* kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
-                                                                  Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution);
+                                                                  Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution, KmerBuckets * buckets);
 template std::pair<size_t, size_t>  fillKmerPositionArray<2, int>(KmerPosition< int> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
-                                                                  Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution);
+                                                                  Parameters & par, BaseMatrix * subMat, bool hashWholeSequence, size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution, KmerBuckets * buckets);
 
 template KmerPosition<short> *initKmerPositionMemory(size_t size);
 template KmerPosition<int> *initKmerPositionMemory(size_t size);
 
 template size_t computeMemoryNeededLinearfilter<short>(size_t totalKmer);
 template size_t computeMemoryNeededLinearfilter<int>(size_t totalKmer);
+template size_t computeKmersPerSplitLinearfilter<short>(size_t memoryLimit, int bucketThreads);
+template size_t computeKmersPerSplitLinearfilter<int>(size_t memoryLimit, int bucketThreads);
 
-template std::vector<std::pair<size_t, size_t>>  setupKmerSplits<short>(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits);
-template std::vector<std::pair<size_t, size_t>>  setupKmerSplits<int>(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits);
+template std::vector<std::pair<size_t, size_t>>  setupKmerSplits<short>(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits, std::vector<size_t> *hashDistribution);
+template std::vector<std::pair<size_t, size_t>>  setupKmerSplits<int>(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits, std::vector<size_t> *hashDistribution);
 
 #undef SIZE_T_MAX
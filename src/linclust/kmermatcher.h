@@ -6,6 +6,7 @@
 #include "DBReader.h"
 #include "Parameters.h"
 #include "BaseMatrix.h"
+#include "KmerSpillFile.h"
 
 
 struct SequencePosition{
@@ -192,6 +193,31 @@ public:
     }
 };
 
+// Partition of a split into buckets of consecutive hash values. The k-mer count of every hash
+// value is known from setupKmerSplits, so fillKmerPositionArray can write each k-mer directly
+// into its bucket and the buckets can be sorted independently. Equal k-mers have the same hash
+// and never span two buckets.
+struct KmerBuckets {
+    // cache sized buckets, a bucket only becomes larger if a single hash value has more k-mers
+    static const size_t BUCKET_SIZE = 65536;
+
+    size_t hashStart;
+    std::vector<unsigned int> bucketOfHash;
+    // bucket i holds [offsets[i], offsets[i + 1])
+    std::vector<size_t> offsets;
+    // next write position of each bucket
+    std::vector<size_t> writePos;
+
+    KmerBuckets(const std::vector<size_t> &hashDist, size_t hashStartRange, size_t hashEndRange);
+
+    size_t size() const {
+        return offsets.size() - 1;
+    }
+
+    size_t kmerCount() const {
+        return offsets.back();
+    }
+};
 
 template  <int TYPE, typename T>
 size_t assignGroup(KmerPosition<T> *kmers, size_t splitKmerCount, bool includeOnlyExtendable, int covMode, float covThr);
@@ -207,7 +233,7 @@ size_t queueNextEntry(KmerPositionQueue &queue, int file, size_t offsetPos, T *e
 void setKmerLengthAndAlphabet(Parameters &parameters, size_t aaDbSize, int seqType);
 
 template <int TYPE, typename T, typename seqLenType>
-void writeKmersToDisk(std::string tmpFile, KmerPosition<seqLenType> *kmers, size_t totalKmers);
+void writeKmersToDisk(KmerSpillWriter &writer, std::string tmpFile, KmerPosition<seqLenType> *kmers, size_t totalKmers);
 
 template <int TYPE, typename T>
 void writeKmerMatcherResult(DBWriter & dbw, KmerPosition<T> *hashSeqPair, size_t totalKmers,
@@ -215,16 +241,17 @@ void writeKmerMatcherResult(DBWriter & dbw, KmerPosition<T> *hashSeqPair, size_t
 
 
 template <typename T>
-KmerPosition<T> * doComputation(size_t totalKmers, size_t split, size_t splits, std::string splitFile,
-                                DBReader<unsigned int> & seqDbr, Parameters & par, BaseMatrix  * subMat,
-                                size_t KMER_SIZE, size_t chooseTopKmer, float chooseTopKmerScale = 0.0);
+KmerPosition<T> * doComputation(size_t totalKmers, size_t hashStartRange, size_t hashEndRange, std::string splitFile,
+                                KmerSpillWriter &spillWriter, DBReader<unsigned int> & seqDbr, Parameters & par, BaseMatrix  * subMat,
+                                const std::vector<size_t> &hashDist);
 template <typename T>
 KmerPosition<T> *initKmerPositionMemory(size_t size);
 
 template <int TYPE, typename T>
 std::pair<size_t, size_t>  fillKmerPositionArray(KmerPosition<T> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
                                                  Parameters & par, BaseMatrix * subMat, bool hashWholeSequence,
-                                                 size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution);
+                                                 size_t hashStartRange, size_t hashEndRange, size_t * hashDistribution,
+                                                 KmerBuckets * buckets = NULL);
 
 
 void maskSequence(int maskMode, int maskLowerCase,
@@ -233,8 +260,14 @@ void maskSequence(int maskMode, int maskLowerCase,
 template <typename T>
 size_t computeMemoryNeededLinearfilter(size_t totalKmer);
 
+// k-mers of a split that fit into memoryLimit together with the buffers needed to write the split to disk
+// and the bucket blocks of bucketThreads threads (0 if the split is not filled through KmerBuckets)
+template <typename T>
+size_t computeKmersPerSplitLinearfilter(size_t memoryLimit, int bucketThreads);
+
 template <typename T>
-std::vector<std::pair<size_t, size_t>> setupKmerSplits(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits);
+std::vector<std::pair<size_t, size_t>> setupKmerSplits(Parameters &par, BaseMatrix * subMat, DBReader<unsigned int> &seqDbr, size_t totalKmers, size_t splits,
+                                                       std::vector<size_t> *hashDistribution = NULL);
 
 size_t computeKmerCount(DBReader<unsigned int> &reader, size_t KMER_SIZE, size_t chooseTopKmer,
                         float chooseTopKmerScale = 0.0);
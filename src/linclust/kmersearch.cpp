@@ -15,6 +15,7 @@
 #include "KmerIndex.h"
 #include "FileUtil.h"
 #include "FastSort.h"
+#include "KmerRadixSort.h"
 
 #ifndef SIZE_T_MAX
 #define SIZE_T_MAX ((size_t) -1)
@@ -47,9 +48,9 @@ KmerSearch::ExtractKmerAndSortResult KmerSearch::extractKmerAndSort(size_t total
     Debug(Debug::INFO) << "Sort kmer ... ";
     timer.reset();
     if(Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)) {
-        SORT_PARALLEL(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<short>::compareRepSequenceAndIdAndPosReverse);
+        KmerRadixSort::sort<true>(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<short>::compareRepSequenceAndIdAndPosReverse);
     }else{
-        SORT_PARALLEL(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<short>::compareRepSequenceAndIdAndPos);
+        KmerRadixSort::sort<false>(hashSeqPair, hashSeqPair + elementsToSort, KmerPosition<short>::compareRepSequenceAndIdAndPos);
     }
 
 
@@ -212,6 +213,9 @@ int kmersearch(int argc, const char **argv, const Command &command) {
     size_t splits = static_cast<size_t>(std::ceil(static_cast<float>(totalSizeNeeded) / memoryLimit));
     size_t totalKmersPerSplit = std::max(static_cast<size_t>(1024+1),
                                          static_cast<size_t>(std::min(totalSizeNeeded, memoryLimit)/sizeof(KmerPosition<short>))+1);
+    if (splits > 1) {
+        totalKmersPerSplit = std::max(static_cast<size_t>(1024+1), computeKmersPerSplitLinearfilter<short>(memoryLimit, 0) + 1);
+    }
 
     std::vector<std::pair<size_t, size_t>> hashRanges = setupKmerSplits<short>(par, subMat, queryDbr, totalKmersPerSplit, splits);
 
@@ -219,6 +223,7 @@ int kmersearch(int argc, const char **argv, const Command &command) {
     Debug(Debug::INFO) << "Process file into " << hashRanges.size() << " parts\n";
 
     std::vector<std::string> splitFiles;
+    KmerSpillWriter spillWriter(par.compressed);
     for (size_t split = 0; split < hashRanges.size(); split++) {
         tidxdbr.remapData();
         char *entriesData = tidxdbr.getDataUncompressed(tidxdbr.getId(PrefilteringIndexReader::ENTRIES));
@@ -263,15 +268,15 @@ int kmersearch(int argc, const char **argv, const Command &command) {
                 dbw.close();
             } else {
                 if (Parameters::isEqualDbtype(queryDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)) {
-                    writeKmersToDisk<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev, short>(tmpFiles.first, kmers,
-                                                                                          kmerCount );
+                    writeKmersToDisk<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev, short>(spillWriter, tmpFiles.first, kmers, kmerCount);
                 } else {
-                    writeKmersToDisk<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry, short>(tmpFiles.first, kmers, kmerCount );
+                    writeKmersToDisk<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry, short>(spillWriter, tmpFiles.first, kmers, kmerCount);
                 }
             }
             delete[] kmers;
         }
     }
+    spillWriter.wait();
     delete subMat;
     tidxdbr.close();
     queryDbr.close();
@@ -420,9 +425,9 @@ std::pair<KmerPosition<short> *,size_t > KmerSearch::searchInIndex(KmerPosition<
     Debug(Debug::INFO) << "Time to find k-mers: " << timer.lap() << "\n";
     timer.reset();
     if(TYPE == Parameters::DBTYPE_NUCLEOTIDES) {
-        SORT_PARALLEL(kmers, kmers + writePos, KmerPosition<short>::compareRepSequenceAndIdAndDiagReverse);
+        KmerRadixSort::sort<true>(kmers, kmers + writePos, KmerPosition<short>::compareRepSequenceAndIdAndDiagReverse);
     }else{
-        SORT_PARALLEL(kmers, kmers + writePos, KmerPosition<short>::compareRepSequenceAndIdAndDiag);
+        KmerRadixSort::sort<false>(kmers, kmers + writePos, KmerPosition<short>::compareRepSequenceAndIdAndDiag);
     }
 
     Debug(Debug::INFO) << "Time to sort: " << timer.lap() << "\n";
@@ -50,6 +50,49 @@ public:
 };
 
 
+static void fillEntries(IndexTable *indexTable, SequenceLookup *sequenceLookup, BaseMatrix &subMat, Sequence *seq,
+                        DBReader<unsigned int> *dbr, size_t dbFrom, size_t dbTo, int kmerThr, char *idScoreLookup, bool isProfile) {
+    Debug::Progress progress(dbTo-dbFrom);
+
+    #pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        Sequence s(seq->getMaxLen(), seq->getSeqType(), &subMat, seq->getKmerSize(), seq->isSpaced(), false, true, seq->getUserSpacedKmerPattern());
+        Indexer idxer(static_cast<unsigned int>(indexTable->getAlphabetSize()), seq->getKmerSize());
+        IndexEntryLocalTmp *buffer = static_cast<IndexEntryLocalTmp *>(malloc( seq->getMaxLen() * sizeof(IndexEntryLocalTmp)));
+        size_t bufferSize = seq->getMaxLen();
+        KmerGenerator *generator = NULL;
+        if (isProfile) {
+            generator = new KmerGenerator(seq->getKmerSize(), indexTable->getAlphabetSize(), kmerThr);
+            generator->setDivideStrategy(s.profile_matrix);
+        }
+
+        #pragma omp for schedule(dynamic, 100)
+        for (size_t id = dbFrom; id < dbTo; id++) {
+            s.resetCurrPos();
+            progress.updateProgress();
+
+            unsigned int qKey = dbr->getDbKey(id);
+            if (isProfile) {
+                s.mapSequence(id - dbFrom, qKey, dbr->getData(id, thread_idx), dbr->getSeqLen(id));
+                indexTable->addSimilarSequence(&s, generator, &buffer, bufferSize, &idxer);
+            } else {
+                s.mapSequence(id - dbFrom, qKey, sequenceLookup->getSequence(id - dbFrom));
+                indexTable->addSequence(&s, &idxer, &buffer, bufferSize, kmerThr, idScoreLookup);
+            }
+        }
+
+        if (generator != NULL) {
+            delete generator;
+        }
+
+        free(buffer);
+    }
+}
+
 void IndexBuilder::fillDatabase(IndexTable *indexTable, SequenceLookup **maskedLookup,
                                 SequenceLookup **unmaskedLookup,BaseMatrix &subMat, Sequence *seq,
                                 DBReader<unsigned int> *dbr, size_t dbFrom, size_t dbTo, int kmerThr,
@@ -204,53 +247,25 @@ void IndexBuilder::fillDatabase(IndexTable *indexTable, SequenceLookup **maskedL
 //    Debug(Debug::INFO) << "Index table: Remove "<< lowSelectiveResidues <<" none selective residues\n";
 //    Debug(Debug::INFO) << "Index table: init... from "<< dbFrom << " to "<< dbTo << "\n";
 
-    indexTable->initMemory(info->tableSize);
-    indexTable->init();
-
+    const size_t indexedSequences = info->tableSize;
     delete info;
-    Debug::Progress progress2(dbTo-dbFrom);
 
     Debug(Debug::INFO) << "Index table: fill\n";
-    #pragma omp parallel
-    {
-        unsigned int thread_idx = 0;
-#ifdef OPENMP
-        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
-#endif
-        Sequence s(seq->getMaxLen(), seq->getSeqType(), &subMat, seq->getKmerSize(), seq->isSpaced(), false, true, seq->getUserSpacedKmerPattern());
-        Indexer idxer(static_cast<unsigned int>(indexTable->getAlphabetSize()), seq->getKmerSize());
-        IndexEntryLocalTmp *buffer = static_cast<IndexEntryLocalTmp *>(malloc( seq->getMaxLen() * sizeof(IndexEntryLocalTmp)));
-        size_t bufferSize = seq->getMaxLen();
-        KmerGenerator *generator = NULL;
-        if (isProfile) {
-            generator = new KmerGenerator(seq->getKmerSize(), indexTable->getAlphabetSize(), kmerThr);
-            generator->setDivideStrategy(s.profile_matrix);
-        }
-
-        #pragma omp for schedule(dynamic, 100)
-        for (size_t id = dbFrom; id < dbTo; id++) {
-            s.resetCurrPos();
-            progress2.updateProgress();
-
-            unsigned int qKey = dbr->getDbKey(id);
-            if (isProfile) {
-                s.mapSequence(id - dbFrom, qKey, dbr->getData(id, thread_idx), dbr->getSeqLen(id));
-                indexTable->addSimilarSequence(&s, generator, &buffer, bufferSize, &idxer);
-            } else {
-                s.mapSequence(id - dbFrom, qKey, sequenceLookup->getSequence(id - dbFrom));
-                indexTable->addSequence(&s, &idxer, &buffer, bufferSize, kmerThr, idScoreLookup);
-            }
+    if (indexTable->isPacked()) {
+        indexTable->initPacking(indexedSequences);
+        const size_t maxBlockEntries = IndexTable::getPackingBlockEntries(indexTable->getTableEntriesNum());
+        while (indexTable->startBlock(maxBlockEntries)) {
+            fillEntries(indexTable, sequenceLookup, subMat, seq, dbr, dbFrom, dbTo, kmerThr, idScoreLookup, isProfile);
+            indexTable->packBlock();
         }
-
-        if (generator != NULL) {
-            delete generator;
-        }
-
-        free(buffer);
+    } else {
+        indexTable->initMemory(indexedSequences);
+        indexTable->init();
+        fillEntries(indexTable, sequenceLookup, subMat, seq, dbr, dbFrom, dbTo, kmerThr, idScoreLookup, isProfile);
+        indexTable->revertPointer();
+        indexTable->sortDBSeqLists();
     }
     if(idScoreLookup!=NULL){
         delete[] idScoreLookup;
     }
-    indexTable->revertPointer();
-    indexTable->sortDBSeqLists();
 }
@@ -17,6 +17,7 @@
 #include "KmerGenerator.h"
 #include "Parameters.h"
 #include "FastSort.h"
+#include "MemoryPlacement.h"
 #include <stdlib.h>
 #include <algorithm>
 
@@ -62,15 +63,20 @@ struct __attribute__((__packed__)) IndexEntryLocalTmp {
     }
 };
 
+// Packed index tables store each k-mer list as varints: the number of entries, followed by
+// the seqId difference to the previous entry and the position for each entry of the list.
+// Offsets point to the first byte of a list and empty lists take no space.
 class IndexTable {
 public:
-    IndexTable(int alphabetSize, int kmerSize, bool externalData)
+    IndexTable(int alphabetSize, int kmerSize, bool externalData, bool packed = false)
             : tableSize(MathUtil::ipow<size_t>(alphabetSize, kmerSize)), alphabetSize(alphabetSize),
-              kmerSize(kmerSize), externalData(externalData), tableEntriesNum(0), size(0),
-              indexer(new Indexer(alphabetSize, kmerSize)), entries(NULL), offsets(NULL) {
+              kmerSize(kmerSize), externalData(externalData), packed(packed), tableEntriesNum(0), size(0),
+              indexer(new Indexer(alphabetSize, kmerSize)), entries(NULL), offsets(NULL),
+              packedEntries(NULL), packedSize(0), blockKmerFrom(0), blockKmerTo(0), blockEntryFrom(0), blockFill(NULL) {
         if (externalData == false) {
             offsets = new(std::nothrow) size_t[tableSize + 1];
             Util::checkAllocation(offsets, "Can not allocate entries memory in IndexTable");
+            MemoryPlacement::advise(offsets, (tableSize + 1) * sizeof(size_t));
             memset(offsets, 0, (tableSize + 1) * sizeof(size_t));
         }
     }
@@ -90,6 +96,10 @@ public:
                 delete[] offsets;
                 offsets = NULL;
             }
+            if (packedEntries != NULL) {
+                free(packedEntries);
+                packedEntries = NULL;
+            }
         }
     }
 
@@ -176,6 +186,40 @@ public:
         return (entries + offsets[kmer]);
     }
 
+    // get the packed list of DB sequences containing this k-mer, decode it with unpackDBSeqList
+    inline const unsigned char *getPackedDBSeqList(size_t kmer, size_t *matchedListSize) {
+        const unsigned char *data = packedEntries + offsets[kmer];
+        if (offsets[kmer + 1] == offsets[kmer]) {
+            *matchedListSize = 0;
+            return data;
+        }
+        *matchedListSize = readVarint(&data);
+        return data;
+    }
+
+    static inline void unpackDBSeqList(const unsigned char *data, size_t listSize, IndexEntryLocal *out) {
+        unsigned int seqId = 0;
+        for (size_t i = 0; i < listSize; i++) {
+            seqId += static_cast<unsigned int>(readVarint(&data));
+            out[i].seqId = seqId;
+            out[i].position_j = static_cast<unsigned short>(readVarint(&data));
+        }
+    }
+
+    bool isPacked() {
+        return packed;
+    }
+
+    // number of entries in the list of this k-mer
+    size_t getListSize(size_t kmer) {
+        if (packed) {
+            size_t listSize;
+            getPackedDBSeqList(kmer, &listSize);
+            return listSize;
+        }
+        return offsets[kmer + 1] - offsets[kmer];
+    }
+
     void sortDBSeqLists() {
         #pragma omp parallel for
         for (size_t i = 0; i < tableSize; i++) {
@@ -190,6 +234,15 @@ public:
         return entries;
     }
 
+    // entries array as stored in the index file
+    char *getEntriesData() {
+        return packed ? (char *) packedEntries : (char *) entries;
+    }
+
+    size_t getEntriesDataSize() {
+        return packed ? packedSize : tableEntriesNum * sizeof(IndexEntryLocal);
+    }
+
     inline size_t getOffset(size_t kmer) {
         return offsets[kmer];
     }
@@ -211,6 +264,108 @@ public:
         // allocate memory for the sequence id lists
         entries = new(std::nothrow) IndexEntryLocal[tableEntriesNum];
         Util::checkAllocation(entries, "Can not allocate entries memory in IndexTable::initMemory");
+        MemoryPlacement::advise(entries, tableEntriesNum * sizeof(IndexEntryLocal));
+    }
+
+    // the lists of a packed table are filled and packed in blocks of k-mers, so the whole
+    // table of fixed size entries never has to be kept in memory
+    void initPacking(size_t dbSize) {
+        size_t tableEntriesNum = 0;
+        for (size_t i = 0; i < getTableSize(); i++) {
+            tableEntriesNum += getOffset(i);
+        }
+        this->tableEntriesNum = tableEntriesNum;
+        this->size = dbSize;
+        init();
+    }
+
+    // next block of k-mers that fits into maxBlockEntries, returns false after the last block
+    bool startBlock(size_t maxBlockEntries) {
+        if (blockKmerTo >= tableSize) {
+            return false;
+        }
+        blockKmerFrom = blockKmerTo;
+        blockEntryFrom = offsets[blockKmerFrom];
+        blockKmerTo = blockKmerFrom + 1;
+        while (blockKmerTo < tableSize && offsets[blockKmerTo + 1] - blockEntryFrom <= maxBlockEntries) {
+            blockKmerTo++;
+        }
+        const size_t blockEntries = offsets[blockKmerTo] - blockEntryFrom;
+        entries = new(std::nothrow) IndexEntryLocal[std::max(blockEntries, (size_t) 1)];
+        Util::checkAllocation(entries, "Can not allocate entries memory in IndexTable::startBlock");
+        blockFill = new(std::nothrow) unsigned int[blockKmerTo - blockKmerFrom];
+        Util::checkAllocation(blockFill, "Can not allocate block memory in IndexTable::startBlock");
+        memset(blockFill, 0, (blockKmerTo - blockKmerFrom) * sizeof(unsigned int));
+        return true;
+    }
+
+    // sorts and packs the lists of the current block and appends them to the packed entries
+    void packBlock() {
+        const size_t blockKmers = blockKmerTo - blockKmerFrom;
+        size_t *listBytes = new(std::nothrow) size_t[blockKmers + 1];
+        Util::checkAllocation(listBytes, "Can not allocate block memory in IndexTable::packBlock");
+        delete[] blockFill;
+        blockFill = NULL;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (size_t i = 0; i < blockKmers; i++) {
+            const size_t kmer = blockKmerFrom + i;
+            const size_t listSize = offsets[kmer + 1] - offsets[kmer];
+            IndexEntryLocal *list = entries + (offsets[kmer] - blockEntryFrom);
+            SORT_SERIAL(list, list + listSize, IndexEntryLocal::comapreByIdAndPos);
+            size_t bytes = 0;
+            if (listSize > 0) {
+                bytes = varintSize(listSize);
+                unsigned int prevSeqId = 0;
+                for (size_t j = 0; j < listSize; j++) {
+                    bytes += varintSize(list[j].seqId - prevSeqId) + varintSize(list[j].position_j);
+                    prevSeqId = list[j].seqId;
+                }
+            }
+            listBytes[i] = bytes;
+        }
+
+        size_t blockBytes = 0;
+        for (size_t i = 0; i < blockKmers; i++) {
+            const size_t bytes = listBytes[i];
+            listBytes[i] = packedSize + blockBytes;
+            blockBytes += bytes;
+        }
+        listBytes[blockKmers] = packedSize + blockBytes;
+
+        packedEntries = static_cast<unsigned char *>(realloc(packedEntries, std::max(packedSize + blockBytes, (size_t) 1)));
+        Util::checkAllocation(packedEntries, "Can not allocate packed entries memory in IndexTable::packBlock");
+        MemoryPlacement::advise(packedEntries + packedSize, blockBytes);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (size_t i = 0; i < blockKmers; i++) {
+            const size_t kmer = blockKmerFrom + i;
+            const size_t listSize = offsets[kmer + 1] - offsets[kmer];
+            if (listSize == 0) {
+                continue;
+            }
+            const IndexEntryLocal *list = entries + (offsets[kmer] - blockEntryFrom);
+            unsigned char *data = packedEntries + listBytes[i];
+            writeVarint(&data, listSize);
+            unsigned int prevSeqId = 0;
+            for (size_t j = 0; j < listSize; j++) {
+                writeVarint(&data, list[j].seqId - prevSeqId);
+                writeVarint(&data, list[j].position_j);
+                prevSeqId = list[j].seqId;
+            }
+        }
+
+        // offsets of the following blocks still count entries, only replace the ones of this block
+        for (size_t i = 0; i < blockKmers; i++) {
+            offsets[blockKmerFrom + i] = listBytes[i];
+        }
+        packedSize = listBytes[blockKmers];
+        if (blockKmerTo == tableSize) {
+            offsets[tableSize] = packedSize;
+        }
+        delete[] listBytes;
+        delete[] entries;
+        entries = NULL;
     }
 
     // allocates memory for index tables
@@ -234,12 +389,35 @@ public:
         this->offsets = entryOffsets;
     }
 
+    void initPackedTableByExternalData(size_t sequenceCount, size_t tableEntriesNum, unsigned char *packedEntries, size_t packedSize, size_t *entryOffsets) {
+        this->tableEntriesNum = tableEntriesNum;
+        this->size = sequenceCount;
+
+        this->packedEntries = packedEntries;
+        this->packedSize = packedSize;
+        this->offsets = entryOffsets;
+    }
+
+    void initPackedTableByExternalDataCopy(size_t sequenceCount, size_t tableEntriesNum, unsigned char *packedEntries, size_t packedSize, size_t *entryOffsets) {
+        this->tableEntriesNum = tableEntriesNum;
+        this->size = sequenceCount;
+
+        this->packedEntries = static_cast<unsigned char *>(malloc(std::max(packedSize, (size_t) 1)));
+        Util::checkAllocation(this->packedEntries, "Can not allocate " + SSTR(packedSize) + " bytes for packed entries in IndexTable");
+        MemoryPlacement::advise(this->packedEntries, packedSize);
+        memcpy(this->packedEntries, packedEntries, packedSize);
+        this->packedSize = packedSize;
+
+        memcpy(this->offsets, entryOffsets, (tableSize + 1) * sizeof(size_t));
+    }
+
     void initTableByExternalDataCopy(size_t sequenceCount, size_t tableEntriesNum, IndexEntryLocal *entries, size_t *entryOffsets) {
         this->tableEntriesNum = tableEntriesNum;
         this->size = sequenceCount;
 
         this->entries = new(std::nothrow) IndexEntryLocal[tableEntriesNum];
         Util::checkAllocation(entries, "Can not allocate " + SSTR(tableEntriesNum * sizeof(IndexEntryLocal)) + " bytes for entries in IndexTable::initMemory");
+        MemoryPlacement::advise(this->entries, tableEntriesNum * sizeof(IndexEntryLocal));
         memcpy(this->entries, entries, tableEntriesNum * sizeof(IndexEntryLocal));
 
         memcpy(this->offsets, entryOffsets, (tableSize + 1) * sizeof(size_t));
@@ -263,7 +441,7 @@ public:
         size_t minKmer = 0;
         size_t emptyKmer = 0;
         for (size_t i = 0; i < tableSize; i++) {
-            const ptrdiff_t size = offsets[i + 1] - offsets[i];
+            const size_t size = getListSize(i);
             minKmer = std::min(minKmer, (size_t) size);
             entrySize += size;
             if (size == 0) {
@@ -283,7 +461,7 @@ public:
         double avgKmer = ((double) entrySize) / ((double) tableSize);
         Debug(Debug::INFO) << "Index statistics\n";
         Debug(Debug::INFO) << "Entries:          " << entrySize << "\n";
-        Debug(Debug::INFO) << "DB size:          " << (entrySize * sizeof(IndexEntryLocal) + tableSize * sizeof(size_t))/1024/1024 << " MB\n";
+        Debug(Debug::INFO) << "DB size:          " << (getEntriesDataSize() + tableSize * sizeof(size_t))/1024/1024 << " MB\n";
         Debug(Debug::INFO) << "Avg k-mer size:   " << avgKmer << "\n";
         Debug(Debug::INFO) << "Top " << top_N << " k-mers\n";
         for (size_t j = 0; j < top_N; j++) {
@@ -328,10 +506,7 @@ public:
         for(size_t pos = 0; pos < kmerPos; pos++){
             unsigned int kmerIdx = (*buffer)[pos].kmer;
             if(kmerIdx != prevKmer){
-                size_t offset = __sync_fetch_and_add(&(offsets[kmerIdx]), 1);
-                IndexEntryLocal *entry = &entries[offset];
-                entry->seqId      = (*buffer)[pos].seqId;
-                entry->position_j = (*buffer)[pos].position_j;
+                addEntry(kmerIdx, (*buffer)[pos].seqId, (*buffer)[pos].position_j);
             }
             prevKmer = kmerIdx;
         }
@@ -384,10 +559,7 @@ public:
         for(size_t pos = 0; pos < kmerPos; pos++){
             unsigned int kmerIdx = (*buffer)[pos].kmer;
             if(kmerIdx != prevKmer){
-                size_t offset = __sync_fetch_and_add(&(offsets[kmerIdx]), 1);
-                IndexEntryLocal *entry = &entries[offset];
-                entry->seqId      = (*buffer)[pos].seqId;
-                entry->position_j = (*buffer)[pos].position_j;
+                addEntry(kmerIdx, (*buffer)[pos].seqId, (*buffer)[pos].position_j);
             }
             prevKmer = kmerIdx;
         }
@@ -395,6 +567,9 @@ public:
 
     // prints the IndexTable
     void print(char *num2aa) {
+        if (packed) {
+            return;
+        }
         for (size_t i = 0; i < tableSize; i++) {
             ptrdiff_t entrySize = offsets[i + 1] - offsets[i];
             if (entrySize > 0) {
@@ -434,6 +609,54 @@ public:
     }
 
 
+    // maximal number of fixed size entries that are filled at once while packing a table
+    static size_t getPackingBlockEntries(size_t tableEntriesNum) {
+        // every block needs another pass over the database, so only use more than one for large tables
+        return std::max(tableEntriesNum / 4, (size_t) 128 * 1024 * 1024);
+    }
+
+    // approx. bytes of the varint packed lists of entriesNum entries of sequenceCount sequences with
+    // avgSeqLen residues, the lists of a k-mer are spread evenly over the sequences
+    static size_t estimatePackedEntriesSize(size_t tableSize, size_t entriesNum, size_t sequenceCount, size_t avgSeqLen) {
+        if (entriesNum == 0) {
+            return 0;
+        }
+        const size_t usedLists = std::min(tableSize, entriesNum);
+        const size_t avgListSize = std::max(entriesNum / usedLists, (size_t) 1);
+        const size_t avgSeqIdDelta = std::max(sequenceCount / avgListSize, (size_t) 1);
+        return usedLists * varintSize(avgListSize)
+               + entriesNum * (varintSize(avgSeqIdDelta) + varintSize(avgSeqLen));
+    }
+
+    static inline size_t varintSize(size_t value) {
+        size_t bytes = 1;
+        while (value >= 0x80) {
+            value >>= 7;
+            bytes++;
+        }
+        return bytes;
+    }
+
+    static inline void writeVarint(unsigned char **data, size_t value) {
+        while (value >= 0x80) {
+            *((*data)++) = static_cast<unsigned char>(value | 0x80);
+            value >>= 7;
+        }
+        *((*data)++) = static_cast<unsigned char>(value);
+    }
+
+    static inline size_t readVarint(const unsigned char **data) {
+        size_t value = 0;
+        unsigned int shift = 0;
+        unsigned char byte;
+        do {
+            byte = *((*data)++);
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value;
+    }
+
     static size_t getUpperBoundAACountForKmerSize(int kmerSize) {
         switch (kmerSize) {
             case 6:
@@ -459,6 +682,22 @@ public:
     }
 
 protected:
+    inline void addEntry(unsigned int kmerIdx, unsigned int seqId, unsigned short position_j) {
+        IndexEntryLocal *entry;
+        if (blockFill == NULL) {
+            size_t offset = __sync_fetch_and_add(&(offsets[kmerIdx]), 1);
+            entry = &entries[offset];
+        } else {
+            if (kmerIdx < blockKmerFrom || kmerIdx >= blockKmerTo) {
+                return;
+            }
+            size_t offset = offsets[kmerIdx] - blockEntryFrom + __sync_fetch_and_add(&(blockFill[kmerIdx - blockKmerFrom]), 1);
+            entry = &entries[offset];
+        }
+        entry->seqId      = seqId;
+        entry->position_j = position_j;
+    }
+
     // alphabetSize**kmerSize
     const size_t tableSize;
     const int alphabetSize;
@@ -466,6 +705,8 @@ protected:
 
     // external data from mmap
     const bool externalData;
+    // k-mer lists are varint packed
+    const bool packed;
 
     // number of entries in all sequence lists - must be 64bit
     uint64_t tableEntriesNum;
@@ -478,6 +719,14 @@ protected:
     IndexEntryLocal *entries;
     size_t *offsets;
 
+    unsigned char *packedEntries;
+    size_t packedSize;
+    // k-mers [blockKmerFrom, blockKmerTo) that are currently filled before packing
+    size_t blockKmerFrom;
+    size_t blockKmerTo;
+    size_t blockEntryFrom;
+    unsigned int *blockFill;
+
     // sequence lookup
     SequenceLookup *sequenceLookup;
 };
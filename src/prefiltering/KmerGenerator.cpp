@@ -8,12 +8,17 @@ KmerGenerator::KmerGenerator(size_t kmerSize, size_t alphabetSize, short thresho
     this->threshold = threshold;
     this->kmerSize = kmerSize;
     this->indexer = new Indexer((int) alphabetSize, (int)kmerSize);
+    this->cache = NULL;
 //    calcDivideStrategy();
 }
 
 void KmerGenerator::setThreshold(short threshold){
     this->threshold = threshold;
 }
+
+void KmerGenerator::setCache(KmerSimilarityCache * cache){
+    this->cache = cache;
+}
 KmerGenerator::~KmerGenerator(){
     delete [] this->stepMultiplicator;
     delete [] this->highestScorePerArray;
@@ -108,6 +113,15 @@ void KmerGenerator::initDataStructure(){
 
 
 std::pair<size_t *, size_t> KmerGenerator::generateKmerList(const unsigned char * int_seq, bool addIdentity){
+    const bool useCache = cache != NULL && addIdentity == false;
+    size_t cacheKmer = 0;
+    if(useCache){
+        cacheKmer = this->indexer->int2index(int_seq, 0, kmerSize);
+        std::pair<size_t *, size_t> cached;
+        if(cache->find(cacheKmer, threshold, cached)){
+            return cached;
+        }
+    }
     int dividerBefore=0;
     // pre compute phase
     // find first threshold
@@ -182,6 +196,9 @@ std::pair<size_t *, size_t> KmerGenerator::generateKmerList(const unsigned char
 
         return std::make_pair(outputIndexArray[0], 1);
     }
+    if(useCache){
+        cache->insert(cacheKmer, threshold, outputIndexArray[(i-1)%2], sizeInputMatrix);
+    }
     return std::make_pair(outputIndexArray[(i-1)%2], sizeInputMatrix);
 }
 
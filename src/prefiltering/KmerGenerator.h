@@ -4,6 +4,7 @@
 #include <vector>
 #include "Indexer.h"
 #include "ScoreMatrix.h"
+#include "KmerSimilarityCache.h"
 #include "Debug.h"
 
 
@@ -24,6 +25,10 @@ class KmerGenerator
         void setDivideStrategy(ScoreMatrix ** one);
 
 	    void setThreshold(short threshold);
+
+        /* lists are looked up in and added to the cache, only valid for
+           the substitution matrix strategy (3,2) */
+        void setCache(KmerSimilarityCache * cache);
     private:
     
         /*creates the product between two arrays and write it to the output array */
@@ -59,6 +64,7 @@ class KmerGenerator
         ScoreMatrix  ** matrixLookup;
         short        ** outputScoreArray;
         size_t       ** outputIndexArray;
+        KmerSimilarityCache * cache;
 
 
         /* init the output vectors for the kmer calculation*/
@@ -0,0 +1,123 @@
+#include "KmerSimilarityCache.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+KmerSimilarityCache::KmerSimilarityCache(size_t memory) : memory(memory), arenaUsed(0) {
+    size_t slotCount = 1024;
+    while (slotCount * BYTES_PER_SLOT < memory) {
+        slotCount <<= 1;
+    }
+    slotMask = slotCount - 1;
+    slots = static_cast<Slot *>(calloc(slotCount, sizeof(Slot)));
+    Util::checkAllocation(slots, "Can not allocate slots in KmerSimilarityCache");
+    const size_t slotMemory = slotCount * sizeof(Slot);
+    arenaSize = (memory > slotMemory) ? (memory - slotMemory) / sizeof(size_t) : 0;
+    arena = static_cast<size_t *>(malloc(std::max(arenaSize, (size_t) 1) * sizeof(size_t)));
+    Util::checkAllocation(arena, "Can not allocate arena in KmerSimilarityCache");
+}
+
+KmerSimilarityCache::~KmerSimilarityCache() {
+    free(arena);
+    free(slots);
+}
+
+bool KmerSimilarityCache::isSupported(size_t alphabetSize, size_t kmerSize) {
+    size_t kmerSpace = 1;
+    for (size_t i = 0; i < kmerSize; i++) {
+        kmerSpace *= alphabetSize;
+        if (kmerSpace > (static_cast<size_t>(1) << THRESHOLD_SHIFT)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void KmerSimilarityCache::insertKey(uint64_t key, const size_t *list, size_t length) {
+    Slot *slot = NULL;
+    for (size_t probe = 0; probe < MAX_PROBE && slot == NULL; probe++) {
+        Slot &candidate = slots[(hash(key) + probe) & slotMask];
+        if (candidate.key == key) {
+            // stored or being stored by another thread
+            return;
+        }
+        if (candidate.key == 0) {
+            if (__sync_bool_compare_and_swap(&candidate.key, 0, key)) {
+                slot = &candidate;
+            } else if (candidate.key == key) {
+                return;
+            }
+        }
+    }
+    if (slot == NULL || arenaUsed + length > arenaSize) {
+        return;
+    }
+    const size_t offset = __sync_fetch_and_add(&arenaUsed, length);
+    if (offset + length > arenaSize) {
+        // the claimed slot is never published and stays a miss
+        return;
+    }
+    memcpy(arena + offset, list, length * sizeof(size_t));
+    slot->offset = offset;
+    slot->length = length;
+    __sync_synchronize();
+    slot->ready = 1;
+}
+
+size_t KmerSimilarityCache::getListCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i <= slotMask; i++) {
+        count += (slots[i].ready != 0);
+    }
+    return count;
+}
+
+size_t KmerSimilarityCache::getUsedMemory() const {
+    return (slotMask + 1) * sizeof(Slot) + std::min(arenaUsed, arenaSize) * sizeof(size_t);
+}
+
+char *KmerSimilarityCache::serialize(size_t *size) const {
+    size_t count = 0;
+    *size = 2 * sizeof(uint64_t);
+    for (size_t i = 0; i <= slotMask; i++) {
+        if (slots[i].ready != 0) {
+            count++;
+            *size += (2 + slots[i].length) * sizeof(uint64_t);
+        }
+    }
+    char *data = static_cast<char *>(malloc(*size));
+    Util::checkAllocation(data, "Can not allocate serialize memory in KmerSimilarityCache");
+    uint64_t *p = reinterpret_cast<uint64_t *>(data);
+    *p++ = memory;
+    *p++ = count;
+    for (size_t i = 0; i <= slotMask; i++) {
+        if (slots[i].ready != 0) {
+            *p++ = slots[i].key;
+            *p++ = slots[i].length;
+            for (size_t j = 0; j < slots[i].length; j++) {
+                *p++ = arena[slots[i].offset + j];
+            }
+        }
+    }
+    return data;
+}
+
+size_t KmerSimilarityCache::getSerializedMemory(const char *data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(uint64_t));
+    return static_cast<size_t>(value);
+}
+
+void KmerSimilarityCache::unserialize(const char *data) {
+    const uint64_t *p = reinterpret_cast<const uint64_t *>(data);
+    const uint64_t count = p[1];
+    p += 2;
+    for (uint64_t i = 0; i < count; i++) {
+        const uint64_t key = p[0];
+        const uint64_t length = p[1];
+        insertKey(key, reinterpret_cast<const size_t *>(p + 2), length);
+        p += 2 + length;
+    }
+}
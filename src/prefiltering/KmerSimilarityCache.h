@@ -0,0 +1,90 @@
+#ifndef MMSEQS_KMERSIMILARITYCACHE_H
+#define MMSEQS_KMERSIMILARITYCACHE_H
+
+// Similar k-mer lists of sequence queries, shared by all prefilter threads.
+// For a substitution matrix the list only depends on the k-mer and the score threshold,
+// which varies between query positions through the composition bias correction. Both
+// together are the key. Slots are claimed with a CAS and published after their list was
+// copied into the arena. Nothing is evicted: once the arena is full new lists are no
+// longer stored.
+#include <cstddef>
+#include <stdint.h>
+#include <utility>
+
+class KmerSimilarityCache {
+public:
+    KmerSimilarityCache(size_t memory);
+    ~KmerSimilarityCache();
+
+    // keys hold the k-mer index in the lower 48 bits
+    static bool isSupported(size_t alphabetSize, size_t kmerSize);
+
+    bool find(size_t kmer, short threshold, std::pair<size_t *, size_t> &list) const {
+        const uint64_t key = makeKey(kmer, threshold);
+        for (size_t probe = 0; probe < MAX_PROBE; probe++) {
+            const Slot &slot = slots[(hash(key) + probe) & slotMask];
+            const uint64_t slotKey = slot.key;
+            if (slotKey == 0) {
+                return false;
+            }
+            if (slotKey == key) {
+                if (slot.ready == 0) {
+                    return false;
+                }
+                __sync_synchronize();
+                list = std::make_pair(arena + slot.offset, static_cast<size_t>(slot.length));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(size_t kmer, short threshold, const size_t *list, size_t length) {
+        insertKey(makeKey(kmer, threshold), list, length);
+    }
+
+    size_t getListCount() const;
+    size_t getUsedMemory() const;
+    size_t getMemory() const {
+        return memory;
+    }
+
+    // all published lists, used to store the cache in the index
+    char *serialize(size_t *size) const;
+    // adds the lists of a serialized cache, returns the memory it was created with
+    static size_t getSerializedMemory(const char *data);
+    void unserialize(const char *data);
+
+private:
+    struct Slot {
+        uint64_t key;
+        uint64_t offset;
+        uint64_t length;
+        volatile uint64_t ready;
+    };
+
+    static const size_t MAX_PROBE = 16;
+    static const int THRESHOLD_SHIFT = 48;
+    // bytes of the budget spent on slots
+    static const size_t BYTES_PER_SLOT = 512;
+
+    size_t memory;
+    Slot *slots;
+    size_t slotMask;
+    size_t *arena;
+    size_t arenaSize;
+    size_t arenaUsed;
+
+    // 0 marks an empty slot
+    static uint64_t makeKey(size_t kmer, short threshold) {
+        return ((static_cast<uint64_t>(threshold) << THRESHOLD_SHIFT) | kmer) + 1;
+    }
+
+    static size_t hash(uint64_t key) {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 20);
+    }
+
+    void insertKey(uint64_t key, const size_t *list, size_t length);
+};
+
+#endif
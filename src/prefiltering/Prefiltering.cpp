@@ -13,6 +13,8 @@
 #include "Parameters.h"
 #include "MemoryMapped.h"
 #include "FastSort.h"
+#include "PerfReport.h"
+#include "MemoryPlacement.h"
 #include <sys/mman.h>
 
 #ifdef OPENMP
@@ -24,7 +26,7 @@ Prefiltering::Prefiltering(const std::string &queryDB,
                            const std::string &targetDB,
                            const std::string &targetDBIndex,
                            int querySeqType, int targetSeqType,
-                           const Parameters &par) :
+                           const Parameters &par, PrefilterHitConsumer *hitConsumer) :
         queryDB(queryDB),
         queryDBIndex(queryDBIndex),
         targetDB(targetDB),
@@ -50,8 +52,10 @@ Prefiltering::Prefiltering(const std::string &queryDB,
         aaBiasCorrection(par.compBiasCorrection != 0),
         covThr(par.covThr), covMode(par.covMode), includeIdentical(par.includeIdentity),
         preloadMode(par.preloadMode),
-        threads(static_cast<unsigned int>(par.threads)), compressed(par.compressed) {
+        threads(static_cast<unsigned int>(par.threads)), compressed(par.compressed), prefFormat(par.prefFormat), packedIndex(par.packedIndex),
+        batchSize(static_cast<size_t>(std::max(par.prefBatchSize, 1))), hitConsumer(hitConsumer) {
     sameQTDB = isSameQTDB();
+    MemoryPlacement::setMode(par.indexPlacement);
 
     // init the substitution matrices
     switch (querySeqType & 0x7FFFFFFF) {
@@ -83,11 +87,14 @@ Prefiltering::Prefiltering(const std::string &queryDB,
 
     if (Parameters::isEqualDbtype(FileUtil::parseDbType(targetDB.c_str()), Parameters::DBTYPE_INDEX_DB)) {
         if (preloadMode == Parameters::PRELOAD_MODE_AUTO) {
-            if (sensitivity > 6.0) {
+            // only index memory read into anonymous pages can be placed
+            if (sensitivity > 6.0 || par.indexPlacement != Parameters::INDEX_PLACEMENT_DEFAULT) {
                 preloadMode = Parameters::PRELOAD_MODE_FREAD;
             } else {
                 preloadMode = Parameters::PRELOAD_MODE_MMAP_TOUCH;
             }
+        } else if (preloadMode != Parameters::PRELOAD_MODE_FREAD && par.indexPlacement != Parameters::INDEX_PLACEMENT_DEFAULT) {
+            Debug(Debug::WARNING) << "--index-placement has no effect on a memory mapped index, use --db-load-mode 1\n";
         }
 
         tidxdbr = new DBReader<unsigned int>(targetDB.c_str(), targetDBIndex.c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
@@ -148,6 +155,7 @@ Prefiltering::Prefiltering(const std::string &queryDB,
                 EXIT(EXIT_FAILURE);
             }
 
+            packedIndex = data.packed;
             splits = data.splits;
             if (data.splits > 1) {
                 splitMode = Parameters::TARGET_DB_SPLIT;
@@ -190,7 +198,8 @@ Prefiltering::Prefiltering(const std::string &queryDB,
     Debug(Debug::INFO) << "Query database size: " << qdbr->getSize() << " type: " << Parameters::getDbTypeName(querySeqType) << "\n";
 
     setupSplit(*tdbr, alphabetSize - 1, querySeqType,
-               threads, templateDBIsIndex, memoryLimit, qdbr->getSize(),
+               threads, packedIndex, hitConsumer != NULL ? hitConsumer->getThreadMemory() : 0,
+               templateDBIsIndex, memoryLimit, qdbr->getSize(),
                maxResListLen, kmerSize, splits, splitMode);
 
     if(Parameters::isEqualDbtype(targetSeqType, Parameters::DBTYPE_NUCLEOTIDES) == false){
@@ -220,10 +229,28 @@ Prefiltering::Prefiltering(const std::string &queryDB,
         _3merSubMatrix = getScoreMatrix(*kmerSubMat, 3);
         kmerSubMat->alphabetSize = alphabetSize;
     }
+
+    // the cache is only used with --similar-kmer-cache, also if the index contains precomputed lists
+    kmerCache = NULL;
+    const char *cacheData = (templateDBIsIndex == true) ? PrefilteringIndexReader::getSimilarKmerCache(tidxdbr) : NULL;
+    if (par.similarKmerCache > 0 && _3merSubMatrix.isValid() && _2merSubMatrix.isValid() && takeOnlyBestKmer == false
+        && KmerSimilarityCache::isSupported(alphabetSize - 1, kmerSize)) {
+        kmerCache = new KmerSimilarityCache(par.similarKmerCache);
+        if (cacheData != NULL) {
+            kmerCache->unserialize(cacheData);
+            Debug(Debug::INFO) << "Similar k-mer lists loaded from index: " << kmerCache->getListCount() << "\n";
+        }
+    } else if (cacheData != NULL && par.similarKmerCache == 0) {
+        Debug(Debug::INFO) << "Index contains similar k-mer lists, use --similar-kmer-cache to search with them\n";
+    }
 }
 
 Prefiltering::~Prefiltering() {
-    if (sameQTDB == false) {
+    if (kmerCache != NULL) {
+        delete kmerCache;
+    }
+
+    if (qdbr != tdbr) {
         qdbr->close();
         delete qdbr;
     }
@@ -255,12 +282,40 @@ Prefiltering::~Prefiltering() {
     delete kmerSubMat;
 }
 
+void Prefiltering::setQueryDatabase(const std::string &queryDB, const std::string &queryDBIndex) {
+    if (qdbr != tdbr) {
+        qdbr->close();
+        delete qdbr;
+    }
+    this->queryDB = queryDB;
+    this->queryDBIndex = queryDBIndex;
+    sameQTDB = isSameQTDB();
+    if (templateDBIsIndex == false && sameQTDB == true) {
+        qdbr = tdbr;
+    } else {
+        qdbr = new DBReader<unsigned int>(queryDB.c_str(), queryDBIndex.c_str(), threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        qdbr->open(DBReader<unsigned int>::LINEAR_ACCCESS);
+    }
+    // profile state searches are set up with the converted query type
+    const int expectedType = Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_PROFILE_STATE_PROFILE) ? Parameters::DBTYPE_HMM_PROFILE : querySeqType;
+    if (Parameters::isEqualDbtype(qdbr->getDbtype(), expectedType) == false) {
+        Debug(Debug::ERROR) << "Query database " << queryDB << " has type " << Parameters::getDbTypeName(qdbr->getDbtype())
+                            << " but the prefilter was set up for " << Parameters::getDbTypeName(expectedType) << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    Debug(Debug::INFO) << "Query database size: " << qdbr->getSize() << " type: " << Parameters::getDbTypeName(querySeqType) << "\n";
+}
+
+void Prefiltering::setHitConsumer(PrefilterHitConsumer *consumer) {
+    hitConsumer = consumer;
+}
+
 void Prefiltering::setupSplit(DBReader<unsigned int>& tdbr, const int alphabetSize, const unsigned int querySeqTyp, const int threads,
-                              const bool templateDBIsIndex, const size_t memoryLimit, const size_t qDbSize,
+                              const int packedIndex, const size_t consumerThreadMemory, const bool templateDBIsIndex, const size_t memoryLimit, const size_t qDbSize,
                               size_t &maxResListLen, int &kmerSize, int &split, int &splitMode) {
     size_t memoryNeeded = estimateMemoryConsumption(1, tdbr.getSize(), tdbr.getAminoAcidDBSize(), maxResListLen, alphabetSize,
                                                     kmerSize == 0 ? // if auto detect kmerSize
-                                                    IndexTable::computeKmerSize(tdbr.getAminoAcidDBSize()) : kmerSize, querySeqTyp, threads);
+                                                    IndexTable::computeKmerSize(tdbr.getAminoAcidDBSize()) : kmerSize, querySeqTyp, threads, packedIndex, consumerThreadMemory);
 
     int optimalSplitMode = Parameters::TARGET_DB_SPLIT;
     if (memoryNeeded > 0.9 * memoryLimit) {
@@ -293,7 +348,7 @@ void Prefiltering::setupSplit(DBReader<unsigned int>& tdbr, const int alphabetSi
     if (memoryNeeded > 0.9 * memoryLimit) {
         // memory is not enough to compute everything at once
         //TODO add PROFILE_STATE (just 6-mers)
-        std::pair<int, int> splitSettings = Prefiltering::optimizeSplit(memoryLimit, &tdbr, alphabetSize, kmerSize, querySeqTyp, threads);
+        std::pair<int, int> splitSettings = Prefiltering::optimizeSplit(memoryLimit, &tdbr, alphabetSize, kmerSize, querySeqTyp, threads, packedIndex, consumerThreadMemory);
         if (splitSettings.second == -1) {
             Debug(Debug::ERROR) << "Cannot fit databases into " << ByteParser::format(memoryLimit) << ". Please use a computer with more main memory.\n";
             EXIT(EXIT_FAILURE);
@@ -350,7 +405,7 @@ void Prefiltering::setupSplit(DBReader<unsigned int>& tdbr, const int alphabetSi
     }
 
     size_t memoryNeededPerSplit = estimateMemoryConsumption((splitMode == Parameters::TARGET_DB_SPLIT) ? split : 1, tdbr.getSize(),
-                                                            tdbr.getAminoAcidDBSize(), maxResListLen, alphabetSize, kmerSize, querySeqTyp, threads);
+                                                            tdbr.getAminoAcidDBSize(), maxResListLen, alphabetSize, kmerSize, querySeqTyp, threads, packedIndex, consumerThreadMemory);
     Debug(Debug::INFO) << "Estimated memory consumption: " << ByteParser::format(memoryNeededPerSplit) << "\n";
     if (memoryNeededPerSplit > 0.9 * memoryLimit) {
         Debug(Debug::WARNING) << "Process needs more than " << ByteParser::format(memoryLimit) << " main memory.\n" <<
@@ -361,11 +416,12 @@ void Prefiltering::setupSplit(DBReader<unsigned int>& tdbr, const int alphabetSi
     }
 }
 
-void Prefiltering::mergeTargetSplits(const std::string &outDB, const std::string &outDBIndex, const std::vector<std::pair<std::string, std::string>> &fileNames, unsigned int threads) {
+void Prefiltering::mergeTargetSplits(const std::string &outDB, const std::string &outDBIndex, const std::vector<std::pair<std::string, std::string>> &fileNames, unsigned int threads, int prefFormat, PrefilterHitConsumer *consumer) {
     // we assume that the hits are in the same order
     const size_t splits = fileNames.size();
 
-    if (splits < 2) {
+    // the consumer has to see the hits of a single split as well
+    if (splits < 2 && consumer == NULL) {
         DBReader<unsigned int>::moveDb(fileNames[0].first, outDB);
         Debug(Debug::INFO) << "No merging needed.\n";
         return;
@@ -415,7 +471,7 @@ void Prefiltering::mergeTargetSplits(const std::string &outDB, const std::string
     Debug(Debug::INFO) << "Preparing offsets for merging: " << timer.lap() << "\n";
     // merge target splits data files and sort the hits at the same time
     // TODO: compressed?
-    DBWriter writer(outDB.c_str(), outDBIndex.c_str(), threads, 0, Parameters::DBTYPE_PREFILTER_RES);
+    DBWriter writer(outDB.c_str(), outDBIndex.c_str(), threads, 0, (consumer != NULL) ? consumer->getResultDbType() : Parameters::DBTYPE_PREFILTER_RES);
     writer.open();
 
     Debug::Progress progress(reader1.getSize());
@@ -429,7 +485,6 @@ void Prefiltering::mergeTargetSplits(const std::string &outDB, const std::string
         result.reserve(1024);
         std::vector<hit_t> hits;
         hits.reserve(300);
-        char buffer[1024];
         size_t * currentDataFileOffset = new size_t[splits];
         memset(currentDataFileOffset, 0, sizeof(size_t)*splits);
         size_t currentId = __sync_fetch_and_add(&(globalIdOffset), 1);
@@ -449,9 +504,13 @@ void Prefiltering::mergeTargetSplits(const std::string &outDB, const std::string
             if (hits.size() > 1) {
                 SORT_SERIAL(hits.begin(), hits.end(), hit_t::compareHitsByScoreAndId);
             }
-            for (size_t i = 0; i < hits.size(); ++i) {
-                int len = QueryMatcher::prefilterHitToBuffer(buffer, hits[i]);
-                result.append(buffer, len);
+            if (consumer != NULL) {
+                consumer->consumeHits(reader1.getDbKey(currentId), hits, thread_idx, result);
+            } else {
+                unsigned int prevSeqId = 0;
+                for (size_t i = 0; i < hits.size(); ++i) {
+                    QueryMatcher::appendPrefilterHit(result, hits[i], prefFormat, prevSeqId);
+                }
             }
             writer.writeData(result.c_str(), result.size(), reader1.getDbKey(currentId), thread_idx);
             hits.clear();
@@ -497,6 +556,7 @@ ScoreMatrix Prefiltering::getScoreMatrix(const BaseMatrix& matrix, const size_t
 }
 
 void Prefiltering::getIndexTable(int split, size_t dbFrom, size_t dbSize) {
+    PerfReport::startPhase("index");
     if (templateDBIsIndex == true) {
         indexTable = PrefilteringIndexReader::getIndexTable(split, tidxdbr, preloadMode);
         // only the ungapped alignment needs the sequence lookup, we can save quite some memory here
@@ -516,7 +576,7 @@ void Prefiltering::getIndexTable(int split, size_t dbFrom, size_t dbSize) {
         int adjustAlphabetSize = (Parameters::isEqualDbtype(targetSeqType, Parameters::DBTYPE_NUCLEOTIDES) ||
                                   Parameters::isEqualDbtype(targetSeqType,Parameters::DBTYPE_AMINO_ACIDS))
                                  ? alphabetSize -1 : alphabetSize;
-        indexTable = new IndexTable(adjustAlphabetSize, kmerSize, false);
+        indexTable = new IndexTable(adjustAlphabetSize, kmerSize, false, (packedIndex & Parameters::PACKED_INDEX_KMERS) != 0);
         SequenceLookup **maskedLookup   = maskMode == 1 || maskLowerCaseMode == 1 ? &sequenceLookup : NULL;
         SequenceLookup **unmaskedLookup = maskMode == 0 ? &sequenceLookup : NULL;
 
@@ -528,6 +588,8 @@ void Prefiltering::getIndexTable(int split, size_t dbFrom, size_t dbSize) {
         if (diagonalScoring == false) {
             delete sequenceLookup;
             sequenceLookup = NULL;
+        } else if (packedIndex & Parameters::PACKED_INDEX_RESIDUES) {
+            sequenceLookup->pack(kmerSubMat->alphabetSize);
         }
 
         indexTable->printStatistics(kmerSubMat->num2aa);
@@ -557,6 +619,10 @@ void Prefiltering::runAllSplits(const std::string &resultDB, const std::string &
 
 #ifdef HAVE_MPI
 void Prefiltering::runMpiSplits(const std::string &resultDB, const std::string &resultDBIndex, const std::string &localTmpPath, const int runRandomId) {
+    if (hitConsumer != NULL && splitMode == Parameters::TARGET_DB_SPLIT) {
+        Debug(Debug::ERROR) << "Prefilter hits cannot be consumed directly in target split mode with MPI.\n";
+        EXIT(EXIT_FAILURE);
+    }
     if(compressed == true && splitMode == Parameters::TARGET_DB_SPLIT){
             Debug(Debug::WARNING) << "The output of the prefilter cannot be compressed during target split mode. "
                                      "Prefilter result will not be compressed.\n";
@@ -682,7 +748,7 @@ int Prefiltering::runSplits(const std::string &resultDB, const std::string &resu
                 resultReader.open(DBReader<unsigned int>::NOSORT);
                 resultReader.readMmapedDataInMemory();
                 const std::pair<std::string, std::string> tempDb = Util::databaseNames(resultDB + "_tmp");
-                DBWriter resultWriter(tempDb.first.c_str(), tempDb.second.c_str(), threads, compressed, Parameters::DBTYPE_PREFILTER_RES);
+                DBWriter resultWriter(tempDb.first.c_str(), tempDb.second.c_str(), threads, compressed, resultReader.getDbtype());
                 resultWriter.open();
                 resultWriter.sortDatafileByIdOrder(resultReader);
                 resultWriter.close(true);
@@ -735,8 +801,10 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
     }
 
     Debug(Debug::INFO) << "k-mer similarity threshold: " << kmerThr << "\n";
+    PerfReport::startPhase("prefilter");
 
     double kmersPerPos = 0;
+    size_t kmers = 0;
     size_t dbMatches = 0;
     size_t doubleMatches = 0;
     size_t querySeqLenSum = 0;
@@ -745,13 +813,17 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
     size_t diagonalOverflow = 0;
     size_t trancatedCounter = 0;
     size_t totalQueryDBSize = querySize;
+    const bool collectStatistics = Debug::debugLevel >= Debug::INFO || PerfReport::isEnabled();
 
     unsigned int localThreads = 1;
 #ifdef OPENMP
     localThreads = std::min((unsigned int)threads, (unsigned int)querySize);
 #endif
 
-    DBWriter tmpDbw(resultDB.c_str(), resultDBIndex.c_str(), localThreads, compressed, Parameters::DBTYPE_PREFILTER_RES);
+    // hits of a target split are only final after merging, the consumer gets them in mergeTargetSplits
+    PrefilterHitConsumer *consumer = (splitMode == Parameters::QUERY_DB_SPLIT || splits == 1) ? hitConsumer : NULL;
+    DBWriter tmpDbw(resultDB.c_str(), resultDBIndex.c_str(), localThreads, compressed,
+                    (consumer != NULL) ? consumer->getResultDbType() : Parameters::DBTYPE_PREFILTER_RES);
     tmpDbw.open();
 
     // init all thread-specific data structures
@@ -768,6 +840,18 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
     Debug(Debug::INFO) << "Target db start " << (dbFrom + 1) << " to " << dbFrom + dbSize << "\n";
     Debug::Progress progress(querySize);
 
+    // long queries generate the most k-mers and diagonal matches, start them first. Only queries within
+    // windows of QUERY_ORDER_WINDOW residues are reordered to keep reading the query DB front to back,
+    // compressed query DBs keep their order since each thread only caches a few decompressed blocks
+    std::vector<size_t> queryCosts(querySize);
+    for (size_t i = 0; i < querySize; i++) {
+        queryCosts[i] = qdbr->getSeqLen(queryFrom + i);
+    }
+    const size_t queryOrderWindow = qdbr->isCompressed() ? 0 : QUERY_ORDER_WINDOW;
+    const std::vector<size_t> queryOrder = Util::orderByDecreasingCost(queryCosts, queryOrderWindow);
+    const size_t blockCount = (querySize + batchSize - 1) / batchSize;
+    std::vector<double> busyTime(localThreads, 0.0);
+
 #pragma omp parallel num_threads(localThreads)
     {
         unsigned int thread_idx = 0;
@@ -783,84 +867,138 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
             matcher.setProfileMatrix(seq.profile_matrix);
         } else if (_3merSubMatrix.isValid() && _2merSubMatrix.isValid()) {
             matcher.setSubstitutionMatrix(&_3merSubMatrix, &_2merSubMatrix);
+            matcher.setKmerCache(kmerCache);
         } else {
             matcher.setSubstitutionMatrix(NULL, NULL);
         }
 
-        char buffer[128];
         std::string result;
         result.reserve(1000000);
-
-#pragma omp for schedule(dynamic, 2) reduction (+: kmersPerPos, resSize, dbMatches, doubleMatches, querySeqLenSum, diagonalOverflow, trancatedCounter)
-        for (size_t id = queryFrom; id < queryFrom + querySize; id++) {
-            progress.updateProgress();
-            // get query sequence
-            char *seqData = qdbr->getData(id, thread_idx);
-            unsigned int qKey = qdbr->getDbKey(id);
-            seq.mapSequence(id, qKey, seqData, qdbr->getSeqLen(id));
-            size_t targetSeqId = UINT_MAX;
-            if (sameQTDB || includeIdentical) {
-                targetSeqId = tdbr->getId(seq.getDbKey());
-                // only the corresponding split should include the id (hack for the hack)
-                if (targetSeqId >= dbFrom && targetSeqId < (dbFrom + dbSize) && targetSeqId != UINT_MAX) {
-                    targetSeqId = targetSeqId - dbFrom;
-                    if(targetSeqId > tdbr->getSize()){
-                        Debug(Debug::ERROR) << "targetSeqId: " << targetSeqId << " > target database size: "  << tdbr->getSize() <<  "\n";
-                        EXIT(EXIT_FAILURE);
-                    }
-                }else{
-                    targetSeqId = UINT_MAX;
+        unsigned int prevSeqId = 0;
+        std::vector<hit_t> hits;
+        std::vector<size_t> blockOrder;
+        Timer busyTimer;
+
+#pragma omp for schedule(dynamic, 1) reduction (+: kmersPerPos, kmers, resSize, dbMatches, doubleMatches, querySeqLenSum, diagonalOverflow, trancatedCounter)
+        for (size_t block = 0; block < blockCount; block++) {
+            const size_t blockStart = block * batchSize;
+            const size_t blockEnd = std::min(querySize, blockStart + batchSize);
+            if (batchSize > 1) {
+                matcher.clearBatch();
+                for (size_t i = blockStart; i < blockEnd; i++) {
+                    const size_t id = queryFrom + queryOrder[i];
+                    seq.mapSequence(id, qdbr->getDbKey(id), qdbr->getData(id, thread_idx), qdbr->getSeqLen(id));
+                    matcher.addBatchQuery(&seq);
                 }
+                matcher.fetchBatchHits();
             }
-            // calculate prefiltering results
-            std::pair<hit_t *, size_t> prefResults = matcher.matchQuery(&seq, targetSeqId);
-            size_t resultSize = prefResults.second;
-            const float queryLength = static_cast<float>(qdbr->getSeqLen(id));
-            for (size_t i = 0; i < resultSize; i++) {
-                hit_t *res = prefResults.first + i;
-                // correct the 0 indexed sequence id again to its real identifier
-                size_t targetSeqId1 = res->seqId + dbFrom;
-                // replace id with key
-                res->seqId = tdbr->getDbKey(targetSeqId1);
-                if (UNLIKELY(targetSeqId1 >= tdbr->getSize())) {
-                    Debug(Debug::WARNING) << "Wrong prefiltering result for query: " << qdbr->getDbKey(id) << " -> " << targetSeqId1 << "\t" << res->prefScore << "\n";
+            // fetched queries first, matchQuery overwrites the hits fetched for the batch
+            blockOrder.clear();
+            for (size_t i = blockStart; i < blockEnd; i++) {
+                if (batchSize > 1 && matcher.isBatchQueryFetched(i - blockStart)) {
+                    blockOrder.push_back(i);
                 }
-
-                // TODO: check if this should happen when diagonalScoring == false
-                if (covThr > 0.0 && (covMode == Parameters::COV_MODE_BIDIRECTIONAL
-                                               || covMode == Parameters::COV_MODE_QUERY
-                                               || covMode == Parameters::COV_MODE_LENGTH_SHORTER )) {
-                    const float targetLength = static_cast<float>(tdbr->getSeqLen(targetSeqId1));
-                    if (Util::canBeCovered(covThr, covMode, queryLength, targetLength) == false) {
-                        continue;
+            }
+            const size_t fetchedCount = blockOrder.size();
+            for (size_t i = blockStart; i < blockEnd; i++) {
+                if (batchSize == 1 || matcher.isBatchQueryFetched(i - blockStart) == false) {
+                    blockOrder.push_back(i);
+                }
+            }
+            for (size_t j = 0; j < blockOrder.size(); j++) {
+                const size_t i = blockOrder[j];
+                const bool fetched = j < fetchedCount;
+                progress.updateProgress();
+                if (PerfReport::isEnabled()) {
+                    busyTimer.reset();
+                }
+                const size_t id = queryFrom + queryOrder[i];
+                // get query sequence
+                char *seqData = qdbr->getData(id, thread_idx);
+                unsigned int qKey = qdbr->getDbKey(id);
+                seq.mapSequence(id, qKey, seqData, qdbr->getSeqLen(id));
+                size_t targetSeqId = UINT_MAX;
+                if (sameQTDB || includeIdentical) {
+                    targetSeqId = tdbr->getId(seq.getDbKey());
+                    // only the corresponding split should include the id (hack for the hack)
+                    if (targetSeqId >= dbFrom && targetSeqId < (dbFrom + dbSize) && targetSeqId != UINT_MAX) {
+                        targetSeqId = targetSeqId - dbFrom;
+                        if(targetSeqId > tdbr->getSize()){
+                            Debug(Debug::ERROR) << "targetSeqId: " << targetSeqId << " > target database size: "  << tdbr->getSize() <<  "\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                    }else{
+                        targetSeqId = UINT_MAX;
                     }
                 }
+                // calculate prefiltering results
+                std::pair<hit_t *, size_t> prefResults = fetched ? matcher.matchBatchQuery(&seq, i - blockStart, targetSeqId)
+                                                                 : matcher.matchQuery(&seq, targetSeqId);
+                size_t resultSize = prefResults.second;
+                const float queryLength = static_cast<float>(qdbr->getSeqLen(id));
+                for (size_t i = 0; i < resultSize; i++) {
+                    hit_t *res = prefResults.first + i;
+                    // correct the 0 indexed sequence id again to its real identifier
+                    size_t targetSeqId1 = res->seqId + dbFrom;
+                    // replace id with key
+                    res->seqId = tdbr->getDbKey(targetSeqId1);
+                    if (UNLIKELY(targetSeqId1 >= tdbr->getSize())) {
+                        Debug(Debug::WARNING) << "Wrong prefiltering result for query: " << qdbr->getDbKey(id) << " -> " << targetSeqId1 << "\t" << res->prefScore << "\n";
+                    }
 
-                // write prefiltering results to a string
-                int len = QueryMatcher::prefilterHitToBuffer(buffer, *res);
-                result.append(buffer, len);
-            }
-            tmpDbw.writeData(result.c_str(), result.length(), qKey, thread_idx);
-            result.clear();
+                    // TODO: check if this should happen when diagonalScoring == false
+                    if (covThr > 0.0 && (covMode == Parameters::COV_MODE_BIDIRECTIONAL
+                                                   || covMode == Parameters::COV_MODE_QUERY
+                                                   || covMode == Parameters::COV_MODE_LENGTH_SHORTER )) {
+                        const float targetLength = static_cast<float>(tdbr->getSeqLen(targetSeqId1));
+                        if (Util::canBeCovered(covThr, covMode, queryLength, targetLength) == false) {
+                            continue;
+                        }
+                    }
 
-            // update statistics counters
-            if (resultSize != 0) {
-                notEmpty[id - queryFrom] = 1;
-            }
+                    if (consumer != NULL) {
+                        hits.emplace_back(*res);
+                    } else {
+                        // write prefiltering results to a string
+                        QueryMatcher::appendPrefilterHit(result, *res, prefFormat, prevSeqId);
+                    }
+                }
+                if (consumer != NULL) {
+                    consumer->consumeHits(qKey, hits, thread_idx, result);
+                    hits.clear();
+                }
+                tmpDbw.writeData(result.c_str(), result.length(), qKey, thread_idx);
+                result.clear();
 
-            if (Debug::debugLevel >= Debug::INFO) {
-                kmersPerPos += matcher.getStatistics()->kmersPerPos;
-                dbMatches += matcher.getStatistics()->dbMatches;
-                doubleMatches += matcher.getStatistics()->doubleMatches;
-                querySeqLenSum += seq.L;
-                diagonalOverflow += matcher.getStatistics()->diagonalOverflow;
-                trancatedCounter += matcher.getStatistics()->truncated;
-                resSize += resultSize;
-                realResSize += std::min(resultSize, maxResListLen);
-                reslens[thread_idx]->emplace_back(resultSize);
+                // update statistics counters
+                if (resultSize != 0) {
+                    notEmpty[id - queryFrom] = 1;
+                }
+
+                if (collectStatistics) {
+                    kmersPerPos += matcher.getStatistics()->kmersPerPos;
+                    kmers += static_cast<size_t>(matcher.getStatistics()->kmersPerPos * seq.L + 0.5);
+                    dbMatches += matcher.getStatistics()->dbMatches;
+                    doubleMatches += matcher.getStatistics()->doubleMatches;
+                    querySeqLenSum += seq.L;
+                    diagonalOverflow += matcher.getStatistics()->diagonalOverflow;
+                    trancatedCounter += matcher.getStatistics()->truncated;
+                    resSize += resultSize;
+                    realResSize += std::min(resultSize, maxResListLen);
+                    reslens[thread_idx]->emplace_back(resultSize);
+                }
+                if (PerfReport::isEnabled()) {
+                    busyTime[thread_idx] += busyTimer.getTimediff();
+                }
             }
         } // step end
     }
+    PerfReport::addThreadBusyTime(busyTime);
+    PerfReport::addCounter("kmers", kmers);
+    PerfReport::addCounter("dbMatches", dbMatches);
+    PerfReport::addCounter("doubleMatches", doubleMatches);
+    PerfReport::addCounter("diagonalOverflows", diagonalOverflow);
+    PerfReport::addCounter("prefilterHits", resSize);
 
     if (Debug::debugLevel >= Debug::INFO) {
         statistics_t stats(kmersPerPos / static_cast<double>(totalQueryDBSize),
@@ -972,8 +1110,9 @@ BaseMatrix *Prefiltering::getSubstitutionMatrix(const MultiParam<char*> &scoring
 
 void Prefiltering::mergePrefilterSplits(const std::string &outDB, const std::string &outDBIndex,
                               const std::vector<std::pair<std::string, std::string>> &splitFiles) {
+    PerfReport::startPhase("merge");
     if (splitMode == Parameters::TARGET_DB_SPLIT) {
-        mergeTargetSplits(outDB, outDBIndex, splitFiles, threads);
+        mergeTargetSplits(outDB, outDBIndex, splitFiles, threads, prefFormat, hitConsumer);
     } else if (splitMode == Parameters::QUERY_DB_SPLIT) {
         DBWriter::mergeResults(outDB, outDBIndex, splitFiles);
     }
@@ -1018,12 +1157,27 @@ int Prefiltering::getKmerThreshold(const float sensitivity, const bool isProfile
 size_t Prefiltering::estimateMemoryConsumption(int split, size_t dbSize, size_t resSize,
                                                size_t maxResListLen,
                                                int alphabetSize, int kmerSize, unsigned int querySeqType,
-                                               int threads) {
-    // for each residue in the database we need 7 byte
+                                               int threads, int packedIndex, size_t consumerThreadMemory) {
     size_t dbSizeSplit = (dbSize) / split;
-    size_t residueSize = (resSize / split * 7);
+    size_t residuesSplit = resSize / split;
+    size_t tableSize = static_cast<size_t>(pow(alphabetSize, kmerSize));
+    // for each residue in the database we need one index table entry and one residue in the sequence lookup
+    size_t residueSize = residuesSplit;
+    // the largest residue of the lookup is X (or N), which is alphabetSize here
+    unsigned int residueBits = SequenceLookup::computeResidueBits(alphabetSize);
+    if ((packedIndex & Parameters::PACKED_INDEX_RESIDUES) && residueBits < 8) {
+        residueSize = SequenceLookup::packedBytes(residuesSplit, residueBits);
+    }
+    if (packedIndex & Parameters::PACKED_INDEX_KMERS) {
+        // the lists are filled in blocks of unpacked entries before they are packed
+        size_t avgSeqLen = resSize / std::max(dbSize, (size_t) 1);
+        residueSize += IndexTable::estimatePackedEntriesSize(tableSize, residuesSplit, dbSizeSplit, avgSeqLen);
+        residueSize += std::min(residuesSplit, IndexTable::getPackingBlockEntries(residuesSplit)) * sizeof(IndexEntryLocal);
+    } else {
+        residueSize += residuesSplit * sizeof(IndexEntryLocal);
+    }
     // 21^7 * pointer size is needed for the index
-    size_t indexTableSize = static_cast<size_t>(pow(alphabetSize, kmerSize)) * sizeof(size_t);
+    size_t indexTableSize = tableSize * sizeof(size_t);
     // memory needed for the threads
     // This memory is an approx. for Countint32Array and QueryTemplateLocalFast
     size_t threadSize = threads * (
@@ -1032,6 +1186,7 @@ size_t Prefiltering::estimateMemoryConsumption(int split, size_t dbSize, size_t
             + (maxResListLen * sizeof(hit_t))
             + (dbSizeSplit * 2 * sizeof(CounterResult) * 2) // BINS * binSize, (binSize = dbSize * 2 / BINS)
               // 2 is a security factor the size can increase during run
+            + consumerThreadMemory // e.g. the aligner of prefilteralign
     );
     size_t dbReaderSize = dbSize * (sizeof(DBReader<unsigned int>::Index) + sizeof(unsigned int)); // DB index size
 
@@ -1054,7 +1209,8 @@ size_t Prefiltering::estimateHDDMemoryConsumption(size_t dbSize, size_t maxResLi
 }
 
 std::pair<int, int> Prefiltering::optimizeSplit(size_t totalMemoryInByte, DBReader<unsigned int> *tdbr,
-                                                int alphabetSize, int externalKmerSize, unsigned int querySeqType, unsigned int threads) {
+                                                int alphabetSize, int externalKmerSize, unsigned int querySeqType, unsigned int threads,
+                                                int packedIndex, size_t consumerThreadMemory) {
 
     int startKmerSize = (externalKmerSize == 0) ? 6 : externalKmerSize;
     int endKmerSize   = (externalKmerSize == 0) ? 7 : externalKmerSize;
@@ -1078,7 +1234,7 @@ std::pair<int, int> Prefiltering::optimizeSplit(size_t totalMemoryInByte, DBRead
                 size_t neededSize = estimateMemoryConsumption(optSplit, tdbr->getSize(),
                                                               tdbr->getAminoAcidDBSize(),
                                                               0, alphabetSize, optKmerSize, querySeqType,
-                                                              threads);
+                                                              threads, packedIndex, consumerThreadMemory);
                 if (neededSize < 0.9 * totalMemoryInByte) {
                     return std::make_pair(optKmerSize, optSplit);
                 }
@@ -21,10 +21,21 @@ public:
             const std::string &targetDB,
             const std::string &targetDBIndex,
             int querySeqType, int targetSeqType,
-            const Parameters &par);
+            const Parameters &par, PrefilterHitConsumer *hitConsumer = NULL);
 
     ~Prefiltering();
 
+    // replaces the query database, the index table and the target database stay loaded
+    void setQueryDatabase(const std::string &queryDB, const std::string &queryDBIndex);
+
+    // the consumer receives the final hits of each query and its entries are written to the result database instead,
+    // the memory of a consumer passed to the constructor is included in the split estimate
+    void setHitConsumer(PrefilterHitConsumer *consumer);
+
+    int getSplitMode() {
+        return splitMode;
+    }
+
     void runAllSplits(const std::string &resultDB, const std::string &resultDBIndex);
 
 #ifdef HAVE_MPI
@@ -41,17 +52,21 @@ public:
     static BaseMatrix *getSubstitutionMatrix(const MultiParam<char*> &scoringMatrixFile, MultiParam<int> alphabetSize, float bitFactor, bool profileState, bool isNucl);
 
     static void setupSplit(DBReader<unsigned int>& dbr, const int alphabetSize, const unsigned int querySeqType, const int threads,
-                           const bool templateDBIsIndex, const size_t memoryLimit, const size_t qDbSize,
+                           const int packedIndex, const size_t consumerThreadMemory, const bool templateDBIsIndex, const size_t memoryLimit, const size_t qDbSize,
                            size_t& maxResListLen, int& kmerSize, int& split, int& splitMode);
 
     static int getKmerThreshold(const float sensitivity, const bool isProfile, const int kmerScore, const int kmerSize);
 
     static void mergeTargetSplits(const std::string &outDB, const std::string &outDBIndex,
-                                  const std::vector<std::pair<std::string, std::string>> &fileNames, unsigned int threads);
+                                  const std::vector<std::pair<std::string, std::string>> &fileNames, unsigned int threads,
+                                  int prefFormat, PrefilterHitConsumer *consumer = NULL);
 
 private:
-    const std::string queryDB;
-    const std::string queryDBIndex;
+    // residues of consecutive queries that are ordered by decreasing length
+    static const size_t QUERY_ORDER_WINDOW = 4 * 1024 * 1024;
+
+    std::string queryDB;
+    std::string queryDBIndex;
     const std::string targetDB;
     const std::string targetDBIndex;
     DBReader<unsigned int> *qdbr;
@@ -63,6 +78,8 @@ private:
     BaseMatrix *ungappedSubMat;
     ScoreMatrix _2merSubMatrix;
     ScoreMatrix _3merSubMatrix;
+    // similar k-mer lists shared by all threads, NULL if disabled
+    KmerSimilarityCache *kmerCache;
     IndexTable *indexTable;
     SequenceLookup *sequenceLookup;
 
@@ -97,18 +114,26 @@ private:
     int preloadMode;
     const unsigned int threads;
     int compressed;
+    int prefFormat;
+    // varint packed k-mer lists for index tables built in memory
+    int packedIndex;
+    // queries per thread whose index lookups are done together
+    const size_t batchSize;
+    PrefilterHitConsumer *hitConsumer;
 
     bool runSplit(const std::string &resultDB, const std::string &resultDBIndex, size_t split, bool merge);
 
     // compute kmer size and split size for index table
     static std::pair<int, int> optimizeSplit(size_t totalMemoryInByte, DBReader<unsigned int> *tdbr, int alphabetSize, int kmerSize,
-                                             unsigned int querySeqType, unsigned int threads);
+                                             unsigned int querySeqType, unsigned int threads, int packedIndex,
+                                             size_t consumerThreadMemory);
 
-    // estimates memory consumption while runtime
+    // estimates memory consumption while runtime, packedIndex is the --packed-index layout of the index table
+    // and consumerThreadMemory the memory of the hit consumer per thread
     static size_t estimateMemoryConsumption(int split, size_t dbSize, size_t resSize,
                                             size_t maxHitsPerQuery,
                                             int alphabetSize, int kmerSize, unsigned int querySeqType,
-                                            int threads);
+                                            int threads, int packedIndex, size_t consumerThreadMemory);
 
     static size_t estimateHDDMemoryConsumption(size_t dbSize, size_t maxResListLen);
 
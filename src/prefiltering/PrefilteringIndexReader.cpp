@@ -4,9 +4,16 @@
 #include "ExtendedSubstitutionMatrix.h"
 #include "FileUtil.h"
 #include "IndexBuilder.h"
+#include "KmerGenerator.h"
 #include "Parameters.h"
 
-const char*  PrefilteringIndexReader::CURRENT_VERSION = "16";
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+const char*  PrefilteringIndexReader::CURRENT_VERSION = "17";
+// version 16 indices only differ by the missing packed flag in META
+const char*  PrefilteringIndexReader::COMPATIBLE_VERSION = "16";
 unsigned int PrefilteringIndexReader::VERSION = 0;
 unsigned int PrefilteringIndexReader::META = 1;
 unsigned int PrefilteringIndexReader::SCOREMATRIXNAME = 2;
@@ -30,6 +37,9 @@ unsigned int PrefilteringIndexReader::HDR2INDEX = 20;
 unsigned int PrefilteringIndexReader::HDR2DATA = 21;
 unsigned int PrefilteringIndexReader::GENERATOR = 22;
 unsigned int PrefilteringIndexReader::SPACEDPATTERN = 23;
+unsigned int PrefilteringIndexReader::SEQINDEXBITS = 24;
+unsigned int PrefilteringIndexReader::SEQINDEXEXCEPTIONS = 25;
+unsigned int PrefilteringIndexReader::SIMILARKMERCACHE = 26;
 
 extern const char* version;
 
@@ -38,7 +48,8 @@ bool PrefilteringIndexReader::checkIfIndexFile(DBReader<unsigned int>* reader) {
     if(version == NULL){
         return false;
     }
-    return (strncmp(version, CURRENT_VERSION, strlen(CURRENT_VERSION)) == 0 ) ? true : false;
+    return (strncmp(version, CURRENT_VERSION, strlen(CURRENT_VERSION)) == 0
+            || strncmp(version, COMPATIBLE_VERSION, strlen(COMPATIBLE_VERSION)) == 0) ? true : false;
 }
 
 std::string PrefilteringIndexReader::indexName(const std::string &outDB) {
@@ -53,7 +64,8 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
                                               BaseMatrix *subMat, int maxSeqLen,
                                               bool hasSpacedKmer, const std::string &spacedKmerPattern,
                                               bool compBiasCorrection, int alphabetSize, int kmerSize,
-                                              int maskMode, int maskLowerCase, int kmerThr, int splits) {
+                                              int maskMode, int maskLowerCase, int kmerThr, int splits, int packedIndex,
+                                              size_t similarKmerCache, int threads) {
     DBWriter writer(outDB.c_str(), std::string(outDB).append(".index").c_str(), splits, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_INDEX_DB);
     writer.open();
 
@@ -69,33 +81,40 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
     const int headers2 = (hdbr2 != NULL) ? 1 : 0;
     const int seqType = dbr1->getDbtype();
     const int srcSeqType = (dbr2 !=NULL) ? dbr2->getDbtype() : seqType;
-    int metadata[] = {maxSeqLen, kmerSize, biasCorr, alphabetSize, mask, spacedKmer, kmerThr, seqType, srcSeqType, headers1, headers2, splits};
+    int metadata[] = {maxSeqLen, kmerSize, biasCorr, alphabetSize, mask, spacedKmer, kmerThr, seqType, srcSeqType, headers1, headers2, splits, packedIndex};
     char *metadataptr = (char *) &metadata;
     writer.writeData(metadataptr, sizeof(metadata), META, 0);
     writer.alignToPageSize();
 
+    ScoreMatrix s3;
+    ScoreMatrix s2;
     if (Parameters::isEqualDbtype(seqType, Parameters::DBTYPE_HMM_PROFILE) == false &&
         Parameters::isEqualDbtype(seqType, Parameters::DBTYPE_PROFILE_STATE_SEQ) == false) {
         int alphabetSize = subMat->alphabetSize;
         subMat->alphabetSize = subMat->alphabetSize-1;
-        ScoreMatrix s3 = ExtendedSubstitutionMatrix::calcScoreMatrix(*subMat, 3);
-        ScoreMatrix s2 = ExtendedSubstitutionMatrix::calcScoreMatrix(*subMat, 2);
+        s3 = ExtendedSubstitutionMatrix::calcScoreMatrix(*subMat, 3);
+        s2 = ExtendedSubstitutionMatrix::calcScoreMatrix(*subMat, 2);
         subMat->alphabetSize = alphabetSize;
 
         char* serialized3mer = ScoreMatrix::serialize(s3);
         Debug(Debug::INFO) << "Write SCOREMATRIX3MER (" << SCOREMATRIX3MER << ")\n";
         writer.writeData(serialized3mer, ScoreMatrix::size(s3), SCOREMATRIX3MER, 0);
         writer.alignToPageSize();
-        ExtendedSubstitutionMatrix::freeScoreMatrix(s3);
         free(serialized3mer);
 
         char* serialized2mer = ScoreMatrix::serialize(s2);
         Debug(Debug::INFO) << "Write SCOREMATRIX2MER (" << SCOREMATRIX2MER << ")\n";
         writer.writeData(serialized2mer, ScoreMatrix::size(s2), SCOREMATRIX2MER, 0);
         writer.alignToPageSize();
-        ExtendedSubstitutionMatrix::freeScoreMatrix(s2);
         free(serialized2mer);
     }
+    // similar k-mer lists exist only for amino acid sequences
+    KmerSimilarityCache *kmerCache = NULL;
+    if (similarKmerCache > 0 && s3.isValid() && s2.isValid()
+        && Parameters::isEqualDbtype(seqType, Parameters::DBTYPE_AMINO_ACIDS)
+        && KmerSimilarityCache::isSupported(alphabetSize - 1, kmerSize)) {
+        kmerCache = new KmerSimilarityCache(similarKmerCache);
+    }
 
     Debug(Debug::INFO) << "Write SCOREMATRIXNAME (" << SCOREMATRIXNAME << ")\n";
     char* subData = BaseMatrix::serialize(subMat);
@@ -196,24 +215,30 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
             continue;
         }
 
-        IndexTable indexTable(adjustAlphabetSize, kmerSize, false);
+        IndexTable indexTable(adjustAlphabetSize, kmerSize, false, (packedIndex & Parameters::PACKED_INDEX_KMERS) != 0);
         SequenceLookup *sequenceLookup = NULL;
         IndexBuilder::fillDatabase(&indexTable,
                                    (maskMode == 1 || maskLowerCase == 1) ? &sequenceLookup : NULL,
                                    (maskMode == 0 ) ? &sequenceLookup : NULL,
                                    *subMat, &seq, dbr1, dbFrom, dbFrom + dbSize, kmerThr, maskMode, maskLowerCase);
         indexTable.printStatistics(subMat->num2aa);
+        if (kmerCache != NULL && s == 0) {
+            fillSimilarKmerCache(*kmerCache, indexTable, &s3, &s2, kmerSize, kmerThr, threads);
+        }
 
         if (sequenceLookup == NULL) {
             Debug(Debug::ERROR) << "Invalid mask mode. No sequence lookup created!\n";
             EXIT(EXIT_FAILURE);
         }
+        if (packedIndex & Parameters::PACKED_INDEX_RESIDUES) {
+            sequenceLookup->pack(subMat->alphabetSize);
+        }
 
         // save the entries
         unsigned int keyOffset = 1000 * s;
         Debug(Debug::INFO) << "Write ENTRIES (" << (keyOffset + ENTRIES) << ")\n";
-        char *entries = (char *) indexTable.getEntries();
-        size_t entriesSize = indexTable.getTableEntriesNum() * indexTable.getSizeOfEntry();
+        char *entries = indexTable.getEntriesData();
+        size_t entriesSize = indexTable.getEntriesDataSize();
         writer.writeData(entries, entriesSize, (keyOffset + ENTRIES), s);
         writer.alignToPageSize(s);
 
@@ -238,8 +263,19 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
         writer.alignToPageSize(s);
 
         Debug(Debug::INFO) << "Write SEQINDEXDATA (" << (keyOffset + SEQINDEXDATA) << ")\n";
-        writer.writeData(sequenceLookup->getData(), (sequenceLookup->getDataSize() + 1) * sizeof(char), (keyOffset + SEQINDEXDATA), s);
+        writer.writeData(sequenceLookup->getData(), sequenceLookup->getDataBytes(), (keyOffset + SEQINDEXDATA), s);
         writer.alignToPageSize(s);
+
+        if (sequenceLookup->isPacked()) {
+            Debug(Debug::INFO) << "Write SEQINDEXBITS (" << (keyOffset + SEQINDEXBITS) << ")\n";
+            int residueBits = sequenceLookup->getResidueBits();
+            writer.writeData((char *) &residueBits, sizeof(int), (keyOffset + SEQINDEXBITS), s);
+            writer.alignToPageSize(s);
+
+            Debug(Debug::INFO) << "Write SEQINDEXEXCEPTIONS (" << (keyOffset + SEQINDEXEXCEPTIONS) << ")\n";
+            writer.writeData((char *) sequenceLookup->getExceptions(), sequenceLookup->getExceptionCount() * sizeof(SequenceLookup::ExceptionRun), (keyOffset + SEQINDEXEXCEPTIONS), s);
+            writer.alignToPageSize(s);
+        }
         delete sequenceLookup;
 
         // ENTRIESNUM
@@ -257,9 +293,68 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
         writer.alignToPageSize(s);
     }
 
+    if (kmerCache != NULL) {
+        Debug(Debug::INFO) << "Write SIMILARKMERCACHE (" << SIMILARKMERCACHE << ")\n";
+        size_t cacheSize;
+        char *cacheData = kmerCache->serialize(&cacheSize);
+        writer.writeData(cacheData, cacheSize, SIMILARKMERCACHE, 0);
+        writer.alignToPageSize();
+        free(cacheData);
+        delete kmerCache;
+    }
+    if (s3.isValid() && s2.isValid()) {
+        ExtendedSubstitutionMatrix::freeScoreMatrix(s3);
+        ExtendedSubstitutionMatrix::freeScoreMatrix(s2);
+    }
+
     writer.close(false);
 }
 
+void PrefilteringIndexReader::fillSimilarKmerCache(KmerSimilarityCache &cache, IndexTable &indexTable, ScoreMatrix *three, ScoreMatrix *two,
+                                                   int kmerSize, int kmerThr, int threads) {
+    // lower the minimum occurrence until the most frequent k-mers roughly fill the cache,
+    // offsets of packed k-mer lists are in bytes which still orders the k-mers by occurrence
+    const size_t *offsets = indexTable.getOffsets();
+    const size_t tableSize = indexTable.getTableSize();
+    const size_t maxCount = 1 << 16;
+    std::vector<size_t> histogram(maxCount + 1, 0);
+    for (size_t kmer = 0; kmer < tableSize; kmer++) {
+        histogram[std::min(offsets[kmer + 1] - offsets[kmer], maxCount)]++;
+    }
+    const size_t targetCount = cache.getMemory() / (64 * sizeof(size_t));
+    size_t minCount = maxCount;
+    size_t selected = histogram[maxCount];
+    while (minCount > 1 && selected < targetCount) {
+        minCount--;
+        selected += histogram[minCount];
+    }
+
+    Debug(Debug::INFO) << "Fill similar k-mer cache with k-mers that occur at least " << minCount << " times\n";
+#pragma omp parallel num_threads(threads)
+    {
+        KmerGenerator generator(kmerSize, indexTable.getAlphabetSize(), kmerThr);
+        generator.setDivideStrategy(three, two);
+        generator.setCache(&cache);
+        Indexer indexer(indexTable.getAlphabetSize(), kmerSize);
+        size_t *kmerResidues = new size_t[kmerSize];
+        unsigned char *kmer = new unsigned char[kmerSize];
+#pragma omp for schedule(dynamic, 4096)
+        for (size_t idx = 0; idx < tableSize; idx++) {
+            if (offsets[idx + 1] - offsets[idx] < minCount) {
+                continue;
+            }
+            indexer.index2int(kmerResidues, idx, kmerSize);
+            for (int i = 0; i < kmerSize; i++) {
+                kmer[i] = static_cast<unsigned char>(kmerResidues[i]);
+            }
+            generator.generateKmerList(kmer);
+        }
+        delete[] kmer;
+        delete[] kmerResidues;
+    }
+    Debug(Debug::INFO) << "Similar k-mer lists in cache: " << cache.getListCount() << "\n";
+}
+
 DBReader<unsigned int> *PrefilteringIndexReader::openNewHeaderReader(DBReader<unsigned int>*dbr, unsigned int dataIdx, unsigned int indexIdx, int threads,  bool touchIndex, bool touchData) {
     size_t indexId = dbr->getId(indexIdx);
     char *indexData = dbr->getData(indexId, 0);
@@ -341,9 +436,25 @@ SequenceLookup *PrefilteringIndexReader::getSequenceLookup(unsigned int split, D
     size_t sequenceCountId = dbr->getId(splitOffset + SEQCOUNT);
     size_t sequenceCount = *((size_t *)dbr->getDataUncompressed(sequenceCountId));
 
+    // only bit packed lookups have the residue width and exception runs
+    int residueBits = 8;
+    SequenceLookup::ExceptionRun *exceptions = NULL;
+    size_t exceptionCount = 0;
+    size_t bitsId = dbr->getId(splitOffset + SEQINDEXBITS);
+    if (bitsId != UINT_MAX) {
+        residueBits = *((int *)dbr->getDataUncompressed(bitsId));
+        size_t exceptionsId = dbr->getId(splitOffset + SEQINDEXEXCEPTIONS);
+        exceptions = (SequenceLookup::ExceptionRun *) dbr->getDataUncompressed(exceptionsId);
+        exceptionCount = (dbr->getEntryLen(exceptionsId) - 1) / sizeof(SequenceLookup::ExceptionRun);
+    }
+
     if (preloadMode == Parameters::PRELOAD_MODE_FREAD) {
-        SequenceLookup *sequenceLookup = new SequenceLookup(sequenceCount, seqDataSize);
-        sequenceLookup->initLookupByExternalDataCopy(seqData, (size_t *) seqOffsetsData);
+        SequenceLookup *sequenceLookup = new SequenceLookup(sequenceCount, residueBits < 8 ? 0 : seqDataSize);
+        if (residueBits < 8) {
+            sequenceLookup->initPackedLookupByExternalDataCopy(seqData, seqDataSize, (size_t *) seqOffsetsData, residueBits, exceptions, exceptionCount);
+        } else {
+            sequenceLookup->initLookupByExternalDataCopy(seqData, (size_t *) seqOffsetsData);
+        }
         return sequenceLookup;
     }
 
@@ -353,7 +464,11 @@ SequenceLookup *PrefilteringIndexReader::getSequenceLookup(unsigned int split, D
     }
 
     SequenceLookup *sequenceLookup = new SequenceLookup(sequenceCount);
-    sequenceLookup->initLookupByExternalData(seqData, seqDataSize, (size_t *) seqOffsetsData);
+    if (residueBits < 8) {
+        sequenceLookup->initPackedLookupByExternalData(seqData, seqDataSize, (size_t *) seqOffsetsData, residueBits, exceptions, exceptionCount);
+    } else {
+        sequenceLookup->initLookupByExternalData(seqData, seqDataSize, (size_t *) seqOffsetsData);
+    }
     return sequenceLookup;
 }
 
@@ -382,10 +497,17 @@ IndexTable *PrefilteringIndexReader::getIndexTable(unsigned int split, DBReader<
     } else {
         adjustAlphabetSize = data.alphabetSize;
     }
+    // the last offset of a packed table is the size of its entries
+    size_t entriesSize = ((size_t *) entriesOffsetsData)[MathUtil::ipow<size_t>(adjustAlphabetSize, data.kmerSize)];
+    const bool packedEntries = (data.packed & Parameters::PACKED_INDEX_KMERS) != 0;
 
     if (preloadMode == Parameters::PRELOAD_MODE_FREAD) {
-        IndexTable* table = new IndexTable(adjustAlphabetSize, data.kmerSize, false);
-        table->initTableByExternalDataCopy(sequenceCount, entriesNum, (IndexEntryLocal*) entriesData, (size_t *)entriesOffsetsData);
+        IndexTable* table = new IndexTable(adjustAlphabetSize, data.kmerSize, false, packedEntries);
+        if (packedEntries) {
+            table->initPackedTableByExternalDataCopy(sequenceCount, entriesNum, (unsigned char *) entriesData, entriesSize, (size_t *)entriesOffsetsData);
+        } else {
+            table->initTableByExternalDataCopy(sequenceCount, entriesNum, (IndexEntryLocal*) entriesData, (size_t *)entriesOffsetsData);
+        }
         return table;
     }
 
@@ -396,8 +518,12 @@ IndexTable *PrefilteringIndexReader::getIndexTable(unsigned int split, DBReader<
         dbr->touchData(entriesOffsetsDataId);
     }
 
-    IndexTable* table = new IndexTable(adjustAlphabetSize, data.kmerSize, true);
-    table->initTableByExternalData(sequenceCount, entriesNum, (IndexEntryLocal*) entriesData, (size_t *)entriesOffsetsData);
+    IndexTable* table = new IndexTable(adjustAlphabetSize, data.kmerSize, true, packedEntries);
+    if (packedEntries) {
+        table->initPackedTableByExternalData(sequenceCount, entriesNum, (unsigned char *) entriesData, entriesSize, (size_t *)entriesOffsetsData);
+    } else {
+        table->initTableByExternalData(sequenceCount, entriesNum, (IndexEntryLocal*) entriesData, (size_t *)entriesOffsetsData);
+    }
     return table;
 }
 
@@ -439,6 +565,7 @@ void PrefilteringIndexReader::printMeta(int *metadata_tmp) {
     Debug(Debug::INFO) << "Headers2:     " << metadata_tmp[10] << "\n";
     // Keep compatible to index version 15
     Debug(Debug::INFO) << "Splits:       " << (metadata_tmp[11] == 0 ? 1 : metadata_tmp[11]) << "\n";
+    Debug(Debug::INFO) << "Packed:       " << metadata_tmp[12] << "\n";
 }
 
 PrefilteringIndexData PrefilteringIndexReader::getMetadata(DBReader<unsigned int> *dbr) {
@@ -458,6 +585,8 @@ PrefilteringIndexData PrefilteringIndexReader::getMetadata(DBReader<unsigned int
     data.headers2 = meta[10];
     // Keep compatible to index version 15, where meta[11] would have been zero due to the alignment padding
     data.splits = meta[11] == 0 ? 1 : meta[11];
+    // version 16 indices are padded with zeros here
+    data.packed = meta[12];
 
     return data;
 }
@@ -519,6 +648,14 @@ ScoreMatrix PrefilteringIndexReader::get2MerScoreMatrix(DBReader<unsigned int> *
     return ScoreMatrix::unserialize(data, meta.alphabetSize-1, 2);
 }
 
+const char *PrefilteringIndexReader::getSimilarKmerCache(DBReader<unsigned int> *dbr) {
+    size_t id = dbr->getId(SIMILARKMERCACHE);
+    if (id == UINT_MAX) {
+        return NULL;
+    }
+    return dbr->getDataUncompressed(id);
+}
+
 ScoreMatrix PrefilteringIndexReader::get3MerScoreMatrix(DBReader<unsigned int> *dbr, int preloadMode) {
     size_t id = dbr->getId(SCOREMATRIX3MER);
     if (id == UINT_MAX) {
@@ -3,6 +3,7 @@
 
 #include "BaseMatrix.h"
 #include "IndexTable.h"
+#include "KmerSimilarityCache.h"
 #include "DBReader.h"
 #include <string>
 
@@ -19,12 +20,14 @@ struct PrefilteringIndexData {
     int headers1;
     int headers2;
     int splits;
+    int packed;
 };
 
 
 class PrefilteringIndexReader {
 public:
     static const char*  CURRENT_VERSION;
+    static const char*  COMPATIBLE_VERSION;
     static unsigned int VERSION;
     static unsigned int ENTRIES;
     static unsigned int ENTRIESOFFSETS;
@@ -49,6 +52,9 @@ public:
     static unsigned int HDR2DATA;
     static unsigned int GENERATOR;
     static unsigned int SPACEDPATTERN;
+    static unsigned int SEQINDEXBITS;
+    static unsigned int SEQINDEXEXCEPTIONS;
+    static unsigned int SIMILARKMERCACHE;
 
     static bool checkIfIndexFile(DBReader<unsigned int> *reader);
     static std::string indexName(const std::string &outDB);
@@ -57,7 +63,8 @@ public:
                                 DBReader<unsigned int> *dbr1, DBReader<unsigned int> *dbr2,
                                 DBReader<unsigned int> *hdbr1, DBReader<unsigned int> *hdbr2,
                                 BaseMatrix *seedSubMat, int maxSeqLen, bool spacedKmer, const std::string &spacedKmerPattern,
-                                bool compBiasCorrection, int alphabetSize, int kmerSize, int maskMode, int maskLowerCase, int kmerThr, int splits);
+                                bool compBiasCorrection, int alphabetSize, int kmerSize, int maskMode, int maskLowerCase, int kmerThr, int splits, int packedIndex,
+                                size_t similarKmerCache, int threads);
 
     static DBReader<unsigned int> *openNewHeaderReader(DBReader<unsigned int>*dbr, unsigned int dataIdx, unsigned int indexIdx, int threads, bool touchIndex, bool touchData);
 
@@ -81,12 +88,19 @@ public:
 
     static ScoreMatrix get3MerScoreMatrix(DBReader<unsigned int> *dbr, int preloadMode);
 
+    // serialized KmerSimilarityCache or NULL if the index has none
+    static const char *getSimilarKmerCache(DBReader<unsigned int> *dbr);
+
     static std::string searchForIndex(const std::string &pathToDB);
 
     static std::string dbPathWithoutIndex(std::string &dbname);
 
 private:
     static void printMeta(int *meta);
+
+    // fills a cache with the lists of the k-mers that occur most often in the index table
+    static void fillSimilarKmerCache(KmerSimilarityCache &cache, IndexTable &indexTable, ScoreMatrix *three, ScoreMatrix *two,
+                                     int kmerSize, int kmerThr, int threads);
 };
 
 #endif
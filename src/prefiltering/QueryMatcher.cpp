@@ -24,7 +24,7 @@ QueryMatcher::QueryMatcher(IndexTable *indexTable, SequenceLookup *sequenceLooku
                            short kmerThr, int kmerSize, size_t dbSize,
                            unsigned int maxSeqLen, size_t maxHitsPerQuery, bool aaBiasCorrection,
                            bool diagonalScoring, unsigned int minDiagScoreThr, bool takeOnlyBestKmer)
-                            : idx(indexTable->getAlphabetSize(), kmerSize)
+                            : idx(indexTable->getAlphabetSize(), kmerSize), currentBatchQuery(NULL)
 {
     this->kmerSubMat = kmerSubMat;
     this->ungappedAlignmentSubMat = ungappedAlignmentSubMat;
@@ -81,12 +81,7 @@ QueryMatcher::~QueryMatcher(){
     delete kmerGenerator;
 }
 
-std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned int identityId) {
-    querySeq->resetCurrPos();
-//    std::cout << "Id: " << querySeq->getId() << std::endl;
-    memset(scoreSizes, 0, SCORE_RANGE * sizeof(unsigned int));
-
-    // bias correction
+void QueryMatcher::computeCompositionBias(Sequence *querySeq) {
     if(aaBiasCorrection == true){
         if(Parameters::isEqualDbtype(querySeq->getSeqType(), Parameters::DBTYPE_AMINO_ACIDS)) {
             SubstitutionMatrix::calcLocalAaBiasCorrection(kmerSubMat, querySeq->numSequence, querySeq->L, compositionBias);
@@ -96,8 +91,143 @@ std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned
     } else {
         memset(compositionBias, 0, sizeof(float) * querySeq->L);
     }
+}
+
+void QueryMatcher::clearBatch() {
+    batchQueries.clear();
+    batchKmers.clear();
+    batchSlotPos.clear();
+    batchSlotHits.clear();
+}
+
+void QueryMatcher::addBatchQuery(Sequence *querySeq) {
+    querySeq->resetCurrPos();
+    computeCompositionBias(querySeq);
+    BatchQuery query;
+    query.slotStart = batchSlotPos.size();
+    query.hitOffset = 0;
+    query.hitCount = 0;
+    query.kmerListLen = 0;
+    query.collected = batchKmers.size() < MAX_BATCH_KMERS;
+    query.fetched = false;
+    if (query.collected == false) {
+        query.slotEnd = query.slotStart;
+        batchQueries.push_back(query);
+        return;
+    }
+    const unsigned int queryIdx = static_cast<unsigned int>(batchQueries.size());
+    while (querySeq->hasNextKmer()) {
+        const unsigned char *kmer = querySeq->nextKmer();
+        if (querySeq->kmerContainsX()) {
+            continue;
+        }
+        std::pair<const size_t *, size_t> kmerList = getSimilarKmers(querySeq, kmer, compositionBias);
+        const unsigned short current_i = querySeq->getCurrentPosition();
+        for (size_t kmerPos = 0; kmerPos < kmerList.second; kmerPos++) {
+            BatchKmer batchKmer;
+            batchKmer.kmer = kmerList.first[kmerPos];
+            batchKmer.slot = static_cast<unsigned int>(batchSlotPos.size());
+            batchKmer.query = queryIdx;
+            batchKmers.push_back(batchKmer);
+            batchSlotPos.push_back(current_i);
+        }
+        query.kmerListLen += kmerList.second;
+    }
+    query.slotEnd = batchSlotPos.size();
+    batchQueries.push_back(query);
+}
+
+void QueryMatcher::sortBatchKmers() {
+    const int RADIX_BITS = 11;
+    const size_t RADIX_SIZE = 1 << RADIX_BITS;
+    size_t maxKmer = 0;
+    for (size_t i = 0; i < batchKmers.size(); i++) {
+        maxKmer = std::max(maxKmer, batchKmers[i].kmer);
+    }
+    batchKmersSorted.resize(batchKmers.size());
+    size_t count[RADIX_SIZE];
+    for (int shift = 0; shift == 0 || (maxKmer >> shift) > 0; shift += RADIX_BITS) {
+        memset(count, 0, sizeof(size_t) * RADIX_SIZE);
+        for (size_t i = 0; i < batchKmers.size(); i++) {
+            count[(batchKmers[i].kmer >> shift) & (RADIX_SIZE - 1)]++;
+        }
+        size_t offset = 0;
+        for (size_t bucket = 0; bucket < RADIX_SIZE; bucket++) {
+            const size_t bucketSize = count[bucket];
+            count[bucket] = offset;
+            offset += bucketSize;
+        }
+        for (size_t i = 0; i < batchKmers.size(); i++) {
+            batchKmersSorted[count[(batchKmers[i].kmer >> shift) & (RADIX_SIZE - 1)]++] = batchKmers[i];
+        }
+        batchKmers.swap(batchKmersSorted);
+    }
+}
+
+void QueryMatcher::fetchBatchHits() {
+    // in k-mer order the offsets and entries of the index are read front to back
+    sortBatchKmers();
+    batchSlotHits.resize(batchSlotPos.size());
+    for (size_t i = 0; i < batchKmers.size(); i++) {
+        batchSlotHits[batchKmers[i].slot] = indexTable->getListSize(batchKmers[i].kmer);
+    }
+
+    // lay out the hits of each query like match would, queries are only fetched if they fit completely,
+    // which also excludes the queries that would overflow databaseHits in match
+    size_t hitOffset = 0;
+    for (size_t i = 0; i < batchQueries.size(); i++) {
+        BatchQuery &query = batchQueries[i];
+        size_t hitCount = 0;
+        for (size_t slot = query.slotStart; slot < query.slotEnd; slot++) {
+            hitCount += batchSlotHits[slot];
+        }
+        query.hitCount = hitCount;
+        query.fetched = query.collected && hitOffset + hitCount < maxDbMatches;
+        if (query.fetched == false) {
+            continue;
+        }
+        query.hitOffset = hitOffset;
+        for (size_t slot = query.slotStart; slot < query.slotEnd; slot++) {
+            const size_t listSize = batchSlotHits[slot];
+            batchSlotHits[slot] = hitOffset;
+            hitOffset += listSize;
+        }
+    }
+
+    const bool packedIndex = indexTable->isPacked();
+    for (size_t i = 0; i < batchKmers.size(); i++) {
+        const BatchKmer &kmer = batchKmers[i];
+        if (batchQueries[kmer.query].fetched == false) {
+            continue;
+        }
+        IndexEntryLocal *out = databaseHits + batchSlotHits[kmer.slot];
+        size_t seqListSize;
+        if (packedIndex) {
+            const unsigned char *packedEntries = indexTable->getPackedDBSeqList(kmer.kmer, &seqListSize);
+            IndexTable::unpackDBSeqList(packedEntries, seqListSize, out);
+        } else {
+            const IndexEntryLocal *entries = indexTable->getDBSeqList(kmer.kmer, &seqListSize);
+            memcpy(out, entries, sizeof(IndexEntryLocal) * seqListSize);
+        }
+    }
+}
+
+std::pair<hit_t*, size_t> QueryMatcher::matchBatchQuery(Sequence *querySeq, size_t batchIdx, unsigned int identityId) {
+    currentBatchQuery = &batchQueries[batchIdx];
+    std::pair<hit_t*, size_t> result = matchQuery(querySeq, identityId);
+    currentBatchQuery = NULL;
+    return result;
+}
+
+std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned int identityId) {
+    querySeq->resetCurrPos();
+//    std::cout << "Id: " << querySeq->getId() << std::endl;
+    memset(scoreSizes, 0, SCORE_RANGE * sizeof(unsigned int));
+
+    // bias correction
+    computeCompositionBias(querySeq);
 
-    size_t resultSize = match(querySeq, compositionBias);
+    size_t resultSize = (currentBatchQuery != NULL) ? matchFetchedHits(querySeq, *currentBatchQuery) : match(querySeq, compositionBias);
     std::pair<hit_t *, size_t> queryResult;
     if (diagonalScoring) {
         // write diagonal scores in count value
@@ -154,6 +284,62 @@ std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned
     return queryResult;
 }
 
+std::pair<const size_t *, size_t> QueryMatcher::getSimilarKmers(Sequence *seq, const unsigned char *kmer, float *compositionBias) {
+    const unsigned char *pos = seq->getAAPosInSpacedPattern();
+    const unsigned short current_i = seq->getCurrentPosition();
+
+    float biasCorrection = 0;
+    for (int i = 0; i < kmerSize; i++){
+        biasCorrection += compositionBias[current_i + static_cast<short>(pos[i])];
+    }
+    // round bias to next higher or lower value
+    short bias = static_cast<short>((biasCorrection < 0.0) ? biasCorrection - 0.5: biasCorrection + 0.5);
+    short kmerMatchScore = std::max(kmerThr - bias, 0);
+
+    // adjust kmer threshold based on composition bias
+    kmerGenerator->setThreshold(kmerMatchScore);
+
+    if (takeOnlyBestKmer) {
+        exactKmer = idx.int2index(kmer);
+        return std::make_pair(&exactKmer, 1);
+    }
+    std::pair<size_t*, size_t> kmerList = kmerGenerator->generateKmerList(kmer);
+    return std::make_pair(kmerList.first, kmerList.second);
+}
+
+size_t QueryMatcher::matchFetchedHits(Sequence *seq, const BatchQuery &query) {
+    stats->diagonalOverflow = false;
+    IndexEntryLocal *hitsEnd = databaseHits + query.hitOffset + query.hitCount;
+    unsigned short indexTo = 0;
+    size_t slot = query.slotStart;
+    while (seq->hasNextKmer()) {
+        seq->nextKmer();
+        const unsigned short current_i = seq->getCurrentPosition();
+        // the lists of a query are stored in the order of their positions, k-mers with X have none
+        indexPointer[current_i] = (slot < query.slotEnd) ? databaseHits + batchSlotHits[slot] : hitsEnd;
+        while (slot < query.slotEnd && batchSlotPos[slot] == current_i) {
+            slot++;
+        }
+        indexTo = current_i;
+    }
+    indexPointer[indexTo + 1] = hitsEnd;
+    size_t hitCount = findDuplicates(indexPointer, foundDiagonals, foundDiagonalsSize, 0, indexTo, (diagonalScoring == false));
+    updateMatchStatistics(seq, hitCount, query.kmerListLen, query.hitCount);
+    return hitCount;
+}
+
+void QueryMatcher::updateMatchStatistics(Sequence *seq, size_t hitCount, size_t kmerListLen, size_t dbMatches) {
+    stats->doubleMatches = 0;
+    if (diagonalScoring == false) {
+        // remove double entries
+        updateScoreBins(foundDiagonals, hitCount);
+        stats->doubleMatches = getDoubleDiagonalMatches();
+    }
+    stats->kmersPerPos = ((double)kmerListLen/(double)seq->L);
+    stats->querySeqLen = seq->L;
+    stats->dbMatches   = dbMatches;
+}
+
 size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
     // go through the query sequence
     size_t kmerListLen = 0;
@@ -166,39 +352,19 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
     size_t seqListSize;
     unsigned short indexStart = 0;
     unsigned short indexTo = 0;
+    const bool packedIndex = indexTable->isPacked();
     while (seq->hasNextKmer()) {
         const unsigned char *kmer = seq->nextKmer();
-        const unsigned char *pos = seq->getAAPosInSpacedPattern();
         const unsigned short current_i = seq->getCurrentPosition();
 
-        float biasCorrection = 0;
-        for (int i = 0; i < kmerSize; i++){
-            biasCorrection += compositionBias[current_i + static_cast<short>(pos[i])];
-        }
         if (seq->kmerContainsX()) {
             indexTo = current_i;
             indexPointer[current_i] = sequenceHits;
             continue;
         }
-        // round bias to next higher or lower value
-        short bias = static_cast<short>((biasCorrection < 0.0) ? biasCorrection - 0.5: biasCorrection + 0.5);
-        short kmerMatchScore = std::max(kmerThr - bias, 0);
-
-        // adjust kmer threshold based on composition bias
-        kmerGenerator->setThreshold(kmerMatchScore);
-
-        const size_t *index;
-        size_t exactKmer;
-        size_t kmerElementSize;
-        if (takeOnlyBestKmer) {
-            kmerElementSize = 1;
-            exactKmer = idx.int2index(kmer);
-            index = &exactKmer;
-        } else {
-            std::pair<size_t*, size_t> kmerList = kmerGenerator->generateKmerList(kmer);
-            kmerElementSize = kmerList.second;
-            index = kmerList.first;
-        }
+        std::pair<const size_t *, size_t> kmerList = getSimilarKmers(seq, kmer, compositionBias);
+        const size_t *index = kmerList.first;
+        const size_t kmerElementSize = kmerList.second;
         //std::cout << kmer << std::endl;
         indexPointer[current_i] = sequenceHits;
         // match the index table
@@ -208,7 +374,13 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
         kmerListLen += kmerElementSize;
 
         for (unsigned int kmerPos = 0; kmerPos < kmerElementSize; kmerPos++) {
-            const IndexEntryLocal *entries = indexTable->getDBSeqList(index[kmerPos], &seqListSize);
+            const IndexEntryLocal *entries = NULL;
+            const unsigned char *packedEntries = NULL;
+            if (packedIndex) {
+                packedEntries = indexTable->getPackedDBSeqList(index[kmerPos], &seqListSize);
+            } else {
+                entries = indexTable->getDBSeqList(index[kmerPos], &seqListSize);
+            }
             // DEBUG
             //std::cout << seq->getDbKey() << std::endl;
             //idx.printKmer(index[kmerPos], kmerSize, kmerSubMat->num2aa);
@@ -247,7 +419,11 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
                     goto outer;
                 }
             }
-            memcpy(sequenceHits, entries, sizeof(IndexEntryLocal) * seqListSize);
+            if (packedIndex) {
+                IndexTable::unpackDBSeqList(packedEntries, seqListSize, sequenceHits);
+            } else {
+                memcpy(sequenceHits, entries, sizeof(IndexEntryLocal) * seqListSize);
+            }
             sequenceHits += seqListSize;
             numMatches += seqListSize;
         }
@@ -262,15 +438,7 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
         // overflow occurred
         hitCount = mergeElements(foundDiagonals, overflowHitCount + hitCount);
     }
-    stats->doubleMatches = 0;
-    if (diagonalScoring == false) {
-        // remove double entries
-        updateScoreBins(foundDiagonals, hitCount);
-        stats->doubleMatches = getDoubleDiagonalMatches();
-    }
-    stats->kmersPerPos = ((double)kmerListLen/(double)seq->L);
-    stats->querySeqLen = seq->L;
-    stats->dbMatches   = overflowNumMatches + numMatches;
+    updateMatchStatistics(seq, hitCount, kmerListLen, overflowNumMatches + numMatches);
 
     return hitCount;
 }
@@ -7,6 +7,7 @@
 
 #include <cstdlib>
 #include "itoa.h"
+#include "Parameters.h"
 #include "EvalueComputation.h"
 #include "CacheFriendlyOperations.h"
 #include "UngappedAlignment.h"
@@ -50,6 +51,19 @@ struct hit_t {
     }
 };
 
+// Takes the hits of a query right after matchQuery instead of the prefilter result database (see Prefiltering::setHitConsumer).
+// consumeHits is called concurrently, each caller passes its own thread_idx, and appends the entry that is
+// written to the result database for the query. Hits are in the order they would have been written.
+class PrefilterHitConsumer {
+public:
+    virtual ~PrefilterHitConsumer() {};
+    virtual void consumeHits(unsigned int queryKey, std::vector<hit_t> &hits, unsigned int thread_idx, std::string &result) = 0;
+    // database type of the entries appended by consumeHits
+    virtual int getResultDbType() = 0;
+    // memory each consumer thread needs, the prefilter adds it to its split estimate
+    virtual size_t getThreadMemory() = 0;
+};
+
 class QueryMatcher {
 public:
     QueryMatcher(IndexTable *indexTable, SequenceLookup *sequenceLookup,
@@ -63,6 +77,23 @@ public:
     // identityId is the id of the identitical sequence in the target database if there is any, UINT_MAX otherwise
     std::pair<hit_t*, size_t> matchQuery(Sequence *querySeq, unsigned int identityId);
 
+    // Batch mode: addBatchQuery collects the similar k-mers of a block of queries, fetchBatchHits looks them
+    // up sorted by k-mer, so that the index is read in one sweep and lists shared by several queries are read
+    // once. matchBatchQuery then scores a query (mapped again) exactly like matchQuery.
+    // Queries whose k-mers or hits do not fit into the batch are not fetched and have to be matched with matchQuery
+    // after all fetched queries of the batch, since matchQuery overwrites the fetched hits.
+    void clearBatch();
+
+    void addBatchQuery(Sequence *querySeq);
+
+    void fetchBatchHits();
+
+    bool isBatchQueryFetched(size_t batchIdx) {
+        return batchQueries[batchIdx].fetched;
+    }
+
+    std::pair<hit_t*, size_t> matchBatchQuery(Sequence *querySeq, size_t batchIdx, unsigned int identityId);
+
     // set substituion matrix for KmerGenerator
     void setProfileMatrix(ScoreMatrix **matrix){
         kmerGenerator->setDivideStrategy(matrix);
@@ -73,6 +104,11 @@ public:
         kmerGenerator->setDivideStrategy(three, two);
     }
 
+    // similar k-mer lists shared between the matchers of all threads
+    void setKmerCache(KmerSimilarityCache *cache) {
+        kmerGenerator->setCache(cache);
+    }
+
     // get statistics
     const statistics_t *getStatistics() {
         return stats;
@@ -95,15 +131,16 @@ public:
 
     static std::vector<hit_t> parsePrefilterHits(char *data) {
         std::vector<hit_t> ret;
-        while (*data != '\0') {
-            hit_t result = parsePrefilterHit(data);
-            ret.push_back(result);
-            data = Util::skipLine(data);
-        }
+        parsePrefilterHits(data, ret);
         return ret;
     }
 
+    // reads both text and binary prefilter entries
     static void parsePrefilterHits(char *data, std::vector<hit_t> &entries) {
+        if (isBinaryPrefilterEntry(data)) {
+            parseBinaryPrefilterHits(data, entries);
+            return;
+        }
         while (*data != '\0') {
             hit_t result = parsePrefilterHit(data);
             entries.push_back(result);
@@ -111,6 +148,66 @@ public:
         }
     }
 
+    // Binary prefilter entries start with a marker byte followed by one record per hit:
+    // varint(zigzag(seqId - previous seqId)), varint(zigzag(prefScore)), varint(zigzag(diagonal)).
+    // Varints are stored with an offset of one so that entries never contain a null byte.
+    static const char BINARY_HIT_MARKER = '\x01';
+
+    static bool isBinaryPrefilterEntry(const char *data) {
+        return data[0] == BINARY_HIT_MARKER;
+    }
+
+    static void parseBinaryPrefilterHits(const char *data, std::vector<hit_t> &entries) {
+        const char *pos = data + 1;
+        int64_t seqId = 0;
+        while (*pos != '\0') {
+            seqId += decodeZigZag(readVarint(pos));
+            hit_t result;
+            result.seqId = static_cast<unsigned int>(seqId);
+            result.prefScore = static_cast<int>(decodeZigZag(readVarint(pos)));
+            result.diagonal = static_cast<unsigned short>(static_cast<short>(decodeZigZag(readVarint(pos))));
+            entries.push_back(result);
+        }
+    }
+
+    // converts a binary entry to tab-separated text for consumers working on raw lines
+    static void binaryPrefilterEntryToText(const char *data, std::string &out) {
+        std::vector<hit_t> hits;
+        parseBinaryPrefilterHits(data, hits);
+        char buffer[64];
+        out.clear();
+        for (size_t i = 0; i < hits.size(); ++i) {
+            size_t len = prefilterHitToBuffer(buffer, hits[i]);
+            out.append(buffer, len);
+        }
+    }
+
+    static size_t prefilterHitToBinaryBuffer(char *buff1, const hit_t &h, unsigned int prevSeqId) {
+        char *pos = buff1;
+        writeVarint(pos, encodeZigZag(static_cast<int64_t>(h.seqId) - static_cast<int64_t>(prevSeqId)));
+        writeVarint(pos, encodeZigZag(h.prefScore));
+        writeVarint(pos, encodeZigZag(static_cast<short>(h.diagonal)));
+        *pos = '\0';
+        return pos - buff1;
+    }
+
+    // appends a hit to a result entry in the given Parameters::PREF_FORMAT_*
+    static void appendPrefilterHit(std::string &entry, hit_t &h, int format, unsigned int &prevSeqId) {
+        char buffer[64];
+        size_t len;
+        if (format == Parameters::PREF_FORMAT_BINARY) {
+            if (entry.empty()) {
+                entry.push_back(BINARY_HIT_MARKER);
+                prevSeqId = 0;
+            }
+            len = prefilterHitToBinaryBuffer(buffer, h, prevSeqId);
+            prevSeqId = h.seqId;
+        } else {
+            len = prefilterHitToBuffer(buffer, h);
+        }
+        entry.append(buffer, len);
+    }
+
     static size_t prefilterHitToBuffer(char *buff1, hit_t &h) {
         char * basePos = buff1;
         char * tmpBuff = Itoa::u32toa_sse2((uint32_t) h.seqId, buff1);
@@ -126,6 +223,35 @@ public:
     }
 
 protected:
+    static uint64_t encodeZigZag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    static int64_t decodeZigZag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    static void writeVarint(char *&pos, uint64_t value) {
+        value += 1;
+        while (value >= 0x80) {
+            *pos++ = static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        *pos++ = static_cast<char>(value);
+    }
+
+    static uint64_t readVarint(const char *&pos) {
+        uint64_t value = 0;
+        int shift = 0;
+        unsigned char byte;
+        do {
+            byte = static_cast<unsigned char>(*pos++);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return value - 1;
+    }
+
     const static int KMER_SCORE = 0;
     const static int UNGAPPED_DIAGONAL_SCORE = 1;
 
@@ -189,6 +315,41 @@ protected:
     unsigned int minDiagScoreThr;
 
     Indexer idx;
+    // k-mer list of takeOnlyBestKmer
+    size_t exactKmer;
+
+    struct BatchQuery {
+        // slots (one per similar k-mer) of the query
+        size_t slotStart;
+        size_t slotEnd;
+        // hits of the query in databaseHits
+        size_t hitOffset;
+        size_t hitCount;
+        size_t kmerListLen;
+        // false if the batch was already full
+        bool collected;
+        bool fetched;
+    };
+
+    // limits the memory of a batch to about 50MB per thread
+    const static size_t MAX_BATCH_KMERS = 2 * 1024 * 1024;
+
+    struct BatchKmer {
+        size_t kmer;
+        unsigned int slot;
+        unsigned int query;
+    };
+
+    std::vector<BatchQuery> batchQueries;
+    std::vector<BatchKmer> batchKmers;
+    // buffer of the radix sort
+    std::vector<BatchKmer> batchKmersSorted;
+    // query position of each slot
+    std::vector<unsigned short> batchSlotPos;
+    // list size of each slot, position in databaseHits after fetchBatchHits
+    std::vector<size_t> batchSlotHits;
+    // set during matchBatchQuery
+    const BatchQuery *currentBatchQuery;
 
     const static size_t SCORE_RANGE = 256;
 
@@ -206,9 +367,23 @@ protected:
         return scoreThr;
     }
 
+    void computeCompositionBias(Sequence *querySeq);
+
+    // LSD radix sort of batchKmers by k-mer
+    void sortBatchKmers();
+
+    // similar k-mers of the current k-mer of seq, the threshold is adjusted by the composition bias
+    std::pair<const size_t *, size_t> getSimilarKmers(Sequence *seq, const unsigned char *kmer, float *compositionBias);
+
     // match sequence against the IndexTable
     size_t match(Sequence *seq, float *compositionBias);
 
+    // same as match for a query whose hits were fetched by fetchBatchHits
+    size_t matchFetchedHits(Sequence *seq, const BatchQuery &query);
+
+    // counts double hits and sets the statistics at the end of match
+    void updateMatchStatistics(Sequence *seq, size_t hitCount, size_t kmerListLen, size_t dbMatches);
+
     // extract result from databaseHits
     template <int TYPE>
     std::pair<hit_t *, size_t> getResult(CounterResult * results,
@@ -3,29 +3,41 @@
 //
 #include <new>
 #include <cstring>
+#include <algorithm>
+#include <climits>
 #include <sys/mman.h>
 #include "Debug.h"
 #include "Util.h"
+#include "MemoryPlacement.h"
 #include "SequenceLookup.h"
 
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
 SequenceLookup::SequenceLookup(size_t sequenceCount, size_t dataSize)
-        : sequenceCount(sequenceCount), dataSize(dataSize), currentIndex(0), currentOffset(0), externalData(false) {
+        : sequenceCount(sequenceCount), dataSize(dataSize), residueBits(8), exceptions(NULL), exceptionCount(0),
+          currentIndex(0), currentOffset(0), externalData(false) {
     data = new(std::nothrow) char[dataSize + 1];
     Util::checkAllocation(data, "Can not allocate data memory in SequenceLookup");
+    MemoryPlacement::advise(data, dataSize + 1);
 
     offsets = new(std::nothrow) size_t[sequenceCount + 1];
     Util::checkAllocation(offsets, "Can not allocate offsets memory in SequenceLookup");
+    MemoryPlacement::advise(offsets, (sequenceCount + 1) * sizeof(size_t));
     offsets[sequenceCount] = dataSize;
 }
 
 SequenceLookup::SequenceLookup(size_t sequenceCount)
-        : sequenceCount(sequenceCount), data(NULL), dataSize(0), offsets(NULL), currentIndex(0), currentOffset(0), externalData(true) {
+        : sequenceCount(sequenceCount), data(NULL), dataSize(0), offsets(NULL), residueBits(8), exceptions(NULL),
+          exceptionCount(0), currentIndex(0), currentOffset(0), externalData(true) {
 }
 
 SequenceLookup::~SequenceLookup() {
     if(externalData == false){
         delete[] data;
         delete[] offsets;
+        delete[] exceptions;
     }
 }
 
@@ -46,6 +58,153 @@ std::pair<const unsigned char *, const unsigned int> SequenceLookup::getSequence
     return std::pair<const unsigned char *, const unsigned int>(reinterpret_cast<const unsigned char*>(p), static_cast<unsigned int>(N));
 }
 
+static bool runStartLess(size_t pos, const SequenceLookup::ExceptionRun &run) {
+    return pos < run.start;
+}
+
+void SequenceLookup::unpackSequence(size_t id, unsigned char *out, size_t stride) {
+    const size_t start = offsets[id];
+    const size_t length = offsets[id + 1] - start;
+    if (isPacked() == false) {
+        const unsigned char *seq = reinterpret_cast<const unsigned char *>(data + start);
+        for (size_t i = 0; i < length; i++) {
+            out[i * stride] = seq[i];
+        }
+        return;
+    }
+
+    // every 64 bit load yields as many residues as fit behind the up to 7 bit shift
+    const unsigned int bits = residueBits;
+    const uint64_t mask = (static_cast<uint64_t>(1) << bits) - 1;
+    const size_t perWord = 57 / bits;
+    const unsigned char *packed = reinterpret_cast<const unsigned char *>(data);
+    size_t bitPos = start * bits;
+    size_t i = 0;
+    while (i < length) {
+        uint64_t word;
+        memcpy(&word, packed + (bitPos >> 3), sizeof(uint64_t));
+        word >>= (bitPos & 7);
+        const size_t n = std::min(perWord, length - i);
+        for (size_t k = 0; k < n; k++) {
+            out[(i + k) * stride] = static_cast<unsigned char>(word & mask);
+            word >>= bits;
+        }
+        i += n;
+        bitPos += n * bits;
+    }
+
+    if (exceptionCount == 0) {
+        return;
+    }
+    const ExceptionRun *run = std::upper_bound(exceptions, exceptions + exceptionCount, start, runStartLess);
+    if (run != exceptions) {
+        run--;
+    }
+    const size_t end = start + length;
+    for (; run < exceptions + exceptionCount && run->start < end; run++) {
+        const size_t from = std::max(run->start, start);
+        const size_t to = std::min(run->start + run->length, end);
+        for (size_t pos = from; pos < to; pos++) {
+            out[(pos - start) * stride] = static_cast<unsigned char>(run->residue);
+        }
+    }
+}
+
+void SequenceLookup::collectExceptions(unsigned int bits, std::vector<ExceptionRun> &runs) {
+    runs.clear();
+    const unsigned char limit = static_cast<unsigned char>(1u << bits);
+    const unsigned char *seq = reinterpret_cast<const unsigned char *>(data);
+    size_t pos = 0;
+    while (pos < dataSize) {
+        if (seq[pos] < limit) {
+            pos++;
+            continue;
+        }
+        ExceptionRun run;
+        run.start = pos;
+        run.residue = seq[pos];
+        while (pos < dataSize && seq[pos] == run.residue && pos - run.start < UINT_MAX) {
+            pos++;
+        }
+        run.length = static_cast<unsigned int>(pos - run.start);
+        runs.push_back(run);
+    }
+}
+
+void SequenceLookup::pack(int alphabetSize) {
+    if (isPacked()) {
+        return;
+    }
+    const unsigned char *seq = reinterpret_cast<const unsigned char *>(data);
+    unsigned int maxResidue = 0;
+#pragma omp parallel for schedule(static) reduction(max:maxResidue)
+    for (size_t i = 0; i < dataSize; i++) {
+        maxResidue = std::max(maxResidue, static_cast<unsigned int>(seq[i]));
+    }
+    maxResidue = std::max(maxResidue, static_cast<unsigned int>(alphabetSize - 1));
+
+    // the last letter (X or N) is often rare enough to be stored as exception run
+    unsigned int wideBits = computeResidueBits(maxResidue);
+    unsigned int narrowBits = 1;
+    while ((1u << narrowBits) < maxResidue) {
+        narrowBits++;
+    }
+    if (wideBits >= 8) {
+        return;
+    }
+    std::vector<ExceptionRun> runs;
+    unsigned int bits = wideBits;
+    if (narrowBits < wideBits) {
+        collectExceptions(narrowBits, runs);
+        if (packedBytes(dataSize, narrowBits) + runs.size() * sizeof(ExceptionRun) < packedBytes(dataSize, wideBits)) {
+            bits = narrowBits;
+        } else {
+            runs.clear();
+        }
+    }
+
+    // blocks of 64 residues start at a byte boundary and can be written independently
+    const size_t bytes = packedBytes(dataSize, bits);
+    unsigned char *packed = new(std::nothrow) unsigned char[bytes];
+    Util::checkAllocation(packed, "Can not allocate packed data memory in SequenceLookup");
+    MemoryPlacement::advise(packed, bytes);
+    memset(packed + bytes - sizeof(uint64_t), 0, sizeof(uint64_t));
+    const unsigned char limit = static_cast<unsigned char>(1u << bits);
+    const size_t blocks = (dataSize + 63) / 64;
+#pragma omp parallel for schedule(static)
+    for (size_t block = 0; block < blocks; block++) {
+        const size_t from = block * 64;
+        const size_t to = std::min(from + 64, dataSize);
+        unsigned char *out = packed + block * 8 * bits;
+        uint64_t buffer = 0;
+        unsigned int bufferBits = 0;
+        for (size_t i = from; i < to; i++) {
+            const uint64_t residue = (seq[i] < limit) ? seq[i] : 0;
+            buffer |= residue << bufferBits;
+            bufferBits += bits;
+            while (bufferBits >= 8) {
+                *out++ = static_cast<unsigned char>(buffer & 0xFF);
+                buffer >>= 8;
+                bufferBits -= 8;
+            }
+        }
+        if (bufferBits > 0) {
+            *out = static_cast<unsigned char>(buffer & 0xFF);
+        }
+    }
+
+    delete[] data;
+    data = reinterpret_cast<char *>(packed);
+    residueBits = bits;
+    exceptionCount = runs.size();
+    if (exceptionCount > 0) {
+        exceptions = new(std::nothrow) ExceptionRun[exceptionCount];
+        Util::checkAllocation(exceptions, "Can not allocate exception memory in SequenceLookup");
+        std::copy(runs.begin(), runs.end(), exceptions);
+    }
+    Debug(Debug::INFO) << "Sequence lookup packed to " << bits << " bits per residue with " << exceptionCount << " exception runs\n";
+}
+
 const char *SequenceLookup::getData() {
     return data;
 }
@@ -54,6 +213,10 @@ int64_t SequenceLookup::getDataSize() {
     return dataSize;
 }
 
+size_t SequenceLookup::getDataBytes() {
+    return isPacked() ? packedBytes(dataSize, residueBits) : dataSize + 1;
+}
+
 size_t *SequenceLookup::getOffsets() {
     return offsets;
 }
@@ -73,3 +236,29 @@ void SequenceLookup::initLookupByExternalDataCopy(char *seqData, size_t *seqOffs
     memcpy(data, seqData, (dataSize + 1) * sizeof(char));
     memcpy(offsets, seqOffsets, (sequenceCount + 1) * sizeof(size_t));
 }
+
+void SequenceLookup::initPackedLookupByExternalData(char *seqData, size_t seqDataSize, size_t *seqOffsets, unsigned int bits,
+                                                    ExceptionRun *runs, size_t runCount) {
+    initLookupByExternalData(seqData, seqDataSize, seqOffsets);
+    residueBits = bits;
+    exceptions = runs;
+    exceptionCount = runCount;
+}
+
+void SequenceLookup::initPackedLookupByExternalDataCopy(char *seqData, size_t seqDataSize, size_t *seqOffsets, unsigned int bits,
+                                                        ExceptionRun *runs, size_t runCount) {
+    dataSize = seqDataSize;
+    residueBits = bits;
+    delete[] data;
+    data = new(std::nothrow) char[getDataBytes()];
+    Util::checkAllocation(data, "Can not allocate data memory in SequenceLookup");
+    MemoryPlacement::advise(data, getDataBytes());
+    memcpy(data, seqData, getDataBytes());
+    memcpy(offsets, seqOffsets, (sequenceCount + 1) * sizeof(size_t));
+    exceptionCount = runCount;
+    if (exceptionCount > 0) {
+        exceptions = new(std::nothrow) ExceptionRun[exceptionCount];
+        Util::checkAllocation(exceptions, "Can not allocate exception memory in SequenceLookup");
+        memcpy(exceptions, runs, exceptionCount * sizeof(ExceptionRun));
+    }
+}
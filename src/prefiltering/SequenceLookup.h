@@ -7,10 +7,24 @@
 
 
 #include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
 #include "Sequence.h"
 
+// Residues are either stored as one byte each or, after pack(), as a little endian bit stream
+// with getResidueBits() bits per residue. Residues that do not fit into these bits (e.g. N and
+// masked residues of nucleotide sequences stored with 2 bits) are kept as runs in a sorted
+// exception list. The offsets always count residues.
 class SequenceLookup {
 public:
+    struct ExceptionRun {
+        size_t start;
+        unsigned int length;
+        unsigned int residue;
+    };
+
     SequenceLookup(size_t dbSize, size_t entrySize);
     SequenceLookup(size_t dbSize);
     ~SequenceLookup();
@@ -21,20 +35,70 @@ public:
     // add sequence to index
     void addSequence(Sequence * seq);
 
-    // get sequence data
+    // get sequence data, only valid for unpacked lookups
     std::pair<const unsigned char *, const unsigned int> getSequence(size_t id);
 
+    unsigned int getSequenceLength(size_t id) {
+        return static_cast<unsigned int>(offsets[id + 1] - offsets[id]);
+    }
+
+    // writes the residues of sequence id to out[0], out[stride], out[2 * stride], ...
+    void unpackSequence(size_t id, unsigned char *out, size_t stride = 1);
+
+    // bit packs all residues of an alphabet with alphabetSize letters,
+    // the lookup stays unpacked if the alphabet does not fit into less than 8 bits
+    void pack(int alphabetSize);
+
+    bool isPacked() {
+        return residueBits < 8;
+    }
+
+    unsigned int getResidueBits() {
+        return residueBits;
+    }
+
     const char *getData();
 
+    // number of residues
     int64_t getDataSize();
 
+    // number of bytes of getData()
+    size_t getDataBytes();
+
     size_t getSequenceCount();
 
     size_t *getOffsets();
 
+    ExceptionRun *getExceptions() {
+        return exceptions;
+    }
+
+    size_t getExceptionCount() {
+        return exceptionCount;
+    }
+
     void initLookupByExternalData(char *seqData, size_t dataSize, size_t *seqOffsets);
     void initLookupByExternalDataCopy(char *seqData, size_t *seqOffsets);
 
+    void initPackedLookupByExternalData(char *seqData, size_t dataSize, size_t *seqOffsets, unsigned int bits,
+                                        ExceptionRun *runs, size_t runCount);
+    void initPackedLookupByExternalDataCopy(char *seqData, size_t dataSize, size_t *seqOffsets, unsigned int bits,
+                                            ExceptionRun *runs, size_t runCount);
+
+    // bits per residue of a packed lookup whose largest residue is maxResidue, 8 means unpacked
+    static unsigned int computeResidueBits(unsigned int maxResidue) {
+        unsigned int bits = 1;
+        while ((1u << bits) <= maxResidue) {
+            bits++;
+        }
+        return std::min(bits, 8u);
+    }
+
+    static size_t packedBytes(size_t residues, unsigned int bits) {
+        // the decoder reads whole 64 bit words
+        return (residues * bits + 7) / 8 + sizeof(uint64_t);
+    }
+
 private:
     size_t sequenceCount;
 
@@ -44,12 +108,18 @@ private:
 
     size_t *offsets;
 
+    unsigned int residueBits;
+    ExceptionRun *exceptions;
+    size_t exceptionCount;
+
     // write position
     size_t currentIndex;
     size_t currentOffset;
 
     // if data are read from mmap
     bool externalData;
+
+    void collectExceptions(unsigned int bits, std::vector<ExceptionRun> &runs);
 };
 
 
@@ -9,6 +9,8 @@
 #include "simd.h"
 #include "CacheFriendlyOperations.h"
 #include "SequenceLookup.h"
+#include "UngappedAlignmentKernel.h"
+
 class UngappedAlignment {
 
 public:
@@ -47,6 +49,11 @@ private:
     char * aaCorrectionScore;
     BaseMatrix *subMatrix;
     SequenceLookup *sequenceLookup;
+    unsigned char *unpackedSequence;
+    unsigned int unpackedSequenceSize;
+    // scores the diagonal of lanes (16/32) db sequences in parallel, selected at runtime
+    const UngappedAlignmentKernel *kernel;
+    unsigned int lanes;
 
     // this function bins the hit_t by diagonals by distributing each hit in an array of 256 * 16(sse)/32(avx2)
     // the function scoreDiagonalAndUpdateHits is called for each bin that reaches its maximum (16 or 32)
@@ -61,11 +68,11 @@ private:
                                     const unsigned int seqLen,
                                     const unsigned char *dbSeq);
 
-    // scores the diagonal of  16/32 db sequences in parallel
-    simd_int vectorDiagonalScoring(const char *profile,
-                                         const char bias, const unsigned int seqLen, const unsigned char *dbSeq);
+    // interleaves the first seqLens[i] residues of the hit sequences for the kernel
+    std::pair<unsigned char *, unsigned int> mapSequences(CounterResult **hits, const unsigned int *seqLens, unsigned int seqCount);
 
-    std::pair<unsigned char *, unsigned int> mapSequences(std::pair<unsigned char *, unsigned int> * seqs, unsigned int seqCount);
+    // returns the residues of a db sequence, packed lookups are decoded into unpackedSequence
+    std::pair<const unsigned char *, const unsigned int> getSequence(unsigned int id);
 
     // calles vectorDiagonalScoring or scalarDiagonalScoring depending on the hitSize
     // and updates diagonalScore of the hit_t objects
@@ -75,8 +82,6 @@ private:
 
     unsigned short distanceFromDiagonal(const unsigned short diagonal);
 
-    void extractScores(unsigned int *score_arr, simd_int score);
-
     short createProfile(Sequence *seq, float *biasCorrection, short **subMat, int alphabetSize);
 
     unsigned int diagonalLength(const short diagonal, const unsigned int len, const unsigned int second);
@@ -0,0 +1,20 @@
+#ifndef MMSEQS_UNGAPPEDALIGNMENTKERNEL_H
+#define MMSEQS_UNGAPPEDALIGNMENTKERNEL_H
+
+// SIMD diagonal scoring of UngappedAlignment. UngappedAlignmentKernel.cpp is compiled once
+// per instruction set (see SimdDispatch.h), UngappedAlignment picks one table at runtime.
+#include "SimdDispatch.h"
+
+struct UngappedAlignmentKernel {
+    // number of db sequences scored in parallel, dbSeq is interleaved with this stride
+    unsigned int lanes;
+
+    // scores the diagonal of lanes db sequences in parallel and writes one max score per lane
+    // profile has PROFILESIZE (32) bytes per position, both buffers are aligned to MAX_ALIGN_INT
+    void (*scoreDiagonals)(const char *profile, const char bias, const unsigned int seqLen,
+                           const unsigned char *dbSeq, unsigned int *scores);
+};
+
+SIMD_DECLARE_KERNEL(UngappedAlignmentKernel, ungappedAlignmentKernel)
+
+#endif
@@ -0,0 +1,49 @@
+// AVX-512BW version of UngappedAlignmentKernel.cpp, scores 64 db sequences per call.
+// Only compiled with -mavx512f -mavx512bw (see SimdDispatch.h).
+#include "UngappedAlignmentKernel.h"
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 warns about _mm512_undefined_* inside its own intrinsic headers (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace simd_avx512 {
+
+static void scoreDiagonals(const char *profile, const char bias, const unsigned int seqLen,
+                           const unsigned char *dbSeq, unsigned int *scores) {
+    __m512i vscore        = _mm512_setzero_si512();
+    __m512i vMaxScore     = _mm512_setzero_si512();
+    const __m512i vBias   = _mm512_set1_epi8(bias);
+    const __m512i fiveten = _mm512_set1_epi8(15);
+    for (unsigned int pos = 0; pos < seqLen; pos++) {
+        __m512i template01 = _mm512_load_si512((const __m512i *)&dbSeq[pos * 64]);
+        // each position has 32 byte, broadcast score 0 - 15 and 16 - 31 into every 128-bit lane
+        __m512i score_matrix_vec01 = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *)&profile[pos * 32]));
+        __m512i score_matrix_vec16 = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *)&profile[pos * 32 + 16]));
+        // t[i] > 15 takes its score from the upper half
+        __mmask64 lookup_mask16 = _mm512_cmpgt_epi8_mask(template01, fiveten);
+        __m512i score_vec_8bit = _mm512_shuffle_epi8(score_matrix_vec01, template01);
+        score_vec_8bit = _mm512_mask_shuffle_epi8(score_vec_8bit, lookup_mask16, score_matrix_vec16, template01);
+
+        vscore    = _mm512_adds_epu8(vscore, score_vec_8bit);
+        vscore    = _mm512_subs_epu8(vscore, vBias);
+        vMaxScore = _mm512_max_epu8(vMaxScore, vscore);
+    }
+    _mm512_storeu_si512(scores,      _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(vMaxScore, 0)));
+    _mm512_storeu_si512(scores + 16, _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(vMaxScore, 1)));
+    _mm512_storeu_si512(scores + 32, _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(vMaxScore, 2)));
+    _mm512_storeu_si512(scores + 48, _mm512_cvtepu8_epi32(_mm512_extracti32x4_epi32(vMaxScore, 3)));
+}
+
+extern const UngappedAlignmentKernel ungappedAlignmentKernel = {
+    64,
+    scoreDiagonals
+};
+
+}
@@ -11,59 +11,74 @@
 #include <fstream>
 #include <algorithm>
 #include <cassert>
-
-int **makeMatrix(size_t maxNodes) {
-    Debug(Debug::INFO) << "Making matrix ...";
-    size_t dimension = maxNodes * 2;
-    int **M = new int*[dimension];
-    int k = (int)(MathUtil::flog2(dimension)) + 1;
-    for (size_t i = 0; i < dimension; ++i) {
-        M[i] = new int[k]();
-    }
-    Debug(Debug::INFO) << " Done\n";
-    return M;
-}
-
-void deleteMatrix(int** M, size_t maxNodes) {
-    for (size_t i = 0; i < (maxNodes * 2); ++i) {
-        delete[] M[i];
-    }
-    delete[] M;
+#include <cstring>
+#include <stdint.h>
+
+template <typename T>
+static T *copyArray(const std::vector<T> &vec) {
+    T *array = new T[std::max(vec.size(), static_cast<size_t>(1))];
+    std::copy(vec.begin(), vec.end(), array);
+    return array;
 }
 
+NcbiTaxonomy::NcbiTaxonomy() : taxonNodes(NULL), maxNodes(0), D(NULL), maxTaxID(0), E(NULL), L(NULL), H(NULL),
+                               M(NULL), mCols(0), block(NULL), blockSize(0), mmapData(NULL), mmapSize(0) {}
 
 NcbiTaxonomy::NcbiTaxonomy(const std::string &namesFile,  const std::string &nodesFile,
-                           const std::string &mergedFile) {
-    loadNodes(nodesFile);
-    loadMerged(mergedFile);
-    loadNames(namesFile);
-
-    maxNodes = taxonNodes.size();
-
-    E.reserve(maxNodes * 2);
-    L.reserve(maxNodes * 2);
+                           const std::string &mergedFile) : mmapData(NULL), mmapSize(0) {
+    std::vector<TaxonNode> nodes;
+    std::vector<int> taxIdToNode;
+    std::string strings;
+    loadNodes(nodes, taxIdToNode, strings, nodesFile);
+    loadMerged(taxIdToNode, mergedFile);
+    loadNames(nodes, taxIdToNode, strings, namesFile);
+
+    maxNodes = nodes.size();
+    taxonNodes = copyArray(nodes);
+    maxTaxID = taxIdToNode.size() - 1;
+    D = copyArray(taxIdToNode);
+    blockSize = strings.size();
+    block = new char[blockSize];
+    memcpy(block, strings.data(), blockSize);
+
+    std::vector<int> tour;
+    std::vector<int> tourLevels;
+    tour.reserve(maxNodes * 2);
+    tourLevels.reserve(maxNodes * 2);
 
     H = new int[maxNodes];
     std::fill(H, H + maxNodes, 0);
 
-    std::vector< std::vector<TaxID> > children(taxonNodes.size());
-    for (std::vector<TaxonNode>::iterator it = taxonNodes.begin(); it != taxonNodes.end(); ++it) {
-        if (it->parentTaxId != it->taxId) {
-            children[nodeId(it->parentTaxId)].push_back(it->taxId);
+    std::vector< std::vector<TaxID> > children(maxNodes);
+    for (size_t i = 0; i < maxNodes; ++i) {
+        if (taxonNodes[i].parentTaxId != taxonNodes[i].taxId) {
+            children[nodeId(taxonNodes[i].parentTaxId)].push_back(taxonNodes[i].taxId);
         }
     }
 
-    elh(children, 1, 0);
-    E.resize(maxNodes * 2, 0);
-    L.resize(maxNodes * 2, 0);
+    elh(children, 1, 0, tour, tourLevels);
+    tour.resize(maxNodes * 2, 0);
+    tourLevels.resize(maxNodes * 2, 0);
+    E = copyArray(tour);
+    L = copyArray(tourLevels);
 
-    M = makeMatrix(maxNodes);
+    mCols = (size_t)(MathUtil::flog2(maxNodes * 2)) + 1;
+    M = new int[maxNodes * 2 * mCols]();
     InitRangeMinimumQuery();
 }
 
 NcbiTaxonomy::~NcbiTaxonomy() {
+    if (mmapData != NULL) {
+        FileUtil::munmapData(mmapData, mmapSize);
+        return;
+    }
+    delete[] taxonNodes;
+    delete[] D;
+    delete[] E;
+    delete[] L;
     delete[] H;
-    deleteMatrix(M, maxNodes);
+    delete[] M;
+    delete[] block;
 }
 
 std::vector<std::string> splitByDelimiter(const std::string &s, const std::string &delimiter, int maxCol) {
@@ -81,7 +96,8 @@ std::vector<std::string> splitByDelimiter(const std::string &s, const std::strin
     return result;
 }
 
-size_t NcbiTaxonomy::loadNodes(const std::string &nodesFile) {
+size_t NcbiTaxonomy::loadNodes(std::vector<TaxonNode> &nodes, std::vector<int> &taxIdToNode, std::string &strings,
+                               const std::string &nodesFile) {
     Debug(Debug::INFO) << "Loading nodes file ...";
     std::ifstream ss(nodesFile);
     if (ss.fail()) {
@@ -89,6 +105,9 @@ size_t NcbiTaxonomy::loadNodes(const std::string &nodesFile) {
         EXIT(EXIT_FAILURE);
     }
 
+    // offset 0 is the empty name of nodes without a scientific name
+    strings.assign(1, '\0');
+    std::map<std::string, size_t> rankIdx;
     std::map<TaxID, int> Dm; // temporary map TaxID -> internal ID;
     int maxTaxID = 0;
     int currentId = 0;
@@ -100,28 +119,33 @@ size_t NcbiTaxonomy::loadNodes(const std::string &nodesFile) {
         if (taxId > maxTaxID) {
             maxTaxID = taxId;
         }
-        taxonNodes.emplace_back(currentId, taxId, parentTaxId, result[2]);
+        std::map<std::string, size_t>::iterator it = rankIdx.find(result[2]);
+        if (it == rankIdx.end()) {
+            it = rankIdx.emplace(result[2], strings.size()).first;
+            strings.append(result[2].c_str(), result[2].size() + 1);
+        }
+        nodes.emplace_back(currentId, taxId, parentTaxId, it->second);
         Dm.emplace(taxId, currentId);
         ++currentId;
     }
 
-    D.clear();
-    D.resize(maxTaxID + 1, -1);
+    taxIdToNode.clear();
+    taxIdToNode.resize(maxTaxID + 1, -1);
     for (std::map<TaxID, int>::iterator it = Dm.begin(); it != Dm.end(); ++it) {
         assert(it->first <= maxTaxID);
-        D[it->first] = it->second;
+        taxIdToNode[it->first] = it->second;
     }
 
     // Loop over taxonNodes and check all parents exist
-    for (std::vector<TaxonNode>::iterator it = taxonNodes.begin(); it != taxonNodes.end(); ++it) {
-        if (!nodeExists(it->parentTaxId)) {
+    for (std::vector<TaxonNode>::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        if (it->parentTaxId < 0 || it->parentTaxId > maxTaxID || taxIdToNode[it->parentTaxId] == -1) {
             Debug(Debug::ERROR) << "Inconsistent nodes.dmp taxonomy file! Cannot find parent taxon with ID " << it->parentTaxId << "!\n";
             EXIT(EXIT_FAILURE);
         }
     }
 
-    Debug(Debug::INFO) << " Done, got " << taxonNodes.size() << " nodes\n";
-    return taxonNodes.size();
+    Debug(Debug::INFO) << " Done, got " << nodes.size() << " nodes\n";
+    return nodes.size();
 }
 
 std::pair<int, std::string> parseName(const std::string &line) {
@@ -133,7 +157,8 @@ std::pair<int, std::string> parseName(const std::string &line) {
     return std::make_pair((int)strtol(result[0].c_str(), NULL, 10), result[1]);
 }
 
-void NcbiTaxonomy::loadNames(const std::string &namesFile) {
+void NcbiTaxonomy::loadNames(std::vector<TaxonNode> &nodes, const std::vector<int> &taxIdToNode, std::string &strings,
+                             const std::string &namesFile) {
     Debug(Debug::INFO) << "Loading names file ...";
     std::ifstream ss(namesFile);
     if (ss.fail()) {
@@ -148,49 +173,51 @@ void NcbiTaxonomy::loadNames(const std::string &namesFile) {
         }
 
         std::pair<int, std::string> entry = parseName(line);
-        if (!nodeExists(entry.first)) {
+        if (entry.first < 0 || static_cast<size_t>(entry.first) >= taxIdToNode.size() || taxIdToNode[entry.first] == -1) {
             Debug(Debug::ERROR) << "loadNames: Taxon " << entry.first << " not present in nodes file!\n";
             EXIT(EXIT_FAILURE);
         }
-        taxonNodes[nodeId(entry.first)].name = entry.second;
+        nodes[taxIdToNode[entry.first]].nameIdx = strings.size();
+        strings.append(entry.second.c_str(), entry.second.size() + 1);
     }
     Debug(Debug::INFO) << " Done\n";
 }
 
 // Euler traversal of tree
-void NcbiTaxonomy::elh(std::vector< std::vector<TaxID> > const & children, TaxID taxId, int level) {
+void NcbiTaxonomy::elh(std::vector< std::vector<TaxID> > const & children, TaxID taxId, int level,
+                       std::vector<int> &tour, std::vector<int> &tourLevels) {
     assert (taxId > 0);
     int id = nodeId(taxId);
 
     if (H[id] == 0) {
-        H[id] = E.size();
+        H[id] = tour.size();
     }
 
-    E.emplace_back(id);
-    L.emplace_back(level);
+    tour.emplace_back(id);
+    tourLevels.emplace_back(level);
 
     for (std::vector<TaxID>::const_iterator child_it = children[id].begin(); child_it != children[id].end(); ++child_it) {
-        elh(children, *child_it, level + 1);
+        elh(children, *child_it, level + 1, tour, tourLevels);
     }
-    E.emplace_back(nodeId(taxonNodes[id].parentTaxId));
-    L.emplace_back(level - 1);
+    tour.emplace_back(nodeId(taxonNodes[id].parentTaxId));
+    tourLevels.emplace_back(level - 1);
 }
 
 void NcbiTaxonomy::InitRangeMinimumQuery() {
     Debug(Debug::INFO) << "Init RMQ ...";
 
     for (unsigned int i = 0; i < (maxNodes * 2); ++i) {
-        M[i][0] = i;
+        M[i * mCols] = i;
     }
 
     for (unsigned int j = 1; (1ul << j) <= (maxNodes * 2); ++j) {
         for (unsigned int i = 0; (i + (1ul << j) - 1) < (maxNodes * 2); ++i) {
-            int A = M[i][j - 1];
-            int B = M[i + (1ul << (j - 1))][j - 1];
+            int A = M[i * mCols + j - 1];
+            int B = M[(i + (1ul << (j - 1))) * mCols + j - 1];
             if (L[A] < L[B]) {
-                M[i][j] = A;
+                M[i * mCols + j] = A;
             } else {
-                M[i][j] = B;
+                M[i * mCols + j] = B;
             }
         }
     }
@@ -200,8 +227,8 @@ void NcbiTaxonomy::InitRangeMinimumQuery() {
 int NcbiTaxonomy::RangeMinimumQuery(int i, int j) const {
     assert(j >= i);
     int k = (int)MathUtil::flog2(j - i + 1);
-    int A = M[i][k];
-    int B = M[j - MathUtil::ipow<int>(2, k) + 1][k];
+    int A = M[i * mCols + k];
+    int B = M[(j - MathUtil::ipow<int>(2, k) + 1) * mCols + k];
     if (L[A] <= L[B]) {
         return A;
     }
@@ -278,7 +305,7 @@ TaxonNode const * NcbiTaxonomy::LCA(const std::vector<TaxID>& taxa) const {
         }
     }
 
-    assert(red >= 0 && static_cast<unsigned int>(red) < taxonNodes.size());
+    assert(red >= 0 && static_cast<unsigned int>(red) < maxNodes);
 
     return &(taxonNodes[red]);
 }
@@ -289,8 +316,8 @@ std::vector<std::string> NcbiTaxonomy::AtRanks(TaxonNode const *node, const std:
     std::vector<std::string> result;
     std::map<std::string, std::string> allRanks = AllRanks(node);
     // map does not include "no rank" nor "no_rank"
-    int baseRankIndex = findRankIndex(node->rank);
-    std::string baseRank = "uc_" + node->name;
+    int baseRankIndex = findRankIndex(getString(node->rankIdx));
+    std::string baseRank = "uc_" + std::string(getString(node->nameIdx));
     for (std::vector<std::string>::const_iterator it = levels.begin(); it != levels.end(); ++it) {
         std::map<std::string, std::string>::iterator jt = allRanks.find(*it);
         if (jt != allRanks.end()) {
@@ -348,9 +375,9 @@ std::string NcbiTaxonomy::taxLineage(TaxonNode const *node, bool infoAsName) {
 
     for (int i = taxLineageVec.size() - 1; i >= 0; --i) {
         if (infoAsName) {
-            taxLineage += findShortRank(taxLineageVec[i]->rank);
+            taxLineage += findShortRank(getString(taxLineageVec[i]->rankIdx));
             taxLineage += '_';
-            taxLineage += taxLineageVec[i]->name;
+            taxLineage += getString(taxLineageVec[i]->nameIdx);
         } else {
             taxLineage += SSTR(taxLineageVec[i]->taxId);
         }
@@ -371,7 +398,7 @@ int NcbiTaxonomy::nodeId(TaxID taxonId) const {
 }
 
 bool NcbiTaxonomy::nodeExists(TaxID taxonId) const {
-    return D[taxonId] != -1;
+    return taxonId >= 0 && taxonId <= maxTaxID && D[taxonId] != -1;
 }
 
 TaxonNode const * NcbiTaxonomy::taxonNode(TaxID taxonId, bool fail) const {
@@ -384,20 +411,21 @@ TaxonNode const * NcbiTaxonomy::taxonNode(TaxID taxonId, bool fail) const {
 std::map<std::string, std::string> NcbiTaxonomy::AllRanks(TaxonNode const *node) const {
     std::map<std::string, std::string> result;
     while (true) {
+        std::string rank = getString(node->rankIdx);
         if (node->taxId == 1) {
-            result.emplace(node->rank, node->name);
+            result.emplace(rank, getString(node->nameIdx));
             return result;
         }
 
-        if ((node->rank != "no_rank") && (node->rank != "no rank")) {
-            result.emplace(node->rank, node->name);
+        if ((rank != "no_rank") && (rank != "no rank")) {
+            result.emplace(rank, getString(node->nameIdx));
         }
 
         node = taxonNode(node->parentTaxId);
     }
 }
 
-size_t NcbiTaxonomy::loadMerged(const std::string &mergedFile) {
+size_t NcbiTaxonomy::loadMerged(std::vector<int> &taxIdToNode, const std::string &mergedFile) {
     Debug(Debug::INFO) << "Loading merged file ...";
     std::ifstream ss(mergedFile);
     if (ss.fail()) {
@@ -416,8 +444,14 @@ size_t NcbiTaxonomy::loadMerged(const std::string &mergedFile) {
 
         unsigned int oldId = (unsigned int)strtoul(result[0].c_str(), NULL, 10);
         unsigned int mergedId = (unsigned int)strtoul(result[1].c_str(), NULL, 10);
-        if (!nodeExists(oldId) && nodeExists(mergedId)) {
-            D[oldId] = D[mergedId];
+        if (mergedId >= taxIdToNode.size() || taxIdToNode[mergedId] == -1) {
+            continue;
+        }
+        if (oldId >= taxIdToNode.size()) {
+            taxIdToNode.resize(oldId + 1, -1);
+        }
+        if (taxIdToNode[oldId] == -1) {
+            taxIdToNode[oldId] = taxIdToNode[mergedId];
             ++count;
         }
     }
@@ -441,7 +475,8 @@ std::unordered_map<TaxID, TaxonCounts> NcbiTaxonomy::getCladeCounts(std::unorder
         }
     }
 
-    for (const TaxonNode& tn : taxonNodes) {
+    for (size_t i = 0; i < maxNodes; ++i) {
+        const TaxonNode& tn = taxonNodes[i];
         if (tn.parentTaxId != tn.taxId && cladeCounts.count(tn.taxId)) {
             std::unordered_map<TaxID, TaxonCounts>::iterator itp = cladeCounts.find(tn.parentTaxId);
             itp->second.children.push_back(tn.taxId);
@@ -453,10 +488,20 @@ std::unordered_map<TaxID, TaxonCounts> NcbiTaxonomy::getCladeCounts(std::unorder
 }
 
 NcbiTaxonomy * NcbiTaxonomy::openTaxonomy(std::string &database){
-    Debug(Debug::INFO) << "Loading NCBI taxonomy\n";
+    std::string binFile = database + "_taxonomy";
     std::string nodesFile = database + "_nodes.dmp";
     std::string namesFile = database + "_names.dmp";
     std::string mergedFile = database + "_merged.dmp";
+    if (FileUtil::fileExists(binFile.c_str())) {
+        // dump files that changed after the binary taxonomy was written are loaded instead
+        if (FileUtil::isNewer(nodesFile, binFile) || FileUtil::isNewer(namesFile, binFile) || FileUtil::isNewer(mergedFile, binFile)) {
+            Debug(Debug::WARNING) << "Binary taxonomy " << binFile << " is older than the NCBI dump files and is ignored. Please recreate it with createbintaxonomy.\n";
+        } else {
+            Debug(Debug::INFO) << "Loading binary taxonomy " << binFile << "\n";
+            return NcbiTaxonomy::unserialize(binFile);
+        }
+    }
+    Debug(Debug::INFO) << "Loading NCBI taxonomy\n";
     if (FileUtil::fileExists(nodesFile.c_str())
         && FileUtil::fileExists(namesFile.c_str())
         && FileUtil::fileExists(mergedFile.c_str())) {
@@ -472,3 +517,129 @@ NcbiTaxonomy * NcbiTaxonomy::openTaxonomy(std::string &database){
     }
     return new NcbiTaxonomy(namesFile, nodesFile, mergedFile);
 }
+
+// file layout: header, then taxonNodes, D, E, L, H, M and the string block, each section padded to 8 bytes
+static const uint64_t TAXONOMY_MAGIC = 0x3130584154534d4dULL; // "MMSTAX01"
+
+struct TaxonomyHeader {
+    uint64_t magic;
+    uint64_t maxNodes;
+    uint64_t maxTaxID;
+    uint64_t mCols;
+    uint64_t blockSize;
+};
+
+static size_t paddedSize(size_t size) {
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+static void writePadding(FILE *handle, size_t size, const std::string &file) {
+    static const char padding[8] = {0};
+    const size_t padSize = paddedSize(size) - size;
+    if (fwrite(padding, 1, padSize, handle) != padSize) {
+        Debug(Debug::ERROR) << "Can not write to " << file << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+static void writeSection(FILE *handle, const void *data, size_t size, const std::string &file) {
+    if (fwrite(data, 1, size, handle) != size) {
+        Debug(Debug::ERROR) << "Can not write to " << file << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    writePadding(handle, size, file);
+}
+
+void NcbiTaxonomy::serialize(const std::string &file) const {
+    // a linked binary taxonomy is replaced instead of overwriting the link target
+    FILE *handle = FileUtil::openAndDelete(file.c_str(), "wb");
+    TaxonomyHeader header;
+    header.magic = TAXONOMY_MAGIC;
+    header.maxNodes = maxNodes;
+    header.maxTaxID = maxTaxID;
+    header.mCols = mCols;
+    header.blockSize = blockSize;
+    writeSection(handle, &header, sizeof(TaxonomyHeader), file);
+    // nodes are copied field by field into zeroed records, so the struct padding is not written
+    const size_t chunkSize = 4096;
+    TaxonNode *nodes = static_cast<TaxonNode *>(calloc(chunkSize, sizeof(TaxonNode)));
+    Util::checkAllocation(nodes, "Can not allocate nodes memory in NcbiTaxonomy::serialize");
+    for (size_t start = 0; start < maxNodes; start += chunkSize) {
+        const size_t count = std::min(chunkSize, maxNodes - start);
+        for (size_t i = 0; i < count; i++) {
+            nodes[i].id = taxonNodes[start + i].id;
+            nodes[i].taxId = taxonNodes[start + i].taxId;
+            nodes[i].parentTaxId = taxonNodes[start + i].parentTaxId;
+            nodes[i].rankIdx = taxonNodes[start + i].rankIdx;
+            nodes[i].nameIdx = taxonNodes[start + i].nameIdx;
+        }
+        if (fwrite(nodes, sizeof(TaxonNode), count, handle) != count) {
+            Debug(Debug::ERROR) << "Can not write to " << file << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    free(nodes);
+    writePadding(handle, sizeof(TaxonNode) * maxNodes, file);
+    writeSection(handle, D, sizeof(int) * (maxTaxID + 1), file);
+    writeSection(handle, E, sizeof(int) * maxNodes * 2, file);
+    writeSection(handle, L, sizeof(int) * maxNodes * 2, file);
+    writeSection(handle, H, sizeof(int) * maxNodes, file);
+    writeSection(handle, M, sizeof(int) * maxNodes * 2 * mCols, file);
+    writeSection(handle, block, blockSize, file);
+    if (fclose(handle) != 0) {
+        Debug(Debug::ERROR) << "Can not close " << file << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+NcbiTaxonomy * NcbiTaxonomy::unserialize(const std::string &file) {
+    FILE *handle = FileUtil::openFileOrDie(file.c_str(), "r", true);
+    size_t dataSize;
+    char *data = static_cast<char *>(FileUtil::mmapFile(handle, &dataSize));
+    fclose(handle);
+
+    TaxonomyHeader header;
+    if (dataSize < sizeof(TaxonomyHeader)) {
+        Debug(Debug::ERROR) << "Binary taxonomy " << file << " is truncated\n";
+        EXIT(EXIT_FAILURE);
+    }
+    memcpy(&header, data, sizeof(TaxonomyHeader));
+    if (header.magic != TAXONOMY_MAGIC) {
+        Debug(Debug::ERROR) << "File " << file << " is not a binary taxonomy of this version. Please recreate it with createbintaxonomy.\n";
+        EXIT(EXIT_FAILURE);
+    }
+    const size_t expectedSize = paddedSize(sizeof(TaxonomyHeader))
+                                + paddedSize(sizeof(TaxonNode) * header.maxNodes)
+                                + paddedSize(sizeof(int) * (header.maxTaxID + 1))
+                                + 2 * paddedSize(sizeof(int) * header.maxNodes * 2)
+                                + paddedSize(sizeof(int) * header.maxNodes)
+                                + paddedSize(sizeof(int) * header.maxNodes * 2 * header.mCols)
+                                + paddedSize(header.blockSize);
+    if (dataSize != expectedSize) {
+        Debug(Debug::ERROR) << "Binary taxonomy " << file << " has size " << dataSize << " instead of " << expectedSize << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    NcbiTaxonomy *t = new NcbiTaxonomy();
+    t->mmapData = data;
+    t->mmapSize = dataSize;
+    t->maxNodes = header.maxNodes;
+    t->maxTaxID = header.maxTaxID;
+    t->mCols = header.mCols;
+    t->blockSize = header.blockSize;
+    char *p = data + paddedSize(sizeof(TaxonomyHeader));
+    t->taxonNodes = reinterpret_cast<TaxonNode *>(p);
+    p += paddedSize(sizeof(TaxonNode) * t->maxNodes);
+    t->D = reinterpret_cast<int *>(p);
+    p += paddedSize(sizeof(int) * (t->maxTaxID + 1));
+    t->E = reinterpret_cast<int *>(p);
+    p += paddedSize(sizeof(int) * t->maxNodes * 2);
+    t->L = reinterpret_cast<int *>(p);
+    p += paddedSize(sizeof(int) * t->maxNodes * 2);
+    t->H = reinterpret_cast<int *>(p);
+    p += paddedSize(sizeof(int) * t->maxNodes);
+    t->M = reinterpret_cast<int *>(p);
+    p += paddedSize(sizeof(int) * t->maxNodes * 2 * t->mCols);
+    t->block = p;
+    return t;
+}
@@ -13,15 +13,17 @@
 
 typedef int TaxID;
 
+// rank and name are offsets into the string block, use NcbiTaxonomy::getString
 struct TaxonNode {
     int id;
     TaxID taxId;
     TaxID parentTaxId;
-    std::string rank;
-    std::string name;
+    size_t rankIdx;
+    size_t nameIdx;
 
-    TaxonNode(int id, TaxID taxId, TaxID parentTaxId, const std::string& rank)
-            : id(id), taxId(taxId), parentTaxId(parentTaxId), rank(rank), name("") {};
+    TaxonNode() {};
+    TaxonNode(int id, TaxID taxId, TaxID parentTaxId, size_t rankIdx)
+            : id(id), taxId(taxId), parentTaxId(parentTaxId), rankIdx(rankIdx), nameIdx(0) {};
 };
 
 struct TaxonCounts {
@@ -90,12 +92,26 @@ public:
     //std::unordered_map<TaxID, unsigned int> getCladeCounts(std::unordered_map<TaxID, unsigned int>& taxonCounts, TaxID taxon = 1) const;
     std::unordered_map<TaxID, TaxonCounts> getCladeCounts(std::unordered_map<TaxID, unsigned int>& taxonCounts) const;
 
+    const char *getString(size_t blockIdx) const {
+        return block + blockIdx;
+    }
+
+    // prefers the binary taxonomy <database>_taxonomy over the NCBI dump files
     static NcbiTaxonomy * openTaxonomy(std::string & database);
+
+    // binary taxonomy with the parsed nodes, names, Euler tour and RMQ table, it is memory mapped when opened
+    void serialize(const std::string &file) const;
+    static NcbiTaxonomy * unserialize(const std::string &file);
 private:
-    size_t loadNodes(const std::string &nodesFile);
-    size_t loadMerged(const std::string &mergedFile);
-    void loadNames(const std::string &namesFile);
-    void elh(std::vector< std::vector<TaxID> > const & children, int node, int level);
+    NcbiTaxonomy();
+
+    static size_t loadNodes(std::vector<TaxonNode> &nodes, std::vector<int> &taxIdToNode, std::string &strings,
+                            const std::string &nodesFile);
+    static size_t loadMerged(std::vector<int> &taxIdToNode, const std::string &mergedFile);
+    static void loadNames(std::vector<TaxonNode> &nodes, const std::vector<int> &taxIdToNode, std::string &strings,
+                          const std::string &namesFile);
+    void elh(std::vector< std::vector<TaxID> > const & children, int node, int level,
+             std::vector<int> &tour, std::vector<int> &tourLevels);
     void InitRangeMinimumQuery();
     int nodeId(TaxID taxId) const;
     bool nodeExists(TaxID taxId) const;
@@ -103,13 +119,21 @@ private:
     int RangeMinimumQuery(int i, int j) const;
     int lcaHelper(int i, int j) const;
 
-    std::vector<TaxonNode> taxonNodes;
-    std::vector<int> D; // maps from taxID to node ID in taxonNodes
-    std::vector<int> E; // for Euler tour sequence (size 2N-1)
-    std::vector<int> L; // Level of nodes in tour sequence (size 2N-1)
-    int* H;
-    int **M;
+    TaxonNode *taxonNodes;
     size_t maxNodes;
+    int *D; // maps from taxID to node ID in taxonNodes
+    TaxID maxTaxID;
+    int *E; // for Euler tour sequence (size 2N-1)
+    int *L; // Level of nodes in tour sequence (size 2N-1)
+    int *H;
+    int *M; // sparse table of 2N rows with mCols columns
+    size_t mCols;
+    char *block; // zero terminated ranks and names
+    size_t blockSize;
+
+    // all arrays point into this mapping if the taxonomy was unserialized
+    char *mmapData;
+    size_t mmapSize;
 
 };
 
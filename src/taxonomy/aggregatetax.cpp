@@ -145,7 +145,7 @@ TaxID selectTaxForSet (const std::vector<taxHit> &setTaxa, NcbiTaxonomy const *t
             int currMinRank = ROOT_RANK;
             TaxID currParentTaxId = node->parentTaxId;
             while (currParentTaxId != currTaxId) {
-                int currRankInd = NcbiTaxonomy::findRankIndex(node->rank);
+                int currRankInd = NcbiTaxonomy::findRankIndex(taxonomy->getString(node->rankIdx));
                 if ((currRankInd > 0) && (currRankInd < currMinRank)) {
                     currMinRank = currRankInd;
                     // the rank can only go up on the way to the root, so we can break
@@ -327,9 +327,9 @@ int aggregate(const bool useAln, int argc, const char **argv, const Command& com
             } else {
                 setTaxStr.append(SSTR(node->taxId));
                 setTaxStr.append(1, '\t');
-                setTaxStr.append(node->rank);
+                setTaxStr.append(t->getString(node->rankIdx));
                 setTaxStr.append(1, '\t');
-                setTaxStr.append(node->name);
+                setTaxStr.append(t->getString(node->nameIdx));
                 setTaxStr.append(1, '\t');
                 setTaxStr.append(SSTR(totalNumSeqs));
                 setTaxStr.append(1, '\t');
@@ -0,0 +1,13 @@
+#include "MappingReader.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "Util.h"
+
+int createbintaxmapping(int argc, const char **argv, const Command& command) {
+    Parameters& par = Parameters::getInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    MappingReader mapping(par.db1, false);
+    mapping.writeBinary(par.db2);
+    return EXIT_SUCCESS;
+}
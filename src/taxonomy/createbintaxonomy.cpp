@@ -0,0 +1,13 @@
+#include "NcbiTaxonomy.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "Util.h"
+
+int createbintaxonomy(int argc, const char **argv, const Command& command) {
+    Parameters& par = Parameters::getInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    NcbiTaxonomy taxonomy(par.db1, par.db2, par.db3);
+    taxonomy.serialize(par.db4);
+    return EXIT_SUCCESS;
+}
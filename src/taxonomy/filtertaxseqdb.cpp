@@ -1,4 +1,5 @@
 #include "NcbiTaxonomy.h"
+#include "MappingReader.h"
 #include "Parameters.h"
 #include "DBWriter.h"
 #include "FileUtil.h"
@@ -12,24 +13,16 @@
 #include <omp.h>
 #endif
 
-static bool compareToFirstInt(const std::pair<unsigned int, unsigned int>& lhs, const std::pair<unsigned int, unsigned int>& rhs){
-    return (lhs.first <= rhs.first);
-}
-
 int filtertaxseqdb(int argc, const char **argv, const Command& command) {
     Parameters& par = Parameters::getInstance();
     par.parseParameters(argc, argv, command, true, 0, 0);
     
     // open mapping (dbKey to taxid)
-    std::vector<std::pair<unsigned int, unsigned int>> mapping;
     if (FileUtil::fileExists(std::string(par.db1 + "_mapping").c_str()) == false) {
         Debug(Debug::ERROR) << par.db1 + "_mapping" << " does not exist. Please create the taxonomy mapping!\n";
         EXIT(EXIT_FAILURE);
     }
-    bool isSorted = Util::readMapping(par.db1 + "_mapping", mapping);
-    if (isSorted == false) {
-        std::stable_sort(mapping.begin(), mapping.end(), compareToFirstInt);
-    }
+    MappingReader mapping(par.db1 + "_mapping");
 
     // open taxonomy - evolutionary relationships amongst taxa
     NcbiTaxonomy * t = NcbiTaxonomy::openTaxonomy(par.db1);
@@ -38,7 +31,9 @@ int filtertaxseqdb(int argc, const char **argv, const Command& command) {
     reader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
     const bool isCompressed = reader.isCompressed();
 
-    DBWriter writer(par.db2.c_str(), par.db2Index.c_str(), par.threads, 0, Parameters::DBTYPE_OMIT_FILE);
+    // compressed entries are decompressed and written again in blocks
+    const size_t writerMode = (isCompressed && par.subDbMode != Parameters::SUBDB_MODE_SOFT) ? Parameters::WRITER_COMPRESSED_MODE : Parameters::WRITER_ASCII_MODE;
+    DBWriter writer(par.db2.c_str(), par.db2Index.c_str(), par.threads, writerMode, Parameters::DBTYPE_OMIT_FILE);
     writer.open();
 
     // a few NCBI taxa are blacklisted by default, they contain unclassified sequences (e.g. metagenomes) or other sequences (e.g. plasmids)
@@ -61,17 +56,10 @@ int filtertaxseqdb(int argc, const char **argv, const Command& command) {
             unsigned int key = reader.getDbKey(i);
             size_t offset = reader.getOffset(i);
             size_t length = reader.getEntryLen(i);
-            unsigned int taxon = 0;
-
             // match dbKey to its taxon based on mapping
-            std::pair<unsigned int, unsigned int> val;
-            val.first = key;
-            std::vector<std::pair<unsigned int, unsigned int>>::iterator mappingIt;
-            mappingIt = std::upper_bound(mapping.begin(), mapping.end(), val, compareToFirstInt);
-            if (mappingIt == mapping.end() || mappingIt->first != val.first) {
+            unsigned int taxon = mapping.lookup(key);
+            if (taxon == MappingReader::NOT_FOUND) {
                 taxon = 0;
-            } else {
-                taxon = mappingIt->second;
             }
 
             // if taxon is a descendent of the requested taxid, it will be retained.
@@ -81,17 +69,10 @@ int filtertaxseqdb(int argc, const char **argv, const Command& command) {
                 if (par.subDbMode == Parameters::SUBDB_MODE_SOFT) {
                     writer.writeIndexEntry(key, offset, length, thread_idx);
                 } else {
-                    char* data = reader.getDataUncompressed(i);
+                    char* data = reader.getData(i, thread_idx);
                     size_t originalLength = reader.getEntryLen(i);
                     size_t entryLength = std::max(originalLength, static_cast<size_t>(1)) - 1;
-
-                    if (isCompressed) {
-                        // copy also the null byte since it contains the information if compressed or not
-                        entryLength = *(reinterpret_cast<unsigned int *>(data)) + sizeof(unsigned int) + 1;
-                        writer.writeData(data, entryLength, key, thread_idx, false, false);
-                    } else {
-                        writer.writeData(data, entryLength, key, thread_idx, true, false);
-                    }
+                    writer.writeData(data, entryLength, key, thread_idx, true, false);
                     writer.writeIndexEntry(key, writer.getStart(thread_idx), originalLength, thread_idx);
                 }
             }
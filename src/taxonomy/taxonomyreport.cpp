@@ -13,10 +13,6 @@
 #include <omp.h>
 #endif
 
-static bool compareToFirstInt(const std::pair<unsigned int, unsigned int>& lhs, const std::pair<unsigned int, unsigned int>&  rhs){
-    return (lhs.first <= rhs.first);
-}
-
 template<typename K, typename V>
 V at(const std::unordered_map<K, V>& map, K key, V default_value = V()) {
     typename std::unordered_map<K, V>::const_iterator it = map.find(key);
@@ -55,7 +51,7 @@ void taxReport(FILE* FP, const NcbiTaxonomy& taxDB, const std::unordered_map<Tax
         const TaxonNode* taxon = taxDB.taxonNode(taxID);
         fprintf(FP, "%.4f\t%i\t%i\t%s\t%i\t%s%s\n",
                 100*cladeCount/double(totalReads), cladeCount, taxCount,
-                taxon->rank.c_str(), taxID, std::string(2*depth, ' ').c_str(), taxon->name.c_str());
+                taxDB.getString(taxon->rankIdx), taxID, std::string(2*depth, ' ').c_str(), taxDB.getString(taxon->nameIdx));
 
         std::vector<TaxID> children = it->second.children;
         std::sort(children.begin(), children.end(), [&](int a, int b) { return cladeCountVal(cladeCounts, a) > cladeCountVal(cladeCounts,b); });
@@ -114,7 +110,7 @@ void kronaReport(FILE* FP, const NcbiTaxonomy& taxDB, const std::unordered_map<T
             return;
         }
         const TaxonNode* taxon = taxDB.taxonNode(taxID);
-        std::string escapedName = escapeAttribute(taxon->name);
+        std::string escapedName = escapeAttribute(taxDB.getString(taxon->nameIdx));
         fprintf(FP, "<node name=\"%s\"><magnitude><val>%d</val></magnitude>", escapedName.c_str(), cladeCount);
         std::vector<TaxID> children = it->second.children;
         std::sort(children.begin(), children.end(), [&](int a, int b) { return cladeCountVal(cladeCounts, a) > cladeCountVal(cladeCounts,b); });
@@ -136,15 +132,10 @@ int taxonomyreport(int argc, const char **argv, const Command& command) {
     // 1. Read taxonomy
     NcbiTaxonomy * taxDB = NcbiTaxonomy::openTaxonomy(par.db1);
 
-    std::vector<std::pair<unsigned int, unsigned int>> mapping;
     if(FileUtil::fileExists(std::string(par.db1 + "_mapping").c_str()) == false){
         Debug(Debug::ERROR) << par.db1 + "_mapping" << " does not exist. Please create the taxonomy mapping!\n";
         EXIT(EXIT_FAILURE);
     }
-    bool isSorted = Util::readMapping( par.db1 + "_mapping", mapping);
-    if(isSorted == false){
-        std::stable_sort(mapping.begin(), mapping.end(), compareToFirstInt);
-    }
 
     DBReader<unsigned int> reader(par.db2.c_str(), par.db2Index.c_str(), 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     reader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
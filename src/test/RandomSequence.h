@@ -0,0 +1,41 @@
+#ifndef MMSEQS_RANDOMSEQUENCE_H
+#define MMSEQS_RANDOMSEQUENCE_H
+
+// Random protein sequences and mutated copies for tests, drawn from rand()
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+
+static const char RANDOM_SEQUENCE_AA[] = "ACDEFGHIKLMNPQRSTVWY";
+
+static inline std::string randomSequence(size_t len) {
+    std::string seq;
+    for (size_t i = 0; i < len; i++) {
+        seq.push_back(RANDOM_SEQUENCE_AA[rand() % 20]);
+    }
+    return seq;
+}
+
+// copies seq[from, from + len) with substitutionPercent substitutions, 2% deletions and 2% insertions
+static inline std::string mutate(const std::string &seq, int substitutionPercent, size_t from = 0, size_t len = SIZE_MAX) {
+    std::string out;
+    from = std::min(from, seq.size());
+    const size_t end = from + std::min(len, seq.size() - from);
+    for (size_t i = from; i < end; i++) {
+        int r = rand() % 100;
+        if (r < substitutionPercent) {
+            out.push_back(RANDOM_SEQUENCE_AA[rand() % 20]);
+        } else if (r < substitutionPercent + 2) {
+            // deletion
+        } else if (r < substitutionPercent + 4) {
+            out.push_back(seq[i]);
+            out.push_back(RANDOM_SEQUENCE_AA[rand() % 20]);
+        } else {
+            out.push_back(seq[i]);
+        }
+    }
+    return out;
+}
+
+#endif
@@ -0,0 +1,115 @@
+// Compares the inter-sequence kernel (ssw_align_batch) against ssw_align
+// for random short queries and mutated targets, reports mismatches and runtime
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+
+#include "StripedSmithWaterman.h"
+#include "SubstitutionMatrix.h"
+#include "EvalueComputation.h"
+#include "Sequence.h"
+#include "Parameters.h"
+#include "Timer.h"
+#include "RandomSequence.h"
+
+const char* binary_name = "test_alignmentbatch";
+
+// a mutated slice of seq with short random flanks
+static std::string mutateSlice(const std::string &seq, size_t from, size_t len) {
+    std::string out = randomSequence(rand() % 8);
+    out += mutate(seq, 15, from, len);
+    out += randomSequence(rand() % 8);
+    return out;
+}
+
+int main (int, const char**) {
+    Parameters& par = Parameters::getInstance();
+    SubstitutionMatrix subMat(par.scoringMatrixFile.aminoacids, 2.0, 0.0);
+    int8_t *tinySubMat = new int8_t[subMat.alphabetSize * subMat.alphabetSize];
+    for (int i = 0; i < subMat.alphabetSize; i++) {
+        for (int j = 0; j < subMat.alphabetSize; j++) {
+            tinySubMat[i * subMat.alphabetSize + j] = (int8_t) subMat.subMatrix[i][j];
+        }
+    }
+    const int gapOpen = 11;
+    const int gapExtend = 1;
+    EvalueComputation evaluer(100000, &subMat, gapOpen, gapExtend);
+
+    SmithWaterman aligner(1000, subMat.alphabetSize, true);
+    Sequence query(1000, Parameters::DBTYPE_AMINO_ACIDS, &subMat, 0, false, true);
+    std::vector<Sequence*> targets;
+    const size_t targetCount = 512;
+    for (size_t i = 0; i < targetCount; i++) {
+        targets.push_back(new Sequence(1000, Parameters::DBTYPE_AMINO_ACIDS, &subMat, 0, false, true));
+    }
+    std::vector<const unsigned char*> targetSeqs(targetCount);
+    std::vector<int32_t> targetLens(targetCount);
+    std::vector<s_align> batchResults(targetCount);
+    std::vector<s_align> singleResults(targetCount);
+
+    srand(1);
+    size_t mismatches = 0;
+    size_t alignments = 0;
+    double timeSingle = 0.0;
+    double timeBatch = 0.0;
+    for (size_t round = 0; round < 200; round++) {
+        std::string querySeq = randomSequence(8 + rand() % ((round % 4 == 0) ? SmithWaterman::BATCH_MAX_QUERY_LEN - 8 : 120));
+        query.mapSequence(0, 0, querySeq.c_str(), querySeq.size());
+        aligner.ssw_init(&query, tinySubMat, &subMat, 2);
+        if (aligner.canAlignBatch() == false) {
+            std::cout << "Query of length " << query.L << " can not be aligned in batches\n";
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < targetCount; i++) {
+            std::string targetSeq;
+            if (rand() % 2 == 0) {
+                size_t from = rand() % querySeq.size();
+                targetSeq = mutateSlice(querySeq, from, 5 + rand() % 250);
+            } else {
+                targetSeq = randomSequence(5 + rand() % 250);
+            }
+            if (targetSeq.empty()) {
+                targetSeq = randomSequence(5);
+            }
+            targets[i]->mapSequence(i, i, targetSeq.c_str(), targetSeq.size());
+            targetSeqs[i] = targets[i]->numSequence;
+            targetLens[i] = targets[i]->L;
+        }
+        const uint8_t mode = round % 2;
+        const int32_t maskLen = query.L / 2;
+
+        Timer timer;
+        aligner.ssw_align_batch(targetSeqs.data(), targetLens.data(), targetCount, gapOpen, gapExtend, mode,
+                                10000, &evaluer, 0, 0.0, maskLen, batchResults.data());
+        timeBatch += timer.getTimediff();
+        timer.reset();
+        for (size_t i = 0; i < targetCount; i++) {
+            singleResults[i] = aligner.ssw_align(targetSeqs[i], targetLens[i], gapOpen, gapExtend, mode,
+                                                 10000, &evaluer, 0, 0.0, maskLen);
+        }
+        timeSingle += timer.getTimediff();
+        for (size_t i = 0; i < targetCount; i++) {
+            const s_align &single = singleResults[i];
+            const s_align &batch = batchResults[i];
+            alignments++;
+            if (single.score1 != batch.score1 || single.dbEndPos1 != batch.dbEndPos1 || single.qEndPos1 != batch.qEndPos1
+                || single.dbStartPos1 != batch.dbStartPos1 || single.qStartPos1 != batch.qStartPos1) {
+                mismatches++;
+                std::cout << "Mismatch query " << querySeq << " target " << i << " length " << targetLens[i] << ": "
+                          << single.score1 << " " << single.qStartPos1 << "-" << single.qEndPos1 << " "
+                          << single.dbStartPos1 << "-" << single.dbEndPos1 << " vs "
+                          << batch.score1 << " " << batch.qStartPos1 << "-" << batch.qEndPos1 << " "
+                          << batch.dbStartPos1 << "-" << batch.dbEndPos1 << "\n";
+            }
+        }
+    }
+    std::cout << alignments << " alignments, " << mismatches << " mismatches\n";
+    std::cout << "ssw_align: " << timeSingle << "s, ssw_align_batch: " << timeBatch << "s\n";
+
+    for (size_t i = 0; i < targetCount; i++) {
+        delete targets[i];
+    }
+    delete [] tinySubMat;
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,129 @@
+// Checks that a query whose hits are aligned by all threads together gives the same alignment DB,
+// sort order and alignment count as aligning it in a single thread
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <climits>
+
+#include "Alignment.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "Util.h"
+#include "RandomSequence.h"
+
+const char* binary_name = "test_alignmentsplit";
+
+static const char* DB_NAME = "alignmentSplitDB";
+static const char* PREF_DB = "alignmentSplitPref";
+
+static const unsigned int FAMILY_SIZE = 300;
+static const unsigned int OTHER_QUERIES = 40;
+
+// key 0 is a long query with a hit to every member of its family, the other queries only hit their neighbours
+static void writeDatabases() {
+    DBWriter seqWriter(DB_NAME, (std::string(DB_NAME) + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_AMINO_ACIDS);
+    seqWriter.open();
+    const std::string ancestor = randomSequence(1200);
+    std::string seq = ancestor + "\n";
+    seqWriter.writeData(seq.c_str(), seq.size(), 0);
+    unsigned int key = 1;
+    for (unsigned int i = 0; i < FAMILY_SIZE; i++) {
+        if (i % 25 == 0) {
+            // too short to reach the coverage threshold
+            seq = mutate(ancestor, 20, rand() % 800, 100) + "\n";
+        } else if (i % 10 == 0) {
+            // duplicates give equal scores, their order has to be kept as well
+            seq = mutate(ancestor, 60, 200, 600) + "\n";
+            seqWriter.writeData(seq.c_str(), seq.size(), key++);
+            i++;
+        } else {
+            seq = mutate(ancestor, 10 + rand() % 60, rand() % 200, 700 + rand() % 300) + "\n";
+        }
+        seqWriter.writeData(seq.c_str(), seq.size(), key++);
+    }
+    const unsigned int familyEnd = key;
+    for (unsigned int i = 0; i < OTHER_QUERIES; i++) {
+        seq = randomSequence(50 + rand() % 200) + "\n";
+        seqWriter.writeData(seq.c_str(), seq.size(), key++);
+    }
+    seqWriter.close();
+
+    DBWriter prefWriter(PREF_DB, (std::string(PREF_DB) + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_PREFILTER_RES);
+    prefWriter.open();
+    std::string hits;
+    for (unsigned int target = 0; target < familyEnd; target++) {
+        hits.append(SSTR(target) + "\t" + SSTR(100 - target % 100) + "\t0\n");
+    }
+    prefWriter.writeData(hits.c_str(), hits.size(), 0);
+    for (unsigned int query = familyEnd; query < key; query++) {
+        hits.clear();
+        hits.append(SSTR(query) + "\t100\t0\n");
+        hits.append(SSTR(query == familyEnd ? key - 1 : query - 1) + "\t10\t0\n");
+        prefWriter.writeData(hits.c_str(), hits.size(), query);
+    }
+    prefWriter.close();
+}
+
+static size_t align(Parameters &par, const std::string &out, size_t &passed) {
+    Alignment aln(DB_NAME, DB_NAME, PREF_DB, std::string(PREF_DB) + ".index", out, out + ".index", par);
+    aln.run(par.maxAccept, par.maxRejected);
+    passed = aln.getPassedCount();
+    return aln.getAlignmentCount();
+}
+
+static bool compareDatabases(const std::string &expected, const std::string &actual) {
+    DBReader<unsigned int> expectedReader(expected.c_str(), (expected + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    expectedReader.open(DBReader<unsigned int>::NOSORT);
+    DBReader<unsigned int> actualReader(actual.c_str(), (actual + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    actualReader.open(DBReader<unsigned int>::NOSORT);
+    bool same = expectedReader.getSize() == actualReader.getSize();
+    if (same == false) {
+        Debug(Debug::ERROR) << expected << " has " << expectedReader.getSize() << " entries, " << actual << " has " << actualReader.getSize() << "\n";
+    }
+    for (size_t i = 0; same && i < expectedReader.getSize(); i++) {
+        const unsigned int key = expectedReader.getDbKey(i);
+        const size_t id = actualReader.getId(key);
+        // the whole entry is compared, so the order of the alignments has to match too
+        same = id != UINT_MAX
+               && std::string(expectedReader.getData(i, 0), expectedReader.getEntryLen(i))
+                  == std::string(actualReader.getData(id, 0), actualReader.getEntryLen(id));
+        if (same == false) {
+            Debug(Debug::ERROR) << "Entry " << key << " differs between " << expected << " and " << actual << "\n";
+        }
+    }
+    actualReader.close();
+    expectedReader.close();
+    return same;
+}
+
+int main (int, const char**) {
+    Parameters &par = Parameters::getInstance();
+    par.covThr = 0.3;
+    par.addBacktrace = true;
+    srand(1);
+    writeDatabases();
+
+    const std::string serialDB = "alignmentSplitSerial";
+    const std::string splitDB = "alignmentSplitThreads";
+    size_t serialPassed;
+    par.threads = 1;
+    const size_t serialAlignments = align(par, serialDB, serialPassed);
+    size_t splitPassed;
+    // query 0 costs more than an even share of 4 threads and is split over its hits
+    par.threads = 4;
+    const size_t splitAlignments = align(par, splitDB, splitPassed);
+
+    bool success = compareDatabases(serialDB, splitDB);
+    std::cout << "Split query results: " << (success ? "ok" : "failed") << std::endl;
+    const bool counts = serialAlignments == splitAlignments && serialPassed == splitPassed && serialPassed > FAMILY_SIZE / 2;
+    std::cout << "Alignments: " << serialAlignments << " / " << splitAlignments << ", passed: " << serialPassed << " / " << splitPassed
+              << " " << (counts ? "ok" : "failed") << std::endl;
+
+    DBReader<unsigned int>::removeDb(serialDB);
+    DBReader<unsigned int>::removeDb(splitDB);
+    DBReader<unsigned int>::removeDb(PREF_DB);
+    DBReader<unsigned int>::removeDb(DB_NAME);
+    return (success && counts) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,275 @@
+// Checks that the CSR clustering graph gives the same links and clusters as the previous
+// symmetrization, with the links in memory and in memory mapped spill files, and that the
+// clustering does not depend on the number of threads
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <climits>
+
+#include "ClusteringAlgorithms.h"
+#include "ClusteringGraph.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Parameters.h"
+#include "Debug.h"
+
+const char* binary_name = "test_clusteringgraph";
+
+static const char* SEQ_DB = "clusteringGraphSeqDB";
+static const char* ALN_DB = "clusteringGraphAlnDB";
+static const char* TIED_SEQ_DB = "clusteringGraphTiedSeqDB";
+static const char* TIED_ALN_DB = "clusteringGraphTiedAlnDB";
+
+static const unsigned int NODE_COUNT = 16;
+static const unsigned int LENGTHS[NODE_COUNT] = { 300, 290, 290, 280, 280, 280, 250, 250, 250, 200, 150, 150, 150, 100, 90, 90 };
+
+struct Link {
+    unsigned int query;
+    unsigned int target;
+    float seqId;
+};
+
+// asymmetric results, every query hits itself first, 14 has an empty result
+static const Link LINKS[] = {
+    { 0, 0, 1.0f }, { 0, 1, 0.9f }, { 0, 2, 0.85f }, { 0, 3, 0.8f },
+    { 1, 1, 1.0f }, { 1, 0, 0.9f }, { 1, 4, 0.7f },
+    { 2, 2, 1.0f }, { 2, 5, 0.6f },
+    { 3, 3, 1.0f }, { 3, 0, 0.8f }, { 3, 5, 0.75f }, { 3, 6, 0.7f },
+    { 4, 4, 1.0f },
+    { 5, 5, 1.0f }, { 5, 2, 0.6f }, { 5, 3, 0.75f },
+    { 6, 6, 1.0f }, { 6, 7, 0.95f }, { 6, 8, 0.9f },
+    { 7, 7, 1.0f }, { 7, 8, 0.85f },
+    { 8, 8, 1.0f }, { 8, 6, 0.9f }, { 8, 7, 0.85f }, { 8, 9, 0.8f },
+    { 9, 9, 1.0f },
+    { 10, 10, 1.0f }, { 10, 11, 0.5f }, { 10, 12, 0.5f },
+    { 11, 11, 1.0f }, { 11, 13, 0.99f },
+    { 12, 12, 1.0f }, { 12, 13, 0.4f },
+    { 13, 13, 1.0f },
+    { 15, 15, 1.0f }, { 15, 14, 0.9f }, { 15, 4, 0.88f }
+};
+
+// (representative, member) pairs of clust before the CSR graph
+static const unsigned int SET_COVER[NODE_COUNT][2] = {
+    { 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 3 }, { 5, 5 }, { 8, 6 }, { 8, 7 }, { 8, 8 },
+    { 8, 9 }, { 10, 10 }, { 10, 12 }, { 13, 11 }, { 13, 13 }, { 15, 4 }, { 15, 14 }, { 15, 15 }
+};
+static const unsigned int CONNECTED_COMPONENT[NODE_COUNT][2] = {
+    { 8, 0 }, { 8, 1 }, { 8, 2 }, { 8, 3 }, { 8, 4 }, { 8, 5 }, { 8, 6 }, { 8, 7 },
+    { 8, 8 }, { 8, 9 }, { 8, 14 }, { 8, 15 }, { 13, 10 }, { 13, 11 }, { 13, 12 }, { 13, 13 }
+};
+
+static std::string formatSeqId(float seqId) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.3f", seqId);
+    return buffer;
+}
+
+static void writeDatabases() {
+    DBWriter seqWriter(SEQ_DB, (std::string(SEQ_DB) + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_AMINO_ACIDS);
+    seqWriter.open();
+    for (unsigned int key = 0; key < NODE_COUNT; key++) {
+        std::string seq = std::string(LENGTHS[key], 'A') + "\n";
+        seqWriter.writeData(seq.c_str(), seq.size(), key);
+    }
+    seqWriter.close();
+
+    DBWriter alnWriter(ALN_DB, (std::string(ALN_DB) + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_ALIGNMENT_RES);
+    alnWriter.open();
+    for (unsigned int key = 0; key < NODE_COUNT; key++) {
+        std::string result;
+        for (size_t i = 0; i < sizeof(LINKS) / sizeof(LINKS[0]); i++) {
+            if (LINKS[i].query != key) {
+                continue;
+            }
+            const unsigned int target = LINKS[i].target;
+            char buffer[1024];
+            snprintf(buffer, sizeof(buffer), "%u\t100\t%s\t1e-10\t0\t%u\t%u\t0\t%u\t%u\n", target, formatSeqId(LINKS[i].seqId).c_str(),
+                     LENGTHS[key] - 1, LENGTHS[key], LENGTHS[target] - 1, LENGTHS[target]);
+            result.append(buffer);
+        }
+        alnWriter.writeData(result.c_str(), result.size(), key);
+    }
+    alnWriter.close();
+}
+
+// every node keeps its own result, links only found by other nodes follow ordered by that node
+static bool checkGraph(DBReader<unsigned int> &seqDbr, DBReader<unsigned int> &alnDbr, size_t memoryLimit) {
+    std::vector<std::vector<std::pair<unsigned int, unsigned short>>> expected(NODE_COUNT);
+    for (unsigned int id = 0; id < NODE_COUNT; id++) {
+        const unsigned int key = seqDbr.getDbKey(id);
+        bool empty = true;
+        for (size_t i = 0; i < sizeof(LINKS) / sizeof(LINKS[0]); i++) {
+            if (LINKS[i].query == key) {
+                expected[id].emplace_back(seqDbr.getId(LINKS[i].target), static_cast<unsigned short>(atof(formatSeqId(LINKS[i].seqId).c_str()) * 1000.0f));
+                empty = false;
+            }
+        }
+        if (empty) {
+            expected[id].emplace_back(id, 1000);
+        }
+    }
+    std::vector<std::vector<std::pair<unsigned int, unsigned short>>> symmetric(expected);
+    for (unsigned int id = 0; id < NODE_COUNT; id++) {
+        for (size_t i = 0; i < expected[id].size(); i++) {
+            const unsigned int other = expected[id][i].first;
+            bool found = false;
+            for (size_t j = 0; j < expected[other].size(); j++) {
+                found |= expected[other][j].first == id;
+            }
+            if (found == false) {
+                symmetric[other].emplace_back(id, expected[id][i].second);
+            }
+        }
+    }
+
+    ClusteringGraph graph(memoryLimit, "clusteringGraphSpill");
+    graph.load(&seqDbr, &alnDbr, Parameters::APC_SEQID, 2);
+    bool same = graph.getSize() == NODE_COUNT;
+    for (unsigned int id = 0; same && id < NODE_COUNT; id++) {
+        same = graph.getElementCount(id) == symmetric[id].size();
+        for (size_t i = 0; same && i < symmetric[id].size(); i++) {
+            same = graph.getElements(id)[i] == symmetric[id][i].first && graph.getScores(id)[i] == symmetric[id][i].second;
+        }
+        if (same == false) {
+            Debug(Debug::ERROR) << "Links of node " << seqDbr.getDbKey(id) << " differ\n";
+        }
+    }
+    return same;
+}
+
+static bool checkClustering(DBReader<unsigned int> &seqDbr, DBReader<unsigned int> &alnDbr, size_t memoryLimit,
+                            int mode, const unsigned int expected[NODE_COUNT][2]) {
+    ClusteringAlgorithms algorithm(&seqDbr, &alnDbr, 2, Parameters::APC_SEQID, 1000, memoryLimit, "clusteringGraphSpill");
+    std::pair<unsigned int, unsigned int> *assignment = algorithm.execute(mode);
+    bool same = true;
+    for (unsigned int i = 0; i < NODE_COUNT; i++) {
+        if (assignment[i].first != expected[i][0] || assignment[i].second != expected[i][1]) {
+            Debug(Debug::ERROR) << "Member " << assignment[i].second << " is in cluster " << assignment[i].first
+                                << ", expected " << expected[i][1] << " in cluster " << expected[i][0] << "\n";
+            same = false;
+        }
+    }
+    delete[] assignment;
+    return same;
+}
+
+// Equal lengths and few distinct scores give many sets of the same size and tied scores. A hub linked to half
+// of the nodes makes the first representative remove enough links to decrease the sets with several threads.
+static void writeTiedDatabases(unsigned int nodeCount) {
+    DBWriter seqWriter(TIED_SEQ_DB, (std::string(TIED_SEQ_DB) + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_AMINO_ACIDS);
+    seqWriter.open();
+    const std::string seq = std::string(100, 'A') + "\n";
+    for (unsigned int key = 0; key < nodeCount; key++) {
+        seqWriter.writeData(seq.c_str(), seq.size(), key);
+    }
+    seqWriter.close();
+
+    const float seqIds[] = { 0.5f, 0.8f, 0.9f };
+    srand(42);
+    std::vector<std::vector<std::pair<unsigned int, float>>> links(nodeCount);
+    for (unsigned int key = 0; key < nodeCount; key++) {
+        links[key].emplace_back(key, 1.0f);
+    }
+    for (unsigned int key = 1; key < nodeCount; key += 2) {
+        links[0].emplace_back(key, seqIds[rand() % 3]);
+    }
+    for (unsigned int key = 1; key < nodeCount; key++) {
+        const unsigned int linkCount = rand() % 120;
+        for (unsigned int i = 0; i < linkCount; i++) {
+            const unsigned int target = 1 + rand() % (nodeCount - 1);
+            bool found = false;
+            for (size_t j = 0; j < links[key].size(); j++) {
+                found |= links[key][j].first == target;
+            }
+            if (found == false) {
+                links[key].emplace_back(target, seqIds[rand() % 3]);
+            }
+        }
+    }
+
+    DBWriter alnWriter(TIED_ALN_DB, (std::string(TIED_ALN_DB) + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_ALIGNMENT_RES);
+    alnWriter.open();
+    for (unsigned int key = 0; key < nodeCount; key++) {
+        std::string result;
+        for (size_t i = 0; i < links[key].size(); i++) {
+            char buffer[1024];
+            snprintf(buffer, sizeof(buffer), "%u\t100\t%s\t1e-10\t0\t99\t100\t0\t99\t100\n", links[key][i].first, formatSeqId(links[key][i].second).c_str());
+            result.append(buffer);
+        }
+        alnWriter.writeData(result.c_str(), result.size(), key);
+    }
+    alnWriter.close();
+}
+
+static bool checkThreads(DBReader<unsigned int> &seqDbr, DBReader<unsigned int> &alnDbr, int mode, int threads) {
+    const size_t dbSize = seqDbr.getSize();
+    ClusteringAlgorithms serial(&seqDbr, &alnDbr, 1, Parameters::APC_SEQID, 1000, SIZE_MAX, "clusteringGraphSpill");
+    std::pair<unsigned int, unsigned int> *expected = serial.execute(mode);
+    ClusteringAlgorithms parallel(&seqDbr, &alnDbr, threads, Parameters::APC_SEQID, 1000, SIZE_MAX, "clusteringGraphSpill");
+    std::pair<unsigned int, unsigned int> *assignment = parallel.execute(mode);
+    bool same = true;
+    size_t representatives = 0;
+    for (size_t i = 0; i < dbSize; i++) {
+        representatives += expected[i].first == expected[i].second;
+        if (assignment[i] != expected[i]) {
+            Debug(Debug::ERROR) << "Member " << assignment[i].second << " is in cluster " << assignment[i].first
+                                << " with " << threads << " threads, expected " << expected[i].second
+                                << " in cluster " << expected[i].first << "\n";
+            same = false;
+        }
+    }
+    // the tied graph should not collapse into a single cluster
+    if (mode == 1 && representatives < 2) {
+        Debug(Debug::ERROR) << "Set cover found only " << representatives << " clusters\n";
+        same = false;
+    }
+    delete[] expected;
+    delete[] assignment;
+    return same;
+}
+
+int main (int, const char**) {
+    writeDatabases();
+    DBReader<unsigned int> seqDbr(SEQ_DB, (std::string(SEQ_DB) + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+    seqDbr.open(DBReader<unsigned int>::SORT_BY_LENGTH);
+    DBReader<unsigned int> alnDbr(ALN_DB, (std::string(ALN_DB) + ".index").c_str(), 2, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    alnDbr.open(DBReader<unsigned int>::NOSORT);
+
+    bool success = true;
+    // a limit of 0 keeps the links in memory mapped files
+    const size_t memoryLimits[] = { SIZE_MAX, 0 };
+    for (size_t i = 0; i < 2; i++) {
+        const char *storage = (memoryLimits[i] == 0) ? "spilled" : "in memory";
+        bool graph = checkGraph(seqDbr, alnDbr, memoryLimits[i]);
+        bool setCover = checkClustering(seqDbr, alnDbr, memoryLimits[i], 1, SET_COVER);
+        bool connectedComponent = checkClustering(seqDbr, alnDbr, memoryLimits[i], 3, CONNECTED_COMPONENT);
+        std::cout << "Graph " << storage << ": links " << (graph ? "ok" : "failed")
+                  << ", set cover " << (setCover ? "ok" : "failed")
+                  << ", connected component " << (connectedComponent ? "ok" : "failed") << std::endl;
+        success = success && graph && setCover && connectedComponent;
+    }
+
+    alnDbr.close();
+    seqDbr.close();
+    DBReader<unsigned int>::removeDb(SEQ_DB);
+    DBReader<unsigned int>::removeDb(ALN_DB);
+
+    writeTiedDatabases(3000);
+    DBReader<unsigned int> tiedSeqDbr(TIED_SEQ_DB, (std::string(TIED_SEQ_DB) + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+    tiedSeqDbr.open(DBReader<unsigned int>::SORT_BY_LENGTH);
+    DBReader<unsigned int> tiedAlnDbr(TIED_ALN_DB, (std::string(TIED_ALN_DB) + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    tiedAlnDbr.open(DBReader<unsigned int>::NOSORT);
+    bool setCoverThreads = checkThreads(tiedSeqDbr, tiedAlnDbr, 1, 8);
+    bool connectedComponentThreads = checkThreads(tiedSeqDbr, tiedAlnDbr, 3, 8);
+    std::cout << "Tied graph 1 and 8 threads: set cover " << (setCoverThreads ? "ok" : "failed")
+              << ", connected component " << (connectedComponentThreads ? "ok" : "failed") << std::endl;
+    success = success && setCoverThreads && connectedComponentThreads;
+    tiedAlnDbr.close();
+    tiedSeqDbr.close();
+    DBReader<unsigned int>::removeDb(TIED_SEQ_DB);
+    DBReader<unsigned int>::removeDb(TIED_ALN_DB);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
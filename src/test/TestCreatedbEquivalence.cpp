@@ -0,0 +1,317 @@
+// Checks that the parallel chunked createdb parser writes the same data, index, lookup, source and header DB
+// as the sequential KSeq reader for plain, gzip, BGZF and zstd FASTA and FASTQ, for records crossing chunks
+// and for wrapped FASTQ records, which are read sequentially
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include <zstd.h>
+
+#include "CommandDeclarations.h"
+#include "DBReader.h"
+#include "FileUtil.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "Util.h"
+#include "RandomSequence.h"
+
+const char* binary_name = "test_createdbequivalence";
+
+extern std::vector<Command> baseCommands;
+
+static const char* PARALLEL_DB = "createdbParallel";
+static const char* SEQUENTIAL_DB = "createdbSequential";
+// the sequential reader gets its input through a pipe with the same base name, pipes cannot be read in chunks
+static const char* PIPE_DIR = "createdbPipe";
+static const unsigned int THREADS = 2;
+
+static std::string readFile(const std::string &fileName) {
+    std::string content;
+    FILE *file = fopen(fileName.c_str(), "r");
+    if (file == NULL) {
+        return content;
+    }
+    char buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, sizeof(char), sizeof(buffer), file)) > 0) {
+        content.append(buffer, read);
+    }
+    fclose(file);
+    return content;
+}
+
+static void writeFile(const std::string &fileName, const std::string &content) {
+    FILE *file = FileUtil::openAndDelete(fileName.c_str(), "w");
+    fwrite(content.c_str(), sizeof(char), content.size(), file);
+    fclose(file);
+}
+
+static std::string fasta(size_t count, size_t minLength, size_t maxLength) {
+    std::string out;
+    for (size_t i = 0; i < count; i++) {
+        out.append(">seq_" + SSTR(i));
+        if (i % 3 != 0) {
+            out.append(" random protein " + SSTR(i));
+        }
+        out.push_back('\n');
+        const std::string seq = randomSequence(minLength + rand() % (maxLength - minLength + 1));
+        // single line and wrapped records
+        const size_t width = (i % 4 == 0) ? seq.size() : 60;
+        for (size_t pos = 0; pos < seq.size(); pos += width) {
+            out.append(seq, pos, width);
+            out.push_back('\n');
+        }
+    }
+    return out;
+}
+
+static std::string wrap(const std::string &line, size_t width) {
+    std::string out;
+    for (size_t pos = 0; pos < line.size(); pos += width) {
+        out.append(line, pos, width);
+        out.push_back('\n');
+    }
+    return out;
+}
+
+// records from wrapFrom on have their sequence and quality wrapped
+static std::string fastq(size_t count, size_t wrapFrom = SIZE_MAX) {
+    std::string out;
+    for (size_t i = 0; i < count; i++) {
+        const std::string seq = randomSequence(50 + rand() % 200);
+        std::string quality;
+        for (size_t pos = 0; pos < seq.size(); pos++) {
+            quality.push_back('!' + rand() % 42);
+        }
+        // quality lines that look like a record start
+        if (i % 7 == 0) {
+            quality[0] = '@';
+        }
+        const size_t width = (i < wrapFrom) ? seq.size() : 40;
+        out.append("@read_" + SSTR(i) + " lane " + SSTR(i % 8) + "\n" + wrap(seq, width) + "+\n" + wrap(quality, width));
+    }
+    return out;
+}
+
+#ifdef HAVE_ZLIB
+static std::string deflateData(const char *data, size_t length, int windowBits) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(z_stream));
+    deflateInit2(&strm, 1, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY);
+    std::string out(deflateBound(&strm, length), '\0');
+    strm.next_in = (Bytef *) data;
+    strm.avail_in = length;
+    strm.next_out = (Bytef *) &out[0];
+    strm.avail_out = out.size();
+    deflate(&strm, Z_FINISH);
+    out.resize(strm.total_out);
+    deflateEnd(&strm);
+    return out;
+}
+
+// plain gzip with two members, the members cannot be found without inflating them
+static std::string gzipCompress(const std::string &data) {
+    const size_t half = data.size() / 2;
+    return deflateData(data.c_str(), half, 15 + 16) + deflateData(data.c_str() + half, data.size() - half, 15 + 16);
+}
+
+static void appendLittleEndian(std::string &out, size_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out.push_back((char) ((value >> (8 * i)) & 0xff));
+    }
+}
+
+// BGZF blocks as written by bgzip, including the empty end of file block
+static std::string bgzfCompress(const std::string &data) {
+    const size_t blockSize = 65280;
+    std::string out;
+    for (size_t pos = 0; pos <= data.size(); pos += blockSize) {
+        const size_t length = std::min(blockSize, data.size() - pos);
+        const std::string compressed = deflateData(data.c_str() + pos, length, -15);
+        const unsigned char header[] = { 31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0 };
+        out.append((const char *) header, sizeof(header));
+        appendLittleEndian(out, sizeof(header) + 2 + compressed.size() + 8 - 1, 2);
+        out.append(compressed);
+        appendLittleEndian(out, crc32(0, (const Bytef *) data.c_str() + pos, length), 4);
+        appendLittleEndian(out, length, 4);
+        if (length == 0) {
+            break;
+        }
+    }
+    return out;
+}
+#endif
+
+// one frame per MiB, every frame knows its content size
+static std::string zstdFrames(const std::string &data) {
+    const size_t frameSize = 1024 * 1024;
+    std::string out;
+    for (size_t pos = 0; pos < data.size(); pos += frameSize) {
+        const size_t length = std::min(frameSize, data.size() - pos);
+        std::string frame(ZSTD_compressBound(length), '\0');
+        frame.resize(ZSTD_compress(&frame[0], frame.size(), data.c_str() + pos, length, 1));
+        out.append(frame);
+    }
+    return out;
+}
+
+// a single streamed frame without content size
+static std::string zstdStream(const std::string &data) {
+    ZSTD_CStream *stream = ZSTD_createCStream();
+    ZSTD_initCStream(stream, 1);
+    std::string out;
+    std::string buffer(ZSTD_CStreamOutSize(), '\0');
+    const size_t pieceSize = 65536;
+    for (size_t pos = 0; pos < data.size(); pos += pieceSize) {
+        ZSTD_inBuffer in = { data.c_str() + pos, std::min(pieceSize, data.size() - pos), 0 };
+        while (in.pos < in.size) {
+            ZSTD_outBuffer result = { &buffer[0], buffer.size(), 0 };
+            ZSTD_compressStream(stream, &result, &in);
+            out.append(buffer.c_str(), result.pos);
+        }
+    }
+    size_t remaining;
+    do {
+        ZSTD_outBuffer result = { &buffer[0], buffer.size(), 0 };
+        remaining = ZSTD_endStream(stream, &result);
+        out.append(buffer.c_str(), result.pos);
+    } while (remaining > 0);
+    ZSTD_freeCStream(stream);
+    return out;
+}
+
+static int runCreatedb(const std::string &input, const char *output, bool shuffle, unsigned int threads) {
+    Command *command = NULL;
+    for (size_t i = 0; i < baseCommands.size(); i++) {
+        if (strcmp(baseCommands[i].cmd, "createdb") == 0) {
+            command = &baseCommands[i];
+        }
+    }
+    // the parameters are parsed again for every run
+    for (size_t i = 0; i < command->params->size(); i++) {
+        command->params->at(i)->wasSet = false;
+    }
+    const std::string threadCount = SSTR(threads);
+    const char *argv[] = { input.c_str(), output, "--createdb-mode", "0", "--shuffle", shuffle ? "1" : "0",
+                           "--write-lookup", "1", "--compressed", "0", "--dbtype", "0", "--threads", threadCount.c_str(), "-v", "1" };
+    return createdb(sizeof(argv) / sizeof(argv[0]), argv, *command);
+}
+
+// feeds content through a named pipe while createdb reads it entry by entry
+static int runSequentialCreatedb(const std::string &pipe, const std::string &content, bool shuffle, unsigned int threads) {
+    if (FileUtil::fileExists(pipe.c_str())) {
+        FileUtil::remove(pipe.c_str());
+    }
+    if (mkfifo(pipe.c_str(), 0666) != 0) {
+        perror(pipe.c_str());
+        return EXIT_FAILURE;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open(pipe.c_str(), O_WRONLY);
+        size_t written = 0;
+        while (fd != -1 && written < content.size()) {
+            ssize_t result = write(fd, content.c_str() + written, content.size() - written);
+            if (result <= 0) {
+                break;
+            }
+            written += result;
+        }
+        close(fd);
+        _exit(written == content.size() ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    const int status = runCreatedb(pipe, SEQUENTIAL_DB, shuffle, threads);
+    int writerStatus;
+    waitpid(pid, &writerStatus, 0);
+    FileUtil::remove(pipe.c_str());
+    return (WIFEXITED(writerStatus) && WEXITSTATUS(writerStatus) == EXIT_SUCCESS) ? status : EXIT_FAILURE;
+}
+
+static bool compareFiles(const std::string &suffix) {
+    const std::string parallel = readFile(PARALLEL_DB + suffix);
+    const std::string sequential = readFile(SEQUENTIAL_DB + suffix);
+    if (parallel.empty() || parallel != sequential) {
+        Debug(Debug::ERROR) << PARALLEL_DB << suffix << " (" << parallel.size() << " bytes) differs from "
+                            << SEQUENTIAL_DB << suffix << " (" << sequential.size() << " bytes)\n";
+        return false;
+    }
+    return true;
+}
+
+static void removeOutput(const char *db) {
+    DBReader<unsigned int>::removeDb(db);
+    DBReader<unsigned int>::removeDb(std::string(db) + "_h");
+}
+
+// the file is read by the parallel path, the sequential reader gets the same content through the pipe
+static bool check(const std::string &name, const std::string &fileName, const std::string &content, bool shuffle,
+                  unsigned int threads = THREADS) {
+    writeFile(fileName, content);
+    bool same = runCreatedb(fileName, PARALLEL_DB, shuffle, threads) == EXIT_SUCCESS
+                && runSequentialCreatedb(std::string(PIPE_DIR) + "/" + fileName, content, shuffle, threads) == EXIT_SUCCESS;
+    const char *suffixes[] = { "", ".index", ".dbtype", ".lookup", ".source", "_h", "_h.index" };
+    for (size_t i = 0; same && i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        same = compareFiles(suffixes[i]);
+    }
+    std::cout << name << ": " << (same ? "ok" : "failed") << std::endl;
+    removeOutput(PARALLEL_DB);
+    removeOutput(SEQUENTIAL_DB);
+    FileUtil::remove(fileName.c_str());
+    return same;
+}
+
+int main (int, const char**) {
+    srand(1);
+    if (FileUtil::directoryExists(PIPE_DIR) == false) {
+        FileUtil::makeDir(PIPE_DIR);
+    }
+
+    bool ok = true;
+    const std::string proteins = fasta(3000, 20, 800);
+    ok &= check("FASTA", "createdbInput.fasta", proteins, false);
+    ok &= check("FASTA shuffled", "createdbInput.fasta", proteins, true);
+    const std::string reads = fastq(3000);
+    ok &= check("FASTQ", "createdbInput.fastq", reads, false);
+#ifdef HAVE_ZLIB
+    ok &= check("gzip FASTA", "createdbInput.fasta.gz", gzipCompress(proteins), false);
+    ok &= check("BGZF FASTQ", "createdbInput.fastq.gz", bgzfCompress(reads), false);
+#endif
+    ok &= check("zstd FASTA", "createdbInput.fasta.zst", zstdFrames(proteins), false);
+    ok &= check("zstd stream FASTQ", "createdbInput.fastq.zst", zstdStream(reads), false);
+
+    // wrapped FASTQ records cannot be chunked and are read sequentially from the start
+    const std::string wrappedReads = fastq(3000, 0);
+    ok &= check("wrapped FASTQ", "createdbWrapped.fastq", wrappedReads, false);
+    ok &= check("zstd wrapped FASTQ", "createdbWrapped.fastq.zst", zstdFrames(wrappedReads), false);
+
+    // records of up to 20000 residues, some of them cross the end of the first chunk of THREADS * 16 MiB
+    const std::string large = fasta(4000, 1000, 20000);
+    if (large.size() <= (size_t) THREADS * 16 * 1024 * 1024) {
+        Debug(Debug::ERROR) << "Input does not reach the second chunk\n";
+        return EXIT_FAILURE;
+    }
+    ok &= check("FASTA across chunks", "createdbLarge.fasta", large, true);
+#ifdef HAVE_ZLIB
+    ok &= check("BGZF FASTA across chunks", "createdbLarge.fasta.gz", bgzfCompress(large), false);
+
+    // a single thread reads chunks of 16 MiB, the first chunks are written before a record
+    // that does not end within the next four chunks is reached and the file is read again
+    const std::string chromosomes = fasta(6000, 1000, 3000) + fasta(1, 70 * 1024 * 1024, 70 * 1024 * 1024) + fasta(10, 100, 1000);
+    ok &= check("BGZF FASTA with a record longer than four chunks", "createdbLongRecord.fasta.gz", bgzfCompress(chromosomes), false, 1);
+#endif
+    ok &= check("zstd FASTA across chunks", "createdbLarge.fasta.zst", zstdFrames(large), false);
+
+    rmdir(PIPE_DIR);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
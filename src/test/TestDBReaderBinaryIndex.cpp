@@ -0,0 +1,44 @@
+#include "Debug.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Parameters.h"
+
+const char* binary_name = "test_dbreaderbinaryindex";
+
+int main (int, const char**) {
+    const unsigned int keys[] = { 3, 1, 12, 7 };
+    const char* entries[] = { "MKV", "AAAAL", "MPEPTIDE", "WWW" };
+    DBWriter writer("binaryIndexDB", "binaryIndexDB.index", 1, Parameters::WRITER_BINARY_INDEX_MODE, Parameters::DBTYPE_AMINO_ACIDS);
+    writer.open();
+    for (size_t i = 0; i < 4; ++i) {
+        writer.writeData(entries[i], strlen(entries[i]), keys[i]);
+    }
+    writer.close();
+
+    DBReader<unsigned int> reader("binaryIndexDB", "binaryIndexDB.index", 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    reader.open(DBReader<unsigned int>::NOSORT);
+    Debug(Debug::INFO) << "Size: " << reader.getSize() << " maxSeqLen: " << reader.getMaxSeqLen() << " lastKey: " << reader.getLastKey() << "\n";
+    for (size_t i = 0; i < reader.getSize(); ++i) {
+        Debug(Debug::INFO) << reader.getDbKey(i) << "\t" << reader.getData(i, 0) << "\n";
+    }
+    Debug(Debug::INFO) << "Check getDataByDBKey: " << reader.getDataByDBKey(12, 0) << "\n";
+    reader.close();
+
+    // sort modes that do not reorder in place use the mapping directly
+    DBReader<unsigned int> lengthReader("binaryIndexDB", "binaryIndexDB.index", 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    lengthReader.open(DBReader<unsigned int>::SORT_BY_LENGTH);
+    for (size_t i = 0; i < lengthReader.getSize(); ++i) {
+        Debug(Debug::INFO) << lengthReader.getDbKey(i) << "\t" << lengthReader.getSeqLen(i) << "\n";
+    }
+    lengthReader.close();
+
+    // round trip through the text format
+    DBWriter::convertIndexFormat("binaryIndexDB.index", "binaryIndexDB.index", Parameters::INDEX_FORMAT_TEXT);
+    DBReader<std::string> textReader("binaryIndexDB", "binaryIndexDB.index", 1, DBReader<std::string>::USE_INDEX);
+    textReader.open(DBReader<std::string>::SORT_BY_ID);
+    Debug(Debug::INFO) << "Text entries: " << textReader.getSize() << " first key: " << textReader.getDbKey(0) << "\n";
+    textReader.close();
+
+    DBReader<unsigned int>::removeDb("binaryIndexDB");
+    return EXIT_SUCCESS;
+}
@@ -127,7 +127,7 @@ int main (int, const char**) {
 
     writer.writeData((char*)data,strlen(data), 1,0);
     writer.close();
-    DBReader<unsigned int> reader("dataLinear", "dataLinear.index", 1, 0);
+    DBReader<unsigned int> reader("dataLinear", "dataLinear.index", 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     reader.open(0);
     reader.readMmapedDataInMemory();
     reader.printMagicNumber();
@@ -138,4 +138,29 @@ int main (int, const char**) {
     }
     reader.close();
 
+    // enough entries for many blocks, written by several threads
+    const size_t entries = 20000;
+    const size_t dataLen = strlen(data);
+    DBWriter blockWriter("dataBlocks", "dataBlocks.index", 4, Parameters::WRITER_COMPRESSED_MODE, Parameters::DBTYPE_NUCLEOTIDES);
+    blockWriter.open();
+    for (size_t i = 0; i < entries; i++) {
+        size_t len = (i * 7919) % dataLen;
+        blockWriter.writeData(data + (dataLen - len), len, i, i % 4);
+    }
+    blockWriter.close();
+    DBReader<unsigned int> blockReader("dataBlocks", "dataBlocks.index", 2, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    blockReader.open(DBReader<unsigned int>::NOSORT);
+    size_t errors = 0;
+    // random order access
+    for (size_t i = 0; i < entries; i++) {
+        size_t key = (i * 104729) % entries;
+        size_t len = (key * 7919) % dataLen;
+        char *entry = blockReader.getDataByDBKey(key, i % 2);
+        if (entry == NULL || strlen(entry) != len || memcmp(entry, data + (dataLen - len), len) != 0) {
+            errors++;
+        }
+    }
+    std::cout << "Block compressed entries: " << blockReader.getSize() << " errors: " << errors << std::endl;
+    blockReader.close();
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
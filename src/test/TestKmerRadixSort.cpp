@@ -0,0 +1,110 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cstring>
+
+#include "KmerRadixSort.h"
+#include "Timer.h"
+
+const char* binary_name = "test_kmerradixsort";
+
+template <bool REVERSE, typename T, typename Compare>
+bool check(std::vector<KmerPosition<T>> &kmers, Compare comp) {
+    std::vector<KmerPosition<T>> expected(kmers);
+    Timer timer;
+    std::sort(expected.begin(), expected.end(), comp);
+    std::cout << "std::sort " << timer.lap() << "\t";
+    timer.reset();
+    KmerRadixSort::sort<REVERSE>(kmers.data(), kmers.data() + kmers.size(), comp);
+    std::cout << "radix sort " << timer.lap() << "\n";
+    for (size_t i = 0; i < kmers.size(); i++) {
+        // elements that only differ in the strand bit are equal for the reverse comparators
+        if (comp(kmers[i], expected[i]) || comp(expected[i], kmers[i])) {
+            std::cout << "Wrong order at " << i << std::endl;
+            return false;
+        }
+    }
+    // no element may be lost or duplicated
+    std::vector<size_t> sortedKmers(kmers.size());
+    std::vector<size_t> expectedKmers(kmers.size());
+    for (size_t i = 0; i < kmers.size(); i++) {
+        sortedKmers[i] = kmers[i].kmer;
+        expectedKmers[i] = expected[i].kmer;
+    }
+    std::sort(sortedKmers.begin(), sortedKmers.end());
+    std::sort(expectedKmers.begin(), expectedKmers.end());
+    if (sortedKmers != expectedKmers) {
+        std::cout << "Elements changed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// buckets group kmers by their value modulo bucketCount, as the hash buckets of linclust do
+template <bool REVERSE, typename T, typename Compare>
+bool checkBuckets(std::vector<KmerPosition<T>> &kmers, size_t bucketCount, Compare comp) {
+    std::vector<std::vector<KmerPosition<T>>> expected(bucketCount);
+    for (size_t i = 0; i < kmers.size(); i++) {
+        expected[KmerRadixSort::key<REVERSE>(kmers[i]) % bucketCount].push_back(kmers[i]);
+    }
+    std::vector<size_t> offsets(1, 0);
+    kmers.clear();
+    for (size_t b = 0; b < bucketCount; b++) {
+        kmers.insert(kmers.end(), expected[b].rbegin(), expected[b].rend());
+        offsets.push_back(kmers.size());
+        std::sort(expected[b].begin(), expected[b].end(), comp);
+    }
+    KmerRadixSort::sortBuckets<REVERSE>(kmers.data(), offsets, comp);
+    for (size_t b = 0; b < bucketCount; b++) {
+        for (size_t i = 0; i < expected[b].size(); i++) {
+            const KmerPosition<T> &kmer = kmers[offsets[b] + i];
+            if (comp(kmer, expected[b][i]) || comp(expected[b][i], kmer)) {
+                std::cout << "Wrong order in bucket " << b << " at " << i << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename T>
+std::vector<KmerPosition<T>> generate(size_t n, size_t kmerRange, bool strand, std::mt19937_64 &rng) {
+    std::vector<KmerPosition<T>> kmers(n);
+    for (size_t i = 0; i < n; i++) {
+        kmers[i].kmer = rng() % kmerRange;
+        if (strand && (rng() & 1)) {
+            kmers[i].kmer = BIT_SET(kmers[i].kmer, 63);
+        }
+        kmers[i].id = rng() % 1000;
+        kmers[i].seqLen = rng() % 100;
+        kmers[i].pos = static_cast<T>(rng() % 200) - 100;
+    }
+    return kmers;
+}
+
+int main (int, const char**) {
+    std::mt19937_64 rng(42);
+    const size_t sizes[] = { 10, 1000, 100000, 5000000 };
+    // full range, few distinct kmers and the range of sequence ids after assignGroup
+    const size_t ranges[] = { SIZE_MAX >> 1, 16, 1ull << 32 };
+    bool ok = true;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+            std::cout << sizes[s] << " elements, kmer range " << ranges[r] << std::endl;
+            std::vector<KmerPosition<short>> kmers = generate<short>(sizes[s], ranges[r], false, rng);
+            ok &= check<false>(kmers, KmerPosition<short>::compareRepSequenceAndIdAndPos);
+            kmers = generate<short>(sizes[s], ranges[r], true, rng);
+            ok &= check<true>(kmers, KmerPosition<short>::compareRepSequenceAndIdAndPosReverse);
+            kmers = generate<short>(sizes[s], ranges[r], false, rng);
+            ok &= check<false>(kmers, KmerPosition<short>::compareRepSequenceAndIdAndDiag);
+            kmers = generate<short>(sizes[s], ranges[r], true, rng);
+            ok &= check<true>(kmers, KmerPosition<short>::compareRepSequenceAndIdAndDiagReverse);
+            std::vector<KmerPosition<int>> longKmers = generate<int>(sizes[s], ranges[r], false, rng);
+            ok &= check<false>(longKmers, KmerPosition<int>::compareRepSequenceAndIdAndPos);
+            kmers = generate<short>(sizes[s], ranges[r], true, rng);
+            ok &= checkBuckets<true>(kmers, 100, KmerPosition<short>::compareRepSequenceAndIdAndPosReverse);
+        }
+    }
+    std::cout << (ok ? "Sorted correctly" : "Sort failed") << std::endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,125 @@
+// Writes random sets to split files with KmerSpillWriter and checks that KmerSpillReader
+// decodes the same sets, with and without compression
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <cstdio>
+#include <climits>
+
+#include "kmermatcher.h"
+#include "KmerSpillFile.h"
+#include "FileUtil.h"
+
+const char* binary_name = "test_kmerspillfile";
+
+template <typename T>
+struct Set {
+    T rep;
+    std::vector<T> hits;
+};
+
+template <int TYPE, typename T>
+std::vector<Set<T>> randomSets(std::mt19937 &rng, size_t setCount) {
+    const bool hasRev = TYPE == Parameters::DBTYPE_NUCLEOTIDES;
+    std::vector<Set<T>> sets(setCount);
+    unsigned int repSeq = 0;
+    for (size_t i = 0; i < setCount; i++) {
+        // rep. sequences are mostly ascending, but may also jump back or reach UINT_MAX - 1
+        repSeq = (rng() % 10 == 0) ? static_cast<unsigned int>(rng() % (UINT_MAX - 1)) : repSeq + rng() % 1000;
+        sets[i].rep.seqId = repSeq;
+        sets[i].rep.score = 0;
+        sets[i].rep.diagonal = 0;
+        sets[i].rep.setReverse(hasRev && (rng() & 1));
+        const size_t hitCount = (rng() % 50 == 0) ? rng() % 5000 : rng() % 20;
+        unsigned int targetId = 0;
+        for (size_t j = 0; j < hitCount; j++) {
+            T hit;
+            targetId = (rng() % 20 == 0) ? static_cast<unsigned int>(rng()) : targetId + rng() % 100;
+            hit.seqId = targetId;
+            hit.diagonal = static_cast<short>(rng());
+            hit.score = static_cast<unsigned char>(rng());
+            hit.setReverse(hasRev && (rng() & 1));
+            sets[i].hits.push_back(hit);
+        }
+    }
+    return sets;
+}
+
+template <int TYPE, typename T>
+bool checkRoundTrip(std::mt19937 &rng, bool compressed, size_t bufferSize) {
+    const std::string fileName = "kmerSpillFileTest";
+    const std::string doneFile = fileName + ".done";
+    std::vector<Set<T>> sets = randomSets<TYPE, T>(rng, 2000);
+    {
+        KmerSpillWriter writer(compressed);
+        std::string data;
+        unsigned int lastRepSeq = 0;
+        std::vector<T> entries;
+        for (size_t i = 0; i < sets.size(); i++) {
+            entries.clear();
+            entries.push_back(sets[i].rep);
+            entries.insert(entries.end(), sets[i].hits.begin(), sets[i].hits.end());
+            KmerSpillFile::encodeSet<TYPE>(data, lastRepSeq, entries.data(), entries.size());
+        }
+        writer.write(fileName, data);
+        writer.wait();
+    }
+    if (FileUtil::fileExists(doneFile.c_str()) == false) {
+        std::cout << "Missing " << doneFile << std::endl;
+        return false;
+    }
+
+    bool success = true;
+    {
+        KmerSpillReader reader(fileName, bufferSize);
+        std::vector<T> entries;
+        for (size_t i = 0; success && i < sets.size(); i++) {
+            if (reader.nextSet<TYPE>(entries) == false) {
+                std::cout << "Set " << i << " is missing" << std::endl;
+                success = false;
+                break;
+            }
+            const size_t hitCount = sets[i].hits.size();
+            if (entries.size() != hitCount + 2 || entries[0].seqId != sets[i].rep.seqId
+                || entries[0].getRev() != sets[i].rep.getRev() || entries[hitCount + 1].seqId != UINT_MAX) {
+                std::cout << "Wrong rep. sequence or size of set " << i << std::endl;
+                success = false;
+                break;
+            }
+            for (size_t j = 0; j < hitCount; j++) {
+                T expected = sets[i].hits[j];
+                T &actual = entries[j + 1];
+                if (actual.seqId != expected.seqId || actual.diagonal != expected.diagonal
+                    || actual.score != expected.score || actual.getRev() != expected.getRev()) {
+                    std::cout << "Wrong hit " << j << " in set " << i << std::endl;
+                    success = false;
+                    break;
+                }
+            }
+        }
+        if (success && reader.nextSet<TYPE>(entries)) {
+            std::cout << "Additional set after the end" << std::endl;
+            success = false;
+        }
+    }
+    FileUtil::remove(fileName.c_str());
+    FileUtil::remove(doneFile.c_str());
+    std::cout << (TYPE == Parameters::DBTYPE_NUCLEOTIDES ? "nucleotides" : "amino acids")
+              << (compressed ? " compressed" : "") << " buffer " << bufferSize << (success ? " ok" : " failed") << std::endl;
+    return success;
+}
+
+int main (int, const char**) {
+    std::mt19937 rng(42);
+    bool success = true;
+    // small buffers split varints and zstd frames between refills
+    const size_t bufferSizes[] = { 1, 7, 4096, 1024 * 1024 };
+    for (size_t i = 0; i < sizeof(bufferSizes) / sizeof(bufferSizes[0]); i++) {
+        for (int compressed = 0; compressed < 2; compressed++) {
+            success = checkRoundTrip<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry>(rng, compressed, bufferSizes[i]) && success;
+            success = checkRoundTrip<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev>(rng, compressed, bufferSizes[i]) && success;
+        }
+    }
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,124 @@
+// Checks that a text _mapping and the _mapping.bin written from it give the same taxa, and that
+// the text mapping is read once it changed after the binary mapping was written
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "MappingReader.h"
+#include "FileUtil.h"
+
+const char* binary_name = "test_mappingreader";
+
+static bool compare(const MappingReader &text, const MappingReader &binary) {
+    if (text.getSize() != binary.getSize()) {
+        std::cout << "Size " << text.getSize() << " of the text mapping, " << binary.getSize() << " of the binary mapping" << std::endl;
+        return false;
+    }
+    // keys beyond getSize() have no taxon
+    const unsigned int largeKeys[] = { static_cast<unsigned int>(text.getSize()) + 1000, UINT_MAX - 1, UINT_MAX };
+    for (size_t i = 0; i < text.getSize() + 10 + sizeof(largeKeys) / sizeof(largeKeys[0]); i++) {
+        const unsigned int key = (i < text.getSize() + 10) ? static_cast<unsigned int>(i) : largeKeys[i - text.getSize() - 10];
+        if (text.lookup(key) != binary.lookup(key)) {
+            std::cout << "Key " << key << " has taxon " << text.lookup(key) << " in the text mapping, "
+                      << binary.lookup(key) << " in the binary mapping" << std::endl;
+            return false;
+        }
+        if (key >= text.getSize() && text.lookup(key) != MappingReader::NOT_FOUND) {
+            std::cout << "Key " << key << " beyond the size has a taxon" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check(const std::string &content, unsigned int duplicateKey, unsigned int firstTaxon) {
+    const std::string file = "testMappingReader_mapping";
+    const std::string binFile = file + ".bin";
+    FILE *handle = FileUtil::openFileOrDie(file.c_str(), "w", false);
+    fwrite(content.c_str(), sizeof(char), content.size(), handle);
+    fclose(handle);
+    if (FileUtil::fileExists(binFile.c_str())) {
+        FileUtil::remove(binFile.c_str());
+    }
+
+    bool success = true;
+    {
+        MappingReader text(file);
+        text.writeBinary(binFile);
+        // the binary mapping is preferred, unless the text file is requested
+        MappingReader binary(file);
+        MappingReader textOnly(file, false);
+        success = compare(text, binary) && compare(text, textOnly);
+        if (success && content.empty() == false && binary.lookup(duplicateKey) != firstTaxon) {
+            std::cout << "Duplicate key " << duplicateKey << " has taxon " << binary.lookup(duplicateKey) << " instead of " << firstTaxon << std::endl;
+            success = false;
+        }
+    }
+
+    // writeBinary replaces a symlink instead of writing into its target
+    const std::string linkTarget = "testMappingReader_linked";
+    FileUtil::copyFile(binFile.c_str(), linkTarget.c_str());
+    FileUtil::remove(binFile.c_str());
+    FileUtil::symlinkAbs(linkTarget, binFile);
+    {
+        MappingReader textOnly(file, false);
+        textOnly.writeBinary(binFile);
+    }
+    char linkBuffer[1];
+    if (readlink(binFile.c_str(), linkBuffer, sizeof(linkBuffer)) != -1) {
+        std::cout << "writeBinary wrote through the symlink " << binFile << std::endl;
+        success = false;
+    }
+    FileUtil::remove(linkTarget.c_str());
+    FileUtil::remove(binFile.c_str());
+    FileUtil::remove(file.c_str());
+    return success;
+}
+
+static bool checkStale() {
+    const std::string file = "testMappingReader_stale_mapping";
+    const std::string binFile = file + ".bin";
+    FILE *handle = FileUtil::openFileOrDie(file.c_str(), "w", false);
+    fputs("0\t562\n1\t9606\n", handle);
+    fclose(handle);
+    {
+        MappingReader text(file, false);
+        text.writeBinary(binFile);
+    }
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= 60;
+    times[1] = times[0];
+    utimes(binFile.c_str(), times);
+    handle = FileUtil::openFileOrDie(file.c_str(), "a", true);
+    fputs("2\t10239\n", handle);
+    fclose(handle);
+
+    bool success = true;
+    {
+        MappingReader reader(file);
+        if (reader.lookup(2) != 10239) {
+            std::cout << "The stale binary mapping was read" << std::endl;
+            success = false;
+        }
+    }
+    FileUtil::remove(binFile.c_str());
+    FileUtil::remove(file.c_str());
+    return success;
+}
+
+int main (int, const char**) {
+    bool success = true;
+    // unsorted keys with gaps, key 7 appears twice
+    success = check("5\t562\n1\t9606\n7\t10239\n3\t2\n7\t561\n12\t1224\n0\t1\n", 7, 10239) && success;
+    std::cout << "Unsorted mapping with a duplicate key " << (success ? "ok" : "failed") << std::endl;
+    success = check("", 0, 0) && success;
+    std::cout << "Empty mapping " << (success ? "ok" : "failed") << std::endl;
+    success = checkStale() && success;
+    std::cout << "Stale binary mapping " << (success ? "ok" : "failed") << std::endl;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,154 @@
+// Checks that alternative prefilter code paths give byte-identical results on a small
+// database of random protein families
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+#include "Prefiltering.h"
+#include "Alignment.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "RandomSequence.h"
+
+const char* binary_name = "test_prefilterequivalence";
+
+static const char* DB_NAME = "prefilterEquivalenceDB";
+
+static void writeDatabase(size_t families, size_t members) {
+    DBWriter writer(DB_NAME, (std::string(DB_NAME) + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_AMINO_ACIDS);
+    writer.open();
+    unsigned int key = 0;
+    for (size_t i = 0; i < families; i++) {
+        std::string ancestor = randomSequence(50 + rand() % 400);
+        for (size_t j = 0; j < members; j++) {
+            std::string seq = mutate(ancestor, 25) + "\n";
+            writer.writeData(seq.c_str(), seq.size(), key++);
+        }
+    }
+    writer.close();
+}
+
+static bool compareDatabases(const std::string &expected, const std::string &actual) {
+    DBReader<unsigned int> expectedReader(expected.c_str(), (expected + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    expectedReader.open(DBReader<unsigned int>::NOSORT);
+    DBReader<unsigned int> actualReader(actual.c_str(), (actual + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    actualReader.open(DBReader<unsigned int>::NOSORT);
+    bool same = expectedReader.getSize() == actualReader.getSize();
+    size_t lines = 0;
+    for (size_t i = 0; same && i < expectedReader.getSize(); i++) {
+        unsigned int key = expectedReader.getDbKey(i);
+        size_t id = actualReader.getId(key);
+        if (id == UINT_MAX) {
+            Debug(Debug::ERROR) << "Entry " << key << " is missing in " << actual << "\n";
+            same = false;
+            break;
+        }
+        std::string expectedEntry(expectedReader.getData(i, 0), expectedReader.getEntryLen(i));
+        std::string actualEntry(actualReader.getData(id, 0), actualReader.getEntryLen(id));
+        if (expectedEntry != actualEntry) {
+            Debug(Debug::ERROR) << "Entry " << key << " differs between " << expected << " and " << actual << "\n";
+            same = false;
+        }
+        lines += std::count(expectedEntry.begin(), expectedEntry.end(), '\n');
+    }
+    if (expectedReader.getSize() != actualReader.getSize()) {
+        Debug(Debug::ERROR) << expected << " has " << expectedReader.getSize() << " entries, " << actual << " has " << actualReader.getSize() << "\n";
+    }
+    Debug(Debug::INFO) << actual << ": " << lines << " results " << (same ? "identical" : "differ") << "\n";
+    actualReader.close();
+    expectedReader.close();
+    return same;
+}
+
+static void runPrefilter(Parameters &par, const std::string &out) {
+    Prefiltering pref(DB_NAME, std::string(DB_NAME) + ".index", DB_NAME, std::string(DB_NAME) + ".index",
+                      Parameters::DBTYPE_AMINO_ACIDS, Parameters::DBTYPE_AMINO_ACIDS, par);
+    pref.runAllSplits(out, out + ".index");
+}
+
+// prefilteralign has to produce the same alignments as prefilter followed by align
+static bool checkFusedAlignment(Parameters &par) {
+    const std::string prefDB = "prefilterEquivalencePref";
+    const std::string alnDB = "prefilterEquivalenceAln";
+    const std::string fusedDB = "prefilterEquivalenceFused";
+    runPrefilter(par, prefDB);
+    {
+        Alignment aln(DB_NAME, DB_NAME, prefDB, prefDB + ".index", alnDB, alnDB + ".index", par);
+        aln.run(par.maxAccept, par.maxRejected);
+    }
+    {
+        Alignment aln(DB_NAME, DB_NAME, "", "", fusedDB, fusedDB + ".index", par);
+        Prefiltering pref(DB_NAME, std::string(DB_NAME) + ".index", DB_NAME, std::string(DB_NAME) + ".index",
+                          Parameters::DBTYPE_AMINO_ACIDS, Parameters::DBTYPE_AMINO_ACIDS, par, &aln);
+        aln.initHitConsumer(par.threads, par.maxAccept, par.maxRejected);
+        pref.runAllSplits(fusedDB, fusedDB + ".index");
+        aln.finishHitConsumer();
+    }
+    bool same = compareDatabases(alnDB, fusedDB);
+    DBReader<unsigned int>::removeDb(prefDB);
+    DBReader<unsigned int>::removeDb(alnDB);
+    DBReader<unsigned int>::removeDb(fusedDB);
+    return same;
+}
+
+// batched index lookups have to give the same prefilter results as single queries
+static bool checkBatchSize(Parameters &par) {
+    const std::string singleDB = "prefilterEquivalenceSingle";
+    const std::string batchDB = "prefilterEquivalenceBatch";
+    const int batchSize = par.prefBatchSize;
+    par.prefBatchSize = 1;
+    runPrefilter(par, singleDB);
+    par.prefBatchSize = 16;
+    runPrefilter(par, batchDB);
+    par.prefBatchSize = batchSize;
+    bool same = compareDatabases(singleDB, batchDB);
+    DBReader<unsigned int>::removeDb(singleDB);
+    DBReader<unsigned int>::removeDb(batchDB);
+    return same;
+}
+
+// the similar k-mer cache must not change the prefilter results
+static bool checkKmerCache(Parameters &par) {
+    const std::string uncachedDB = "prefilterEquivalenceUncached";
+    const std::string cachedDB = "prefilterEquivalenceCached";
+    par.similarKmerCache = 0;
+    runPrefilter(par, uncachedDB);
+    par.similarKmerCache = 64 * 1024 * 1024;
+    runPrefilter(par, cachedDB);
+    par.similarKmerCache = 0;
+    bool same = compareDatabases(uncachedDB, cachedDB);
+    DBReader<unsigned int>::removeDb(uncachedDB);
+    DBReader<unsigned int>::removeDb(cachedDB);
+    return same;
+}
+
+int main (int, const char**) {
+    Parameters &par = Parameters::getInstance();
+    par.threads = 4;
+    par.sensitivity = 7.5;
+    srand(1);
+    writeDatabase(60, 6);
+
+    bool success = checkFusedAlignment(par);
+    // target splits pass the merged hits of all splits to the aligner
+    par.split = 3;
+    par.splitMode = Parameters::TARGET_DB_SPLIT;
+    success = checkFusedAlignment(par) && success;
+    par.split = 0;
+    par.splitMode = Parameters::DETECT_BEST_DB_SPLIT;
+
+    success = checkBatchSize(par) && success;
+    // packed k-mer lists are decoded before the batch lookup
+    par.packedIndex = Parameters::PACKED_INDEX_KMERS | Parameters::PACKED_INDEX_RESIDUES;
+    success = checkBatchSize(par) && success;
+    par.packedIndex = 0;
+
+    success = checkKmerCache(par) && success;
+
+    DBReader<unsigned int>::removeDb(DB_NAME);
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
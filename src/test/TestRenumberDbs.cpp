@@ -0,0 +1,202 @@
+// Checks that renumberdbs gives the keys, entries and lookup of the previous sort/join/awk remapping
+// in clusterupdate, with a new DB split into two data files
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "CommandDeclarations.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "FileUtil.h"
+#include "Parameters.h"
+#include "Debug.h"
+#include "Util.h"
+
+const char* binary_name = "test_renumberdbs";
+
+extern std::vector<Command> baseCommands;
+
+static const char* OLD_DB = "renumberDbsOld";
+static const char* NEW_DB = "renumberDbsNew";
+static const char* OUT_DB = "renumberDbsOut";
+static const char* REMOVED_FILE = "renumberDbsRemoved";
+static const char* KEPT_FILE = "renumberDbsKept";
+static const char* NEW_KEYS_FILE = "renumberDbsNewKeys";
+
+static const unsigned int OLD_COUNT = 5;
+static const char* OLD_SEQS[OLD_COUNT] = { "MKVLA", "MSTNPKPQRKTKRNTNRRPQDVKFPGG", "MQIFV", "MDEFGHIKLMN", "MGSSHHHHHH" };
+// new keys 0, 1 and 3 are the old keys 2, 0 and 4, new keys 2 and 4 are added, old keys 1 and 3 are removed
+static const unsigned int NEW_COUNT = 5;
+static const char* NEW_SEQS[NEW_COUNT] = { "MQIFV", "MKVLA", "MPEPTIDE", "MGSSHHHHHH", "MWWYYCC" };
+// the new DB is split into two data files after this many entries
+static const unsigned int NEW_SPLIT = 3;
+
+struct Expected {
+    unsigned int key;
+    std::string seq;
+    std::string header;
+};
+
+static void writeFile(const std::string &fileName, const std::string &content) {
+    FILE *file = FileUtil::openAndDelete(fileName.c_str(), "w");
+    fwrite(content.c_str(), sizeof(char), content.size(), file);
+    fclose(file);
+}
+
+static void writeDb(const std::string &name, const std::string &prefix, const char **seqs, unsigned int count, int dbType) {
+    DBWriter seqWriter(name.c_str(), (name + ".index").c_str(), 1, Parameters::WRITER_ASCII_MODE, dbType);
+    seqWriter.open();
+    DBWriter headerWriter((name + "_h").c_str(), (name + "_h.index").c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_GENERIC_DB);
+    headerWriter.open();
+    std::string lookup;
+    for (unsigned int key = 0; key < count; key++) {
+        const std::string seq = std::string(seqs[key]) + "\n";
+        seqWriter.writeData(seq.c_str(), seq.size(), key);
+        const std::string header = prefix + SSTR(key) + "\n";
+        headerWriter.writeData(header.c_str(), header.size(), key);
+        lookup.append(SSTR(key) + "\t" + prefix + SSTR(key) + "\t0\n");
+    }
+    seqWriter.close();
+    headerWriter.close();
+    writeFile(name + ".lookup", lookup);
+}
+
+// moves the entries from NEW_SPLIT on into a second data file, the offsets keep running through both
+static void splitNewDb() {
+    DBReader<unsigned int> reader(NEW_DB, (std::string(NEW_DB) + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+    reader.open(DBReader<unsigned int>::NOSORT);
+    const size_t splitOffset = reader.getOffset(reader.getId(NEW_SPLIT));
+    const std::string data(reader.getDataForFile(0), reader.getDataSizeForFile(0));
+    reader.close();
+    writeFile(std::string(NEW_DB) + ".0", data.substr(0, splitOffset));
+    writeFile(std::string(NEW_DB) + ".1", data.substr(splitOffset));
+    FileUtil::remove(NEW_DB);
+}
+
+static void writeInputs() {
+    writeDb(OLD_DB, "old", OLD_SEQS, OLD_COUNT, Parameters::DBTYPE_AMINO_ACIDS);
+    writeDb(NEW_DB, "new", NEW_SEQS, NEW_COUNT, Parameters::DBTYPE_AMINO_ACIDS);
+    splitNewDb();
+    // the files of diffseqdbs
+    writeFile(REMOVED_FILE, "1\n3\n");
+    writeFile(KEPT_FILE, "2\t0\n0\t1\n4\t3\n");
+    writeFile(NEW_KEYS_FILE, "2\n4\n");
+}
+
+static int runRenumberdbs(bool recoverDeleted) {
+    Command *command = NULL;
+    for (size_t i = 0; i < baseCommands.size(); i++) {
+        if (strcmp(baseCommands[i].cmd, "renumberdbs") == 0) {
+            command = &baseCommands[i];
+        }
+    }
+    // the parameters are parsed again for every run
+    for (size_t i = 0; i < command->params->size(); i++) {
+        command->params->at(i)->wasSet = false;
+    }
+    const char *argv[] = { OLD_DB, NEW_DB, REMOVED_FILE, KEPT_FILE, NEW_KEYS_FILE, OUT_DB,
+                           "--recover-deleted", recoverDeleted ? "1" : "0", "--threads", "1", "-v", "1" };
+    return renumberdbs(sizeof(argv) / sizeof(argv[0]), argv, *command);
+}
+
+static bool checkDb(const std::string &name, const std::vector<Expected> &expected, bool header) {
+    DBReader<unsigned int> reader(name.c_str(), (name + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+    reader.open(DBReader<unsigned int>::NOSORT);
+    bool same = reader.getSize() == expected.size();
+    if (same == false) {
+        Debug(Debug::ERROR) << name << " has " << reader.getSize() << " entries, expected " << expected.size() << "\n";
+    }
+    for (size_t i = 0; same && i < expected.size(); i++) {
+        const std::string entry = (header ? expected[i].header : expected[i].seq) + "\n";
+        const size_t id = reader.getId(expected[i].key);
+        same = id != UINT_MAX && reader.getEntryLen(id) == entry.size() + 1 && entry == reader.getData(id, 0);
+        if (same == false) {
+            Debug(Debug::ERROR) << "Key " << expected[i].key << " of " << name << " does not contain " << entry;
+        }
+    }
+    reader.close();
+    return same;
+}
+
+// the previous join kept the key and name columns of the lookup, the file number is kept now as well
+static bool checkLookup(const std::vector<Expected> &expected) {
+    std::string lookup;
+    for (size_t i = 0; i < expected.size(); i++) {
+        lookup.append(SSTR(expected[i].key) + "\t" + expected[i].header + "\t0\n");
+    }
+    FILE *file = FileUtil::openFileOrDie((std::string(OUT_DB) + ".lookup").c_str(), "r", true);
+    std::string content;
+    char buffer[1024];
+    size_t read;
+    while ((read = fread(buffer, sizeof(char), sizeof(buffer), file)) > 0) {
+        content.append(buffer, read);
+    }
+    fclose(file);
+    if (content != lookup) {
+        Debug(Debug::ERROR) << "Lookup\n" << content << "expected\n" << lookup;
+        return false;
+    }
+    return true;
+}
+
+static bool checkMappedKeys(const std::string &expected) {
+    FILE *file = FileUtil::openFileOrDie((std::string(NEW_KEYS_FILE) + ".mapped").c_str(), "r", true);
+    char buffer[1024];
+    const size_t read = fread(buffer, sizeof(char), sizeof(buffer), file);
+    fclose(file);
+    if (std::string(buffer, read) != expected) {
+        Debug(Debug::ERROR) << "Mapped new keys\n" << std::string(buffer, read) << "expected\n" << expected;
+        return false;
+    }
+    return true;
+}
+
+static bool check(bool recoverDeleted) {
+    // Kept sequences get their old key. The previous script appended the recovered sequences behind the highest
+    // new key first, then numbered the added sequences after the highest key of the old and the extended new DB.
+    std::vector<Expected> expected;
+    expected.push_back({ 0, NEW_SEQS[1], "new1" });
+    if (recoverDeleted) {
+        expected.push_back({ 1, OLD_SEQS[1], "old1" });
+    }
+    expected.push_back({ 2, NEW_SEQS[0], "new0" });
+    if (recoverDeleted) {
+        expected.push_back({ 3, OLD_SEQS[3], "old3" });
+    }
+    expected.push_back({ 4, NEW_SEQS[3], "new3" });
+    const unsigned int firstNewKey = recoverDeleted ? 7 : 5;
+    expected.push_back({ firstNewKey, NEW_SEQS[2], "new2" });
+    expected.push_back({ firstNewKey + 1, NEW_SEQS[4], "new4" });
+
+    if (runRenumberdbs(recoverDeleted) != EXIT_SUCCESS) {
+        return false;
+    }
+    const bool sequences = checkDb(OUT_DB, expected, false);
+    const bool headers = checkDb(std::string(OUT_DB) + "_h", expected, true);
+    const bool lookup = checkLookup(expected);
+    const bool mappedKeys = checkMappedKeys(SSTR(firstNewKey) + "\n" + SSTR(firstNewKey + 1) + "\n");
+    DBReader<unsigned int>::removeDb(OUT_DB);
+    DBReader<unsigned int>::removeDb(std::string(OUT_DB) + "_h");
+    FileUtil::remove((std::string(NEW_KEYS_FILE) + ".mapped").c_str());
+    return sequences && headers && lookup && mappedKeys;
+}
+
+int main (int, const char**) {
+    writeInputs();
+    const bool renumbered = check(false);
+    std::cout << "Renumbered: " << (renumbered ? "ok" : "failed") << std::endl;
+    const bool recovered = check(true);
+    std::cout << "Renumbered with recovered sequences: " << (recovered ? "ok" : "failed") << std::endl;
+
+    DBReader<unsigned int>::removeDb(OLD_DB);
+    DBReader<unsigned int>::removeDb(std::string(OLD_DB) + "_h");
+    DBReader<unsigned int>::removeDb(NEW_DB);
+    DBReader<unsigned int>::removeDb(std::string(NEW_DB) + "_h");
+    FileUtil::remove(REMOVED_FILE);
+    FileUtil::remove(KEPT_FILE);
+    FileUtil::remove(NEW_KEYS_FILE);
+    return (renumbered && recovered) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
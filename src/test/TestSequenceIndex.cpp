@@ -77,4 +77,19 @@ int main (int, const char**) {
             std::cout << "Wrong data" << std::endl;
         }
     }
+
+    lookup.pack(subMat.alphabetSize);
+    std::cout << "Packed to " << lookup.getResidueBits() << " bits" << std::endl;
+    const char *packedSeqs[] = { S1char, S2char, S3char, S4char };
+    unsigned char unpacked[10000];
+    for (size_t id = 0; id < 4; id++) {
+        lookup.unpackSequence(id, unpacked);
+        if (lookup.getSequenceLength(id) != strlen(packedSeqs[id]))
+            std::cout << "Diff length" << std::endl;
+        for (size_t i = 0; i < lookup.getSequenceLength(id); i++) {
+            if (subMat.num2aa[unpacked[i]] != packedSeqs[id][i]) {
+                std::cout << "Wrong packed data" << std::endl;
+            }
+        }
+    }
 }
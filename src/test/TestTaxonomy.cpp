@@ -1,16 +1,231 @@
+// Builds a small taxonomy from dump files and checks that the binary taxonomy written by
+// serialize answers LCA, taxLineage and AtRanks queries like the parsed one, that it is written
+// deterministically without following links, and that openTaxonomy ignores it once it is stale
 #include "NcbiTaxonomy.h"
+#include "FileUtil.h"
 #include "Debug.h"
 
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/time.h>
+
 const char* binary_name = "test_taxonomy";
 
+struct DumpNode {
+    TaxID taxId;
+    TaxID parentTaxId;
+    const char *rank;
+    const char *name;
+};
+
+static const DumpNode NODES[] = {
+    { 1, 1, "no rank", "root" },
+    { 2, 131567, "superkingdom", "Bacteria" },
+    { 1224, 2, "phylum", "Proteobacteria" },
+    { 1236, 1224, "class", "Gammaproteobacteria" },
+    { 91347, 1236, "order", "Enterobacterales" },
+    { 543, 91347, "family", "Enterobacteriaceae" },
+    { 561, 543, "genus", "Escherichia" },
+    { 562, 561, "species", "Escherichia coli" },
+    { 83333, 562, "no rank", "Escherichia coli K-12" },
+    { 564, 561, "species", "Escherichia fergusonii" },
+    { 590, 543, "genus", "Salmonella" },
+    { 28901, 590, "species", "Salmonella enterica" },
+    { 2759, 131567, "superkingdom", "Eukaryota" },
+    { 33208, 2759, "kingdom", "Metazoa" },
+    { 9606, 33208, "species", "Homo sapiens" },
+    { 131567, 1, "no rank", "cellular organisms" },
+    { 10239, 1, "superkingdom", "Viruses" },
+};
+
+// merged IDs point to existing taxa
+static const TaxID MERGED[][2] = { { 469598, 562 }, { 1637, 564 } };
+
+static void writeDumpFiles(const std::string &prefix) {
+    FILE *nodes = FileUtil::openFileOrDie((prefix + "_nodes.dmp").c_str(), "w", false);
+    FILE *names = FileUtil::openFileOrDie((prefix + "_names.dmp").c_str(), "w", false);
+    for (size_t i = 0; i < sizeof(NODES) / sizeof(NODES[0]); i++) {
+        fprintf(nodes, "%d\t|\t%d\t|\t%s\t|\t\t|\n", NODES[i].taxId, NODES[i].parentTaxId, NODES[i].rank);
+        fprintf(names, "%d\t|\t%s\t|\t\t|\tscientific name\t|\n", NODES[i].taxId, NODES[i].name);
+        fprintf(names, "%d\t|\tsynonym of %s\t|\t\t|\tsynonym\t|\n", NODES[i].taxId, NODES[i].name);
+    }
+    fclose(nodes);
+    fclose(names);
+    FILE *merged = FileUtil::openFileOrDie((prefix + "_merged.dmp").c_str(), "w", false);
+    for (size_t i = 0; i < sizeof(MERGED) / sizeof(MERGED[0]); i++) {
+        fprintf(merged, "%d\t|\t%d\t|\n", MERGED[i][0], MERGED[i][1]);
+    }
+    fclose(merged);
+}
+
+static std::string readFile(const std::string &file) {
+    FILE *handle = FileUtil::openFileOrDie(file.c_str(), "r", true);
+    std::string content;
+    char buffer[4096];
+    size_t read;
+    while ((read = fread(buffer, sizeof(char), sizeof(buffer), handle)) > 0) {
+        content.append(buffer, read);
+    }
+    fclose(handle);
+    return content;
+}
+
+// the padding of the node records is zero, the nodes follow the 40 byte header
+static size_t checkPadding(const std::string &binFile, size_t nodeCount) {
+    const std::string content = readFile(binFile);
+    const size_t paddingStart = offsetof(TaxonNode, parentTaxId) + sizeof(TaxID);
+    const size_t paddingEnd = offsetof(TaxonNode, rankIdx);
+    for (size_t i = 0; i < nodeCount; i++) {
+        for (size_t j = paddingStart; j < paddingEnd; j++) {
+            if (content[40 + i * sizeof(TaxonNode) + j] != 0) {
+                Debug(Debug::ERROR) << "Padding of node " << i << " is not zero\n";
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// serialize replaces a link instead of writing into its target
+static size_t checkLink(const NcbiTaxonomy &taxonomy, const std::string &binFile) {
+    const std::string linkTarget = binFile + "_linked";
+    FILE *handle = FileUtil::openFileOrDie(linkTarget.c_str(), "w", false);
+    fputs("target", handle);
+    fclose(handle);
+    FileUtil::symlinkAbs(linkTarget, binFile);
+    taxonomy.serialize(binFile);
+    char linkBuffer[1];
+    size_t errors = 0;
+    if (readFile(linkTarget) != "target" || readlink(binFile.c_str(), linkBuffer, sizeof(linkBuffer)) != -1) {
+        Debug(Debug::ERROR) << "serialize wrote through the link " << binFile << "\n";
+        errors++;
+    }
+    FileUtil::remove(linkTarget.c_str());
+    return errors;
+}
+
+// a dump file changed after the binary taxonomy was written is loaded instead of it
+static size_t checkStale(std::string &prefix, const std::string &binFile) {
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= 60;
+    times[1] = times[0];
+    utimes(binFile.c_str(), times);
+    FILE *names = FileUtil::openFileOrDie((prefix + "_names.dmp").c_str(), "a", true);
+    fprintf(names, "9606\t|\tupdated name\t|\t\t|\tscientific name\t|\n");
+    fclose(names);
+    NcbiTaxonomy *taxonomy = NcbiTaxonomy::openTaxonomy(prefix);
+    size_t errors = 0;
+    if (std::string(taxonomy->getString(taxonomy->taxonNode(9606)->nameIdx)) != "updated name") {
+        Debug(Debug::ERROR) << "The stale binary taxonomy was loaded\n";
+        errors++;
+    }
+    delete taxonomy;
+    return errors;
+}
+
+static std::string join(const std::vector<std::string> &values) {
+    std::string result;
+    for (size_t i = 0; i < values.size(); i++) {
+        result.append(values[i]);
+        result.push_back(';');
+    }
+    return result;
+}
+
 int main (int, const char**) {
-    NcbiTaxonomy t("/Users/mirdita/tmp/taxonomy/names.dmp",
-                   "/Users/mirdita/tmp/taxonomy/nodes.dmp",
-                   "/Users/mirdita/tmp/taxonomy/merged.dmp");
-                   //"/Users/mirdita/tmp/taxonomy/delnodes.dmp");
-    std::vector<int> taxa;
-    taxa.push_back(9);
-    taxa.push_back(7);
-    TaxonNode const * node = t.LCA(taxa);
-    Debug(Debug::INFO) << node->name << "\n";
+    const std::string prefix = "testTaxonomy";
+    const std::string binFile = prefix + "_taxonomy";
+    writeDumpFiles(prefix);
+    NcbiTaxonomy parsed(prefix + "_names.dmp", prefix + "_nodes.dmp", prefix + "_merged.dmp");
+    parsed.serialize(binFile);
+    NcbiTaxonomy *binary = NcbiTaxonomy::unserialize(binFile);
+    // unknown IDs are expected and only produce warnings
+    Debug::setDebugLevel(Debug::ERROR);
+
+    // existing, merged, unknown and too large IDs
+    std::vector<TaxID> taxa;
+    for (size_t i = 0; i < sizeof(NODES) / sizeof(NODES[0]); i++) {
+        taxa.push_back(NODES[i].taxId);
+    }
+    for (size_t i = 0; i < sizeof(MERGED) / sizeof(MERGED[0]); i++) {
+        taxa.push_back(MERGED[i][0]);
+    }
+    taxa.push_back(3);
+    taxa.push_back(1000000);
+
+    std::vector<std::string> ranks = NcbiTaxonomy::parseRanks("superkingdom,kingdom,phylum,class,order,family,genus,species");
+    size_t errors = 0;
+    for (size_t i = 0; i < taxa.size(); i++) {
+        TaxonNode const *parsedNode = parsed.taxonNode(taxa[i], false);
+        TaxonNode const *binaryNode = binary->taxonNode(taxa[i], false);
+        if ((parsedNode == NULL) != (binaryNode == NULL)) {
+            Debug(Debug::ERROR) << "Taxon " << taxa[i] << " only exists in one taxonomy\n";
+            errors++;
+            continue;
+        }
+        if (parsedNode == NULL) {
+            continue;
+        }
+        if (parsedNode->taxId != binaryNode->taxId
+            || std::string(parsed.getString(parsedNode->nameIdx)) != binary->getString(binaryNode->nameIdx)) {
+            Debug(Debug::ERROR) << "Taxon " << taxa[i] << " differs\n";
+            errors++;
+        }
+        if (parsed.taxLineage(parsedNode, true) != binary->taxLineage(binaryNode, true)
+            || parsed.taxLineage(parsedNode, false) != binary->taxLineage(binaryNode, false)) {
+            Debug(Debug::ERROR) << "Lineage of " << taxa[i] << " differs: " << parsed.taxLineage(parsedNode, true)
+                                << " " << binary->taxLineage(binaryNode, true) << "\n";
+            errors++;
+        }
+        if (join(parsed.AtRanks(parsedNode, ranks)) != join(binary->AtRanks(binaryNode, ranks))) {
+            Debug(Debug::ERROR) << "Ranks of " << taxa[i] << " differ: " << join(parsed.AtRanks(parsedNode, ranks))
+                                << " " << join(binary->AtRanks(binaryNode, ranks)) << "\n";
+            errors++;
+        }
+        for (size_t j = 0; j < taxa.size(); j++) {
+            if (parsed.LCA(taxa[i], taxa[j]) != binary->LCA(taxa[i], taxa[j])) {
+                Debug(Debug::ERROR) << "LCA of " << taxa[i] << " and " << taxa[j] << " differs\n";
+                errors++;
+            }
+            for (size_t k = j; k < taxa.size(); k += 3) {
+                std::vector<TaxID> set;
+                set.push_back(taxa[i]);
+                set.push_back(taxa[j]);
+                set.push_back(taxa[k]);
+                TaxonNode const *parsedLca = parsed.LCA(set);
+                TaxonNode const *binaryLca = binary->LCA(set);
+                if ((parsedLca == NULL) != (binaryLca == NULL) || (parsedLca != NULL && parsedLca->taxId != binaryLca->taxId)) {
+                    Debug(Debug::ERROR) << "LCA of " << taxa[i] << ", " << taxa[j] << " and " << taxa[k] << " differs\n";
+                    errors++;
+                }
+            }
+        }
+    }
+
+    // sanity check of the parsed taxonomy itself
+    if (parsed.LCA(562, 564) != 561 || parsed.LCA(83333, 28901) != 543 || parsed.LCA(469598, 9606) != 131567
+        || parsed.LCA(9606, 10239) != 1) {
+        Debug(Debug::ERROR) << "Wrong LCA in the parsed taxonomy\n";
+        errors++;
+    }
+    std::cout << "Lineage of 83333: " << binary->taxLineage(binary->taxonNode(83333), true) << std::endl;
+    delete binary;
+
+    errors += checkPadding(binFile, sizeof(NODES) / sizeof(NODES[0]));
+    errors += checkLink(parsed, binFile);
+    std::string database = prefix;
+    errors += checkStale(database, binFile);
+
+    FileUtil::remove(binFile.c_str());
+    FileUtil::remove((prefix + "_nodes.dmp").c_str());
+    FileUtil::remove((prefix + "_names.dmp").c_str());
+    FileUtil::remove((prefix + "_merged.dmp").c_str());
+    std::cout << (errors == 0 ? "Parsed and binary taxonomy agree" : "Parsed and binary taxonomy differ") << std::endl;
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cstdint>
+
+#include "IndexTable.h"
+
+const char* binary_name = "test_varint";
+
+bool checkValues(const std::vector<size_t> &values) {
+    size_t expectedBytes = 0;
+    for (size_t i = 0; i < values.size(); i++) {
+        expectedBytes += IndexTable::varintSize(values[i]);
+    }
+    std::vector<unsigned char> buffer(expectedBytes);
+    unsigned char *out = buffer.data();
+    for (size_t i = 0; i < values.size(); i++) {
+        IndexTable::writeVarint(&out, values[i]);
+    }
+    if (static_cast<size_t>(out - buffer.data()) != expectedBytes) {
+        std::cout << "Wrote " << (out - buffer.data()) << " bytes, varintSize expected " << expectedBytes << std::endl;
+        return false;
+    }
+    const unsigned char *in = buffer.data();
+    for (size_t i = 0; i < values.size(); i++) {
+        size_t value = IndexTable::readVarint(&in);
+        if (value != values[i]) {
+            std::cout << "Read " << value << " instead of " << values[i] << " at " << i << std::endl;
+            return false;
+        }
+    }
+    return in == buffer.data() + buffer.size();
+}
+
+// encodes a k-mer list like IndexTable::packBlock and decodes it with unpackDBSeqList
+bool checkList(const std::vector<IndexEntryLocal> &list) {
+    std::vector<unsigned char> buffer(IndexTable::varintSize(list.size()) + list.size() * 2 * 10);
+    unsigned char *out = buffer.data();
+    IndexTable::writeVarint(&out, list.size());
+    unsigned int prevSeqId = 0;
+    for (size_t i = 0; i < list.size(); i++) {
+        IndexTable::writeVarint(&out, list[i].seqId - prevSeqId);
+        IndexTable::writeVarint(&out, list[i].position_j);
+        prevSeqId = list[i].seqId;
+    }
+    const unsigned char *in = buffer.data();
+    size_t listSize = IndexTable::readVarint(&in);
+    if (listSize != list.size()) {
+        std::cout << "List size " << listSize << " instead of " << list.size() << std::endl;
+        return false;
+    }
+    std::vector<IndexEntryLocal> decoded(listSize);
+    IndexTable::unpackDBSeqList(in, listSize, decoded.data());
+    for (size_t i = 0; i < listSize; i++) {
+        if (decoded[i].seqId != list[i].seqId || decoded[i].position_j != list[i].position_j) {
+            std::cout << "Wrong list entry at " << i << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main (int, const char**) {
+    std::mt19937_64 rng(42);
+
+    // the boundaries of every byte count
+    std::vector<size_t> values;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        size_t boundary = static_cast<size_t>(1) << shift;
+        values.push_back(boundary - 1);
+        values.push_back(boundary);
+        values.push_back(boundary + 1);
+    }
+    values.push_back(UINT32_MAX);
+    values.push_back(SIZE_MAX);
+    for (size_t i = 0; i < 100000; i++) {
+        values.push_back(rng() >> (rng() % 64));
+    }
+    if (checkValues(values) == false) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "Values ok" << std::endl;
+
+    for (size_t listSize = 0; listSize < 2000; listSize += 37) {
+        std::vector<IndexEntryLocal> list(listSize);
+        for (size_t i = 0; i < listSize; i++) {
+            list[i].seqId = static_cast<unsigned int>(rng() % (listSize % 2 ? UINT32_MAX : 1000));
+            list[i].position_j = static_cast<unsigned short>(rng());
+        }
+        std::sort(list.begin(), list.end(), IndexEntryLocal::comapreByIdAndPos);
+        if (checkList(list) == false) {
+            return EXIT_FAILURE;
+        }
+    }
+    std::cout << "Lists ok" << std::endl;
+
+    // the estimate of a uniformly spread table has to be close to the real size
+    const size_t tableSize = 21 * 21 * 21 * 21;
+    const size_t sequenceCount = 10000;
+    const size_t avgSeqLen = 300;
+    std::vector<std::vector<IndexEntryLocal>> lists(tableSize);
+    size_t entriesNum = sequenceCount * avgSeqLen;
+    for (size_t i = 0; i < entriesNum; i++) {
+        IndexEntryLocal entry;
+        entry.seqId = static_cast<unsigned int>(i / avgSeqLen);
+        entry.position_j = static_cast<unsigned short>(i % avgSeqLen);
+        lists[rng() % tableSize].push_back(entry);
+    }
+    size_t packedSize = 0;
+    for (size_t i = 0; i < tableSize; i++) {
+        if (lists[i].empty()) {
+            continue;
+        }
+        packedSize += IndexTable::varintSize(lists[i].size());
+        unsigned int prevSeqId = 0;
+        for (size_t j = 0; j < lists[i].size(); j++) {
+            packedSize += IndexTable::varintSize(lists[i][j].seqId - prevSeqId) + IndexTable::varintSize(lists[i][j].position_j);
+            prevSeqId = lists[i][j].seqId;
+        }
+    }
+    size_t estimate = IndexTable::estimatePackedEntriesSize(tableSize, entriesNum, sequenceCount, avgSeqLen);
+    std::cout << "Packed size " << packedSize << " estimate " << estimate << std::endl;
+    if (estimate < packedSize * 0.8 || estimate > packedSize * 1.5) {
+        std::cout << "Estimate is off" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (estimate >= entriesNum * sizeof(IndexEntryLocal)) {
+        std::cout << "Estimate is not smaller than the unpacked table" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -11,6 +11,7 @@
 #include "Orf.h"
 #include "MemoryMapped.h"
 #include "NcbiTaxonomy.h"
+#include "MappingReader.h"
 
 #define ZSTD_STATIC_LINKING_ONLY
 #include <zstd.h>
@@ -139,10 +140,6 @@ std::map<unsigned int, std::string> readSetToSource(const std::string& file) {
     return mapping;
 }
 
-static bool compareToFirstInt(const std::pair<unsigned int, unsigned int>& lhs, const std::pair<unsigned int, unsigned int>&  rhs){
-    return (lhs.first <= rhs.first);
-}
-
 int convertalignments(int argc, const char **argv, const Command &command) {
     Parameters &par = Parameters::getInstance();
     par.parseParameters(argc, argv, command, true, 0, 0);
@@ -162,7 +159,7 @@ int convertalignments(int argc, const char **argv, const Command &command) {
                                                                   needLookup, needSource, needTaxonomyMapping, needTaxonomy);
 
     NcbiTaxonomy * t = NULL;
-    std::vector<std::pair<unsigned int, unsigned int>> mapping;
+    MappingReader * mapping = NULL;
     if(needTaxonomy){
         std::string db2NoIndexName = PrefilteringIndexReader::dbPathWithoutIndex(par.db2);
         t = NcbiTaxonomy::openTaxonomy(db2NoIndexName);
@@ -173,10 +170,7 @@ int convertalignments(int argc, const char **argv, const Command &command) {
             Debug(Debug::ERROR) << db2NoIndexName + "_mapping" << " does not exist. Please create the taxonomy mapping!\n";
             EXIT(EXIT_FAILURE);
         }
-        bool isSorted = Util::readMapping( db2NoIndexName + "_mapping", mapping);
-        if(isSorted == false){
-            std::stable_sort(mapping.begin(), mapping.end(), compareToFirstInt);
-        }
+        mapping = new MappingReader(db2NoIndexName + "_mapping");
     }
 
     bool isTranslatedSearch = false;
@@ -466,15 +460,11 @@ int convertalignments(int argc, const char **argv, const Command &command) {
                             unsigned int taxon = 0;
 
                             if(needTaxonomy || needTaxonomyMapping) {
-                                std::pair<unsigned int, unsigned int> val;
-                                val.first = res.dbKey;
-                                std::vector<std::pair<unsigned int, unsigned int>>::iterator mappingIt;
-                                mappingIt = std::upper_bound(mapping.begin(), mapping.end(), val, compareToFirstInt);
-                                if (mappingIt == mapping.end() || mappingIt->first != val.first) {
+                                taxon = mapping->lookup(res.dbKey);
+                                if (taxon == MappingReader::NOT_FOUND) {
                                     taxon = 0;
                                     taxonNode = NULL;
                                 }else{
-                                    taxon = mappingIt->second;
                                     if(needTaxonomy){
                                         taxonNode = t->taxonNode(taxon, false);
                                     }
@@ -617,7 +607,7 @@ int convertalignments(int argc, const char **argv, const Command &command) {
                                         result.append(SSTR(taxon));
                                         break;
                                     case Parameters::OUTFMT_TAXNAME:
-                                        result.append((taxonNode != NULL) ? taxonNode->name : "unclassified");
+                                        result.append((taxonNode != NULL) ? t->getString(taxonNode->nameIdx) : "unclassified");
                                         break;
                                     case Parameters::OUTFMT_TAXLIN:
                                         result.append((taxonNode != NULL) ? t->taxLineage(taxonNode, true) : "unclassified");
@@ -791,6 +781,9 @@ int convertalignments(int argc, const char **argv, const Command &command) {
     if(needTaxonomy){
         delete t;
     }
+    if(needTaxonomy || needTaxonomyMapping){
+        delete mapping;
+    }
     alnDbr.close();
     if (sameDB == false) {
         delete tDbr;
@@ -0,0 +1,40 @@
+#include "Parameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "FileUtil.h"
+#include "Debug.h"
+
+#include <cstring>
+#include <cstdlib>
+
+int convertdbindex(int argc, const char **argv, const Command& command) {
+    Parameters& par = Parameters::getInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    FILE *indexFile = FileUtil::openFileOrDie(par.db1Index.c_str(), "r", true);
+    DBIndexHeader header;
+    const size_t headerSize = fread(&header, 1, sizeof(DBIndexHeader), indexFile);
+    if (fclose(indexFile) != 0) {
+        Debug(Debug::ERROR) << "Cannot close index file " << par.db1Index << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    const bool isBinary = DBIndexHeader::isBinaryIndex(reinterpret_cast<const char*>(&header), headerSize);
+    const bool wantBinary = par.indexFormat == Parameters::INDEX_FORMAT_BINARY;
+    if (isBinary == wantBinary) {
+        // an index in the requested format is only linked, so workflows can convert unconditionally
+        char *inPath = realpath(par.db1Index.c_str(), NULL);
+        char *outPath = realpath(par.db2.c_str(), NULL);
+        const bool sameFile = outPath != NULL && inPath != NULL && strcmp(inPath, outPath) == 0;
+        free(inPath);
+        free(outPath);
+        if (sameFile == false) {
+            FileUtil::symlinkAbs(par.db1Index, par.db2);
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // output may be the input index itself for in-place conversion
+    DBWriter::convertIndexFormat(par.db1Index.c_str(), par.db2.c_str(), par.indexFormat);
+
+    return EXIT_SUCCESS;
+}
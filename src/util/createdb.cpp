@@ -10,8 +10,68 @@
 #include "Debug.h"
 #include "Util.h"
 #include "KSeqWrapper.h"
+#include "KSeqChunkReader.h"
 #include "itoa.h"
 
+static bool isNucleotideSequence(const char *sequence, size_t length) {
+    size_t cnt = 0;
+    for (size_t i = 0; i < length; i++) {
+        switch (toupper(sequence[i])) {
+            case 'T':
+            case 'A':
+            case 'G':
+            case 'C':
+            case 'U':
+            case 'N':
+                cnt++;
+                break;
+        }
+    }
+    const float nuclDNAFraction = static_cast<float>(cnt) / static_cast<float>(length);
+    return nuclDNAFraction > 0.9;
+}
+
+struct ParsedEntry {
+    unsigned int id;
+    size_t header;
+    size_t headerLength;
+    size_t sequence;
+    size_t sequenceLength;
+    bool validName;
+    bool hasIdentifier;
+};
+
+// entries of one range of a chunk, headers and sequences are stored as they are written
+struct ParsedChunk {
+    std::string data;
+    std::vector<ParsedEntry> entries;
+};
+
+static void parseChunk(const char *data, size_t length, ParsedChunk &chunk) {
+    chunk.data.clear();
+    chunk.entries.clear();
+    KSeqBuffer kseq(data, length);
+    while (kseq.ReadEntry()) {
+        const KSeqWrapper::KSeqEntry &e = kseq.entry;
+        ParsedEntry entry;
+        entry.validName = e.name.l > 0;
+        entry.header = chunk.data.size();
+        chunk.data.append(e.name.s, e.name.l);
+        if (e.comment.l > 0) {
+            chunk.data.append(" ", 1);
+            chunk.data.append(e.comment.s, e.comment.l);
+        }
+        entry.hasIdentifier = Util::parseFastaHeader(chunk.data.c_str() + entry.header).empty() == false;
+        chunk.data.push_back('\n');
+        entry.headerLength = chunk.data.size() - entry.header;
+        entry.sequence = chunk.data.size();
+        chunk.data.append(e.sequence.s, e.sequence.l);
+        entry.sequenceLength = e.sequence.l;
+        chunk.data.push_back('\n');
+        chunk.entries.push_back(entry);
+    }
+}
+
 int createdb(int argc, const char **argv, const Command& command) {
     Parameters &par = Parameters::getInstance();
     par.parseParameters(argc, argv, command, true, Parameters::PARSE_VARIADIC, 0);
@@ -82,6 +142,8 @@ int createdb(int argc, const char **argv, const Command& command) {
     Debug(Debug::INFO) << "Converting sequences\n";
 
     std::string sourceFile = dataFile + ".source";
+    // input files that cannot be split into chunks at record boundaries
+    std::vector<bool> sequentialInput(filenames.size(), false);
 
     redoComputation:
     FILE *source = fopen(sourceFile.c_str(), "w");
@@ -123,6 +185,92 @@ int createdb(int argc, const char **argv, const Command& command) {
             EXIT(EXIT_FAILURE);
         }
 
+        if (dbInput == false && par.createdbMode == Parameters::SEQUENCE_SPLIT_MODE_HARD
+            && sequentialInput[fileIdx] == false && KSeqChunkReader::isSupported(filenames[fileIdx].c_str())) {
+            // records are parsed in parallel in chunks, then written in input order
+            // to get the same keys as reading the file entry by entry
+            const size_t chunkSize = (size_t) par.threads * 16 * 1024 * 1024;
+            KSeqChunkReader chunkReader(filenames[fileIdx].c_str(), chunkSize);
+            std::vector<ParsedChunk> parsed(par.threads);
+            // range and entry index of the entries of each shuffle split in the current chunk
+            std::vector<std::vector<std::pair<unsigned int, unsigned int>>> splitEntries(shuffleSplits);
+            const char *chunk;
+            size_t chunkLength;
+            while (chunkReader.nextChunk(&chunk, &chunkLength)) {
+                std::vector<size_t> ranges = chunkReader.splitChunk(chunk, chunkLength, par.threads);
+                const size_t rangeCount = ranges.size() - 1;
+#pragma omp parallel for schedule(dynamic, 1)
+                for (size_t i = 0; i < rangeCount; i++) {
+                    parseChunk(chunk + ranges[i], ranges[i + 1] - ranges[i], parsed[i]);
+                }
+
+                for (size_t split = 0; split < shuffleSplits; split++) {
+                    splitEntries[split].clear();
+                }
+                for (size_t i = 0; i < rangeCount; i++) {
+                    for (size_t j = 0; j < parsed[i].entries.size(); j++) {
+                        ParsedEntry &e = parsed[i].entries[j];
+                        if (e.validName == false) {
+                            Debug(Debug::ERROR) << "Fasta entry " << entries_num << " is invalid\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                        if (e.hasIdentifier == false) {
+                            Debug(Debug::WARNING) << "Cannot extract identifier from entry " << entries_num << "\n";
+                        }
+                        if (dbType == -1 && (sampleCount < 10 || (sampleCount % 100) == 0)) {
+                            if (sampleCount < testForNucSequence) {
+                                isNuclCnt += isNucleotideSequence(parsed[i].data.c_str() + e.sequence, e.sequenceLength);
+                            }
+                            sampleCount++;
+                        }
+                        e.id = par.identifierOffset + entries_num;
+                        splitEntries[e.id % shuffleSplits].emplace_back(i, j);
+                        entries_num++;
+                        numEntriesInCurrFile++;
+                    }
+                }
+
+                // every shuffle split owns its own writer slot, so splits can be written concurrently
+#pragma omp parallel for schedule(static, 1)
+                for (unsigned int split = 0; split < shuffleSplits; split++) {
+                    for (size_t k = 0; k < splitEntries[split].size(); k++) {
+                        const ParsedChunk &current = parsed[splitEntries[split][k].first];
+                        const ParsedEntry &e = current.entries[splitEntries[split][k].second];
+                        progress.updateProgress();
+                        sourceLookup[split].emplace_back(fileIdx);
+                        hdrWriter.writeData(current.data.c_str() + e.header, e.headerLength, e.id, split);
+                        seqWriter.writeStart(split);
+                        seqWriter.writeAdd(current.data.c_str() + e.sequence, e.sequenceLength, split);
+                        seqWriter.writeAdd(&newline, 1, split);
+                        seqWriter.writeEnd(e.id, split, true);
+                    }
+                }
+            }
+            if (chunkReader.needsSequentialRead() == false) {
+                continue;
+            }
+            sequentialInput[fileIdx] = true;
+            if (numEntriesInCurrFile > 0) {
+                Debug(Debug::WARNING) << "Cannot split " << filenames[fileIdx] << " into chunks of complete records\n";
+                Debug(Debug::WARNING) << "We recompute and read it entry by entry\n";
+                entries_num = 0;
+                sampleCount = 0;
+                isNuclCnt = 0;
+                progress.reset(SIZE_MAX);
+                hdrWriter.close();
+                seqWriter.close();
+                if (fclose(source) != 0) {
+                    Debug(Debug::ERROR) << "Cannot close file " << sourceFile << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                for (size_t i = 0; i < shuffleSplits; ++i) {
+                    sourceLookup[i].clear();
+                }
+                goto redoComputation;
+            }
+            // nothing was written yet, the file is read entry by entry below
+        }
+
         KSeqWrapper* kseq = NULL;
         if (dbInput == true) {
             kseq = new KSeqBuffer(reader->getData(fileIdx, 0), reader->getEntryLen(fileIdx) - 1);
@@ -174,23 +322,7 @@ int createdb(int argc, const char **argv, const Command& command) {
                 // check for the first 10 sequences if they are nucleotide sequences
                 if (sampleCount < 10 || (sampleCount % 100) == 0) {
                     if (sampleCount < testForNucSequence) {
-                        size_t cnt = 0;
-                        for (size_t i = 0; i < e.sequence.l; i++) {
-                            switch (toupper(e.sequence.s[i])) {
-                                case 'T':
-                                case 'A':
-                                case 'G':
-                                case 'C':
-                                case 'U':
-                                case 'N':
-                                    cnt++;
-                                    break;
-                            }
-                        }
-                        const float nuclDNAFraction = static_cast<float>(cnt) / static_cast<float>(e.sequence.l);
-                        if (nuclDNAFraction > 0.9) {
-                            isNuclCnt += true;
-                        }
+                        isNuclCnt += isNucleotideSequence(e.sequence.s, e.sequence.l);
                     }
                     sampleCount++;
                 }
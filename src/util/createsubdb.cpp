@@ -14,6 +14,18 @@ int createsubdb(int argc, const char **argv, const Command& command) {
     FILE *orderFile = NULL;
     if (FileUtil::fileExists(par.db1Index.c_str())) {
         orderFile = fopen(par.db1Index.c_str(), "r");
+        DBIndexHeader header;
+        size_t headerSize = fread(&header, 1, sizeof(DBIndexHeader), orderFile);
+        if (DBIndexHeader::isBinaryIndex(reinterpret_cast<const char*>(&header), headerSize)) {
+            // binary indices have no lines to parse, dump the keys as text instead
+            fclose(orderFile);
+            DBReader<unsigned int> orderReader(par.db1.c_str(), par.db1Index.c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+            orderReader.open(DBReader<unsigned int>::HARDNOSORT);
+            orderFile = tmpfile();
+            DBWriter::writeIndex(orderFile, orderReader.getSize(), orderReader.getIndex());
+            orderReader.close();
+        }
+        rewind(orderFile);
     } else {
         if(FileUtil::fileExists(par.db1.c_str())){
             orderFile = fopen(par.db1.c_str(), "r");
@@ -27,7 +39,9 @@ int createsubdb(int argc, const char **argv, const Command& command) {
     reader.open(DBReader<unsigned int>::NOSORT);
     const bool isCompressed = reader.isCompressed();
 
-    DBWriter writer(par.db3.c_str(), par.db3Index.c_str(), 1, 0, Parameters::DBTYPE_OMIT_FILE);
+    // compressed entries are decompressed and written again in blocks
+    const size_t writerMode = (isCompressed && par.subDbMode != Parameters::SUBDB_MODE_SOFT) ? Parameters::WRITER_COMPRESSED_MODE : Parameters::WRITER_ASCII_MODE;
+    DBWriter writer(par.db3.c_str(), par.db3Index.c_str(), 1, writerMode, Parameters::DBTYPE_OMIT_FILE);
     writer.open();
     // getline reallocs automatic
     char *line = NULL;
@@ -48,17 +62,10 @@ int createsubdb(int argc, const char **argv, const Command& command) {
         if (par.subDbMode == Parameters::SUBDB_MODE_SOFT) {
             writer.writeIndexEntry(key, reader.getOffset(id), reader.getEntryLen(id), 0);
         } else {
-            char* data = reader.getDataUncompressed(id);
+            char* data = reader.getData(id, 0);
             size_t originalLength = reader.getEntryLen(id);
             size_t entryLength = std::max(originalLength, static_cast<size_t>(1)) - 1;
-
-            if (isCompressed) {
-                // copy also the null byte since it contains the information if compressed or not
-                entryLength = *(reinterpret_cast<unsigned int *>(data)) + sizeof(unsigned int) + 1;
-                writer.writeData(data, entryLength, key, 0, false, false);
-            } else {
-                writer.writeData(data, entryLength, key, 0, true, false);
-            }
+            writer.writeData(data, entryLength, key, 0, true, false);
             // do not write null byte since
             writer.writeIndexEntry(key, writer.getStart(0), originalLength, 0);
         }
@@ -35,6 +35,11 @@ std::string findIncompatibleParameter(DBReader<unsigned int>& index, const Param
         return "seedScoringMatrixFile";
     if (par.spacedKmerPattern != PrefilteringIndexReader::getSpacedPattern(&index))
         return "spacedKmerPattern";
+    if (meta.packed != par.packedIndex)
+        return "packedIndex";
+    const char *kmerCache = PrefilteringIndexReader::getSimilarKmerCache(&index);
+    if ((kmerCache != NULL ? KmerSimilarityCache::getSerializedMemory(kmerCache) : 0) != par.similarKmerCache)
+        return "similarKmerCache";
     return "";
 }
 
@@ -64,7 +69,7 @@ int indexdb(int argc, const char **argv, const Command &command) {
 
     int splitMode = Parameters::TARGET_DB_SPLIT;
     par.maxResListLen = std::min(dbr.getSize(), par.maxResListLen);
-    Prefiltering::setupSplit(dbr, seedSubMat->alphabetSize - 1, dbr.getDbtype(), par.threads, false, memoryLimit, 1, par.maxResListLen, par.kmerSize, par.split, splitMode);
+    Prefiltering::setupSplit(dbr, seedSubMat->alphabetSize - 1, dbr.getDbtype(), par.threads, par.packedIndex, 0, false, memoryLimit, 1, par.maxResListLen, par.kmerSize, par.split, splitMode);
 
     bool kScoreSet = false;
     for (size_t i = 0; i < par.indexdb.size(); i++) {
@@ -132,7 +137,7 @@ int indexdb(int argc, const char **argv, const Command &command) {
         PrefilteringIndexReader::createIndexFile(indexDB, &dbr, dbr2, &hdbr1, hdbr2, seedSubMat, par.maxSeqLen,
                                                  par.spacedKmer, par.spacedKmerPattern, par.compBiasCorrection,
                                                  seedSubMat->alphabetSize, par.kmerSize, par.maskMode, par.maskLowerCaseMode,
-                                                 par.kmerScore, par.split);
+                                                 par.kmerScore, par.split, par.packedIndex, par.similarKmerCache, par.threads);
 
         if (hdbr2 != NULL) {
             hdbr2->close();
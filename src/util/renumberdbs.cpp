@@ -0,0 +1,305 @@
+// Moves the keys of an updated sequence DB into the key space of the previous DB (used by clusterupdate)
+// Kept sequences get their old key, added sequences get keys above all existing ones and deleted
+// sequences can be recovered with their old key. Only indices and lookup are rewritten, the data
+// files of both DBs are linked as split files of the output DB. The new keys of the added
+// sequences are listed in <newSeqKeysFile>.mapped.
+
+#include "Parameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "FileUtil.h"
+#include "FastSort.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+typedef DBReader<unsigned int>::Index Index;
+typedef DBReader<unsigned int>::LookupEntry LookupEntry;
+// key in the new DB, key in the output DB
+typedef std::pair<unsigned int, unsigned int> KeyMapping;
+
+static FILE *openKeyFile(const std::string &fileName) {
+    if (FileUtil::fileExists(fileName.c_str()) == false) {
+        Debug(Debug::ERROR) << "File " << fileName << " does not exist\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return FileUtil::openFileOrDie(fileName.c_str(), "r", true);
+}
+
+// first column of a key file written by diffseqdbs
+static void readKeys(const std::string &fileName, std::vector<unsigned int> &keys) {
+    FILE *file = openKeyFile(fileName);
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, file) != -1) {
+        keys.push_back(Util::fast_atoi<unsigned int>(line));
+    }
+    free(line);
+    fclose(file);
+}
+
+// kept sequences are listed as old key, new key
+static void readKeptKeys(const std::string &fileName, std::vector<KeyMapping> &mapping) {
+    FILE *file = openKeyFile(fileName);
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, file) != -1) {
+        const unsigned int oldKey = Util::fast_atoi<unsigned int>(line);
+        const char *second = strchr(line, '\t');
+        if (second == NULL) {
+            Debug(Debug::ERROR) << "Invalid line in " << fileName << ": " << line;
+            EXIT(EXIT_FAILURE);
+        }
+        mapping.emplace_back(Util::fast_atoi<unsigned int>(second + 1), oldKey);
+    }
+    free(line);
+    fclose(file);
+}
+
+static unsigned int mapKey(const std::vector<KeyMapping> &mapping, unsigned int key) {
+    std::vector<KeyMapping>::const_iterator it = std::lower_bound(mapping.begin(), mapping.end(), KeyMapping(key, 0));
+    if (it == mapping.end() || it->first != key) {
+        return UINT_MAX;
+    }
+    return it->second;
+}
+
+// Entries are addressed by offsets that run through all split files. Block compressed files span
+// their uncompressed size, others their file size. Returns the offset after the last file.
+static size_t getOffsetSpace(DBReader<unsigned int> &reader, bool &isBlockCompressed) {
+    size_t space = 0;
+    isBlockCompressed = false;
+    for (size_t i = 0; i < reader.getDataFileCnt(); i++) {
+        const size_t fileSize = reader.getDataSizeForFile(i);
+        if (fileSize == 0) {
+            continue;
+        }
+        const size_t uncompressedSize = DBBlockCompression::uncompressedSize(reader.getDataForFile(i), fileSize);
+        if (uncompressedSize == SIZE_MAX) {
+            space += fileSize;
+        } else {
+            isBlockCompressed = true;
+            space += uncompressedSize;
+        }
+    }
+    return space;
+}
+
+static void remapIndex(DBReader<unsigned int> &newReader, DBReader<unsigned int> *oldReader,
+                       const std::vector<KeyMapping> &mapping, const std::vector<unsigned int> &recovered,
+                       size_t oldOffsetShift, std::vector<Index> &out) {
+    const size_t newSize = newReader.getSize();
+    out.resize(newSize);
+    size_t missing = 0;
+#pragma omp parallel for schedule(static) reduction(+:missing)
+    for (size_t i = 0; i < newSize; i++) {
+        out[i].id = mapKey(mapping, newReader.getDbKey(i));
+        out[i].offset = newReader.getOffset(i);
+        out[i].length = newReader.getEntryLen(i);
+        missing += (out[i].id == UINT_MAX);
+    }
+    if (missing > 0) {
+        Debug(Debug::WARNING) << missing << " entries of " << newReader.getDataFileName() << " are neither kept nor new and are skipped\n";
+        out.erase(std::remove_if(out.begin(), out.end(), [](const Index &entry) { return entry.id == UINT_MAX; }), out.end());
+    }
+
+    for (size_t i = 0; i < recovered.size(); i++) {
+        const size_t id = oldReader->getId(recovered[i]);
+        if (id == UINT_MAX) {
+            Debug(Debug::WARNING) << "Key " << recovered[i] << " not found in " << oldReader->getDataFileName() << "\n";
+            continue;
+        }
+        Index entry;
+        entry.id = recovered[i];
+        entry.offset = oldReader->getOffset(id) + oldOffsetShift;
+        entry.length = oldReader->getEntryLen(id);
+        out.push_back(entry);
+    }
+    SORT_PARALLEL(out.begin(), out.end(), Index::compareById);
+}
+
+static void writeIndexFile(const std::string &fileName, std::vector<Index> &index) {
+    if (DBWriter::useBinaryIndex(Parameters::WRITER_ASCII_MODE)) {
+        size_t dataSize = 0;
+        unsigned int maxSeqLen = 0;
+        for (size_t i = 0; i < index.size(); i++) {
+            dataSize += index[i].length;
+            maxSeqLen = std::max(maxSeqLen, index[i].length);
+        }
+        const unsigned int lastKey = index.empty() ? 0 : index.back().id;
+        DBWriter::writeBinaryIndex(fileName.c_str(), index.data(), index.size(), dataSize, maxSeqLen, lastKey);
+        return;
+    }
+    FILE *file = FileUtil::openAndDelete(fileName.c_str(), "w");
+    DBWriter::writeIndex(file, index.size(), index.data());
+    if (fclose(file) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+static void removeDataFile(const std::string &fileName) {
+    if (FileUtil::fileExists(fileName.c_str()) || FileUtil::symlinkExists(fileName)) {
+        FileUtil::remove(fileName.c_str());
+    }
+}
+
+// links the files in order as the data files of outDb
+static void linkDataFiles(const std::vector<std::string> &files, const std::string &outDb) {
+    // left over data files of a previous run would shadow the new ones
+    removeDataFile(outDb);
+    for (size_t i = 0; FileUtil::fileExists((outDb + "." + SSTR(i)).c_str()) || FileUtil::symlinkExists(outDb + "." + SSTR(i)); i++) {
+        removeDataFile(outDb + "." + SSTR(i));
+    }
+    if (files.size() == 1) {
+        FileUtil::symlinkAbs(files[0], outDb);
+        return;
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        FileUtil::symlinkAbs(files[i], outDb + "." + SSTR(i));
+    }
+}
+
+static void remapDb(const std::string &oldDb, const std::string &newDb, const std::string &outDb,
+                    const std::vector<KeyMapping> &mapping, const std::vector<unsigned int> &recovered,
+                    bool withLookup, int threads) {
+    const unsigned int lookupMode = withLookup ? DBReader<unsigned int>::USE_LOOKUP : 0;
+    DBReader<unsigned int> newReader(newDb.c_str(), (newDb + ".index").c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA | lookupMode);
+    newReader.open(DBReader<unsigned int>::NOSORT);
+
+    DBReader<unsigned int> *oldReader = NULL;
+    size_t oldOffsetShift = 0;
+    std::vector<std::string> dataFiles = newReader.getDataFileNames();
+    if (recovered.empty() == false) {
+        oldReader = new DBReader<unsigned int>(oldDb.c_str(), (oldDb + ".index").c_str(), threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA | lookupMode);
+        oldReader->open(DBReader<unsigned int>::NOSORT);
+        bool newBlockCompressed;
+        oldOffsetShift = getOffsetSpace(newReader, newBlockCompressed);
+        bool oldBlockCompressed;
+        getOffsetSpace(*oldReader, oldBlockCompressed);
+        if (newBlockCompressed != oldBlockCompressed) {
+            Debug(Debug::ERROR) << "Can not recover deleted sequences, only one of " << oldDb << " and " << newDb << " is block compressed\n";
+            EXIT(EXIT_FAILURE);
+        }
+        std::vector<std::string> oldDataFiles = oldReader->getDataFileNames();
+        dataFiles.insert(dataFiles.end(), oldDataFiles.begin(), oldDataFiles.end());
+    }
+
+    std::vector<Index> index;
+    remapIndex(newReader, oldReader, mapping, recovered, oldOffsetShift, index);
+    writeIndexFile(outDb + ".index", index);
+    linkDataFiles(dataFiles, outDb);
+
+    if (withLookup) {
+        std::vector<LookupEntry> lookup;
+        lookup.reserve(newReader.getLookupSize() + recovered.size());
+        const LookupEntry *newLookup = newReader.getLookup();
+        for (size_t i = 0; i < newReader.getLookupSize(); i++) {
+            LookupEntry entry = newLookup[i];
+            entry.id = mapKey(mapping, entry.id);
+            if (entry.id != UINT_MAX) {
+                lookup.push_back(entry);
+            }
+        }
+        for (size_t i = 0; i < recovered.size(); i++) {
+            const size_t id = oldReader->getLookupIdByKey(recovered[i]);
+            if (id != SIZE_MAX) {
+                lookup.push_back(oldReader->getLookup()[id]);
+            }
+        }
+        SORT_PARALLEL(lookup.begin(), lookup.end(), LookupEntry::compareById);
+
+        FILE *file = FileUtil::openAndDelete((outDb + ".lookup").c_str(), "w");
+        std::string buffer;
+        buffer.reserve(1024 * 1024);
+        for (size_t i = 0; i < lookup.size(); i++) {
+            newReader.lookupEntryToBuffer(buffer, lookup[i]);
+            if (buffer.size() > 1024 * 1024 || i + 1 == lookup.size()) {
+                fwrite(buffer.c_str(), sizeof(char), buffer.size(), file);
+                buffer.clear();
+            }
+        }
+        if (fclose(file) != 0) {
+            Debug(Debug::ERROR) << "Cannot close file " << outDb << ".lookup\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+
+    if (oldReader != NULL) {
+        oldReader->close();
+        delete oldReader;
+    }
+    newReader.close();
+}
+
+int renumberdbs(int argc, const char **argv, const Command &command) {
+    Parameters &par = Parameters::getInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+    const std::string &oldDb = par.db1;
+    const std::string &newDb = par.db2;
+    const std::string &outDb = par.db6;
+    const std::string mappedNewKeysFile = par.db5 + ".mapped";
+
+    std::vector<unsigned int> removedKeys;
+    readKeys(par.db3, removedKeys);
+    std::vector<KeyMapping> mapping;
+    readKeptKeys(par.db4, mapping);
+    std::vector<unsigned int> newKeys;
+    readKeys(par.db5, newKeys);
+
+    unsigned int oldHighest;
+    unsigned int newHighest;
+    {
+        DBReader<unsigned int> oldReader(oldDb.c_str(), (oldDb + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+        oldReader.open(DBReader<unsigned int>::HARDNOSORT);
+        oldHighest = oldReader.getLastKey();
+        oldReader.close();
+        DBReader<unsigned int> newReader(newDb.c_str(), (newDb + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+        newReader.open(DBReader<unsigned int>::HARDNOSORT);
+        newHighest = newReader.getLastKey();
+        newReader.close();
+    }
+
+    std::vector<unsigned int> recovered;
+    if (par.recoverDeleted) {
+        recovered = removedKeys;
+        // recovered sequences used to be appended to the new DB first, the added sequences are
+        // numbered behind them as before to keep the keys of earlier updates reproducible
+        newHighest += recovered.size();
+    }
+    const unsigned int maxKey = std::max(oldHighest, newHighest);
+    if (static_cast<size_t>(maxKey) + newKeys.size() >= UINT_MAX) {
+        Debug(Debug::ERROR) << "Too many sequences to number them after key " << maxKey << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    FILE *mappedNewKeys = FileUtil::openAndDelete((mappedNewKeysFile + "_tmp").c_str(), "w");
+    for (size_t i = 0; i < newKeys.size(); i++) {
+        const unsigned int key = maxKey + 1 + i;
+        mapping.emplace_back(newKeys[i], key);
+        fprintf(mappedNewKeys, "%u\n", key);
+    }
+    if (fclose(mappedNewKeys) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << mappedNewKeysFile << "_tmp\n";
+        EXIT(EXIT_FAILURE);
+    }
+    SORT_PARALLEL(mapping.begin(), mapping.end());
+
+    const bool withLookup = FileUtil::fileExists((newDb + ".lookup").c_str())
+                            && (recovered.empty() || FileUtil::fileExists((oldDb + ".lookup").c_str()));
+    remapDb(oldDb, newDb, outDb, mapping, recovered, withLookup, par.threads);
+    remapDb(oldDb + "_h", newDb + "_h", outDb + "_h", mapping, recovered, false, par.threads);
+
+    DBReader<unsigned int>::softlinkDb(newDb, outDb, (DBFiles::Files) (DBFiles::DATA_DBTYPE | DBFiles::HEADER_DBTYPE | DBFiles::SOURCE));
+    // the list of added sequences is written last, it marks the output as complete
+    std::rename((mappedNewKeysFile + "_tmp").c_str(), mappedNewKeysFile.c_str());
+
+    return EXIT_SUCCESS;
+}
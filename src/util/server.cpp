@@ -0,0 +1,279 @@
+#include "Parameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "Timer.h"
+#include "IndexReader.h"
+#include "KSeqWrapper.h"
+#include "Prefiltering.h"
+#include "PrefilteringIndexReader.h"
+#include "Alignment.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+static char socketPath[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+
+static void removeSocket(int signal) {
+    unlink(socketPath);
+    _exit(128 + signal);
+}
+
+static bool writeAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+// a request ends when the client shuts down its side of the socket or sends a line containing only "//"
+static bool readRequest(int fd, std::string &request) {
+    char buffer[65536];
+    while (true) {
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (length == 0) {
+            return true;
+        }
+        request.append(buffer, length);
+        const size_t size = request.size();
+        if (size >= 3 && request.compare(size - 3, 3, "//\n") == 0 && (size == 3 || request[size - 4] == '\n')) {
+            request.resize(size - 3);
+            return true;
+        }
+    }
+}
+
+static void sendError(int fd, const std::string &message) {
+    Debug(Debug::WARNING) << message << "\n";
+    std::string line = "ERROR " + message + "\n";
+    writeAll(fd, line.c_str(), line.length());
+}
+
+int server(int argc, const char **argv, const Command &command) {
+    Parameters &par = Parameters::getInstance();
+    // same defaults as the search workflow
+    par.spacedKmer = true;
+    par.alignmentMode = Parameters::ALIGNMENT_MODE_SCORE_COV;
+    par.sensitivity = 5.7;
+    par.evalThr = 0.001;
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN | MMseqsParameter::COMMAND_PREFILTER);
+
+    std::string indexDB = PrefilteringIndexReader::searchForIndex(par.db1);
+    if (indexDB.empty()) {
+        Debug(Debug::ERROR) << "No index found for " << par.db1 << ". Please create one with 'createindex' first.\n";
+        EXIT(EXIT_FAILURE);
+    }
+    DBReader<unsigned int> indexReader(indexDB.c_str(), (indexDB + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    indexReader.open(DBReader<unsigned int>::NOSORT);
+    if (PrefilteringIndexReader::checkIfIndexFile(&indexReader) == false) {
+        Debug(Debug::ERROR) << "Outdated index version. Please recompute it with 'createindex'!\n";
+        EXIT(EXIT_FAILURE);
+    }
+    PrefilteringIndexData data = PrefilteringIndexReader::getMetadata(&indexReader);
+    indexReader.close();
+    if (Parameters::isEqualDbtype(data.seqType, Parameters::DBTYPE_AMINO_ACIDS) == false) {
+        Debug(Debug::ERROR) << "Only amino acid sequence indices are supported. The index of " << par.db1 << " has type "
+                            << Parameters::getDbTypeName(data.seqType) << ".\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (data.splits > 1) {
+        Debug(Debug::ERROR) << "The index was created with --split " << data.splits << ". "
+                            << "The server has to keep the whole index in memory, please recreate it with --split 1.\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (strlen(par.db2.c_str()) >= sizeof(socketPath)) {
+        Debug(Debug::ERROR) << "Socket path " << par.db2 << " is too long.\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    // build the index table once and reuse it for every request
+    par.split = 1;
+    par.splitMode = Parameters::QUERY_DB_SPLIT;
+    // the intermediate databases are only read back by this process
+    par.compressed = 0;
+
+    std::string tmpDir = par.db3;
+    std::pair<std::string, std::string> queryDB = Util::databaseNames(tmpDir + "/query");
+    std::pair<std::string, std::string> prefDB = Util::databaseNames(tmpDir + "/pref");
+    std::pair<std::string, std::string> alnDB = Util::databaseNames(tmpDir + "/aln");
+
+    // the target database stands in as query until the first request
+    Prefiltering prefilter(par.db1, par.db1Index, indexDB, indexDB + ".index", Parameters::DBTYPE_AMINO_ACIDS, data.seqType, par);
+    // query and target are the same reader here, so no second database is opened
+    Alignment aligner(indexDB, indexDB, "", "", alnDB.first, alnDB.second, par);
+    IndexReader targetHeaders((data.headers1 == 1) ? indexDB : par.db1, par.threads, IndexReader::HEADERS, IndexReader::PRELOAD_INDEX);
+
+    strncpy(socketPath, par.db2.c_str(), sizeof(socketPath) - 1);
+    struct stat st;
+    if (lstat(socketPath, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        // left behind by a previous server
+        unlink(socketPath);
+    }
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        Debug(Debug::ERROR) << "Cannot create socket: " << strerror(errno) << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, socketPath, sizeof(address.sun_path));
+    if (bind(listenFd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listenFd, 16) != 0) {
+        Debug(Debug::ERROR) << "Cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, removeSocket);
+    signal(SIGTERM, removeSocket);
+    Debug(Debug::INFO) << "Listening on " << socketPath << "\n";
+
+    std::vector<std::string> queryNames;
+    std::string result;
+    result.reserve(1024 * 1024);
+    char key[255 + 1];
+    for (size_t requestIdx = 1; ; requestIdx++) {
+        int fd = accept(listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            Debug(Debug::ERROR) << "Cannot accept connection: " << strerror(errno) << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        Timer timer;
+        std::string request;
+        if (readRequest(fd, request) == false) {
+            Debug(Debug::WARNING) << "Cannot read request " << requestIdx << ": " << strerror(errno) << "\n";
+            close(fd);
+            continue;
+        }
+
+        size_t start = request.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos) {
+            sendError(fd, "Empty request");
+            close(fd);
+            continue;
+        }
+
+        // either FASTA or the path of a query sequence database
+        std::string querySeqDB;
+        DBReader<unsigned int> *queryHeaders = NULL;
+        queryNames.clear();
+        if (request[start] == '>') {
+            DBWriter seqWriter(queryDB.first.c_str(), queryDB.second.c_str(), 1, 0, Parameters::DBTYPE_AMINO_ACIDS);
+            seqWriter.open();
+            KSeqBuffer kseq(request.c_str() + start, request.length() - start);
+            const char newline = '\n';
+            while (kseq.ReadEntry()) {
+                const KSeqWrapper::KSeqEntry &e = kseq.entry;
+                seqWriter.writeStart(0);
+                seqWriter.writeAdd(e.sequence.s, e.sequence.l, 0);
+                seqWriter.writeAdd(&newline, 1, 0);
+                seqWriter.writeEnd(queryNames.size(), 0, true);
+                std::string name = Util::parseFastaHeader(e.name.s);
+                queryNames.emplace_back(name.empty() ? std::string(e.name.s, e.name.l) : name);
+            }
+            seqWriter.close(true);
+            if (queryNames.empty()) {
+                sendError(fd, "Request " + SSTR(requestIdx) + " contains no FASTA entry");
+                close(fd);
+                continue;
+            }
+            querySeqDB = queryDB.first;
+        } else {
+            querySeqDB = request.substr(start, request.find_first_of("\r\n", start) - start);
+            const int dbtype = FileUtil::parseDbType(querySeqDB.c_str());
+            if (Parameters::isEqualDbtype(dbtype, Parameters::DBTYPE_AMINO_ACIDS) == false) {
+                sendError(fd, "Query database " + querySeqDB + " is missing or not an amino acid database");
+                close(fd);
+                continue;
+            }
+            if (FileUtil::fileExists((querySeqDB + "_h.dbtype").c_str())) {
+                queryHeaders = new DBReader<unsigned int>((querySeqDB + "_h").c_str(), (querySeqDB + "_h.index").c_str(), 1, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+                queryHeaders->open(DBReader<unsigned int>::NOSORT);
+            }
+        }
+
+        prefilter.setQueryDatabase(querySeqDB, querySeqDB + ".index");
+        prefilter.runAllSplits(prefDB.first, prefDB.second);
+        aligner.setQueryDatabase(querySeqDB, prefDB.first, prefDB.second);
+        aligner.run(par.maxAccept, par.maxRejected);
+
+        // query, target, then the alignment result columns after the target key
+        DBReader<unsigned int> alnReader(alnDB.first.c_str(), alnDB.second.c_str(), 1, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        alnReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+        bool connected = true;
+        size_t hits = 0;
+        for (size_t i = 0; i < alnReader.getSize() && connected; i++) {
+            const unsigned int queryKey = alnReader.getDbKey(i);
+            std::string queryName;
+            if (queryHeaders != NULL) {
+                queryName = Util::parseFastaHeader(queryHeaders->getData(queryHeaders->getId(queryKey), 0));
+            } else if (queryNames.empty() == false) {
+                queryName = queryNames[queryKey];
+            } else {
+                queryName = SSTR(queryKey);
+            }
+            char *data = alnReader.getData(i, 0);
+            while (*data != '\0') {
+                Util::parseKey(data, key);
+                const unsigned int targetKey = (unsigned int) strtoul(key, NULL, 10);
+                const size_t targetId = targetHeaders.sequenceReader->getId(targetKey);
+                char *end = Util::skipLine(data);
+                result.append(queryName);
+                result.push_back('\t');
+                result.append(Util::parseFastaHeader(targetHeaders.sequenceReader->getData(targetId, 0)));
+                result.append(data + strlen(key), end - data - strlen(key));
+                data = end;
+                hits++;
+            }
+            if (result.size() > 1024 * 1024) {
+                connected = writeAll(fd, result.c_str(), result.length());
+                result.clear();
+            }
+        }
+        if (connected) {
+            connected = writeAll(fd, result.c_str(), result.length());
+        }
+        result.clear();
+        if (connected == false) {
+            Debug(Debug::WARNING) << "Client of request " << requestIdx << " disconnected: " << strerror(errno) << "\n";
+        }
+        close(fd);
+        alnReader.close();
+        if (queryHeaders != NULL) {
+            queryHeaders->close();
+            delete queryHeaders;
+        }
+
+        DBReader<unsigned int>::removeDb(alnDB.first);
+        DBReader<unsigned int>::removeDb(prefDB.first);
+        if (querySeqDB == queryDB.first) {
+            DBReader<unsigned int>::removeDb(queryDB.first);
+        }
+        Debug(Debug::INFO) << "Request " << requestIdx << ": " << hits << " hits in " << timer.lap() << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -36,6 +36,7 @@ int sortresult(int argc, const char **argv, const Command &command) {
 
         std::vector<hit_t> prefResults;
         prefResults.reserve(300);
+        std::string binaryEntry;
 
 #pragma omp for schedule(dynamic, 5)
         for (size_t i = 0; i < reader.getSize(); ++i) {
@@ -45,6 +46,11 @@ int sortresult(int argc, const char **argv, const Command &command) {
             char *data = reader.getData(i, thread_idx);
 
             int format = -1;
+            if (QueryMatcher::isBinaryPrefilterEntry(data)) {
+                QueryMatcher::parseBinaryPrefilterHits(data, prefResults);
+                format = 3;
+                data += strlen(data);
+            }
             while (*data != '\0') {
                 const size_t columns = Util::getWordsOfLine(data, entry, 255);
                 if (columns >= Matcher::ALN_RES_WITHOUT_BT_COL_CNT) {
@@ -73,6 +79,14 @@ int sortresult(int argc, const char **argv, const Command &command) {
                     size_t length = QueryMatcher::prefilterHitToBuffer(buffer, prefResults[i]);
                     writer.writeAdd(buffer, length, thread_idx);
                 }
+            } else if (format == 3) {
+                SORT_SERIAL(prefResults.begin(), prefResults.end(), hit_t::compareHitsByScoreAndId);
+                unsigned int prevSeqId = 0;
+                for (size_t i = 0; i < prefResults.size(); ++i) {
+                    QueryMatcher::appendPrefilterHit(binaryEntry, prefResults[i], Parameters::PREF_FORMAT_BINARY, prevSeqId);
+                }
+                writer.writeAdd(binaryEntry.c_str(), binaryEntry.size(), thread_idx);
+                binaryEntry.clear();
             }
             writer.writeEnd(key, thread_idx);
 
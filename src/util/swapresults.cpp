@@ -57,10 +57,15 @@ int doswap(Parameters& par, bool isGeneralMode) {
             thread_idx = omp_get_thread_num();
 #endif
             char key[255];
+            std::string textEntry;
 #pragma omp for schedule(dynamic, 100) reduction(max:maxTargetId)
             for (size_t i = 0; i < resultReader.getSize(); ++i) {
                 progress.updateProgress();
                 char *data = resultReader.getData(i, thread_idx);
+                if (QueryMatcher::isBinaryPrefilterEntry(data)) {
+                    QueryMatcher::binaryPrefilterEntryToText(data, textEntry);
+                    data = const_cast<char *>(textEntry.c_str());
+                }
                 while (*data != '\0') {
                     Util::parseKey(data, key);
                     unsigned int dbKey = std::strtoul(key, NULL, 10);
@@ -115,6 +120,7 @@ int doswap(Parameters& par, bool isGeneralMode) {
 #ifdef OPENMP
             thread_idx = omp_get_thread_num();
 #endif
+            std::string textEntry;
 #pragma omp  for schedule(dynamic, 100)
             for (size_t i = 0; i < resultSize; ++i) {
                 progress.updateProgress();
@@ -124,6 +130,10 @@ int doswap(Parameters& par, bool isGeneralMode) {
                 *(tmpBuff) = '\0';
                 size_t queryKeyLen = strlen(queryKeyStr);
                 char *data = resultDbr.getData(i, thread_idx);
+                if (QueryMatcher::isBinaryPrefilterEntry(data)) {
+                    QueryMatcher::binaryPrefilterEntryToText(data, textEntry);
+                    data = const_cast<char *>(textEntry.c_str());
+                }
                 char dbKeyBuffer[255 + 1];
                 while (*data != '\0') {
                     Util::parseKey(data, dbKeyBuffer);
@@ -178,10 +188,15 @@ int doswap(Parameters& par, bool isGeneralMode) {
             thread_idx = omp_get_thread_num();
 #endif
 
+            std::string textEntry;
 #pragma omp for schedule(dynamic, 10)
             for (size_t i = 0; i < resultSize; ++i) {
                 progress.updateProgress();
                 char *data = resultDbr.getData(i, thread_idx);
+                if (QueryMatcher::isBinaryPrefilterEntry(data)) {
+                    QueryMatcher::binaryPrefilterEntryToText(data, textEntry);
+                    data = const_cast<char *>(textEntry.c_str());
+                }
                 unsigned int queryKey = resultDbr.getDbKey(i);
                 char queryKeyStr[1024];
                 char *tmpBuff = Itoa::u32toa_sse2((uint32_t) queryKey, queryKeyStr);
@@ -216,12 +231,17 @@ int doswap(Parameters& par, bool isGeneralMode) {
         Debug(Debug::INFO) << "\nOutput database: " << parOutDbStr << "\n";
         bool isAlignmentResult = false;
         bool hasBacktrace = false;
+        int prefFormat = Parameters::PREF_FORMAT_TEXT;
         const char *entry[255];
         for (size_t i = 0; i < resultDbr.getSize(); i++){
             char *data = resultDbr.getData(i, 0);
             if (*data == '\0'){
                 continue;
             }
+            if (QueryMatcher::isBinaryPrefilterEntry(data)) {
+                prefFormat = Parameters::PREF_FORMAT_BINARY;
+                break;
+            }
             const size_t columns = Util::getWordsOfLine(data, entry, 255);
             isAlignmentResult = columns >= Matcher::ALN_RES_WITHOUT_BT_COL_CNT;
             hasBacktrace = columns >= Matcher::ALN_RES_WITH_BT_COL_CNT;
@@ -292,6 +312,7 @@ int doswap(Parameters& par, bool isGeneralMode) {
                         SORT_SERIAL(curRes.begin(), curRes.end(), Matcher::compareHits);
                     }
 
+                    unsigned int prevSeqId = 0;
                     for (size_t j = 0; j < curRes.size(); j++) {
                         const Matcher::result_t &res = curRes[j];
                         if (isAlignmentResult) {
@@ -302,8 +323,7 @@ int doswap(Parameters& par, bool isGeneralMode) {
                             hit.seqId = res.dbKey;
                             hit.prefScore = res.score;
                             hit.diagonal = res.alnLength;
-                            size_t len = QueryMatcher::prefilterHitToBuffer(buffer, hit);
-                            ss.append(buffer, len);
+                            QueryMatcher::appendPrefilterHit(ss, hit, prefFormat, prevSeqId);
                         }
                     }
 
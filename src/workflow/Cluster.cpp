@@ -205,6 +205,11 @@ int clusteringworkflow(int argc, const char **argv, const Command& command) {
         par.minDiagScoreThr = 0;
         par.diagonalScoring = 0;
         par.compBiasCorrection = 0;
+        // prefilter results are only consumed by align, rescorediagonal or swapdb
+        int originalPrefFormat = par.prefFormat;
+        if (par.PARAM_PREF_FORMAT.wasSet == false) {
+            par.prefFormat = Parameters::PREF_FORMAT_BINARY;
+        }
         cmd.addVariable("PREFILTER0_PAR", par.createParameterString(par.prefilter).c_str());
         if (isUngappedMode) {
             par.rescoreMode = Parameters::RESCORE_MODE_ALIGNMENT;
@@ -243,6 +248,7 @@ int clusteringworkflow(int argc, const char **argv, const Command& command) {
         par.covMode = swapedCovMode;
         cmd.addVariable("PREFILTER_REASSIGN_PAR", par.createParameterString(par.prefilter).c_str());
         par.covMode = tmpCovMode;
+        par.prefFormat = originalPrefFormat;
         cmd.addVariable("ALIGNMENT_REASSIGN_PAR", par.createParameterString(par.align).c_str());
         cmd.addVariable("MERGEDBS_PAR", par.createParameterString(par.mergedbs).c_str());
 
@@ -258,7 +264,12 @@ int clusteringworkflow(int argc, const char **argv, const Command& command) {
         cmd.addVariable("DETECTREDUNDANCY_PAR", par.createParameterString(par.clusthash).c_str());
         par.alphabetSize = alphabetSize;
         par.seqIdThr = seqIdThr;
+        int originalPrefFormat = par.prefFormat;
+        if (par.PARAM_PREF_FORMAT.wasSet == false) {
+            par.prefFormat = Parameters::PREF_FORMAT_BINARY;
+        }
         cmd.addVariable("PREFILTER_PAR", par.createParameterString(par.prefilter).c_str());
+        par.prefFormat = originalPrefFormat;
         if (isUngappedMode) {
             cmd.addVariable("ALIGNMENT_PAR", par.createParameterString(par.rescorediagonal).c_str());
         } else {
@@ -40,10 +40,10 @@ int clusterupdate(int argc, const char **argv, const Command& command) {
 
     CommandCaller cmd;
     cmd.addVariable("REMOVE_TMP", par.removeTmpFiles ? "TRUE" : NULL);
-    cmd.addVariable("RECOVER_DELETED", par.recoverDeleted ? "TRUE" : NULL);
 
     cmd.addVariable("RUNNER", par.runner.c_str());
     cmd.addVariable("DIFF_PAR", par.createParameterString(par.diff).c_str());
+    cmd.addVariable("RENUMBER_PAR", par.createParameterString(par.renumberdbs).c_str());
     cmd.addVariable("VERBOSITY", par.createParameterString(par.onlyverbosity).c_str());
 
     int maxAccept = par.maxAccept;
@@ -348,6 +348,7 @@ int search(int argc, const char **argv, const Command& command) {
         program = std::string(tmpDir + "/searchtargetprofile.sh");
     } else if (par.numIterations > 1) {
         cmd.addVariable("NUM_IT", SSTR(par.numIterations).c_str());
+        cmd.addVariable("SKIP_CONVERGED", par.skipConverged ? "TRUE" : NULL);
         cmd.addVariable("SUBSTRACT_PAR", par.createParameterString(par.subtractdbs).c_str());
         cmd.addVariable("VERBOSITY_PAR", par.createParameterString(par.onlyverbosity).c_str());
 
@@ -417,13 +418,28 @@ int search(int argc, const char **argv, const Command& command) {
                 prefilterWithoutS.push_back(par.prefilter[i]);
             }
         }
+        // prefilter results are only consumed by align or rescorediagonal
+        int originalPrefFormat = par.prefFormat;
+        if (par.PARAM_PREF_FORMAT.wasSet == false) {
+            par.prefFormat = Parameters::PREF_FORMAT_BINARY;
+        }
         cmd.addVariable("PREFILTER_PAR", par.createParameterString(prefilterWithoutS).c_str());
+        par.prefFormat = originalPrefFormat;
         if (isUngappedMode) {
             par.rescoreMode = Parameters::RESCORE_MODE_ALIGNMENT;
             cmd.addVariable("ALIGNMENT_PAR", par.createParameterString(par.rescorediagonal).c_str());
             par.rescoreMode = originalRescoreMode;
         } else {
             cmd.addVariable("ALIGNMENT_PAR", par.createParameterString(par.align).c_str());
+            // prefilter and align share their parameters here, so both run in one process
+            std::vector<MMseqsParameter*> prefilterAlignWithoutS;
+            for (size_t i = 0; i < par.prefilteralign.size(); i++) {
+                if (par.prefilteralign[i]->uniqid != par.PARAM_S.uniqid) {
+                    prefilterAlignWithoutS.push_back(par.prefilteralign[i]);
+                }
+            }
+            cmd.addVariable("PREFILTER_ALIGN", "TRUE");
+            cmd.addVariable("PREFILTER_ALIGN_PAR", par.createParameterString(prefilterAlignWithoutS).c_str());
         }
         FileUtil::writeFile(tmpDir + "/blastp.sh", blastp_sh, blastp_sh_len);
         program = std::string(tmpDir + "/blastp.sh");